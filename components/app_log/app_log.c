@@ -0,0 +1,587 @@
+/**
+ * @file app_log.c
+ * @brief Logging with compile-time levels and deferred formatting.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "app_log.h"
+
+// Argument types, two bits each in app_log_record_t.types
+#define APP_LOG_TYPE_U32               0
+#define APP_LOG_TYPE_U64               1
+#define APP_LOG_TYPE_DOUBLE            2
+#define APP_LOG_TYPE_STRING            3
+
+// Printed for an argument which is missing or of the wrong type
+#define APP_LOG_MISSING                "<?>"
+
+/**
+ * Position in the arguments of a record while it is formatted.
+ */
+typedef struct app_log_reader
+{
+  const app_log_record_t *record;
+  uint8_t index;
+  uint8_t offset;
+} app_log_reader_t;
+
+#if CONFIG_APP_LOG_DEFERRED
+static const char TAG[] = "app_log";
+
+static QueueHandle_t app_log_queue = NULL;
+static uint32_t app_log_dropped = 0;
+static volatile bool app_log_busy = false;
+static portMUX_TYPE app_log_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+void app_log_begin(app_log_record_t *record, int level, const char *tag, const char *format)
+{
+  record->timestamp = esp_log_timestamp();
+  record->tag = tag;
+  record->format = format;
+  record->level = (uint8_t)level;
+  record->count = 0;
+  record->size = 0;
+  record->truncated = 0;
+  record->types = 0;
+}
+
+/**
+ * Appends an argument of type with size bytes of data.
+ * @return where to copy the data, NULL if the record is full.
+ */
+static uint8_t *app_log_put(app_log_record_t *record, uint32_t type, size_t size)
+{
+  uint8_t *data;
+
+  if (record->count >= APP_LOG_MAX_ARGS || size > (size_t)(APP_LOG_DATA_SIZE - record->size))
+  {
+    record->truncated = 1;
+    return NULL;
+  }
+
+  data = record->data + record->size;
+  record->types |= type << (2 * record->count);
+  record->count++;
+  record->size += (uint8_t)size;
+
+  return data;
+}
+
+void app_log_arg_u32(app_log_record_t *record, uint32_t value)
+{
+  uint8_t *data = app_log_put(record, APP_LOG_TYPE_U32, sizeof(value));
+
+  if (data != NULL)
+  {
+    memcpy(data, &value, sizeof(value));
+  }
+}
+
+void app_log_arg_u64(app_log_record_t *record, unsigned long long value)
+{
+  uint64_t wide = value;
+  uint8_t *data = app_log_put(record, APP_LOG_TYPE_U64, sizeof(wide));
+
+  if (data != NULL)
+  {
+    memcpy(data, &wide, sizeof(wide));
+  }
+}
+
+void app_log_arg_i64(app_log_record_t *record, long long value)
+{
+  app_log_arg_u64(record, (unsigned long long)value);
+}
+
+void app_log_arg_long(app_log_record_t *record, long value)
+{
+  if (sizeof(value) > sizeof(uint32_t))
+  {
+    app_log_arg_u64(record, (unsigned long long)value);
+  }
+  else
+  {
+    app_log_arg_u32(record, (uint32_t)value);
+  }
+}
+
+void app_log_arg_ulong(app_log_record_t *record, unsigned long value)
+{
+  if (sizeof(value) > sizeof(uint32_t))
+  {
+    app_log_arg_u64(record, value);
+  }
+  else
+  {
+    app_log_arg_u32(record, (uint32_t)value);
+  }
+}
+
+void app_log_arg_double(app_log_record_t *record, double value)
+{
+  uint8_t *data = app_log_put(record, APP_LOG_TYPE_DOUBLE, sizeof(value));
+
+  if (data != NULL)
+  {
+    memcpy(data, &value, sizeof(value));
+  }
+}
+
+void app_log_arg_ptr(app_log_record_t *record, const void *value)
+{
+  app_log_arg_ulong(record, (unsigned long)(uintptr_t)value);
+}
+
+void app_log_arg_strn(app_log_record_t *record, app_log_strn_t value)
+{
+  size_t length = (value.str == NULL) ? 0 : value.length;
+  uint8_t *data;
+
+  if (length > APP_LOG_STRING_MAX)
+  {
+    length = APP_LOG_STRING_MAX;
+  }
+
+  // Shortened to what is left of the record, the terminator is stored too
+  if (length + 1 > (size_t)(APP_LOG_DATA_SIZE - record->size) && APP_LOG_DATA_SIZE - record->size > 1)
+  {
+    length = APP_LOG_DATA_SIZE - record->size - 1;
+  }
+
+  data = app_log_put(record, APP_LOG_TYPE_STRING, length + 1);
+  if (data != NULL)
+  {
+    memcpy(data, value.str, length);
+    data[length] = '\0';
+  }
+}
+
+void app_log_arg_str(app_log_record_t *record, const char *value)
+{
+  if (value == NULL)
+  {
+    value = "(null)";
+  }
+  app_log_arg_strn(record, APP_LOG_STRN(value, strnlen(value, APP_LOG_STRING_MAX)));
+}
+
+void app_log_arg_ustr(app_log_record_t *record, const unsigned char *value)
+{
+  app_log_arg_str(record, (const char *)value);
+}
+
+/**
+ * Reads the next argument of a record.
+ * @param type set to the APP_LOG_TYPE_* of the argument.
+ * @return the argument data, NULL if the record has no more arguments.
+ */
+static const uint8_t *app_log_next(app_log_reader_t *reader, uint32_t *type)
+{
+  const app_log_record_t *record = reader->record;
+  const uint8_t *data;
+
+  if (reader->index >= record->count)
+  {
+    return NULL;
+  }
+
+  data = record->data + reader->offset;
+  *type = (record->types >> (2 * reader->index)) & 3;
+  reader->index++;
+
+  switch (*type)
+  {
+    case APP_LOG_TYPE_U32:
+      reader->offset += sizeof(uint32_t);
+      break;
+    case APP_LOG_TYPE_STRING:
+      reader->offset += strlen((const char *)data) + 1;
+      break;
+    default:
+      reader->offset += sizeof(uint64_t);
+      break;
+  }
+
+  return data;
+}
+
+/**
+ * Converts a numeric argument to an integer.
+ * @param is_signed true to sign extend 32 bit arguments.
+ * @return false if the argument is a string.
+ */
+static bool app_log_integer(uint32_t type, const uint8_t *data, bool is_signed, uint64_t *value)
+{
+  uint32_t narrow;
+  double real;
+
+  switch (type)
+  {
+    case APP_LOG_TYPE_U32:
+      memcpy(&narrow, data, sizeof(narrow));
+      *value = is_signed ? (uint64_t)(int64_t)(int32_t)narrow : narrow;
+      return true;
+    case APP_LOG_TYPE_U64:
+      memcpy(value, data, sizeof(*value));
+      return true;
+    case APP_LOG_TYPE_DOUBLE:
+      memcpy(&real, data, sizeof(real));
+      *value = (uint64_t)(int64_t)real;
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * Reads the next argument as an integer.
+ * @return false if there is no numeric argument left.
+ */
+static bool app_log_next_integer(app_log_reader_t *reader, bool is_signed, uint64_t *value)
+{
+  uint32_t type;
+  const uint8_t *data = app_log_next(reader, &type);
+
+  return data != NULL && app_log_integer(type, data, is_signed, value);
+}
+
+/**
+ * Appends text to a line, the line stays terminated.
+ */
+static void app_log_append(char *line, size_t *length, const char *text)
+{
+  size_t copied = strlcpy(line + *length, text, APP_LOG_LINE_SIZE - *length);
+
+  *length += (copied < APP_LOG_LINE_SIZE - *length) ? copied : APP_LOG_LINE_SIZE - 1 - *length;
+}
+
+/**
+ * Advances length past what snprintf() wrote to line + length.
+ */
+static void app_log_advance(size_t *length, int written)
+{
+  if (written > 0)
+  {
+    *length += ((size_t)written < APP_LOG_LINE_SIZE - *length) ? (size_t)written : APP_LOG_LINE_SIZE - 1 - *length;
+  }
+}
+
+/**
+ * Formats a record the way printf() formats its format and arguments.
+ * @param line output, APP_LOG_LINE_SIZE bytes.
+ */
+static void app_log_format(const app_log_record_t *record, char *line)
+{
+  app_log_reader_t reader = { .record = record };
+  const char *p = record->format;
+  size_t length = 0;
+
+  line[0] = '\0';
+
+  while (*p != '\0' && length < APP_LOG_LINE_SIZE - 1)
+  {
+    // Conversion specification rebuilt from flags, width and precision, with a length of its own
+    char spec[40] = "%";
+    size_t spec_length = 1;
+    uint64_t value;
+    uint32_t type;
+    const uint8_t *data;
+    char *out = line + length;
+    size_t room = APP_LOG_LINE_SIZE - length;
+
+    if (*p != '%')
+    {
+      line[length++] = *p++;
+      line[length] = '\0';
+      continue;
+    }
+    p++;
+    if (*p == '%')
+    {
+      app_log_append(line, &length, "%");
+      p++;
+      continue;
+    }
+
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL && spec_length < 6)
+    {
+      spec[spec_length++] = *p++;
+    }
+    for (int part = 0; part < 2; part++)
+    {
+      if (part == 1)
+      {
+        if (*p != '.')
+        {
+          break;
+        }
+        spec[spec_length++] = *p++;
+      }
+      if (*p == '*')
+      {
+        p++;
+        value = 0;
+        app_log_next_integer(&reader, true, &value);
+        spec_length += snprintf(spec + spec_length, sizeof(spec) - spec_length, "%d", (int)(int64_t)value);
+      }
+      while (*p >= '0' && *p <= '9')
+      {
+        if (spec_length < 24)
+        {
+          spec[spec_length++] = *p;
+        }
+        p++;
+      }
+    }
+    while (*p != '\0' && strchr("hlLqjzt", *p) != NULL)
+    {
+      p++;
+    }
+    if (*p == '\0')
+    {
+      break;
+    }
+
+    switch (*p)
+    {
+      case 'd':
+      case 'i':
+      case 'u':
+      case 'o':
+      case 'x':
+      case 'X':
+        if (!app_log_next_integer(&reader, *p == 'd' || *p == 'i', &value))
+        {
+          app_log_append(line, &length, APP_LOG_MISSING);
+          break;
+        }
+        spec[spec_length++] = 'l';
+        spec[spec_length++] = 'l';
+        spec[spec_length++] = *p;
+        spec[spec_length] = '\0';
+        app_log_advance(&length, snprintf(out, room, spec, (unsigned long long)value));
+        break;
+
+      case 'c':
+        if (!app_log_next_integer(&reader, false, &value))
+        {
+          app_log_append(line, &length, APP_LOG_MISSING);
+          break;
+        }
+        spec[spec_length++] = 'c';
+        spec[spec_length] = '\0';
+        app_log_advance(&length, snprintf(out, room, spec, (int)value));
+        break;
+
+      case 'p':
+        if (!app_log_next_integer(&reader, false, &value))
+        {
+          app_log_append(line, &length, APP_LOG_MISSING);
+          break;
+        }
+        app_log_advance(&length, snprintf(out, room, "%p", (void *)(uintptr_t)value));
+        break;
+
+      case 'f':
+      case 'F':
+      case 'e':
+      case 'E':
+      case 'g':
+      case 'G':
+      case 'a':
+      case 'A':
+      {
+        double real;
+
+        data = app_log_next(&reader, &type);
+        if (data == NULL || type == APP_LOG_TYPE_STRING)
+        {
+          app_log_append(line, &length, APP_LOG_MISSING);
+          break;
+        }
+        if (type == APP_LOG_TYPE_DOUBLE)
+        {
+          memcpy(&real, data, sizeof(real));
+        }
+        else
+        {
+          app_log_integer(type, data, true, &value);
+          real = (double)(int64_t)value;
+        }
+        spec[spec_length++] = *p;
+        spec[spec_length] = '\0';
+        app_log_advance(&length, snprintf(out, room, spec, real));
+        break;
+      }
+
+      case 's':
+        data = app_log_next(&reader, &type);
+        if (data == NULL || type != APP_LOG_TYPE_STRING)
+        {
+          app_log_append(line, &length, APP_LOG_MISSING);
+          break;
+        }
+        spec[spec_length++] = 's';
+        spec[spec_length] = '\0';
+        app_log_advance(&length, snprintf(out, room, spec, (const char *)data));
+        break;
+
+      default:
+        // Unknown conversion, printed as it is
+        spec[spec_length++] = *p;
+        spec[spec_length] = '\0';
+        app_log_append(line, &length, spec);
+        break;
+    }
+    p++;
+  }
+}
+
+/**
+ * Formats a record and prints it with the timestamp of the log call.
+ */
+static void app_log_write(const app_log_record_t *record)
+{
+  char line[APP_LOG_LINE_SIZE];
+  esp_log_level_t level = (esp_log_level_t)record->level;
+
+  if (esp_log_level_get(record->tag) < level)
+  {
+    return;
+  }
+
+  app_log_format(record, line);
+
+  switch (level)
+  {
+    case ESP_LOG_ERROR:
+      esp_log_write(level, record->tag, LOG_FORMAT(E, "%s"), record->timestamp, record->tag, line);
+      break;
+    case ESP_LOG_WARN:
+      esp_log_write(level, record->tag, LOG_FORMAT(W, "%s"), record->timestamp, record->tag, line);
+      break;
+    case ESP_LOG_INFO:
+      esp_log_write(level, record->tag, LOG_FORMAT(I, "%s"), record->timestamp, record->tag, line);
+      break;
+    case ESP_LOG_DEBUG:
+      esp_log_write(level, record->tag, LOG_FORMAT(D, "%s"), record->timestamp, record->tag, line);
+      break;
+    default:
+      esp_log_write(level, record->tag, LOG_FORMAT(V, "%s"), record->timestamp, record->tag, line);
+      break;
+  }
+}
+
+#if CONFIG_APP_LOG_DEFERRED
+
+/**
+ * Formats and prints the queued records.
+ * @param pvParam parameter which can be passed to the task.
+ */
+static void app_log_task(void *pvParam)
+{
+  app_log_record_t record;
+  uint32_t reported = 0;
+
+  for (;;)
+  {
+    if (xQueueReceive(app_log_queue, &record, portMAX_DELAY) != pdTRUE)
+    {
+      continue;
+    }
+    app_log_busy = true;
+
+    taskENTER_CRITICAL(&app_log_lock);
+    uint32_t dropped = app_log_dropped;
+    taskEXIT_CRITICAL(&app_log_lock);
+
+    if (dropped != reported)
+    {
+      ESP_LOGW(TAG, "%" PRIu32 " log records dropped", dropped - reported);
+      reported = dropped;
+    }
+
+    app_log_write(&record);
+    app_log_busy = false;
+  }
+}
+
+void app_log_init(void)
+{
+  if (app_log_queue != NULL)
+  {
+    return;
+  }
+
+  QueueHandle_t queue = xQueueCreate(CONFIG_APP_LOG_QUEUE_LENGTH, sizeof(app_log_record_t));
+  if (queue == NULL)
+  {
+    ESP_LOGE(TAG, "app_log_init: No memory for the queue, formatting in place");
+    return;
+  }
+
+  if (xTaskCreatePinnedToCore(&app_log_task, "app_log", APP_LOG_TASK_STACK_SIZE, NULL,
+                              APP_LOG_TASK_PRIORITY, NULL, APP_LOG_TASK_CORE_ID) != pdPASS)
+  {
+    ESP_LOGE(TAG, "app_log_init: Failed to start the task, formatting in place");
+    vQueueDelete(queue);
+    return;
+  }
+
+  app_log_queue = queue;
+}
+
+void app_log_flush(uint32_t timeout_ms)
+{
+  TickType_t start = xTaskGetTickCount();
+
+  while (app_log_queue != NULL && (uxQueueMessagesWaiting(app_log_queue) > 0 || app_log_busy) &&
+         xTaskGetTickCount() - start < pdMS_TO_TICKS(timeout_ms))
+  {
+    vTaskDelay(1);
+  }
+}
+
+void app_log_commit(const app_log_record_t *record)
+{
+  if (app_log_queue == NULL)
+  {
+    app_log_write(record);
+    return;
+  }
+
+  if (xQueueSend(app_log_queue, record, 0) != pdTRUE)
+  {
+    taskENTER_CRITICAL(&app_log_lock);
+    app_log_dropped++;
+    taskEXIT_CRITICAL(&app_log_lock);
+  }
+}
+
+#else
+
+void app_log_init(void)
+{
+}
+
+void app_log_flush(uint32_t timeout_ms)
+{
+  (void)timeout_ms;
+}
+
+void app_log_commit(const app_log_record_t *record)
+{
+  app_log_write(record);
+}
+
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file app_log.h
+ * @brief Logging with compile-time levels and deferred formatting.
+ *
+ * APP_LOGx() records the address of the format string, a literal which stays in flash, and the
+ * binary value of each argument in a fixed size record, then queues the record without blocking.
+ * A low priority task formats the records and prints them with esp_log_write(), so the logging
+ * task pays for a few stores instead of a vprintf and a UART write. Records logged while the
+ * queue is full are dropped and counted, before app_log_init() they are formatted in place.
+ *
+ * A source file may define APP_LOG_LEVEL before including this header, calls above that level
+ * compile to nothing. The default is CONFIG_APP_LOG_DEFAULT_LEVEL, the runtime level of
+ * esp_log_level_set() still applies to the rest.
+ *
+ * Arguments are captured by type: integers up to 64 bits, floating point, pointers and strings.
+ * Strings are copied, at most APP_LOG_STRING_MAX characters, use APP_LOG_STRN() for strings
+ * which are not NUL terminated. Length modifiers of the format are ignored, so "%d", "%ld" and
+ * "%" PRId32 all print the captured value. Not for use from interrupt handlers.
+ */
+#ifndef APP_LOG_H_
+#define APP_LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+// Levels, the same values as esp_log_level_t
+#define APP_LOG_NONE                   0
+#define APP_LOG_ERROR                  1
+#define APP_LOG_WARN                   2
+#define APP_LOG_INFO                   3
+#define APP_LOG_DEBUG                  4
+#define APP_LOG_VERBOSE                5
+
+#ifndef APP_LOG_LEVEL
+#define APP_LOG_LEVEL                  CONFIG_APP_LOG_DEFAULT_LEVEL
+#endif
+
+// Arguments and bytes of argument data a record holds, further arguments print as <?>
+#define APP_LOG_MAX_ARGS               12
+#define APP_LOG_DATA_SIZE              64
+
+// Characters copied of a string argument
+#define APP_LOG_STRING_MAX             32
+
+// Longest formatted message
+#define APP_LOG_LINE_SIZE              256
+
+// Formatting task, below every application task
+#define APP_LOG_TASK_STACK_SIZE        3072
+#define APP_LOG_TASK_PRIORITY          1
+#define APP_LOG_TASK_CORE_ID           0
+
+/**
+ * A log call waiting to be formatted.
+ */
+typedef struct app_log_record
+{
+  uint32_t timestamp;                 // esp_log_timestamp() of the call
+  const char *tag;
+  const char *format;
+  uint8_t level;
+  uint8_t count;                      // Arguments captured
+  uint8_t size;                       // Bytes of data used
+  uint8_t truncated;                  // Arguments left out for lack of room
+  uint32_t types;                     // Type of argument n in bits 2n and 2n+1
+  uint8_t data[APP_LOG_DATA_SIZE];
+} app_log_record_t;
+
+/**
+ * A string argument with a length, captured by APP_LOG_STRN().
+ */
+typedef struct app_log_strn
+{
+  const char *str;
+  size_t length;
+} app_log_strn_t;
+
+/**
+ * Logs at level if it is compiled in.
+ * @param level APP_LOG_ERROR to APP_LOG_VERBOSE.
+ * @param tag tag of the module, must stay valid.
+ * @param ... format string literal followed by up to APP_LOG_MAX_ARGS arguments.
+ */
+#define APP_LOG_AT(level, tag, ...)                                                               \
+  do                                                                                              \
+  {                                                                                               \
+    if ((level) <= APP_LOG_LEVEL)                                                                 \
+    {                                                                                             \
+      APP_LOG_WRITE(level, tag, __VA_ARGS__);                                                     \
+    }                                                                                             \
+  } while (0)
+
+#define APP_LOGE(tag, ...)             APP_LOG_AT(APP_LOG_ERROR, tag, __VA_ARGS__)
+#define APP_LOGW(tag, ...)             APP_LOG_AT(APP_LOG_WARN, tag, __VA_ARGS__)
+#define APP_LOGI(tag, ...)             APP_LOG_AT(APP_LOG_INFO, tag, __VA_ARGS__)
+#define APP_LOGD(tag, ...)             APP_LOG_AT(APP_LOG_DEBUG, tag, __VA_ARGS__)
+#define APP_LOGV(tag, ...)             APP_LOG_AT(APP_LOG_VERBOSE, tag, __VA_ARGS__)
+
+/**
+ * String argument of length characters at str, printed with "%s".
+ */
+#define APP_LOG_STRN(str, length)      ((app_log_strn_t){ (const char *)(str), (size_t)(length) })
+
+/**
+ * Logs regardless of APP_LOG_LEVEL, for libraries which have their own level settings.
+ */
+#define APP_LOG_WRITE(level, tag, ...)                                                            \
+  do                                                                                              \
+  {                                                                                               \
+    app_log_record_t app_log_record_;                                                             \
+    app_log_begin(&app_log_record_, (level), (tag), "" APP_LOG_FORMAT_(__VA_ARGS__, ~));          \
+    APP_LOG_CAT_(APP_LOG_CAPTURE_, APP_LOG_NARGS_(__VA_ARGS__))(&app_log_record_, __VA_ARGS__)    \
+    app_log_commit(&app_log_record_);                                                             \
+  } while (0)
+
+#define APP_LOG_ARG_(record, value)                                                               \
+  _Generic((value),                                                                               \
+    char *: app_log_arg_str,                                                                      \
+    const char *: app_log_arg_str,                                                                \
+    unsigned char *: app_log_arg_ustr,                                                            \
+    const unsigned char *: app_log_arg_ustr,                                                      \
+    app_log_strn_t: app_log_arg_strn,                                                             \
+    void *: app_log_arg_ptr,                                                                      \
+    const void *: app_log_arg_ptr,                                                                \
+    float: app_log_arg_double,                                                                    \
+    double: app_log_arg_double,                                                                   \
+    long: app_log_arg_long,                                                                       \
+    unsigned long: app_log_arg_ulong,                                                             \
+    long long: app_log_arg_i64,                                                                   \
+    unsigned long long: app_log_arg_u64,                                                          \
+    default: app_log_arg_u32)(record, value);
+
+#define APP_LOG_FORMAT_(format, ...)   format
+#define APP_LOG_CAT_(a, b)             APP_LOG_CAT2_(a, b)
+#define APP_LOG_CAT2_(a, b)            a##b
+#define APP_LOG_NARGS_(...)            APP_LOG_NARGS2_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, ~)
+#define APP_LOG_NARGS2_(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12, n, ...) n
+
+#define APP_LOG_CAPTURE_0(r, f)
+#define APP_LOG_CAPTURE_1(r, f, a)      APP_LOG_ARG_(r, a)
+#define APP_LOG_CAPTURE_2(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_1(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_3(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_2(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_4(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_3(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_5(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_4(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_6(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_5(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_7(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_6(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_8(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_7(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_9(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_8(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_10(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_9(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_11(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_10(r, f, __VA_ARGS__)
+#define APP_LOG_CAPTURE_12(r, f, a, ...) APP_LOG_ARG_(r, a) APP_LOG_CAPTURE_11(r, f, __VA_ARGS__)
+
+/**
+ * Starts the task which formats the records. Records logged before are formatted in place.
+ */
+void app_log_init(void);
+
+/**
+ * Waits until the queued records are printed, e.g. before a restart.
+ * @param timeout_ms longest wait.
+ */
+void app_log_flush(uint32_t timeout_ms);
+
+// Used by the macros above
+void app_log_begin(app_log_record_t *record, int level, const char *tag, const char *format);
+void app_log_arg_u32(app_log_record_t *record, uint32_t value);
+void app_log_arg_u64(app_log_record_t *record, unsigned long long value);
+void app_log_arg_i64(app_log_record_t *record, long long value);
+void app_log_arg_long(app_log_record_t *record, long value);
+void app_log_arg_ulong(app_log_record_t *record, unsigned long value);
+void app_log_arg_double(app_log_record_t *record, double value);
+void app_log_arg_ptr(app_log_record_t *record, const void *value);
+void app_log_arg_str(app_log_record_t *record, const char *value);
+void app_log_arg_ustr(app_log_record_t *record, const unsigned char *value);
+void app_log_arg_strn(app_log_record_t *record, app_log_strn_t value);
+void app_log_commit(const app_log_record_t *record);
+
+#endif /* APP_LOG_H_ */
@@ -0,0 +1,203 @@
+/*
+ * Fuzzes every parser entry point on one input and keeps track of the worst
+ * time spent per input byte, so that inputs which make the parser do more
+ * than linear work are noticed even when they do not crash it.
+ *
+ * An input is split at its first newline: the bytes before it are the query
+ * for JSON_SearchConst and JSON_SearchBatch, the bytes after it the document.
+ * Input without a newline is all document, searched with an empty query.
+ *
+ * Each new worst case of at least FUZZ_MIN_TIMED_SIZE bytes is timed again
+ * and, if it holds, printed.  When
+ * JSON_FUZZ_MAX_NS_PER_BYTE is set in the environment, an input slower than
+ * that aborts, which makes libFuzzer save it as a crash.
+ */
+
+#define _POSIX_C_SOURCE    199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <core_json.h>
+
+/* Shorter inputs are not timed; the cost of the calls themselves dominates. */
+#define FUZZ_MIN_TIMED_SIZE    256U
+
+/* Longest query taken from an input. */
+#define FUZZ_MAX_QUERY         64U
+
+/* Extra runs of an input that looks like a new worst case. */
+#define FUZZ_RETIMES           4U
+
+static double worstNsPerByte = 0.0;
+static double limitNsPerByte = 0.0;
+static volatile size_t sink;
+
+int LLVMFuzzerInitialize( int * argc,
+                          char *** argv )
+{
+    const char * limit = getenv( "JSON_FUZZ_MAX_NS_PER_BYTE" );
+
+    ( void ) argc;
+    ( void ) argv;
+
+    if( limit != NULL )
+    {
+        limitNsPerByte = strtod( limit, NULL );
+    }
+
+    return 0;
+}
+
+/* Visit every value of a valid document, descending into collections. */
+static void walk( const char * buf,
+                  size_t max )
+{
+    size_t start = 0U, next = 0U;
+    JSONPair_t pair;
+
+    while( JSON_Iterate( buf, max, &start, &next, &pair ) == JSONSuccess )
+    {
+        if( ( pair.jsonType == JSONObject ) || ( pair.jsonType == JSONArray ) )
+        {
+            walk( pair.value, pair.valueLength );
+        }
+    }
+}
+
+/* Read every byte reported, so that the sanitizers check the pointers. */
+static void touch( void * pContext,
+                   const JSONPair_t * pPair )
+{
+    size_t i, sum = 0U;
+
+    ( void ) pContext;
+
+    for( i = 0U; i < pPair->keyLength; i++ )
+    {
+        sum += ( uint8_t ) pPair->key[ i ];
+    }
+
+    for( i = 0U; ( pPair->value != NULL ) && ( i < pPair->valueLength ); i++ )
+    {
+        sum += ( uint8_t ) pPair->value[ i ];
+    }
+
+    sink = sum;
+}
+
+static double now( void )
+{
+    struct timespec ts;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return ( ( double ) ts.tv_sec * 1e9 ) + ( double ) ts.tv_nsec;
+}
+
+/* Run every entry point over one document; returns the status of the stream. */
+static JSONStatus_t parse( const char * buf,
+                           size_t max,
+                           const char * query,
+                           size_t queryLength,
+                           JSONStatus_t * validated )
+{
+    JSONStatus_t streamed = JSONPartial;
+    JSONStream_t stream;
+    JSONQuery_t batch;
+    const char * value;
+    size_t valueLength, offset, piece;
+    JSONTypes_t type;
+
+    *validated = JSON_Validate( buf, max );
+
+    if( *validated == JSONSuccess )
+    {
+        walk( buf, max );
+        ( void ) JSON_SearchConst( buf, max, query, queryLength, &value, &valueLength, &type );
+
+        batch.query = query;
+        batch.queryLength = queryLength;
+        ( void ) JSON_SearchBatch( buf, max, &batch, 1U );
+    }
+
+    /* Feed the document in pieces of 1 to 61 bytes, depending on its length. */
+    piece = 1U + ( max % 61U );
+    ( void ) JSON_StreamInit( &stream, touch, NULL );
+
+    for( offset = 0U; ( offset < max ) && ( ( streamed == JSONPartial ) || ( streamed == JSONSuccess ) ); offset += piece )
+    {
+        streamed = JSON_StreamFeed( &stream, &buf[ offset ], ( ( max - offset ) < piece ) ? ( max - offset ) : piece );
+    }
+
+    if( streamed == JSONPartial )
+    {
+        streamed = JSON_StreamFinish( &stream );
+    }
+
+    return streamed;
+}
+
+int LLVMFuzzerTestOneInput( const uint8_t * data,
+                            size_t size )
+{
+    const char * buf = ( const char * ) data;
+    const char * query = "";
+    size_t queryLength = 0U, max = size;
+    const uint8_t * newline = memchr( data, '\n', ( size < FUZZ_MAX_QUERY ) ? size : FUZZ_MAX_QUERY );
+    JSONStatus_t validated, streamed;
+    double start, elapsed, nsPerByte;
+    unsigned i;
+
+    if( newline != NULL )
+    {
+        query = buf;
+        queryLength = ( size_t ) ( newline - data );
+        buf = ( const char * ) &newline[ 1 ];
+        max = size - queryLength - 1U;
+    }
+
+    start = now();
+    streamed = parse( buf, max, query, queryLength, &validated );
+    nsPerByte = ( now() - start ) / ( double ) size;
+
+    /* The stream is stricter than JSON_Validate, never more lenient. */
+    if( ( streamed == JSONSuccess ) && ( validated != JSONSuccess ) )
+    {
+        ( void ) fprintf( stderr, "stream accepted a document JSON_Validate rejects (%d)\n", ( int ) validated );
+        abort();
+    }
+
+    if( ( size >= FUZZ_MIN_TIMED_SIZE ) && ( nsPerByte > worstNsPerByte ) )
+    {
+        /* A single run is easily slowed down by preemption or a cold cache;
+         * keep the fastest of a few more before believing it. */
+        for( i = 0U; i < FUZZ_RETIMES; i++ )
+        {
+            start = now();
+            ( void ) parse( buf, max, query, queryLength, &validated );
+            elapsed = ( now() - start ) / ( double ) size;
+
+            if( elapsed < nsPerByte )
+            {
+                nsPerByte = elapsed;
+            }
+        }
+    }
+
+    if( ( size >= FUZZ_MIN_TIMED_SIZE ) && ( nsPerByte > worstNsPerByte ) )
+    {
+        worstNsPerByte = nsPerByte;
+        ( void ) fprintf( stderr, "worst case: %.1f ns/byte over %zu bytes\n", nsPerByte, size );
+
+        if( ( limitNsPerByte > 0.0 ) && ( nsPerByte > limitNsPerByte ) )
+        {
+            abort();
+        }
+    }
+
+    return 0;
+}
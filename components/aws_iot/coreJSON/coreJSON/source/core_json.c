@@ -30,6 +30,7 @@
 #include <limits.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include "core_json.h"
 
 /** @cond DO_NOT_DOCUMENT */
@@ -61,6 +62,142 @@ typedef union
 #define isSquareOpen_( x )            ( ( x ) == '[' )
 #define isSquareClose_( x )           ( ( x ) == ']' )
 
+/**
+ * @brief Scan string bodies a machine word at a time.
+ *
+ * Off by default, define as 1 to enable it.  It only pays off on long runs
+ * of plain ASCII: shadow documents parse a few percent faster, while text
+ * with many UTF-8 sequences or escapes parses 10-25% slower, since each
+ * short run between them pays for a word load that finds a special byte
+ * at once.  Measure with test/benchmark before enabling it.  Word loads go
+ * through memcpy(), so targets that trap on unaligned access fall back to
+ * byte loads and gain little from this.
+ *
+ * Whitespace is always scanned byte by byte: runs are short, and any call
+ * in skipSpace() stops compilers inlining it at its many call sites.
+ */
+#ifndef JSON_WORD_SCAN
+    #define JSON_WORD_SCAN    0
+#endif
+
+/* A byte that a string body may contain verbatim. */
+#define isplain_( x ) \
+    ( isascii_( x ) && !iscntrl_( x ) && ( ( x ) != '"' ) && ( ( x ) != '\\' ) )
+
+#if ( JSON_WORD_SCAN != 0 )
+
+/* The scanners treat a size_t as a vector of bytes (SWAR). */
+    #define WORD_SIZE_          ( sizeof( size_t ) )
+    #define WORD_ONES_          ( ( ( size_t ) ~( ( size_t ) 0U ) ) / 0xFFU )
+    #define WORD_HIGHS_         ( WORD_ONES_ * 0x80U )
+    #define wordRepeat_( c )    ( WORD_ONES_ * ( size_t ) ( c ) )
+
+/* On little-endian targets the lowest set bit belongs to the first byte in memory. */
+    #if defined( __GNUC__ ) && defined( __BYTE_ORDER__ ) && ( __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ )
+        #define firstMarkedByte_( m )    ( ( size_t ) __builtin_ctzll( m ) / 8U )
+    #endif
+
+/**
+ * @brief Load a word from a buffer without alignment requirements.
+ *
+ * @param[in] buf  The buffer to read.
+ * @param[in] i  The index of the first byte; i + WORD_SIZE_ must not exceed the buffer size.
+ *
+ * @return the bytes as a word in native byte order.
+ */
+static size_t loadWord( const char * buf,
+                        size_t i )
+{
+    size_t w;
+
+    ( void ) memcpy( &w, &buf[ i ], WORD_SIZE_ );
+
+    return w;
+}
+
+/**
+ * @brief Find the bytes of a word that a string body may not contain
+ * verbatim.
+ *
+ * Plain bytes are printable ASCII other than the double quote and the
+ * backslash; anything else needs the byte-wise scanner.
+ *
+ * @param[in] w  The word to test.
+ *
+ * @return zero if every byte is plain; otherwise a mask in which the
+ * high bit of the first special byte is set (later bits may be spurious).
+ */
+static size_t specialBytes( size_t w )
+{
+    size_t quote = w ^ wordRepeat_( '"' );
+    size_t backslash = w ^ wordRepeat_( '\\' );
+    size_t special;
+
+    special = ( quote - WORD_ONES_ ) & ~quote;
+    special |= ( backslash - WORD_ONES_ ) & ~backslash;
+    /* A control character, i.e. below the space. */
+    special |= ( w - wordRepeat_( ' ' ) ) & ~w;
+    /* The start or continuation of a multi-byte UTF-8 sequence. */
+    special |= w;
+
+    return special & WORD_HIGHS_;
+}
+
+/**
+ * @brief Advance buffer index over plain string body.
+ *
+ * The first word's worth is scanned byte by byte; past that, whole words
+ * are skipped while they are plain.  Where the byte order allows it, the
+ * first special byte is then located within the word directly; otherwise
+ * the rest of the run is scanned byte by byte.  Stops at the first quote,
+ * backslash, control character or non-ASCII byte, which the caller must
+ * examine.
+ *
+ * @param[in] buf  The buffer to parse.
+ * @param[in,out] start  The index at which to begin.
+ * @param[in] max  The size of the buffer.
+ */
+static void skipPlainChars( const char * buf,
+                            size_t * start,
+                            size_t max )
+{
+    size_t i = *start, limit, special;
+
+    /* Short runs, such as most keys, are cheaper to scan byte by byte. */
+    limit = ( ( max - i ) > WORD_SIZE_ ) ? ( i + WORD_SIZE_ ) : max;
+
+    while( ( i < limit ) && isplain_( buf[ i ] ) )
+    {
+        i++;
+    }
+
+    if( i == limit )
+    {
+        while( ( max - i ) >= WORD_SIZE_ )
+        {
+            special = specialBytes( loadWord( buf, i ) );
+
+            if( special != 0U )
+            {
+                #ifdef firstMarkedByte_
+                    i += firstMarkedByte_( special );
+                #endif
+                break;
+            }
+
+            i += WORD_SIZE_;
+        }
+
+        while( ( i < max ) && isplain_( buf[ i ] ) )
+        {
+            i++;
+        }
+    }
+
+    *start = i;
+}
+#endif /* if ( JSON_WORD_SCAN != 0 ) */
+
 /**
  * @brief Advance buffer index beyond whitespace.
  *
@@ -522,6 +659,15 @@ static bool skipString( const char * buf,
 
         while( i < max )
         {
+            #if ( JSON_WORD_SCAN != 0 )
+                skipPlainChars( buf, &i, max );
+
+                if( i >= max )
+                {
+                    break;
+                }
+            #endif
+
             if( buf[ i ] == '"' )
             {
                 ret = true;
@@ -1072,9 +1218,6 @@ static void skipScalars( const char * buf,
  * #JSONMaxDepthExceeded if object and array nesting exceeds a threshold;
  * #JSONPartial if the buffer contents are potentially valid but incomplete.
  */
-#ifndef JSON_MAX_DEPTH
-    #define JSON_MAX_DEPTH    32
-#endif
 static JSONStatus_t skipCollection( const char * buf,
                                     size_t * start,
                                     size_t max )
@@ -1727,71 +1870,356 @@ JSONStatus_t JSON_SearchT( char * buf,
 /** @cond DO_NOT_DOCUMENT */
 
 /**
- * @brief Output the next key-value pair or value from a collection.
+ * @brief Advance an index beyond the next part of a query.
+ *
+ * The part is either a key, or an array index in square brackets;
+ * a separator following the part is also skipped.
+ *
+ * @param[in] query  The query to parse.
+ * @param[in,out] start  The index at which to begin.
+ * @param[in] queryLength  The length of the query.
+ * @param[out] outKeyLength  A pointer to receive the length of a key part, or 0.
+ * @param[out] outIndex  A pointer to receive the value of an index part, or -1.
+ *
+ * @return #JSONSuccess if a part was present;
+ * #JSONBadParameter if the part is empty, or followed by a trailing
+ * separator, or an index is malformed or too large to convert.
+ */
+static JSONStatus_t nextQueryPart( const char * query,
+                                   size_t * start,
+                                   size_t queryLength,
+                                   size_t * outKeyLength,
+                                   int32_t * outIndex )
+{
+    JSONStatus_t ret = JSONSuccess;
+    size_t i = 0U, keyLength = 0U;
+    int32_t queryIndex = -1;
+
+    coreJSON_ASSERT( ( query != NULL ) && ( start != NULL ) && ( queryLength > 0U ) );
+    coreJSON_ASSERT( ( outKeyLength != NULL ) && ( outIndex != NULL ) );
+
+    i = *start;
+
+    if( ( i < queryLength ) && isSquareOpen_( query[ i ] ) )
+    {
+        i++;
+
+        ( void ) skipDigits( query, &i, queryLength, &queryIndex );
+
+        if( ( queryIndex < 0 ) ||
+            ( i >= queryLength ) || !isSquareClose_( query[ i ] ) )
+        {
+            ret = JSONBadParameter;
+        }
+        else
+        {
+            i++;
+        }
+    }
+    else if( ( skipQueryPart( query, &i, queryLength, &keyLength ) != true ) ||
+             /* catch an empty key part or a trailing separator */
+             ( i == ( queryLength - 1U ) ) )
+    {
+        ret = JSONBadParameter;
+    }
+    else
+    {
+        /* MISRA 15.7 */
+    }
+
+    if( ret == JSONSuccess )
+    {
+        if( ( i < queryLength ) && isSeparator_( query[ i ] ) )
+        {
+            i++;
+        }
+
+        *start = i;
+        *outKeyLength = keyLength;
+        *outIndex = queryIndex;
+    }
+
+    return ret;
+}
+
+/**
+ * @brief Advance the queries waiting inside a collection past a member
+ * whose key or index matches their next part.
+ *
+ * @param[in,out] queries  The queries of the batch.
+ * @param[in] queryCount  The number of queries.
+ * @param[in] depth  The depth of the collection.
+ * @param[in] key  The key of an object member, or NULL for an array element.
+ * @param[in] keyLength  The length of the key.
+ * @param[in] index  The index of an array element.
+ */
+static void matchMember( JSONQuery_t * queries,
+                         size_t queryCount,
+                         int16_t depth,
+                         const char * key,
+                         size_t keyLength,
+                         uint32_t index )
+{
+    size_t n, next, partLength;
+    int32_t partIndex;
+    bool match;
+
+    for( n = 0U; n < queryCount; n++ )
+    {
+        JSONQuery_t * q = &queries[ n ];
+
+        if( ( q->value == NULL ) && ( q->depth == depth ) )
+        {
+            next = q->next;
+
+            /* The queries were checked before the search began. */
+            ( void ) nextQueryPart( q->query, &next, q->queryLength, &partLength, &partIndex );
+
+            if( key == NULL )
+            {
+                match = ( partIndex >= 0 ) && ( ( uint32_t ) partIndex == index );
+            }
+            else
+            {
+                match = ( partIndex < 0 ) && ( partLength == keyLength ) &&
+                        ( strnEq( &q->query[ q->next ], key, keyLength ) == true );
+            }
+
+            if( match == true )
+            {
+                q->next = next;
+                q->depth = depth + 1;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Settle the queries that matched a value, once its end is known.
+ *
+ * Queries that matched the value in full are found; queries that matched
+ * only its key or index are not, as only the first match is searched.
+ *
+ * @param[in] buf  The buffer being searched.
+ * @param[in,out] queries  The queries of the batch.
+ * @param[in] queryCount  The number of queries.
+ * @param[in] depth  The depth of the value.
+ * @param[in] end  The index just past the value.
+ *
+ * @return the number of queries settled.
+ */
+static size_t settleQueries( const char * buf,
+                             JSONQuery_t * queries,
+                             size_t queryCount,
+                             int16_t depth,
+                             size_t end )
+{
+    size_t n, settled = 0U;
+
+    for( n = 0U; n < queryCount; n++ )
+    {
+        JSONQuery_t * q = &queries[ n ];
+
+        if( q->depth == depth )
+        {
+            if( q->value != NULL )
+            {
+                /* MISRA Ref 18.2.1 [Pointer subtraction] */
+                q->valueLength = end - ( size_t ) ( q->value - buf );
+            }
+
+            q->depth = -1;
+            settled++;
+        }
+    }
+
+    return settled;
+}
+
+/**
+ * @brief Handle a value that some queries have matched so far.
+ *
+ * Queries that end here record the value's start.  The others can only
+ * match inside the value, if it is an object and their next part is a
+ * key, or an array and their next part is an index.
+ *
+ * @param[in] buf  The buffer being searched.
+ * @param[in] start  The index of the value.
+ * @param[in,out] queries  The queries of the batch.
+ * @param[in] queryCount  The number of queries.
+ * @param[in] depth  The depth of the value.
+ *
+ * @return true if any query needs to descend into the value;
+ * false otherwise.
+ */
+static bool visitValue( const char * buf,
+                        size_t start,
+                        JSONQuery_t * queries,
+                        size_t queryCount,
+                        int16_t depth )
+{
+    size_t n;
+    bool descend = false;
+
+    for( n = 0U; n < queryCount; n++ )
+    {
+        JSONQuery_t * q = &queries[ n ];
+
+        if( ( q->value == NULL ) && ( q->depth == depth ) )
+        {
+            if( q->next == q->queryLength )
+            {
+                q->value = &buf[ start ];
+            }
+            else if( ( ( buf[ start ] == '{' ) && !isSquareOpen_( q->query[ q->next ] ) ) ||
+                     ( ( buf[ start ] == '[' ) && isSquareOpen_( q->query[ q->next ] ) ) )
+            {
+                descend = true;
+            }
+            else
+            {
+                /* Settled as not found once the value is skipped. */
+            }
+        }
+    }
+
+    return descend;
+}
+
+/* Where batchSearch() is within the document. */
+typedef enum
+{
+    batchAtValue,    /* At a value, which may be entered or skipped. */
+    batchAfterValue, /* Just past a value. */
+    batchAtMember,   /* At an object key or array element. */
+    batchAtClose     /* At the end of a collection. */
+} batchState_t;
+
+/**
+ * @brief Resolve a batch of queries in one walk of the document.
+ *
+ * The walk enters only collections that some query descends into; any
+ * other value is skipped whole.  A query matching a collection that is
+ * entered for other queries records its start on the way in, and its
+ * length when the collection closes.
  *
  * @param[in] buf  The buffer to search.
  * @param[in] max  size of the buffer.
- * @param[in] start  The index at which the collection begins.
- * @param[in,out] next  The index at which to seek the next value.
- * @param[out] outKey  A pointer to receive the index of the value found.
- * @param[out] outKeyLength  A pointer to receive the length of the value found.
- * @param[out] outValue  A pointer to receive the index of the value found.
- * @param[out] outValueLength  A pointer to receive the length of the value found.
+ * @param[in,out] queries  The queries of the batch, each with depth 0 and next 0.
+ * @param[in] queryCount  The number of queries.
  *
- * @return #JSONSuccess if a value is output;
- * #JSONIllegalDocument if the buffer does not begin with '[' or '{';
- * #JSONNotFound if there are no further values in the collection.
+ * @note Queries whose value is not NULL on return were found.
  */
-static JSONStatus_t iterate( const char * buf,
-                             size_t max,
-                             size_t * start,
-                             size_t * next,
-                             size_t * outKey,
-                             size_t * outKeyLength,
-                             size_t * outValue,
-                             size_t * outValueLength )
+static void batchSearch( const char * buf,
+                         size_t max,
+                         JSONQuery_t * queries,
+                         size_t queryCount )
 {
-    JSONStatus_t ret = JSONNotFound;
-    bool found = false;
+    char stack[ JSON_MAX_DEPTH ];
+    uint32_t index[ JSON_MAX_DEPTH ];
+    size_t i = 0U, n = 0U, key = 0U, value = 0U, valueLength = 0U, remaining = queryCount;
+    int16_t depth = 0;
+    batchState_t state = batchAtValue;
+    bool ok = true;
 
-    coreJSON_ASSERT( ( buf != NULL ) && ( max > 0U ) );
-    coreJSON_ASSERT( ( start != NULL ) && ( next != NULL ) );
-    coreJSON_ASSERT( ( outKey != NULL ) && ( outKeyLength != NULL ) );
-    coreJSON_ASSERT( ( outValue != NULL ) && ( outValueLength != NULL ) );
+    coreJSON_ASSERT( ( buf != NULL ) && ( max > 0U ) && ( queries != NULL ) );
 
-    if( *start < max )
+    skipSpace( buf, &i, max );
+
+    /* depth is the number of collections entered, and so the depth of
+     * the current value or member. */
+    while( ( ok == true ) && ( remaining > 0U ) )
     {
-        switch( buf[ *start ] )
+        switch( state )
         {
-            case '[':
-                found = nextValue( buf, next, max, outValue, outValueLength );
+            case batchAtValue:
 
-                if( found == true )
+                if( ( i < max ) && ( depth < JSON_MAX_DEPTH ) &&
+                    ( visitValue( buf, i, queries, queryCount, depth ) == true ) )
                 {
-                    *outKey = 0;
-                    *outKeyLength = 0;
+                    stack[ depth ] = buf[ i ];
+                    index[ depth ] = 0U;
+                    depth++;
+                    i++;
+                    skipSpace( buf, &i, max );
+                    state = ( ( i < max ) && isCloseBracket_( buf[ i ] ) ) ? batchAtClose : batchAtMember;
+                }
+                else
+                {
+                    ok = nextValue( buf, &i, max, &value, &valueLength );
+                    state = batchAfterValue;
                 }
 
                 break;
 
-            case '{':
-                found = nextKeyValuePair( buf, next, max, outKey, outKeyLength,
-                                          outValue, outValueLength );
+            case batchAfterValue:
+                remaining -= settleQueries( buf, queries, queryCount, depth, i );
+
+                if( depth == 0 )
+                {
+                    /* The whole document has been walked. */
+                    ok = false;
+                }
+                else if( skipSpaceAndComma( buf, &i, max ) == true )
+                {
+                    index[ depth - 1 ]++;
+                    state = batchAtMember;
+                }
+                else
+                {
+                    state = batchAtClose;
+                }
+
                 break;
 
-            default:
-                ret = JSONIllegalDocument;
+            case batchAtMember:
+
+                if( stack[ depth - 1 ] == '[' )
+                {
+                    matchMember( queries, queryCount, depth - 1, NULL, 0U, index[ depth - 1 ] );
+                }
+                else
+                {
+                    key = i;
+                    ok = skipString( buf, &i, max );
+
+                    if( ok == true )
+                    {
+                        /* The key without its quotes. */
+                        matchMember( queries, queryCount, depth - 1,
+                                     &buf[ key + 1U ], i - key - 2U, 0U );
+                        skipSpace( buf, &i, max );
+                        ok = ( i < max ) && ( buf[ i ] == ':' );
+                    }
+
+                    if( ok == true )
+                    {
+                        i++;
+                        skipSpace( buf, &i, max );
+                    }
+                }
+
+                state = batchAtValue;
+                break;
+
+            default: /* batchAtClose */
+                ok = ( i < max ) && isMatchingBracket_( stack[ depth - 1 ], buf[ i ] );
+                i++;
+                depth--;
+                state = batchAfterValue;
                 break;
         }
     }
 
-    if( found == true )
+    /* A value whose end was never reached is not found. */
+    for( n = 0U; n < queryCount; n++ )
     {
-        ret = JSONSuccess;
-        ( void ) skipSpaceAndComma( buf, next, max );
+        if( queries[ n ].depth >= 0 )
+        {
+            queries[ n ].value = NULL;
+            queries[ n ].depth = -1;
+        }
     }
-
-    return ret;
 }
 
 /** @endcond */
@@ -1799,27 +2227,178 @@ static JSONStatus_t iterate( const char * buf,
 /**
  * See core_json.h for docs.
  */
-JSONStatus_t JSON_Iterate( const char * buf,
-                           size_t max,
-                           size_t * start,
-                           size_t * next,
-                           JSONPair_t * outPair )
+JSONStatus_t JSON_SearchBatch( const char * buf,
+                               size_t max,
+                               JSONQuery_t * queries,
+                               size_t queryCount )
 {
-    JSONStatus_t ret;
-    size_t key = 0U, keyLength = 0U, value = 0U, valueLength = 0U;
+    JSONStatus_t ret = JSONSuccess;
+    size_t n = 0U, i = 0U, keyLength = 0U;
+    int32_t queryIndex = -1;
 
-    if( ( buf == NULL ) || ( start == NULL ) || ( next == NULL ) ||
-        ( outPair == NULL ) )
+    if( ( buf == NULL ) || ( queries == NULL ) )
     {
         ret = JSONNullParameter;
     }
-    else if( ( max == 0U ) || ( *start >= max ) || ( *next > max ) )
+    else if( ( max == 0U ) || ( queryCount == 0U ) )
     {
         ret = JSONBadParameter;
     }
     else
     {
-        skipSpace( buf, start, max );
+        for( n = 0U; ( n < queryCount ) && ( ret == JSONSuccess ); n++ )
+        {
+            JSONQuery_t * q = &queries[ n ];
+
+            if( q->query == NULL )
+            {
+                ret = JSONNullParameter;
+            }
+            else if( q->queryLength == 0U )
+            {
+                ret = JSONBadParameter;
+            }
+            else
+            {
+                for( i = 0U; ( i < q->queryLength ) && ( ret == JSONSuccess ); )
+                {
+                    ret = nextQueryPart( q->query, &i, q->queryLength, &keyLength, &queryIndex );
+                }
+            }
+
+            q->value = NULL;
+            q->valueLength = 0U;
+            q->jsonType = JSONInvalid;
+            q->next = 0U;
+            q->depth = 0;
+        }
+    }
+
+    if( ret == JSONSuccess )
+    {
+        batchSearch( buf, max, queries, queryCount );
+
+        for( n = 0U; n < queryCount; n++ )
+        {
+            JSONQuery_t * q = &queries[ n ];
+
+            if( q->value == NULL )
+            {
+                ret = JSONNotFound;
+            }
+            else
+            {
+                q->jsonType = getType( q->value[ 0 ] );
+
+                if( q->jsonType == JSONString )
+                {
+                    /* strip the surrounding quotes */
+                    q->value++;
+                    q->valueLength -= 2U;
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/** @cond DO_NOT_DOCUMENT */
+
+/**
+ * @brief Output the next key-value pair or value from a collection.
+ *
+ * @param[in] buf  The buffer to search.
+ * @param[in] max  size of the buffer.
+ * @param[in] start  The index at which the collection begins.
+ * @param[in,out] next  The index at which to seek the next value.
+ * @param[out] outKey  A pointer to receive the index of the value found.
+ * @param[out] outKeyLength  A pointer to receive the length of the value found.
+ * @param[out] outValue  A pointer to receive the index of the value found.
+ * @param[out] outValueLength  A pointer to receive the length of the value found.
+ *
+ * @return #JSONSuccess if a value is output;
+ * #JSONIllegalDocument if the buffer does not begin with '[' or '{';
+ * #JSONNotFound if there are no further values in the collection.
+ */
+static JSONStatus_t iterate( const char * buf,
+                             size_t max,
+                             size_t * start,
+                             size_t * next,
+                             size_t * outKey,
+                             size_t * outKeyLength,
+                             size_t * outValue,
+                             size_t * outValueLength )
+{
+    JSONStatus_t ret = JSONNotFound;
+    bool found = false;
+
+    coreJSON_ASSERT( ( buf != NULL ) && ( max > 0U ) );
+    coreJSON_ASSERT( ( start != NULL ) && ( next != NULL ) );
+    coreJSON_ASSERT( ( outKey != NULL ) && ( outKeyLength != NULL ) );
+    coreJSON_ASSERT( ( outValue != NULL ) && ( outValueLength != NULL ) );
+
+    if( *start < max )
+    {
+        switch( buf[ *start ] )
+        {
+            case '[':
+                found = nextValue( buf, next, max, outValue, outValueLength );
+
+                if( found == true )
+                {
+                    *outKey = 0;
+                    *outKeyLength = 0;
+                }
+
+                break;
+
+            case '{':
+                found = nextKeyValuePair( buf, next, max, outKey, outKeyLength,
+                                          outValue, outValueLength );
+                break;
+
+            default:
+                ret = JSONIllegalDocument;
+                break;
+        }
+    }
+
+    if( found == true )
+    {
+        ret = JSONSuccess;
+        ( void ) skipSpaceAndComma( buf, next, max );
+    }
+
+    return ret;
+}
+
+/** @endcond */
+
+/**
+ * See core_json.h for docs.
+ */
+JSONStatus_t JSON_Iterate( const char * buf,
+                           size_t max,
+                           size_t * start,
+                           size_t * next,
+                           JSONPair_t * outPair )
+{
+    JSONStatus_t ret;
+    size_t key = 0U, keyLength = 0U, value = 0U, valueLength = 0U;
+
+    if( ( buf == NULL ) || ( start == NULL ) || ( next == NULL ) ||
+        ( outPair == NULL ) )
+    {
+        ret = JSONNullParameter;
+    }
+    else if( ( max == 0U ) || ( *start >= max ) || ( *next > max ) )
+    {
+        ret = JSONBadParameter;
+    }
+    else
+    {
+        skipSpace( buf, start, max );
 
         if( *next <= *start )
         {
@@ -1851,3 +2430,1022 @@ JSONStatus_t JSON_Iterate( const char * buf,
 
     return ret;
 }
+
+/** @cond DO_NOT_DOCUMENT */
+
+/**
+ * @brief What the next byte of a streamed document may be.
+ *
+ * The number states come last; see streamByte().
+ */
+typedef enum
+{
+    streamAtValue = 0,    /* a value, e.g., at the start or after a colon */
+    streamAtValueOrClose, /* a value or ']', after '[' */
+    streamAtKeyOrClose,   /* a key or '}', after '{' */
+    streamAtKey,          /* a key, after a comma in an object */
+    streamAtColon,        /* the colon after a key */
+    streamAtCommaOrClose, /* a comma or bracket, after a value in a collection */
+    streamAtEnd,          /* only whitespace, after the outermost value */
+    streamInString,       /* the body of a key or string value */
+    streamInEscape,       /* after a backslash */
+    streamInHex,          /* the digits of a \u escape */
+    streamAtLowBackslash, /* the backslash of the low half of a surrogate pair */
+    streamAtLowU,         /* the 'u' of the low half of a surrogate pair */
+    streamInLowHex,       /* the digits of the low half of a surrogate pair */
+    streamInUTF8,         /* the trailing bytes of a UTF-8 sequence */
+    streamInLiteral,      /* true, false or null */
+    streamAtMinus,        /* after the sign of a number */
+    streamInZero,         /* after a leading zero */
+    streamInInteger,      /* the integer digits of a number */
+    streamAtDecimal,      /* after the decimal point */
+    streamInDecimals,     /* the decimal digits of a number */
+    streamAtExponent,     /* after an 'e' or 'E' */
+    streamAtExponentSign, /* after the sign of an exponent */
+    streamInExponent      /* the exponent digits of a number */
+} streamState_t;
+
+/* The states in which a number may end. */
+#define isNumberEnd_( x )                                                \
+    ( ( ( x ) == ( uint8_t ) streamInZero ) ||                           \
+      ( ( x ) == ( uint8_t ) streamInInteger ) ||                        \
+      ( ( x ) == ( uint8_t ) streamInDecimals ) ||                       \
+      ( ( x ) == ( uint8_t ) streamInExponent ) )
+
+/**
+ * @brief Advance buffer index over plain string body.
+ *
+ * @param[in] buf  The buffer to parse.
+ * @param[in,out] start  The index at which to begin.
+ * @param[in] max  The size of the buffer.
+ */
+static void streamSkipPlain( const char * buf,
+                             size_t * start,
+                             size_t max )
+{
+    #if ( JSON_WORD_SCAN != 0 )
+        skipPlainChars( buf, start, max );
+    #else
+        size_t i = *start;
+
+        while( ( i < max ) && isplain_( buf[ i ] ) )
+        {
+            i++;
+        }
+
+        *start = i;
+    #endif
+}
+
+/**
+ * @brief Append text to the path.
+ *
+ * Once the path does not fit, its length stays past the buffer size until
+ * it is cut back to a collection that fits.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] text  The text to append.
+ * @param[in] length  The length of the text.
+ */
+static void streamAppendPath( JSONStream_t * stream,
+                              const char * text,
+                              size_t length )
+{
+    if( ( stream->pathLength <= JSON_STREAM_MAX_PATH ) &&
+        ( length <= ( JSON_STREAM_MAX_PATH - stream->pathLength ) ) )
+    {
+        ( void ) memcpy( &stream->path[ stream->pathLength ], text, length );
+        stream->pathLength += length;
+    }
+    else
+    {
+        stream->pathLength = JSON_STREAM_MAX_PATH + 1U;
+    }
+}
+
+/**
+ * @brief Append text to a key or to a scalar value.
+ *
+ * A value that does not fit is counted but no longer stored.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] text  The text to append.
+ * @param[in] length  The length of the text.
+ */
+static void streamAppend( JSONStream_t * stream,
+                          const char * text,
+                          size_t length )
+{
+    if( stream->inKey == true )
+    {
+        streamAppendPath( stream, text, length );
+    }
+    else
+    {
+        if( ( stream->valueLength <= JSON_STREAM_MAX_VALUE ) &&
+            ( length <= ( JSON_STREAM_MAX_VALUE - stream->valueLength ) ) )
+        {
+            ( void ) memcpy( &stream->value[ stream->valueLength ], text, length );
+        }
+
+        stream->valueLength = ( length <= ( SIZE_MAX - stream->valueLength ) ) ?
+                              ( stream->valueLength + length ) : SIZE_MAX;
+    }
+}
+
+/**
+ * @brief Pass the current value to the callback.
+ *
+ * Values whose path does not fit are not reported.
+ *
+ * @param[in] stream  The stream state.
+ * @param[in] type  The type of the value.
+ */
+static void streamReport( const JSONStream_t * stream,
+                          JSONTypes_t type )
+{
+    JSONPair_t pair;
+
+    if( ( stream->callback != NULL ) && ( stream->pathLength <= JSON_STREAM_MAX_PATH ) )
+    {
+        pair.key = stream->path;
+        pair.keyLength = stream->pathLength;
+        pair.jsonType = type;
+
+        if( ( type == JSONObject ) || ( type == JSONArray ) )
+        {
+            pair.value = NULL;
+            pair.valueLength = 0U;
+        }
+        else
+        {
+            pair.value = ( stream->valueLength <= JSON_STREAM_MAX_VALUE ) ? stream->value : NULL;
+            pair.valueLength = stream->valueLength;
+        }
+
+        stream->callback( stream->pContext, &pair );
+    }
+}
+
+/**
+ * @brief Move past a complete value.
+ *
+ * @param[in,out] stream  The stream state.
+ */
+static void streamEndValue( JSONStream_t * stream )
+{
+    if( stream->depth < 0 )
+    {
+        stream->state = ( uint8_t ) streamAtEnd;
+        stream->status = JSONSuccess;
+    }
+    else
+    {
+        stream->state = ( uint8_t ) streamAtCommaOrClose;
+    }
+}
+
+/**
+ * @brief Report a complete scalar and move past it.
+ *
+ * @param[in,out] stream  The stream state.
+ */
+static void streamEndScalar( JSONStream_t * stream )
+{
+    streamReport( stream, stream->type );
+    streamEndValue( stream );
+}
+
+/**
+ * @brief Set the path to the next element of the innermost array.
+ *
+ * @param[in,out] stream  The stream state.
+ */
+static void streamIndexPath( JSONStream_t * stream )
+{
+    /* '[', the decimal digits of a size_t, and ']' */
+    char text[ ( sizeof( size_t ) * 3U ) + 2U ];
+    size_t i = sizeof( text ) - 1U, n = stream->index[ stream->depth ];
+
+    text[ i ] = ']';
+
+    do
+    {
+        i--;
+        text[ i ] = ( char ) ( '0' + ( char ) ( n % 10U ) );
+        n /= 10U;
+    } while( n > 0U );
+
+    i--;
+    text[ i ] = '[';
+
+    stream->pathLength = stream->mark[ stream->depth ];
+    streamAppendPath( stream, &text[ i ], sizeof( text ) - i );
+    stream->index[ stream->depth ]++;
+}
+
+/**
+ * @brief Open an object or array.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The opening bracket.
+ */
+static void streamOpen( JSONStream_t * stream,
+                        char c )
+{
+    if( stream->depth >= ( JSON_MAX_DEPTH - 1 ) )
+    {
+        stream->status = JSONMaxDepthExceeded;
+    }
+    else
+    {
+        streamReport( stream, ( c == '{' ) ? JSONObject : JSONArray );
+
+        stream->depth++;
+        stream->stack[ stream->depth ] = c;
+        stream->mark[ stream->depth ] = stream->pathLength;
+        stream->index[ stream->depth ] = 0U;
+        stream->state = ( uint8_t ) ( ( c == '{' ) ? streamAtKeyOrClose : streamAtValueOrClose );
+    }
+}
+
+/**
+ * @brief Close the innermost object or array.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The closing bracket.
+ */
+static void streamClose( JSONStream_t * stream,
+                         char c )
+{
+    if( isMatchingBracket_( stream->stack[ stream->depth ], c ) )
+    {
+        stream->depth--;
+        streamEndValue( stream );
+    }
+    else
+    {
+        stream->status = JSONIllegalDocument;
+    }
+}
+
+/**
+ * @brief Begin a key.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The first byte of the key.
+ */
+static void streamBeginKey( JSONStream_t * stream,
+                            char c )
+{
+    static const char separator = JSON_QUERY_KEY_SEPARATOR;
+
+    if( c == '"' )
+    {
+        stream->pathLength = stream->mark[ stream->depth ];
+
+        if( stream->pathLength > 0U )
+        {
+            streamAppendPath( stream, &separator, 1U );
+        }
+
+        stream->inKey = true;
+        stream->state = ( uint8_t ) streamInString;
+    }
+    else
+    {
+        stream->status = JSONIllegalDocument;
+    }
+}
+
+/**
+ * @brief Begin a value.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The first byte of the value.
+ */
+static void streamBeginValue( JSONStream_t * stream,
+                              char c )
+{
+    uint8_t state = ( uint8_t ) streamInLiteral;
+
+    if( ( stream->depth >= 0 ) && isSquareOpen_( stream->stack[ stream->depth ] ) )
+    {
+        streamIndexPath( stream );
+    }
+
+    stream->inKey = false;
+    stream->valueLength = 0U;
+    stream->type = JSONNumber;
+
+    switch( c )
+    {
+        case '{':
+        case '[':
+            state = ( uint8_t ) streamAtValue;
+            break;
+
+        case '"':
+            stream->type = JSONString;
+            state = ( uint8_t ) streamInString;
+            break;
+
+        case 't':
+            stream->type = JSONTrue;
+            break;
+
+        case 'f':
+            stream->type = JSONFalse;
+            break;
+
+        case 'n':
+            stream->type = JSONNull;
+            break;
+
+        case '-':
+            state = ( uint8_t ) streamAtMinus;
+            break;
+
+        case '0':
+            state = ( uint8_t ) streamInZero;
+            break;
+
+        default:
+            state = isdigit_( c ) ? ( uint8_t ) streamInInteger : ( uint8_t ) streamAtEnd;
+            break;
+    }
+
+    #ifdef JSON_VALIDATE_COLLECTIONS_ONLY
+        if( ( stream->depth < 0 ) && !isOpenBracket_( c ) )
+        {
+            state = ( uint8_t ) streamAtEnd;
+        }
+    #endif
+
+    if( state == ( uint8_t ) streamAtEnd )
+    {
+        stream->status = JSONIllegalDocument;
+    }
+    else if( state == ( uint8_t ) streamAtValue )
+    {
+        streamOpen( stream, c );
+    }
+    else
+    {
+        stream->state = state;
+        stream->count = 1U;
+
+        if( state != ( uint8_t ) streamInString )
+        {
+            streamAppend( stream, &c, 1U );
+        }
+    }
+}
+
+/**
+ * @brief Handle a byte between tokens.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamStructure( JSONStream_t * stream,
+                             char c )
+{
+    if( isspace_( c ) )
+    {
+        /* MISRA 15.7 */
+    }
+    else
+    {
+        switch( stream->state )
+        {
+            case streamAtValue:
+                streamBeginValue( stream, c );
+                break;
+
+            case streamAtValueOrClose:
+
+                if( isSquareClose_( c ) )
+                {
+                    streamClose( stream, c );
+                }
+                else
+                {
+                    streamBeginValue( stream, c );
+                }
+
+                break;
+
+            case streamAtKeyOrClose:
+
+                if( c == '}' )
+                {
+                    streamClose( stream, c );
+                }
+                else
+                {
+                    streamBeginKey( stream, c );
+                }
+
+                break;
+
+            case streamAtKey:
+                streamBeginKey( stream, c );
+                break;
+
+            case streamAtColon:
+
+                if( c == ':' )
+                {
+                    stream->state = ( uint8_t ) streamAtValue;
+                }
+                else
+                {
+                    stream->status = JSONIllegalDocument;
+                }
+
+                break;
+
+            case streamAtCommaOrClose:
+
+                if( c == ',' )
+                {
+                    stream->state = ( uint8_t ) ( isSquareOpen_( stream->stack[ stream->depth ] ) ?
+                                                  streamAtValue : streamAtKey );
+                }
+                else if( isCloseBracket_( c ) )
+                {
+                    streamClose( stream, c );
+                }
+                else
+                {
+                    stream->status = JSONIllegalDocument;
+                }
+
+                break;
+
+            default:
+                /* Only whitespace may follow the outermost value. */
+                stream->status = JSONIllegalDocument;
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Handle a byte of a string body that is not plain.
+ *
+ * Plain bytes are appended by JSON_StreamFeed() without coming here.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamStringByte( JSONStream_t * stream,
+                              char c )
+{
+    char_ n;
+
+    coreJSON_ASSERT( !isplain_( c ) );
+
+    n.c = c;
+
+    if( c == '"' )
+    {
+        if( stream->inKey == true )
+        {
+            stream->inKey = false;
+            stream->state = ( uint8_t ) streamAtColon;
+        }
+        else
+        {
+            streamEndScalar( stream );
+        }
+    }
+    else if( c == '\\' )
+    {
+        streamAppend( stream, &c, 1U );
+        stream->state = ( uint8_t ) streamInEscape;
+    }
+    /* See skipUTF8MultiByte() for the legal leading bytes. */
+    else if( ( n.u > 0xC1U ) && ( n.u < 0xF5U ) )
+    {
+        stream->length = ( uint8_t ) countHighBits( n.u );
+        stream->count = stream->length - 1U;
+        stream->code = ( ( uint32_t ) n.u ) & ( ( ( uint32_t ) 1 << ( 7U - stream->length ) ) - 1U );
+        stream->state = ( uint8_t ) streamInUTF8;
+        streamAppend( stream, &c, 1U );
+    }
+    /* An unescaped control character is not allowed. */
+    else
+    {
+        stream->status = JSONIllegalDocument;
+    }
+}
+
+/**
+ * @brief Handle a trailing byte of a UTF-8 sequence.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamUTF8Byte( JSONStream_t * stream,
+                            char c )
+{
+    char_ n;
+
+    n.c = c;
+
+    /* Additional bytes must match 10xxxxxx. */
+    if( ( n.u & 0xC0U ) != 0x80U )
+    {
+        stream->status = JSONIllegalDocument;
+    }
+    else
+    {
+        stream->code = ( stream->code << 6U ) | ( n.u & 0x3FU );
+        stream->count--;
+        streamAppend( stream, &c, 1U );
+
+        if( stream->count > 0U )
+        {
+            /* MISRA 15.7 */
+        }
+        else if( shortestUTF8( stream->length, stream->code ) == true )
+        {
+            stream->state = ( uint8_t ) streamInString;
+        }
+        else
+        {
+            stream->status = JSONIllegalDocument;
+        }
+    }
+}
+
+/**
+ * @brief Handle the byte after a backslash.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ *
+ * @note As in skipEscape(), \NUL is disallowed.
+ */
+static void streamEscapeByte( JSONStream_t * stream,
+                              char c )
+{
+    uint8_t state = ( uint8_t ) streamInString;
+
+    switch( c )
+    {
+        case '\0':
+            state = ( uint8_t ) streamAtEnd;
+            break;
+
+        case 'u':
+            state = ( uint8_t ) streamInHex;
+            break;
+
+        case '"':
+        case '\\':
+        case '/':
+        case 'b':
+        case 'f':
+        case 'n':
+        case 'r':
+        case 't':
+            break;
+
+        default:
+
+            /* a control character: (NUL,SPACE) */
+            if( !iscntrl_( c ) )
+            {
+                state = ( uint8_t ) streamAtEnd;
+            }
+
+            break;
+    }
+
+    if( state == ( uint8_t ) streamAtEnd )
+    {
+        stream->status = JSONIllegalDocument;
+    }
+    else
+    {
+        stream->state = state;
+        stream->count = 4U;
+        stream->code = 0U;
+        streamAppend( stream, &c, 1U );
+    }
+}
+
+/**
+ * @brief Handle a digit of a \u escape.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ *
+ * @note As in skipHexEscape(), \u0000 and unpaired surrogates are
+ * disallowed.
+ */
+static void streamHexByte( JSONStream_t * stream,
+                           char c )
+{
+    uint8_t n = hexToInt( c );
+
+    if( n == NOT_A_HEX_CHAR )
+    {
+        stream->status = JSONIllegalDocument;
+    }
+    else
+    {
+        stream->code = ( stream->code << 4U ) | n;
+        stream->count--;
+        streamAppend( stream, &c, 1U );
+
+        if( stream->count > 0U )
+        {
+            /* MISRA 15.7 */
+        }
+        else if( stream->state == ( uint8_t ) streamInLowHex )
+        {
+            if( isLowSurrogate( stream->code ) )
+            {
+                stream->state = ( uint8_t ) streamInString;
+            }
+            else
+            {
+                stream->status = JSONIllegalDocument;
+            }
+        }
+        else if( ( stream->code == 0U ) || isLowSurrogate( stream->code ) )
+        {
+            stream->status = JSONIllegalDocument;
+        }
+        else if( isHighSurrogate( stream->code ) )
+        {
+            stream->state = ( uint8_t ) streamAtLowBackslash;
+        }
+        else
+        {
+            stream->state = ( uint8_t ) streamInString;
+        }
+    }
+}
+
+/**
+ * @brief Handle the "\u" that must follow a high surrogate.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamLowByte( JSONStream_t * stream,
+                           char c )
+{
+    if( ( stream->state == ( uint8_t ) streamAtLowBackslash ) && ( c == '\\' ) )
+    {
+        stream->state = ( uint8_t ) streamAtLowU;
+        streamAppend( stream, &c, 1U );
+    }
+    else if( ( stream->state == ( uint8_t ) streamAtLowU ) && ( c == 'u' ) )
+    {
+        stream->state = ( uint8_t ) streamInLowHex;
+        stream->count = 4U;
+        stream->code = 0U;
+        streamAppend( stream, &c, 1U );
+    }
+    else
+    {
+        stream->status = JSONIllegalDocument;
+    }
+}
+
+/**
+ * @brief Handle a byte of true, false or null.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamLiteralByte( JSONStream_t * stream,
+                               char c )
+{
+    const char * literal = "null";
+
+    if( stream->type == JSONTrue )
+    {
+        literal = "true";
+    }
+    else if( stream->type == JSONFalse )
+    {
+        literal = "false";
+    }
+    else
+    {
+        /* MISRA 15.7 */
+    }
+
+    if( c == literal[ stream->count ] )
+    {
+        streamAppend( stream, &c, 1U );
+        stream->count++;
+
+        if( literal[ stream->count ] == '\0' )
+        {
+            streamEndScalar( stream );
+        }
+    }
+    else
+    {
+        stream->status = JSONIllegalDocument;
+    }
+}
+
+/**
+ * @brief The state after the next byte of a number.
+ *
+ * @param[in] state  The current number state.
+ * @param[in] c  The byte.
+ *
+ * @return the next state, or streamAtValue if the byte is not part of
+ * the number.
+ */
+static uint8_t nextNumberState( uint8_t state,
+                                char c )
+{
+    uint8_t next = ( uint8_t ) streamAtValue;
+    bool exponent = ( ( c == 'e' ) || ( c == 'E' ) ) ? true : false;
+
+    switch( state )
+    {
+        case streamAtMinus:
+
+            if( c == '0' )
+            {
+                next = ( uint8_t ) streamInZero;
+            }
+            else if( isdigit_( c ) )
+            {
+                next = ( uint8_t ) streamInInteger;
+            }
+            else
+            {
+                /* MISRA 15.7 */
+            }
+
+            break;
+
+        case streamInZero:
+        case streamInInteger:
+
+            /* JSON disallows superfluous leading zeroes. */
+            if( isdigit_( c ) && ( state == ( uint8_t ) streamInInteger ) )
+            {
+                next = ( uint8_t ) streamInInteger;
+            }
+            else if( c == '.' )
+            {
+                next = ( uint8_t ) streamAtDecimal;
+            }
+            else if( exponent == true )
+            {
+                next = ( uint8_t ) streamAtExponent;
+            }
+            else
+            {
+                /* MISRA 15.7 */
+            }
+
+            break;
+
+        case streamAtDecimal:
+        case streamInDecimals:
+
+            if( isdigit_( c ) )
+            {
+                next = ( uint8_t ) streamInDecimals;
+            }
+            else if( ( exponent == true ) && ( state == ( uint8_t ) streamInDecimals ) )
+            {
+                next = ( uint8_t ) streamAtExponent;
+            }
+            else
+            {
+                /* MISRA 15.7 */
+            }
+
+            break;
+
+        case streamAtExponent:
+
+            if( ( c == '-' ) || ( c == '+' ) )
+            {
+                next = ( uint8_t ) streamAtExponentSign;
+            }
+            else if( isdigit_( c ) )
+            {
+                next = ( uint8_t ) streamInExponent;
+            }
+            else
+            {
+                /* MISRA 15.7 */
+            }
+
+            break;
+
+        default:
+
+            /* streamAtExponentSign and streamInExponent */
+            if( isdigit_( c ) )
+            {
+                next = ( uint8_t ) streamInExponent;
+            }
+
+            break;
+    }
+
+    return next;
+}
+
+/**
+ * @brief Handle a byte of a number, or the byte after it.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamNumberByte( JSONStream_t * stream,
+                              char c )
+{
+    uint8_t next = nextNumberState( stream->state, c );
+
+    if( next != ( uint8_t ) streamAtValue )
+    {
+        stream->state = next;
+        streamAppend( stream, &c, 1U );
+    }
+    else if( isNumberEnd_( stream->state ) )
+    {
+        streamEndScalar( stream );
+        streamStructure( stream, c );
+    }
+    else
+    {
+        stream->status = JSONIllegalDocument;
+    }
+}
+
+/**
+ * @brief Handle one byte of a streamed document.
+ *
+ * @param[in,out] stream  The stream state.
+ * @param[in] c  The byte.
+ */
+static void streamByte( JSONStream_t * stream,
+                        char c )
+{
+    switch( stream->state )
+    {
+        case streamInString:
+            streamStringByte( stream, c );
+            break;
+
+        case streamInEscape:
+            streamEscapeByte( stream, c );
+            break;
+
+        case streamInHex:
+        case streamInLowHex:
+            streamHexByte( stream, c );
+            break;
+
+        case streamAtLowBackslash:
+        case streamAtLowU:
+            streamLowByte( stream, c );
+            break;
+
+        case streamInUTF8:
+            streamUTF8Byte( stream, c );
+            break;
+
+        case streamInLiteral:
+            streamLiteralByte( stream, c );
+            break;
+
+        default:
+
+            if( stream->state >= ( uint8_t ) streamAtMinus )
+            {
+                streamNumberByte( stream, c );
+            }
+            else
+            {
+                streamStructure( stream, c );
+            }
+
+            break;
+    }
+}
+
+/** @endcond */
+
+/**
+ * See core_json.h for docs.
+ */
+JSONStatus_t JSON_StreamInit( JSONStream_t * stream,
+                              JSONStreamCallback_t callback,
+                              void * pContext )
+{
+    JSONStatus_t ret = JSONSuccess;
+
+    if( stream == NULL )
+    {
+        ret = JSONNullParameter;
+    }
+    else
+    {
+        stream->callback = callback;
+        stream->pContext = pContext;
+        stream->status = JSONPartial;
+        stream->type = JSONInvalid;
+        stream->state = ( uint8_t ) streamAtValue;
+        stream->count = 0U;
+        stream->length = 0U;
+        stream->inKey = false;
+        stream->depth = -1;
+        stream->code = 0U;
+        stream->pathLength = 0U;
+        stream->valueLength = 0U;
+    }
+
+    return ret;
+}
+
+/**
+ * See core_json.h for docs.
+ *
+ * Runs of plain string body are appended in one go; every other byte
+ * goes through the state machine.
+ */
+JSONStatus_t JSON_StreamFeed( JSONStream_t * stream,
+                              const char * buf,
+                              size_t max )
+{
+    JSONStatus_t ret;
+    size_t i = 0U, end = 0U;
+
+    if( ( stream == NULL ) || ( buf == NULL ) )
+    {
+        ret = JSONNullParameter;
+    }
+    else if( max == 0U )
+    {
+        ret = JSONBadParameter;
+    }
+    else
+    {
+        while( ( i < max ) &&
+               ( ( stream->status == JSONPartial ) || ( stream->status == JSONSuccess ) ) )
+        {
+            if( stream->state == ( uint8_t ) streamInString )
+            {
+                end = i;
+                streamSkipPlain( buf, &end, max );
+                streamAppend( stream, &buf[ i ], end - i );
+                i = end;
+            }
+
+            if( i < max )
+            {
+                streamByte( stream, buf[ i ] );
+                i++;
+            }
+        }
+
+        ret = stream->status;
+    }
+
+    return ret;
+}
+
+/**
+ * See core_json.h for docs.
+ */
+JSONStatus_t JSON_StreamFinish( JSONStream_t * stream )
+{
+    JSONStatus_t ret;
+
+    if( stream == NULL )
+    {
+        ret = JSONNullParameter;
+    }
+    else
+    {
+        if( ( stream->status == JSONPartial ) && ( stream->depth < 0 ) &&
+            isNumberEnd_( stream->state ) )
+        {
+            streamEndScalar( stream );
+        }
+
+        ret = stream->status;
+    }
+
+    return ret;
+}
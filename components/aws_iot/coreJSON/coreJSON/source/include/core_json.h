@@ -33,6 +33,7 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* *INDENT-OFF* */
 #ifdef __cplusplus
@@ -251,6 +252,88 @@ JSONStatus_t JSON_SearchConst( const char * buf,
                                JSONTypes_t * outType );
 /* @[declare_json_searchconst] */
 
+/**
+ * @ingroup json_struct_types
+ * @brief One query of a batch search, and its result.
+ *
+ * Set @p query and @p queryLength before calling JSON_SearchBatch(); the
+ * remaining members are outputs or working state and need not be set.
+ */
+typedef struct
+{
+    const char * query;   /**< @brief The object keys and array indexes to search for. */
+    size_t queryLength;   /**< @brief Length of the query. */
+    const char * value;   /**< @brief Receives the address of the value found, or NULL if not found. */
+    size_t valueLength;   /**< @brief Receives the length of the value found. */
+    JSONTypes_t jsonType; /**< @brief Receives the JSON-specific type of the value found. */
+    size_t next;          /**< @brief Working state: offset of the next unmatched part of the query. */
+    int16_t depth;        /**< @brief Working state: depth of the value matched so far, or -1. */
+} JSONQuery_t;
+
+/**
+ * @brief Find several keys or array indexes in a JSON document in a
+ * single pass.
+ *
+ * Each query has the syntax and the result of JSON_SearchConst(), but the
+ * document is walked once for the whole batch rather than once per query:
+ * only the objects and arrays on the path of some query are entered, and
+ * all other values are skipped.  The walk stops as soon as every query is
+ * resolved.  Queries may be given in any order and may share prefixes
+ * (e.g., "state", "state.color" and "state.led[0]").
+ *
+ * As with JSON_Search(), the first matching key of an object is taken; if
+ * the rest of a query does not match within its value, the query is not
+ * found even if the key appears again later.
+ *
+ * @note Only the parts of the document that are walked are validated, and
+ * the walk may stop early.  To validate the entire JSON document, use
+ * JSON_Validate().
+ *
+ * @param[in] buf  The buffer to search.
+ * @param[in] max  size of the buffer.
+ * @param[in,out] queries  The queries; results are written to each entry.
+ * @param[in] queryCount  The number of queries.
+ *
+ * @note The maximum nesting depth may be specified by defining the macro
+ * JSON_MAX_DEPTH.  The default is 32 of sizeof(char).
+ *
+ * @return #JSONSuccess if every query is matched;
+ * #JSONNullParameter if any pointer parameters are NULL;
+ * #JSONBadParameter if max or queryCount is 0, or any query is empty or
+ * malformed as described for JSON_Search();
+ * #JSONNotFound if at least one query has no match.  The queries that
+ * did match are still output; the others have a NULL value.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *     // Variables used in this example.
+ *     JSONStatus_t result;
+ *     char buffer[] = "{\"foo\":\"abc\",\"bar\":{\"foo\":\"xyz\"}}";
+ *     size_t bufferLength = sizeof( buffer ) - 1;
+ *     JSONQuery_t queries[] =
+ *     {
+ *         { .query = "foo",     .queryLength = 3 },
+ *         { .query = "bar.foo", .queryLength = 7 },
+ *     };
+ *
+ *     result = JSON_SearchBatch( buffer, bufferLength, queries, 2 );
+ *
+ *     if( result == JSONSuccess )
+ *     {
+ *         // "abc xyz" will be printed.
+ *         printf( "%.*s %.*s\n",
+ *                 ( int ) queries[ 0 ].valueLength, queries[ 0 ].value,
+ *                 ( int ) queries[ 1 ].valueLength, queries[ 1 ].value );
+ *     }
+ * @endcode
+ */
+/* @[declare_json_searchbatch] */
+JSONStatus_t JSON_SearchBatch( const char * buf,
+                               size_t max,
+                               JSONQuery_t * queries,
+                               size_t queryCount );
+/* @[declare_json_searchbatch] */
+
 /**
  * @ingroup json_struct_types
  * @brief Structure to represent a key-value pair.
@@ -340,6 +423,175 @@ JSONStatus_t JSON_Iterate( const char * buf,
                            JSONPair_t * outPair );
 /* @[declare_json_iterate] */
 
+/**
+ * @brief The maximum nesting depth of objects and arrays.
+ */
+#ifndef JSON_MAX_DEPTH
+    #define JSON_MAX_DEPTH    32
+#endif
+
+/**
+ * @brief The size of the path buffer of a #JSONStream_t.
+ *
+ * Values whose path is longer are validated but not reported.
+ */
+#ifndef JSON_STREAM_MAX_PATH
+    #define JSON_STREAM_MAX_PATH    64
+#endif
+
+/**
+ * @brief The size of the value buffer of a #JSONStream_t.
+ *
+ * Longer scalars are validated and reported without their text.
+ */
+#ifndef JSON_STREAM_MAX_VALUE
+    #define JSON_STREAM_MAX_VALUE    128
+#endif
+
+/**
+ * @brief Receives the values of a document fed to JSON_StreamFeed().
+ *
+ * The key of @p pPair is the path of the value in query syntax, e.g.,
+ * "bar.foo" or "[2].bar[0]", and is empty for the outermost value.  The
+ * value is as JSON_Search() would output it: strings without quotes and
+ * with escapes untouched.
+ *
+ * An object or array is reported when it opens, with a NULL value and a
+ * length of 0.  A scalar longer than #JSON_STREAM_MAX_VALUE is reported
+ * with a NULL value and its full length.  The key and value are only
+ * valid for the duration of the call.
+ *
+ * @param[in] pContext  The context given to JSON_StreamInit().
+ * @param[in] pPair  The path, value and type.
+ */
+typedef void ( * JSONStreamCallback_t )( void * pContext,
+                                         const JSONPair_t * pPair );
+
+/**
+ * @ingroup json_struct_types
+ * @brief The state of a document validated in pieces.
+ *
+ * Initialize with JSON_StreamInit(); all members are private.
+ */
+typedef struct
+{
+    JSONStreamCallback_t callback;          /**< @brief Receives each value, may be NULL. */
+    void * pContext;                        /**< @brief Passed to the callback. */
+    JSONStatus_t status;                    /**< @brief The result so far. */
+    JSONTypes_t type;                       /**< @brief The type of the scalar being scanned. */
+    uint8_t state;                          /**< @brief What the next byte may be. */
+    uint8_t count;                          /**< @brief Bytes left of a literal, escape or UTF-8 sequence. */
+    uint8_t length;                         /**< @brief Length of the UTF-8 sequence being scanned. */
+    bool inKey;                             /**< @brief The string being scanned is a key. */
+    int16_t depth;                          /**< @brief The index of the innermost open collection, or -1. */
+    uint32_t code;                          /**< @brief The code point being decoded. */
+    size_t pathLength;                      /**< @brief Length of the path, or more than the buffer once it overflows. */
+    size_t valueLength;                     /**< @brief Length of the scalar being scanned. */
+    char stack[ JSON_MAX_DEPTH ];           /**< @brief The opening bracket of each open collection. */
+    size_t index[ JSON_MAX_DEPTH ];         /**< @brief The next index of each open array. */
+    size_t mark[ JSON_MAX_DEPTH ];          /**< @brief The path length of each open collection. */
+    char path[ JSON_STREAM_MAX_PATH ];      /**< @brief The path of the current value. */
+    char value[ JSON_STREAM_MAX_VALUE ];    /**< @brief The text of the scalar being scanned. */
+} JSONStream_t;
+
+/**
+ * @brief Prepare to validate a document fed in pieces.
+ *
+ * @param[out] stream  The state to initialize.
+ * @param[in] callback  Receives each value as it completes; may be NULL to
+ * only validate.
+ * @param[in] pContext  Passed to the callback.
+ *
+ * @return #JSONSuccess if the state was initialized;
+ * #JSONNullParameter if stream is NULL.
+ */
+/* @[declare_json_streaminit] */
+JSONStatus_t JSON_StreamInit( JSONStream_t * stream,
+                              JSONStreamCallback_t callback,
+                              void * pContext );
+/* @[declare_json_streaminit] */
+
+/**
+ * @brief Validate the next piece of a document and report the values it
+ * completes.
+ *
+ * The document may be split anywhere, even within a token, so pieces can
+ * be passed on as they are received and then discarded.  The rules are
+ * those of JSON_Validate(), except that a comma and a key are always
+ * required before a nested object or array.
+ *
+ * Values are reported as soon as they are complete, so a later piece may
+ * still make the document illegal.  Act on the reported values only once
+ * JSON_StreamFinish() returns #JSONSuccess.
+ *
+ * @param[in,out] stream  The state from JSON_StreamInit().
+ * @param[in] buf  The next piece of the document.
+ * @param[in] max  The size of the piece.
+ *
+ * @note The maximum nesting depth may be specified by defining the macro
+ * JSON_MAX_DEPTH.  The default is 32 of sizeof(char).
+ *
+ * @return #JSONPartial if the document is valid so far but incomplete;
+ * #JSONSuccess if a complete document has been seen, which may still be
+ * followed by whitespace;
+ * #JSONNullParameter if stream or buf is NULL;
+ * #JSONBadParameter if max is 0;
+ * #JSONIllegalDocument if the document is NOT valid JSON;
+ * #JSONMaxDepthExceeded if object and array nesting exceeds a threshold.
+ * The last two are final: later pieces are ignored.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *     // Variables used in this example.
+ *     static void print( void * pContext,
+ *                        const JSONPair_t * pPair )
+ *     {
+ *         if( pPair->value != NULL )
+ *         {
+ *             printf( "%.*s = %.*s\n",
+ *                     ( int ) pPair->keyLength, pPair->key,
+ *                     ( int ) pPair->valueLength, pPair->value );
+ *         }
+ *     }
+ *
+ *     JSONStream_t stream;
+ *     JSONStatus_t result;
+ *     char piece1[] = "{\"foo\":\"ab";
+ *     char piece2[] = "c\",\"bar\":{\"foo\":\"xyz\"}}";
+ *
+ *     ( void ) JSON_StreamInit( &stream, print, NULL );
+ *     ( void ) JSON_StreamFeed( &stream, piece1, sizeof( piece1 ) - 1 );
+ *     ( void ) JSON_StreamFeed( &stream, piece2, sizeof( piece2 ) - 1 );
+ *     result = JSON_StreamFinish( &stream );
+ *
+ *     // "foo = abc" and "bar.foo = xyz" were printed, and the document is valid.
+ *     assert( result == JSONSuccess );
+ * @endcode
+ */
+/* @[declare_json_streamfeed] */
+JSONStatus_t JSON_StreamFeed( JSONStream_t * stream,
+                              const char * buf,
+                              size_t max );
+/* @[declare_json_streamfeed] */
+
+/**
+ * @brief Signal the end of a document fed in pieces.
+ *
+ * A number is only known to be complete when the byte after it is seen,
+ * so an outermost number is reported here.
+ *
+ * @param[in,out] stream  The state from JSON_StreamInit().
+ *
+ * @return #JSONSuccess if the document is valid and complete;
+ * #JSONNullParameter if stream is NULL;
+ * #JSONIllegalDocument if the document is NOT valid JSON;
+ * #JSONMaxDepthExceeded if object and array nesting exceeds a threshold;
+ * #JSONPartial if the document is valid so far but incomplete.
+ */
+/* @[declare_json_streamfinish] */
+JSONStatus_t JSON_StreamFinish( JSONStream_t * stream );
+/* @[declare_json_streamfinish] */
+
 /* *INDENT-OFF* */
 #ifdef __cplusplus
     }
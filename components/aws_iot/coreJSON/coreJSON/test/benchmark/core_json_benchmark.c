@@ -0,0 +1,512 @@
+/*
+ * coreJSON v3.3.0
+ * Copyright (C) 2020 Amazon.com, Inc. or its affiliates.  All Rights Reserved.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file core_json_benchmark.c
+ * @brief Throughput benchmark for JSON_Validate, JSON_Search and JSON_Iterate
+ * on Linux.
+ *
+ * The first documents imitate what a device receives on the MQTT path:
+ * compact device shadow deltas, pretty-printed shadow documents and job
+ * documents.  The others each stress one part of the parser: deep nesting,
+ * escape sequences, UTF-8 text and numbers.  Each is grown to 1, 4, 16 and
+ * 64 KB.
+ *
+ * Search looks up a key placed last in the document.  Iterate walks every
+ * value of the document, descending into each collection, and is also
+ * reported as nanoseconds per value visited.
+ *
+ * The library is linked twice: once with the word-at-a-time scanner and
+ * once with JSON_WORD_SCAN=0, under the prefixes word_ and byte_.  Runs of
+ * the two alternate so that frequency changes affect both alike.
+ */
+
+#define _POSIX_C_SOURCE    199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core_json.h"
+
+/* Total bytes to scan per measurement. */
+#define BENCH_BYTES_PER_RUN    ( 2U * 1024U * 1024U )
+
+/* Number of measurements per case; the fastest one is reported, which
+ * filters out preemption on shared machines. */
+#define BENCH_RUNS             20U
+
+/* The key added last, and so searched for, in every document. */
+#define BENCH_LAST_KEY         "clientToken"
+
+/* Collections opened by each entry of the nested document; with the
+ * enclosing object and array this stays below JSON_MAX_DEPTH. */
+#define BENCH_NESTED_DEPTH     24U
+
+/* The two builds of the library; see CMakeLists.txt. */
+JSONStatus_t word_JSON_Validate( const char * buf,
+                                 size_t max );
+JSONStatus_t word_JSON_SearchT( char * buf,
+                                size_t max,
+                                const char * query,
+                                size_t queryLength,
+                                char ** outValue,
+                                size_t * outValueLength,
+                                JSONTypes_t * outType );
+JSONStatus_t byte_JSON_Validate( const char * buf,
+                                 size_t max );
+JSONStatus_t byte_JSON_SearchT( char * buf,
+                                size_t max,
+                                const char * query,
+                                size_t queryLength,
+                                char ** outValue,
+                                size_t * outValueLength,
+                                JSONTypes_t * outType );
+JSONStatus_t word_JSON_Iterate( const char * buf,
+                                size_t max,
+                                size_t * start,
+                                size_t * next,
+                                JSONPair_t * outPair );
+JSONStatus_t byte_JSON_Iterate( const char * buf,
+                                size_t max,
+                                size_t * start,
+                                size_t * next,
+                                JSONPair_t * outPair );
+
+typedef struct
+{
+    JSONStatus_t ( * validate )( const char * buf,
+                                 size_t max );
+    JSONStatus_t ( * search )( char * buf,
+                               size_t max,
+                               const char * query,
+                               size_t queryLength,
+                               char ** outValue,
+                               size_t * outValueLength,
+                               JSONTypes_t * outType );
+    JSONStatus_t ( * iterate )( const char * buf,
+                                size_t max,
+                                size_t * start,
+                                size_t * next,
+                                JSONPair_t * outPair );
+} Scanner_t;
+
+static const Scanner_t scanners[ 2 ] =
+{
+    { byte_JSON_Validate, byte_JSON_SearchT, byte_JSON_Iterate },
+    { word_JSON_Validate, word_JSON_SearchT, word_JSON_Iterate },
+};
+
+/* What a measurement runs. */
+typedef enum
+{
+    benchValidate,
+    benchSearch,
+    benchIterate
+} BenchOperation_t;
+
+typedef struct
+{
+    char * buf;
+    size_t length;
+    size_t size;
+} Document_t;
+
+typedef void ( * DocumentBuilder_t )( Document_t * doc,
+                                      size_t target );
+
+/*-----------------------------------------------------------*/
+
+static void append( Document_t * doc,
+                    const char * text )
+{
+    size_t length = strlen( text );
+
+    if( ( doc->length + length ) < doc->size )
+    {
+        memcpy( &doc->buf[ doc->length ], text, length + 1U );
+        doc->length += length;
+    }
+}
+
+/* Compact desired-state delta, as published on .../shadow/update/delta. */
+static void buildShadowDelta( Document_t * doc,
+                              size_t target )
+{
+    char line[ 256 ];
+    unsigned i;
+
+    append( doc, "{\"version\":4211,\"timestamp\":1700000000,\"state\":{" );
+
+    for( i = 0U; doc->length < ( target / 2U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s\"sensor_%u\":{\"label\":\"Greenhouse bench %u, north wall\","
+                           "\"enabled\":true,\"period_ms\":%u,\"offset\":-%u.%02u}",
+                           ( i == 0U ) ? "" : ",", i, i, 1000U + i, i % 10U, i % 100U );
+        append( doc, line );
+    }
+
+    append( doc, "},\"metadata\":{" );
+
+    for( i = 0U; doc->length < ( target - 64U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s\"sensor_%u\":{\"label\":{\"timestamp\":%u},\"enabled\":{\"timestamp\":%u}}",
+                           ( i == 0U ) ? "" : ",", i, 1700000000U + i, 1700000000U + i );
+        append( doc, line );
+    }
+
+    append( doc, "},\"" BENCH_LAST_KEY "\":\"a5d1c6e2-0b7f-4e55\"}" );
+}
+
+/* Pretty-printed reported state, as returned by .../shadow/get/accepted. */
+static void buildShadowPretty( Document_t * doc,
+                               size_t target )
+{
+    char line[ 256 ];
+    unsigned i;
+
+    append( doc, "{\n  \"state\": {\n    \"reported\": {\n" );
+
+    for( i = 0U; doc->length < ( target - 96U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s      \"reading_%u\": {\n"
+                           "        \"name\": \"temperature probe %u\",\n"
+                           "        \"value\": %u.%u,\n"
+                           "        \"unit\": \"celsius\"\n"
+                           "      }",
+                           ( i == 0U ) ? "" : ",\n", i, i, 20U + ( i % 10U ), i % 10U );
+        append( doc, line );
+    }
+
+    append( doc, "\n    }\n  },\n  \"version\": 77,\n  \"" BENCH_LAST_KEY "\": \"pretty\"\n}\n" );
+}
+
+/* Job execution with an OTA-style job document carrying signatures. */
+static void buildJob( Document_t * doc,
+                      size_t target )
+{
+    char line[ 512 ];
+    unsigned i;
+
+    append( doc, "{\"execution\":{\"jobId\":\"AFR_OTA-firmware-rollout-2024\",\"status\":\"QUEUED\","
+                 "\"queuedAt\":1700000000,\"versionNumber\":1,\"executionNumber\":1,"
+                 "\"jobDocument\":{\"afr_ota\":{\"protocols\":[\"MQTT\"],\"streamname\":\"AFR_OTA-1\",\"files\":[" );
+
+    for( i = 0U; doc->length < ( target - 64U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s{\"filepath\":\"/firmware/partition_%u.bin\",\"filesize\":%u,\"fileid\":%u,"
+                           "\"certfile\":\"/certs/codesign.crt\","
+                           "\"sig-sha256-ecdsa\":\"MEUCIQDx8n3rQ0c5pY9bR2m7Vw1Lq6f4T8kJdZs0aH3gYp2uXwIgE5v7N1oB9cQ+R4tM6yK8jL0sF2wD3hG5uI7eP9aX1bc=\"}",
+                           ( i == 0U ) ? "" : ",", i, 100000U + i, i );
+        append( doc, line );
+    }
+
+    append( doc, "]}}},\"" BENCH_LAST_KEY "\":\"job\"}" );
+}
+
+/* Readings nested close to JSON_MAX_DEPTH, so that most of the time goes to
+ * opening and closing collections. */
+static void buildNested( Document_t * doc,
+                         size_t target )
+{
+    char line[ 64 ];
+    unsigned i, depth;
+
+    append( doc, "{\"readings\":[" );
+
+    for( i = 0U; doc->length < ( target - 256U ); i++ )
+    {
+        append( doc, ( i == 0U ) ? "" : "," );
+
+        for( depth = 0U; depth < BENCH_NESTED_DEPTH; depth++ )
+        {
+            append( doc, ( ( depth % 2U ) == 0U ) ? "{\"n\":" : "[" );
+        }
+
+        ( void ) snprintf( line, sizeof( line ), "%u", i );
+        append( doc, line );
+
+        for( depth = BENCH_NESTED_DEPTH; depth > 0U; depth-- )
+        {
+            append( doc, ( ( ( depth - 1U ) % 2U ) == 0U ) ? "}" : "]" );
+        }
+    }
+
+    append( doc, "],\"" BENCH_LAST_KEY "\":\"nested\"}" );
+}
+
+/* Log lines and paths, where escape sequences break up every string. */
+static void buildEscaped( Document_t * doc,
+                          size_t target )
+{
+    char line[ 256 ];
+    unsigned i;
+
+    append( doc, "{\"log\":{" );
+
+    for( i = 0U; doc->length < ( target - 64U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s\"line_%u\":\"\\\"%u\\\"\\topened C:\\\\dev\\\\ttyUSB%u\\r\\n"
+                           "\\tstatus \\/ok\\/\\u0009\\u001b[0m\\b\\f\"",
+                           ( i == 0U ) ? "" : ",", i, i, i % 4U );
+        append( doc, line );
+    }
+
+    append( doc, "},\"" BENCH_LAST_KEY "\":\"escaped\"}" );
+}
+
+/* Labels in several scripts, as raw UTF-8 and as \u escapes. */
+static void buildUnicode( Document_t * doc,
+                          size_t target )
+{
+    char line[ 256 ];
+    unsigned i;
+
+    append( doc, "{\"labels\":{" );
+
+    for( i = 0U; doc->length < ( target - 64U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s\"\xce\xb8_%u\":{\"el\":\"\xce\xb8\xce\xb5\xcf\x81\xce\xbc\xce\xbf\xce\xba\xcf\x81\xce\xb1\xcf\x83\xce\xaf\xce\xb1 %u\","
+                           "\"ja\":\"\xe6\xb8\xa9\xe5\xba\xa6\xe3\x82\xbb\xe3\x83\xb3\xe3\x82\xb5\xe3\x83\xbc\","
+                           "\"icon\":\"\xf0\x9f\x8c\xa1\",\"ascii\":\"\\u00b0C \\u2103 \\ud83c\\udf21\"}",
+                           ( i == 0U ) ? "" : ",", i, i );
+        append( doc, line );
+    }
+
+    append( doc, "},\"" BENCH_LAST_KEY "\":\"unicode\"}" );
+}
+
+/* Sample arrays, with integers, fractions and exponents of both signs. */
+static void buildNumbers( Document_t * doc,
+                          size_t target )
+{
+    char line[ 256 ];
+    unsigned i;
+
+    append( doc, "{\"samples\":[" );
+
+    for( i = 0U; doc->length < ( target - 64U ); i++ )
+    {
+        ( void ) snprintf( line, sizeof( line ),
+                           "%s[%u,-%u.%03u,%u.%ue-%u,-0.%05u,%u.%uE+%u,1700000%03u]",
+                           ( i == 0U ) ? "" : ",", i, i % 50U, i % 1000U,
+                           1U + ( i % 9U ), i % 10U, 1U + ( i % 12U ), i,
+                           1U + ( i % 9U ), i % 100U, 10U + ( i % 20U ), i % 1000U );
+        append( doc, line );
+    }
+
+    append( doc, "],\"" BENCH_LAST_KEY "\":\"numbers\"}" );
+}
+
+/*-----------------------------------------------------------*/
+
+/* Process CPU time, so that time spent descheduled is not counted. */
+static double now( void )
+{
+    struct timespec ts;
+
+    ( void ) clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &ts );
+
+    return ( double ) ts.tv_sec + ( ( double ) ts.tv_nsec / 1e9 );
+}
+
+/* Visit every value of a collection and of the collections within it,
+ * adding their number to count. */
+static JSONStatus_t walk( const Scanner_t * scanner,
+                          const char * buf,
+                          size_t max,
+                          size_t * count )
+{
+    JSONStatus_t status;
+    size_t start = 0U, next = 0U;
+    JSONPair_t pair;
+
+    status = scanner->iterate( buf, max, &start, &next, &pair );
+
+    while( status == JSONSuccess )
+    {
+        ( *count )++;
+
+        if( ( pair.jsonType == JSONObject ) || ( pair.jsonType == JSONArray ) )
+        {
+            status = walk( scanner, pair.value, pair.valueLength, count );
+        }
+
+        if( status == JSONSuccess )
+        {
+            status = scanner->iterate( buf, max, &start, &next, &pair );
+        }
+    }
+
+    return ( status == JSONNotFound ) ? JSONSuccess : status;
+}
+
+/* Time one run of a scanner. */
+static double measureOnce( const Scanner_t * scanner,
+                           Document_t * doc,
+                           BenchOperation_t operation,
+                           size_t iterations )
+{
+    JSONStatus_t status = JSONSuccess;
+    double start;
+    size_t i;
+
+    start = now();
+
+    for( i = 0U; ( i < iterations ) && ( status == JSONSuccess ); i++ )
+    {
+        if( operation == benchValidate )
+        {
+            status = scanner->validate( doc->buf, doc->length );
+        }
+        else if( operation == benchSearch )
+        {
+            char * value;
+            size_t valueLength;
+            JSONTypes_t type;
+
+            status = scanner->search( doc->buf, doc->length, BENCH_LAST_KEY, strlen( BENCH_LAST_KEY ),
+                                      &value, &valueLength, &type );
+        }
+        else
+        {
+            size_t count = 0U;
+
+            status = walk( scanner, doc->buf, doc->length, &count );
+        }
+    }
+
+    if( status != JSONSuccess )
+    {
+        ( void ) fprintf( stderr, "benchmark document rejected: %d\n", ( int ) status );
+        exit( EXIT_FAILURE );
+    }
+
+    return now() - start;
+}
+
+/* Fills in the best throughput in MB/s of each scanner. */
+static void measure( Document_t * doc,
+                     BenchOperation_t operation,
+                     double best[ 2 ] )
+{
+    size_t iterations = ( BENCH_BYTES_PER_RUN / doc->length ) + 1U;
+    double rate;
+    unsigned run, n;
+
+    best[ 0 ] = 0.0;
+    best[ 1 ] = 0.0;
+
+    for( run = 0U; run < BENCH_RUNS; run++ )
+    {
+        for( n = 0U; n < 2U; n++ )
+        {
+            rate = ( ( double ) doc->length * ( double ) iterations ) /
+                   measureOnce( &scanners[ n ], doc, operation, iterations ) / 1e6;
+
+            if( rate > best[ n ] )
+            {
+                best[ n ] = rate;
+            }
+        }
+    }
+}
+
+int main( void )
+{
+    static const struct
+    {
+        const char * name;
+        DocumentBuilder_t build;
+    } kinds[] =
+    {
+        { "shadow-delta",  buildShadowDelta  },
+        { "shadow-pretty", buildShadowPretty },
+        { "job",           buildJob          },
+        { "nested",        buildNested       },
+        { "escaped",       buildEscaped      },
+        { "unicode",       buildUnicode      },
+        { "numbers",       buildNumbers      },
+    };
+    static const size_t sizes[] = { 1024U, 4096U, 16384U, 65536U };
+    Document_t doc;
+    double validate[ 2 ], search[ 2 ], iterate[ 2 ];
+    size_t k, s, values;
+
+    doc.size = sizes[ ( sizeof( sizes ) / sizeof( sizes[ 0 ] ) ) - 1U ] + 1024U;
+    doc.buf = malloc( doc.size );
+
+    if( doc.buf == NULL )
+    {
+        return EXIT_FAILURE;
+    }
+
+    ( void ) printf( "%-14s %8s %6s %24s %24s %24s\n", "", "", "",
+                     "validate MB/s", "search MB/s", "iterate MB/s" );
+    ( void ) printf( "%-14s %8s %6s %8s %8s %6s %8s %8s %6s %8s %8s %6s %8s\n",
+                     "document", "bytes", "values",
+                     "byte", "word", "ratio", "byte", "word", "ratio",
+                     "byte", "word", "ratio", "ns/value" );
+
+    for( k = 0U; k < ( sizeof( kinds ) / sizeof( kinds[ 0 ] ) ); k++ )
+    {
+        for( s = 0U; s < ( sizeof( sizes ) / sizeof( sizes[ 0 ] ) ); s++ )
+        {
+            doc.length = 0U;
+            doc.buf[ 0 ] = '\0';
+            kinds[ k ].build( &doc, sizes[ s ] );
+
+            values = 0U;
+
+            if( ( scanners[ 1 ].validate( doc.buf, doc.length ) != JSONSuccess ) ||
+                ( walk( &scanners[ 1 ], doc.buf, doc.length, &values ) != JSONSuccess ) )
+            {
+                ( void ) fprintf( stderr, "%s document rejected\n", kinds[ k ].name );
+                return EXIT_FAILURE;
+            }
+
+            measure( &doc, benchValidate, validate );
+            measure( &doc, benchSearch, search );
+            measure( &doc, benchIterate, iterate );
+
+            ( void ) printf( "%-14s %8zu %6zu %8.0f %8.0f %6.2f %8.0f %8.0f %6.2f %8.0f %8.0f %6.2f %8.1f\n",
+                             kinds[ k ].name, doc.length, values,
+                             validate[ 0 ], validate[ 1 ], validate[ 1 ] / validate[ 0 ],
+                             search[ 0 ], search[ 1 ], search[ 1 ] / search[ 0 ],
+                             iterate[ 0 ], iterate[ 1 ], iterate[ 1 ] / iterate[ 0 ],
+                             ( ( double ) doc.length * 1e3 ) / ( iterate[ 1 ] * ( double ) values ) );
+        }
+    }
+
+    free( doc.buf );
+
+    return EXIT_SUCCESS;
+}
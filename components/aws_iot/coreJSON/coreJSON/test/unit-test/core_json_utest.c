@@ -1692,6 +1692,462 @@ void test_JSON_Search_Partial_Documents( void )
     TEST_ASSERT_EQUAL( JSONNotFound, jsonStatus );
 }
 
+/* A document and queries for JSON_SearchBatch(). */
+#define BATCH_DOC                                                        \
+    "{\"state\":{\"color\":\"red\",\"led\":[true,{\"on\":1}],\"e\":{}}," \
+    "\"version\":7,\"state\":{\"color\":\"blue\"}}"
+#define BATCH_DOC_LENGTH    ( sizeof( BATCH_DOC ) - 1 )
+
+/**
+ * @brief Set up a batch query.
+ */
+void setQuery( JSONQuery_t * query,
+               const char * text )
+{
+    memset( query, 0xA5, sizeof( *query ) );
+    query->query = text;
+    query->queryLength = strlen( text );
+}
+
+/**
+ * @brief Test that JSON_SearchBatch resolves every query of a batch in one call.
+ */
+void test_JSON_SearchBatch_Legal_Documents( void )
+{
+    JSONStatus_t jsonStatus;
+    JSONQuery_t queries[ 7 ];
+
+    /* Out of order, with shared prefixes and a query on an entered collection. */
+    setQuery( &queries[ 0 ], "version" );
+    setQuery( &queries[ 1 ], "state.led[1].on" );
+    setQuery( &queries[ 2 ], "state" );
+    setQuery( &queries[ 3 ], "state.color" );
+    setQuery( &queries[ 4 ], "state.led[0]" );
+    setQuery( &queries[ 5 ], "state.led" );
+    setQuery( &queries[ 6 ], "state.e" );
+
+    jsonStatus = JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 7 );
+    TEST_ASSERT_EQUAL( JSONSuccess, jsonStatus );
+
+    TEST_ASSERT_EQUAL( JSONNumber, queries[ 0 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "7", queries[ 0 ].value, queries[ 0 ].valueLength );
+    TEST_ASSERT_EQUAL( JSONNumber, queries[ 1 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "1", queries[ 1 ].value, queries[ 1 ].valueLength );
+    TEST_ASSERT_EQUAL( JSONObject, queries[ 2 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "{\"color\":\"red\",\"led\":[true,{\"on\":1}],\"e\":{}}",
+                                  queries[ 2 ].value, queries[ 2 ].valueLength );
+    /* The first "state" key is the one searched, as with JSON_Search. */
+    TEST_ASSERT_EQUAL( JSONString, queries[ 3 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "red", queries[ 3 ].value, queries[ 3 ].valueLength );
+    TEST_ASSERT_EQUAL( JSONTrue, queries[ 4 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "true", queries[ 4 ].value, queries[ 4 ].valueLength );
+    TEST_ASSERT_EQUAL( JSONArray, queries[ 5 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "[true,{\"on\":1}]", queries[ 5 ].value, queries[ 5 ].valueLength );
+    TEST_ASSERT_EQUAL( JSONObject, queries[ 6 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( "{}", queries[ 6 ].value, queries[ 6 ].valueLength );
+
+    /* Results agree with JSON_Search on an existing document. */
+    setQuery( &queries[ 0 ], COMPLETE_QUERY_KEY );
+    setQuery( &queries[ 1 ], FIRST_QUERY_KEY );
+    jsonStatus = JSON_SearchBatch( JSON_DOC_VARIED_SCALARS, JSON_DOC_VARIED_SCALARS_LENGTH,
+                                   queries, 2 );
+    TEST_ASSERT_EQUAL( JSONSuccess, jsonStatus );
+    TEST_ASSERT_EQUAL( COMPLETE_QUERY_KEY_ANSWER_TYPE, queries[ 0 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( COMPLETE_QUERY_KEY_ANSWER, queries[ 0 ].value,
+                                  queries[ 0 ].valueLength );
+    TEST_ASSERT_EQUAL( FIRST_QUERY_KEY_ANSWER_TYPE, queries[ 1 ].jsonType );
+    TEST_ASSERT_EQUAL_STRING_LEN( FIRST_QUERY_KEY_ANSWER, queries[ 1 ].value,
+                                  queries[ 1 ].valueLength );
+
+    /* A document holding a single scalar. */
+    setQuery( &queries[ 0 ], "[0]" );
+    jsonStatus = JSON_SearchBatch( "[\"x\"]", 5, queries, 1 );
+    TEST_ASSERT_EQUAL( JSONSuccess, jsonStatus );
+    TEST_ASSERT_EQUAL_STRING_LEN( "x", queries[ 0 ].value, queries[ 0 ].valueLength );
+}
+
+/**
+ * @brief Test that JSON_SearchBatch reports the queries it cannot match.
+ */
+void test_JSON_SearchBatch_Not_Found( void )
+{
+    JSONStatus_t jsonStatus;
+    JSONQuery_t queries[ 5 ];
+
+    setQuery( &queries[ 0 ], "state.color" );
+    /* Only the first "state" is searched. */
+    setQuery( &queries[ 1 ], "state.size" );
+    setQuery( &queries[ 2 ], "state.led[2]" );
+    /* The next part does not fit the type of the value. */
+    setQuery( &queries[ 3 ], "state.color.x" );
+    setQuery( &queries[ 4 ], "state[0]" );
+
+    jsonStatus = JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 5 );
+    TEST_ASSERT_EQUAL( JSONNotFound, jsonStatus );
+    TEST_ASSERT_EQUAL_STRING_LEN( "red", queries[ 0 ].value, queries[ 0 ].valueLength );
+    TEST_ASSERT_NULL( queries[ 1 ].value );
+    TEST_ASSERT_NULL( queries[ 2 ].value );
+    TEST_ASSERT_NULL( queries[ 3 ].value );
+    TEST_ASSERT_NULL( queries[ 4 ].value );
+    TEST_ASSERT_EQUAL( JSONInvalid, queries[ 4 ].jsonType );
+
+    /* A value cut off by the end of the buffer is not found. */
+    setQuery( &queries[ 0 ], "state" );
+    setQuery( &queries[ 1 ], "state.color" );
+    jsonStatus = JSON_SearchBatch( BATCH_DOC, 30, queries, 2 );
+    TEST_ASSERT_EQUAL( JSONNotFound, jsonStatus );
+    TEST_ASSERT_NULL( queries[ 0 ].value );
+    TEST_ASSERT_EQUAL_STRING_LEN( "red", queries[ 1 ].value, queries[ 1 ].valueLength );
+
+    /* Illegal documents. */
+    setQuery( &queries[ 0 ], "a.b" );
+    TEST_ASSERT_EQUAL( JSONNotFound, JSON_SearchBatch( "{\"a\":{\"b\" 1}}", 13, queries, 1 ) );
+    TEST_ASSERT_EQUAL( JSONNotFound, JSON_SearchBatch( "{\"a\":{1:1}}", 11, queries, 1 ) );
+    TEST_ASSERT_EQUAL( JSONNotFound, JSON_SearchBatch( "{\"a\":{\"c\":1]}", 13, queries, 1 ) );
+    TEST_ASSERT_EQUAL( JSONNotFound, JSON_SearchBatch( "{\"a\":{\"c\":1,}}", 14, queries, 1 ) );
+    TEST_ASSERT_EQUAL( JSONNotFound, JSON_SearchBatch( "{\"a\":{", 6, queries, 1 ) );
+}
+
+/**
+ * @brief Test that JSON_SearchBatch checks its parameters and every query.
+ */
+void test_JSON_SearchBatch_Invalid_Params( void )
+{
+    JSONQuery_t queries[ 2 ];
+
+    setQuery( &queries[ 0 ], "state" );
+    setQuery( &queries[ 1 ], "version" );
+
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_SearchBatch( NULL, BATCH_DOC_LENGTH, queries, 2 ) );
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, NULL, 2 ) );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, 0, queries, 2 ) );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 0 ) );
+
+    queries[ 1 ].query = NULL;
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+
+    setQuery( &queries[ 1 ], "" );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+
+    setQuery( &queries[ 1 ], "state." );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+
+    setQuery( &queries[ 1 ], "state..color" );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+
+    setQuery( &queries[ 1 ], "state.led[x]" );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+
+    setQuery( &queries[ 1 ], "state.led[1" );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+
+    setQuery( &queries[ 1 ], "state.led[99999999999]" );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_SearchBatch( BATCH_DOC, BATCH_DOC_LENGTH, queries, 2 ) );
+}
+
+/* The values JSON_StreamFeed() reports for BATCH_DOC, as logged by logValue(). */
+#define BATCH_DOC_STREAM_LOG                                       \
+    "=object;state=object;state.color=red;state.led=array;"        \
+    "state.led[0]=true;state.led[1]=object;state.led[1].on=1;"     \
+    "state.e=object;version=7;state=object;state.color=blue;"
+
+/* Empty and long collections, and scalars of every kind. */
+#define STREAM_EDGES                                              \
+    "[[],{},[0,1,2,3,4,5,6,7,8,9,10],0,-1,1.5e5,2E-3,-0e+1,"      \
+    "true,false,null,\"\x7F\\/\"]"
+
+/* Scalars whose values are reported as JSON_Search() outputs them. */
+#define STREAM_SCALARS    "[\"a\\\"b\\u00e9\",null,-0.5E+2]"
+
+/**
+ * @brief Log of the values reported by a stream.
+ */
+typedef struct
+{
+    char text[ 512 ];
+    size_t length;
+    size_t count;
+    JSONPair_t lastPair;
+} StreamLog_t;
+
+/**
+ * @brief Stream callback which appends "path=value;" to a StreamLog_t.
+ */
+void logValue( void * pContext,
+               const JSONPair_t * pPair )
+{
+    StreamLog_t * log = pContext;
+    const char * value = pPair->value;
+    size_t valueLength = pPair->valueLength;
+
+    if( pPair->jsonType == JSONObject )
+    {
+        value = "object";
+        valueLength = strlen( value );
+    }
+    else if( pPair->jsonType == JSONArray )
+    {
+        value = "array";
+        valueLength = strlen( value );
+    }
+    else if( value == NULL )
+    {
+        value = "...";
+        valueLength = strlen( value );
+    }
+
+    log->length += snprintf( &log->text[ log->length ], sizeof( log->text ) - log->length,
+                             "%.*s=%.*s;", ( int ) pPair->keyLength, pPair->key,
+                             ( int ) valueLength, value );
+    log->count++;
+    log->lastPair = *pPair;
+}
+
+/**
+ * @brief Feed a document to a stream in pieces of the given size.
+ *
+ * @return the result of JSON_StreamFinish().
+ */
+JSONStatus_t feedInPieces( const char * buf,
+                           size_t max,
+                           size_t pieceSize,
+                           StreamLog_t * log )
+{
+    JSONStream_t stream;
+    size_t i, length;
+
+    memset( &stream, 0xA5, sizeof( stream ) );
+
+    if( log != NULL )
+    {
+        memset( log, 0x00, sizeof( *log ) );
+    }
+
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamInit( &stream, ( log != NULL ) ? logValue : NULL, log ) );
+
+    for( i = 0; i < max; i += length )
+    {
+        length = ( ( max - i ) < pieceSize ) ? ( max - i ) : pieceSize;
+        ( void ) JSON_StreamFeed( &stream, &buf[ i ], length );
+    }
+
+    return JSON_StreamFinish( &stream );
+}
+
+/**
+ * @brief Test that JSON_StreamFeed accepts legal documents however they are split,
+ * and reports their values.
+ */
+void test_JSON_Stream_Legal_Documents( void )
+{
+    static const struct
+    {
+        const char * buf;
+        size_t length;
+    } documents[] =
+    {
+        { JSON_DOC_VARIED_SCALARS,                 JSON_DOC_VARIED_SCALARS_LENGTH                 },
+        { JSON_DOC_LEGAL_TRAILING_SPACE,           JSON_DOC_LEGAL_TRAILING_SPACE_LENGTH           },
+        { JSON_DOC_MULTIPLE_VALID_ESCAPES,         JSON_DOC_MULTIPLE_VALID_ESCAPES_LENGTH         },
+        { JSON_DOC_LEGAL_UTF8_BYTE_SEQUENCES,      JSON_DOC_LEGAL_UTF8_BYTE_SEQUENCES_LENGTH      },
+        { JSON_DOC_LEGAL_UNICODE_ESCAPE_SURROGATES,JSON_DOC_LEGAL_UNICODE_ESCAPE_SURROGATES_LENGTH},
+        { JSON_DOC_UNICODE_ESCAPE_SEQUENCES_BMP,   JSON_DOC_UNICODE_ESCAPE_SEQUENCES_BMP_LENGTH   },
+        { JSON_DOC_LEGAL_ARRAY,                    JSON_DOC_LEGAL_ARRAY_LENGTH                    },
+        { SINGLE_SCALAR,                           SINGLE_SCALAR_LENGTH                           },
+        { BATCH_DOC,                               BATCH_DOC_LENGTH                               },
+        { STREAM_EDGES,                            sizeof( STREAM_EDGES ) - 1                     },
+        { "-0.5",                                  4                                              },
+        { "2e3",                                   3                                              },
+    };
+    JSONStream_t stream;
+    StreamLog_t log;
+    size_t i, pieceSize;
+
+    for( i = 0; i < ( sizeof( documents ) / sizeof( documents[ 0 ] ) ); i++ )
+    {
+        for( pieceSize = 1; pieceSize <= 9; pieceSize += 4 )
+        {
+            TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( documents[ i ].buf, documents[ i ].length,
+                                                          pieceSize, NULL ) );
+        }
+
+        TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( documents[ i ].buf, documents[ i ].length,
+                                                      documents[ i ].length, NULL ) );
+    }
+
+    /* Every value is reported once with its path, duplicate keys included. */
+    TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( BATCH_DOC, BATCH_DOC_LENGTH, 1, &log ) );
+    TEST_ASSERT_EQUAL_STRING( BATCH_DOC_STREAM_LOG, log.text );
+    TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( BATCH_DOC, BATCH_DOC_LENGTH, BATCH_DOC_LENGTH, &log ) );
+    TEST_ASSERT_EQUAL_STRING( BATCH_DOC_STREAM_LOG, log.text );
+
+    /* Values are as JSON_Search outputs them. */
+    TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( STREAM_SCALARS, strlen( STREAM_SCALARS ), 2, &log ) );
+    TEST_ASSERT_EQUAL_STRING( "=array;[0]=a\\\"b\\u00e9;[1]=null;[2]=-0.5E+2;", log.text );
+    TEST_ASSERT_EQUAL( JSONNumber, log.lastPair.jsonType );
+
+    /* An outermost number is complete only at the end of the document. */
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamInit( &stream, logValue, &log ) );
+    memset( &log, 0x00, sizeof( log ) );
+    TEST_ASSERT_EQUAL( JSONPartial, JSON_StreamFeed( &stream, " 4", 2 ) );
+    TEST_ASSERT_EQUAL( JSONPartial, JSON_StreamFeed( &stream, "2", 1 ) );
+    TEST_ASSERT_EQUAL( 0, log.count );
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamFinish( &stream ) );
+    TEST_ASSERT_EQUAL_STRING( "=42;", log.text );
+
+    /* Whitespace may follow a complete document. */
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamInit( &stream, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamFeed( &stream, "{} ", 3 ) );
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamFeed( &stream, "\r\n", 2 ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, JSON_StreamFeed( &stream, " {}", 3 ) );
+}
+
+/**
+ * @brief Test that JSON_StreamFeed rejects illegal documents, and that the
+ * result is final.
+ */
+void test_JSON_Stream_Illegal_Documents( void )
+{
+    static const struct
+    {
+        const char * buf;
+        size_t length;
+    } documents[] =
+    {
+        { INCORRECT_OBJECT_SEPARATOR,              INCORRECT_OBJECT_SEPARATOR_LENGTH              },
+        { ILLEGAL_KEY_NOT_STRING,                  ILLEGAL_KEY_NOT_STRING_LENGTH                  },
+        { WRONG_KEY_VALUE_SEPARATOR,               WRONG_KEY_VALUE_SEPARATOR_LENGTH               },
+        { TRAILING_COMMA_IN_ARRAY,                 TRAILING_COMMA_IN_ARRAY_LENGTH                 },
+        { TRAILING_COMMA_AFTER_VALUE,              TRAILING_COMMA_AFTER_VALUE_LENGTH              },
+        { MISSING_COMMA_AFTER_VALUE,               MISSING_COMMA_AFTER_VALUE_LENGTH               },
+        { MISSING_VALUE_AFTER_KEY,                 MISSING_VALUE_AFTER_KEY_LENGTH                 },
+        { MISMATCHED_BRACKETS,                     MISMATCHED_BRACKETS_LENGTH                     },
+        { ILLEGAL_SCALAR_IN_ARRAY,                 ILLEGAL_SCALAR_IN_ARRAY_LENGTH                 },
+        { LEADING_ZEROS_IN_NUMBER,                 LEADING_ZEROS_IN_NUMBER_LENGTH                 },
+        { LETTER_AS_EXPONENT,                      LETTER_AS_EXPONENT_LENGTH                      },
+        { UNESCAPED_CONTROL_CHAR,                  UNESCAPED_CONTROL_CHAR_LENGTH                  },
+        { NUL_ESCAPE,                              NUL_ESCAPE_LENGTH                              },
+        { ILLEGAL_UTF8_NEXT_BYTE,                  ILLEGAL_UTF8_NEXT_BYTE_LENGTH                  },
+        { ILLEGAL_UTF8_START_C1,                   ILLEGAL_UTF8_START_C1_LENGTH                   },
+        { ILLEGAL_UTF8_START_F5,                   ILLEGAL_UTF8_START_F5_LENGTH                   },
+        { ILLEGAL_UTF8_SURROGATE_RANGE_MIN,        ILLEGAL_UTF8_SURROGATE_RANGE_MIN_LENGTH        },
+        { ILLEGAL_UTF8_GT_MIN_CP_THREE_BYTES,      ILLEGAL_UTF8_GT_MIN_CP_THREE_BYTES_LENGTH      },
+        { UNICODE_ESCAPE_SEQUENCE_ZERO_CP,         UNICODE_ESCAPE_SEQUENCE_ZERO_CP_LENGTH         },
+        { UNICODE_PREMATURE_LOW_SURROGATE,         UNICODE_PREMATURE_LOW_SURROGATE_LENGTH         },
+        { UNICODE_BOTH_SURROGATES_HIGH,            UNICODE_BOTH_SURROGATES_HIGH_LENGTH            },
+        { UNICODE_VALID_HIGH_NO_LOW_SURROGATE,     UNICODE_VALID_HIGH_NO_LOW_SURROGATE_LENGTH     },
+        { UNICODE_WRONG_ESCAPE_AFTER_HIGH_SURROGATE, UNICODE_WRONG_ESCAPE_AFTER_HIGH_SURROGATE_LENGTH },
+        { UNICODE_INVALID_LOWERCASE_HEX,           UNICODE_INVALID_LOWERCASE_HEX_LENGTH           },
+        { CLOSING_CURLY_BRACKET,                   CLOSING_CURLY_BRACKET_LENGTH                   },
+    };
+    JSONStream_t stream;
+    size_t i;
+
+    for( i = 0; i < ( sizeof( documents ) / sizeof( documents[ 0 ] ) ); i++ )
+    {
+        TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( documents[ i ].buf, documents[ i ].length,
+                                                              1, NULL ) );
+        TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( documents[ i ].buf, documents[ i ].length,
+                                                              documents[ i ].length, NULL ) );
+    }
+
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( "[tru3]", strlen( "[tru3]" ), 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( "[-a]", strlen( "[-a]" ), 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( "[1e+a]", strlen( "[1e+a]" ), 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( "[\"\\q\"]", strlen( "[\"\\q\"]" ), 1, NULL ) );
+
+    /* Unlike JSON_Validate, a comma and a key are required before a collection. */
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( "[1 {}]", strlen( "[1 {}]" ), 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, feedInPieces( "{[]}", strlen( "{[]}" ), 1, NULL ) );
+
+    /* Documents that end too soon are partial. */
+    TEST_ASSERT_EQUAL( JSONPartial, feedInPieces( CUT_AFTER_OBJECT_OPEN_BRACE,
+                                                  CUT_AFTER_OBJECT_OPEN_BRACE_LENGTH, 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONPartial, feedInPieces( CUT_AFTER_COMMA_SEPARATOR,
+                                                  CUT_AFTER_COMMA_SEPARATOR_LENGTH, 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONPartial, feedInPieces( CUT_AFTER_EXPONENT_MARKER,
+                                                  CUT_AFTER_EXPONENT_MARKER_LENGTH, 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONPartial, feedInPieces( ESCAPE_CHAR_ALONE_NOT_ENCLOSED,
+                                                  ESCAPE_CHAR_ALONE_NOT_ENCLOSED_LENGTH, 1, NULL ) );
+    TEST_ASSERT_EQUAL( JSONPartial, feedInPieces( WHITE_SPACE, WHITE_SPACE_LENGTH, 1, NULL ) );
+
+    /* Once illegal, later pieces are ignored. */
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamInit( &stream, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, JSON_StreamFeed( &stream, "[1,,", 4 ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, JSON_StreamFeed( &stream, "2]", 2 ) );
+    TEST_ASSERT_EQUAL( JSONIllegalDocument, JSON_StreamFinish( &stream ) );
+}
+
+/**
+ * @brief Test the limits of a stream: nesting depth, path and value length.
+ */
+void test_JSON_Stream_Limits( void )
+{
+    char * maxNestedArray, * maxNestedObject;
+    char buf[ JSON_STREAM_MAX_PATH + JSON_STREAM_MAX_VALUE + 16 ];
+    JSONStream_t stream;
+    StreamLog_t log;
+    size_t length;
+
+    maxNestedArray = allocateMaxDepthArray();
+    TEST_ASSERT_EQUAL( JSONMaxDepthExceeded, feedInPieces( maxNestedArray, strlen( maxNestedArray ),
+                                                           3, NULL ) );
+    maxNestedObject = allocateMaxDepthObject();
+    TEST_ASSERT_EQUAL( JSONMaxDepthExceeded, feedInPieces( maxNestedObject, strlen( maxNestedObject ),
+                                                           3, NULL ) );
+    free( maxNestedArray );
+    free( maxNestedObject );
+
+    /* A value that does not fit is reported without its text. */
+    buf[ 0 ] = '[';
+    buf[ 1 ] = '"';
+    memset( &buf[ 2 ], 'v', JSON_STREAM_MAX_VALUE + 1 );
+    length = JSON_STREAM_MAX_VALUE + 3;
+    buf[ length++ ] = '"';
+    buf[ length++ ] = ']';
+    TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( buf, length, 5, &log ) );
+    TEST_ASSERT_EQUAL( 2, log.count );
+    TEST_ASSERT_NULL( log.lastPair.value );
+    TEST_ASSERT_EQUAL( JSONString, log.lastPair.jsonType );
+    TEST_ASSERT_EQUAL( JSON_STREAM_MAX_VALUE + 1, log.lastPair.valueLength );
+
+    /* Values under a path that does not fit are not reported. */
+    buf[ 0 ] = '{';
+    buf[ 1 ] = '"';
+    memset( &buf[ 2 ], 'k', JSON_STREAM_MAX_PATH + 1 );
+    length = JSON_STREAM_MAX_PATH + 3;
+    memcpy( &buf[ length ], "\":[{\"a\":1}],\"b\":2}", 18 );
+    length += 18;
+    TEST_ASSERT_EQUAL( JSONSuccess, feedInPieces( buf, length, 7, &log ) );
+    TEST_ASSERT_EQUAL_STRING( "=object;b=2;", log.text );
+
+    /* The length of a value saturates. */
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamInit( &stream, logValue, &log ) );
+    TEST_ASSERT_EQUAL( JSONPartial, JSON_StreamFeed( &stream, "\"ab", 3 ) );
+    stream.valueLength = SIZE_MAX - 1U;
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamFeed( &stream, "cd\"", 3 ) );
+    TEST_ASSERT_EQUAL( SIZE_MAX, log.lastPair.valueLength );
+}
+
+/**
+ * @brief Test that the stream functions check their parameters.
+ */
+void test_JSON_Stream_Invalid_Params( void )
+{
+    JSONStream_t stream;
+
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_StreamInit( NULL, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamInit( &stream, NULL, NULL ) );
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_StreamFeed( NULL, "{}", 2 ) );
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_StreamFeed( &stream, NULL, 2 ) );
+    TEST_ASSERT_EQUAL( JSONBadParameter, JSON_StreamFeed( &stream, "{}", 0 ) );
+    TEST_ASSERT_EQUAL( JSONNullParameter, JSON_StreamFinish( NULL ) );
+
+    /* A parameter error leaves the stream as it was. */
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamFeed( &stream, "{}", 2 ) );
+    TEST_ASSERT_EQUAL( JSONSuccess, JSON_StreamFinish( &stream ) );
+}
+
 /**
  * @brief Test that a nested collection can only have up to JSON_MAX_DEPTH levels
  * of nesting.
@@ -1725,6 +2181,7 @@ void test_JSON_asserts( void )
     uint16_t u = 0;
     size_t key, keyLength, value, valueLength;
     int32_t queryIndex = 0;
+    JSONStream_t stream;
 
     catch_assert( skipSpace( NULL, &start, max ) );
     catch_assert( skipSpace( buf, NULL, max ) );
@@ -1850,6 +2307,9 @@ void test_JSON_asserts( void )
     catch_assert( iterate( buf, max, &start, &next, &key, NULL, &value, &valueLength ) );
     catch_assert( iterate( buf, max, &start, &next, &key, &keyLength, NULL, &valueLength ) );
     catch_assert( iterate( buf, max, &start, &next, &key, &keyLength, &value, NULL ) );
+
+    ( void ) JSON_StreamInit( &stream, NULL, NULL );
+    catch_assert( streamStringByte( &stream, 'a' ) );
 }
 
 /**
@@ -1887,6 +2347,90 @@ void test_JSON_unreached( void )
     }
 }
 
+/**
+ * @brief Test that whitespace runs and string bodies are classified the same
+ * wherever a significant byte falls relative to a machine word.
+ */
+void test_JSON_Word_Boundaries( void )
+{
+    /* Longer than two words on any supported target. */
+    char buf[ 40 ];
+    const size_t bodyLength = sizeof( buf ) - 2U;
+    size_t i, start;
+    bool ret;
+
+    for( i = 0; i < bodyLength; i++ )
+    {
+        /* A whitespace run ending just before offset i. */
+        memset( buf, ' ', sizeof( buf ) );
+        buf[ i ] = 'x';
+        start = 0;
+        skipSpace( buf, &start, sizeof( buf ) );
+        TEST_ASSERT_EQUAL( i, start );
+
+        /* Every JSON whitespace character is skipped. */
+        buf[ i ] = "\t\n\r "[ i % 4U ];
+        start = 0;
+        skipSpace( buf, &start, bodyLength );
+        TEST_ASSERT_EQUAL( bodyLength, start );
+
+        /* A plain ASCII body terminated at offset i + 1. */
+        memset( buf, 'a', sizeof( buf ) );
+        buf[ 0 ] = '"';
+        buf[ i + 1U ] = '"';
+        start = 0;
+        ret = skipString( buf, &start, sizeof( buf ) );
+        TEST_ASSERT_EQUAL( true, ret );
+        TEST_ASSERT_EQUAL( i + 2U, start );
+
+        /* An escaped quote at offset i + 1 does not terminate the string. */
+        if( i > 0U )
+        {
+            memset( buf, 'a', sizeof( buf ) );
+            buf[ 0 ] = '"';
+            buf[ sizeof( buf ) - 1U ] = '"';
+            buf[ i ] = '\\';
+            buf[ i + 1U ] = '"';
+            start = 0;
+            ret = skipString( buf, &start, sizeof( buf ) );
+            TEST_ASSERT_EQUAL( true, ret );
+            TEST_ASSERT_EQUAL( sizeof( buf ), start );
+        }
+
+        /* An unescaped control character at offset i + 1 is illegal. */
+        memset( buf, 'a', sizeof( buf ) );
+        buf[ 0 ] = '"';
+        buf[ sizeof( buf ) - 1U ] = '"';
+        buf[ i + 1U ] = '\x1F';
+        start = 0;
+        TEST_ASSERT_EQUAL( false, skipString( buf, &start, sizeof( buf ) ) );
+
+        /* DEL is printable as far as JSON is concerned. */
+        buf[ i + 1U ] = '\x7F';
+        start = 0;
+        TEST_ASSERT_EQUAL( true, skipString( buf, &start, sizeof( buf ) ) );
+
+        /* A two-byte UTF-8 sequence is legal unless it is cut in half. */
+        if( ( i + 2U ) < ( sizeof( buf ) - 1U ) )
+        {
+            buf[ i + 1U ] = '\xC3';
+            buf[ i + 2U ] = '\xA9';
+            start = 0;
+            TEST_ASSERT_EQUAL( true, skipString( buf, &start, sizeof( buf ) ) );
+
+            buf[ i + 2U ] = 'a';
+            start = 0;
+            TEST_ASSERT_EQUAL( false, skipString( buf, &start, sizeof( buf ) ) );
+        }
+
+        /* An unterminated string ends at the buffer limit. */
+        memset( buf, 'a', sizeof( buf ) );
+        buf[ 0 ] = '"';
+        start = 0;
+        TEST_ASSERT_EQUAL( false, skipString( buf, &start, i + 1U ) );
+    }
+}
+
 /**
  * @brief Test overflows.
  */
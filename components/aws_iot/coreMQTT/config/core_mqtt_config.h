@@ -9,13 +9,10 @@
 /* Logging configurations */
 #if CONFIG_CORE_MQTT_LOG_ERROR || CONFIG_CORE_MQTT_LOG_WARN || CONFIG_CORE_MQTT_LOG_INFO || CONFIG_CORE_MQTT_LOG_DEBUG
 
-    /* Set logging level for the coreMQTT and coreMQTT-Agent components to highest level,
-     * so any defined logging level below is printed. */
-    #ifdef LOG_LOCAL_LEVEL
-        #undef LOG_LOCAL_LEVEL
-    #endif
-    #define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
-    #include "esp_log.h"
+    /* The levels below are chosen in sdkconfig.h, so the messages are logged with
+     * APP_LOG_WRITE, which ignores APP_LOG_LEVEL. Files which include this header keep
+     * their own level. */
+    #include "app_log.h"
 
     /* Change LIBRARY_LOG_NAME to "coreMQTT" if defined somewhere else. */
     #ifdef LIBRARY_LOG_NAME
@@ -44,27 +41,27 @@
 
 /* Define logging macros based on configurations in sdkconfig.h. */
 #if CONFIG_CORE_MQTT_LOG_ERROR
-    #define LogError( message, ... ) ESP_LOGE( LIBRARY_LOG_NAME, REMOVE_PARENS( message ), ##__VA_ARGS__ )
+    #define LogError( message ) APP_LOG_WRITE( APP_LOG_ERROR, LIBRARY_LOG_NAME, REMOVE_PARENS( message ) )
 #else
-    #define LogError( message, ... )
+    #define LogError( message )
 #endif
 
 #if CONFIG_CORE_MQTT_LOG_WARN
-    #define LogWarn( message, ... ) ESP_LOGW( LIBRARY_LOG_NAME, REMOVE_PARENS( message ), ##__VA_ARGS__ )
+    #define LogWarn( message ) APP_LOG_WRITE( APP_LOG_WARN, LIBRARY_LOG_NAME, REMOVE_PARENS( message ) )
 #else
-    #define LogWarn( message, ... )
+    #define LogWarn( message )
 #endif
 
 #if CONFIG_CORE_MQTT_LOG_INFO
-    #define LogInfo( message, ... ) ESP_LOGI( LIBRARY_LOG_NAME, REMOVE_PARENS( message ), ##__VA_ARGS__ )
+    #define LogInfo( message ) APP_LOG_WRITE( APP_LOG_INFO, LIBRARY_LOG_NAME, REMOVE_PARENS( message ) )
 #else
-    #define LogInfo( message, ... )
+    #define LogInfo( message )
 #endif
 
 #if CONFIG_CORE_MQTT_LOG_DEBUG
-    #define LogDebug( message, ... ) ESP_LOGD( LIBRARY_LOG_NAME, REMOVE_PARENS( message ), ##__VA_ARGS__ )
+    #define LogDebug( message ) APP_LOG_WRITE( APP_LOG_DEBUG, LIBRARY_LOG_NAME, REMOVE_PARENS( message ) )
 #else
-    #define LogDebug( message, ... )
+    #define LogDebug( message )
 #endif
 
 /* coreMQTT configurations */
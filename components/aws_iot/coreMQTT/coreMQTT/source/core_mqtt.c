@@ -393,6 +393,38 @@ static MQTTStatus_t handleIncomingAck( MQTTContext_t * pContext,
 static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
                                             bool manageKeepAlive );
 
+/**
+ * @brief Update the state records of received PUBACKs in one pass and give
+ * the PUBACKs to the application.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] pPackets PUBACK packets, in the order they were received.
+ * @param[in] pPacketIds Packet identifiers of the PUBACKs.
+ * @param[in] packetCount Number of PUBACKs.
+ *
+ * @return Status of the first PUBACK whose state update failed;
+ * #MQTTSuccess if none failed.
+ */
+static MQTTStatus_t handlePubAckBatch( MQTTContext_t * pContext,
+                                       MQTTPacketInfo_t * pPackets,
+                                       const uint16_t * pPacketIds,
+                                       size_t packetCount );
+
+/**
+ * @brief Run one transport read and handle every complete packet that is
+ * then in the network buffer.
+ *
+ * @param[in] pContext MQTT Connection context.
+ * @param[in] manageKeepAlive Flag indicating if keep alive should be handled.
+ * @param[out] pPacketCount Incremented for each packet removed from the
+ * network buffer.
+ *
+ * @return Same as #receiveSingleIteration.
+ */
+static MQTTStatus_t receiveBatch( MQTTContext_t * pContext,
+                                  bool manageKeepAlive,
+                                  size_t * pPacketCount );
+
 /**
  * @brief Validates parameters of #MQTT_Subscribe or #MQTT_Unsubscribe.
  *
@@ -1343,13 +1375,17 @@ static MQTTStatus_t handleKeepAlive( MQTTContext_t * pContext )
     uint32_t now = 0U;
     uint32_t packetTxTimeoutMs = 0U;
     uint32_t lastPacketTxTime = 0U;
+    uint32_t keepAliveMs = 0U;
+    uint32_t txElapsed = 0U;
+    uint32_t rxElapsed = 0U;
 
     assert( pContext != NULL );
     assert( pContext->getTime != NULL );
 
     now = pContext->getTime();
 
-    packetTxTimeoutMs = 1000U * ( uint32_t ) pContext->keepAliveIntervalSec;
+    keepAliveMs = 1000U * ( uint32_t ) pContext->keepAliveIntervalSec;
+    packetTxTimeoutMs = keepAliveMs;
 
     if( PACKET_TX_TIMEOUT_MS < packetTxTimeoutMs )
     {
@@ -1366,6 +1402,24 @@ static MQTTStatus_t handleKeepAlive( MQTTContext_t * pContext )
             status = MQTTKeepAliveTimeout;
         }
     }
+    else if( pContext->pingIntervalMs != 0U )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+        lastPacketTxTime = pContext->lastPacketTxTime;
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+        txElapsed = calculateElapsedTime( now, lastPacketTxTime );
+        rxElapsed = calculateElapsedTime( now, pContext->lastPacketRxTime );
+
+        /* Traffic in either direction postpones the PINGREQ, but the server
+         * must hear from the client within the keep alive interval. */
+        if( ( ( keepAliveMs != 0U ) && ( txElapsed >= keepAliveMs ) ) ||
+            ( ( txElapsed >= pContext->pingIntervalMs ) &&
+              ( rxElapsed >= pContext->pingIntervalMs ) ) )
+        {
+            status = MQTT_Ping( pContext );
+        }
+    }
     else
     {
         MQTT_PRE_STATE_UPDATE_HOOK( pContext );
@@ -1807,6 +1861,229 @@ static MQTTStatus_t receiveSingleIteration( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
+static MQTTStatus_t handlePubAckBatch( MQTTContext_t * pContext,
+                                       MQTTPacketInfo_t * pPackets,
+                                       const uint16_t * pPacketIds,
+                                       size_t packetCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t ackStatus[ MQTT_PUBACK_BATCH_SIZE ];
+    MQTTDeserializedInfo_t deserializedInfo;
+    size_t index;
+
+    assert( pContext != NULL );
+    assert( pContext->appCallback != NULL );
+    assert( packetCount <= MQTT_PUBACK_BATCH_SIZE );
+
+    MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+    ( void ) MQTT_UpdateStatePubAcks( pContext,
+                                      pPacketIds,
+                                      ackStatus,
+                                      packetCount );
+
+    MQTT_POST_STATE_UPDATE_HOOK( pContext );
+
+    for( index = 0U; index < packetCount; index++ )
+    {
+        if( ackStatus[ index ] == MQTTSuccess )
+        {
+            /* A PUBACK completes the publish, there is no ack to send. */
+            deserializedInfo.packetIdentifier = pPacketIds[ index ];
+            deserializedInfo.deserializationResult = MQTTSuccess;
+            deserializedInfo.pPublishInfo = NULL;
+
+            pContext->appCallback( pContext, &pPackets[ index ], &deserializedInfo );
+        }
+        else
+        {
+            LogError( ( "Updating the state engine for packet id %hu"
+                        " failed with error %s.",
+                        ( unsigned short ) pPacketIds[ index ],
+                        MQTT_Status_strerror( ackStatus[ index ] ) ) );
+
+            if( status == MQTTSuccess )
+            {
+                status = ackStatus[ index ];
+            }
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+static MQTTStatus_t receiveBatch( MQTTContext_t * pContext,
+                                  bool manageKeepAlive,
+                                  size_t * pPacketCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTStatus_t batchStatus = MQTTSuccess;
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTPacketInfo_t pubAckPackets[ MQTT_PUBACK_BATCH_SIZE ];
+    uint16_t pubAckIds[ MQTT_PUBACK_BATCH_SIZE ];
+    size_t pubAckCount = 0U;
+    size_t handledCount = 0U;
+    size_t offset = 0U;
+    size_t available = 0U;
+    size_t totalMQTTPacketLength = 0U;
+    uint16_t packetIdentifier = MQTT_PACKET_ID_INVALID;
+    int32_t recvBytes;
+
+    assert( pContext != NULL );
+    assert( pContext->networkBuffer.pBuffer != NULL );
+    assert( pPacketCount != NULL );
+
+    /* Read as many bytes as possible into the network buffer. */
+    recvBytes = pContext->transportInterface.recv( pContext->transportInterface.pNetworkContext,
+                                                   &( pContext->networkBuffer.pBuffer[ pContext->index ] ),
+                                                   pContext->networkBuffer.size - pContext->index );
+
+    if( recvBytes < 0 )
+    {
+        /* The receive function has failed. Bubble up the error up to the user. */
+        status = MQTTRecvFailed;
+    }
+    else if( recvBytes == 0 )
+    {
+        if( manageKeepAlive == true )
+        {
+            status = handleKeepAlive( pContext );
+
+            if( status != MQTTSuccess )
+            {
+                LogError( ( "Handling of keep alive failed. Status=%s",
+                            MQTT_Status_strerror( status ) ) );
+            }
+        }
+    }
+    else
+    {
+        /* Update the number of bytes in the MQTT fixed buffer. */
+        pContext->index += ( size_t ) recvBytes;
+    }
+
+    /* Handle the buffered packets in place, the buffer is compacted once at
+     * the end. */
+    while( status == MQTTSuccess )
+    {
+        available = pContext->index - offset;
+        status = MQTT_ProcessIncomingPacketTypeAndLength( &( pContext->networkBuffer.pBuffer[ offset ] ),
+                                                          &available,
+                                                          &incomingPacket );
+        totalMQTTPacketLength = incomingPacket.remainingLength + incomingPacket.headerLength;
+
+        if( status != MQTTSuccess )
+        {
+            /* Either the buffer is empty, or it ends with an incomplete
+             * header, or the packet is invalid. */
+        }
+        else if( totalMQTTPacketLength > pContext->networkBuffer.size )
+        {
+            if( offset == 0U )
+            {
+                /* Discard the packet from the receive buffer and drain the
+                 * pending data from the socket buffer. */
+                status = discardStoredPacket( pContext, &incomingPacket );
+            }
+            else
+            {
+                /* Discarding needs the packet at the front of the buffer. */
+                status = MQTTNeedMoreBytes;
+            }
+        }
+        else if( totalMQTTPacketLength > available )
+        {
+            status = MQTTNeedMoreBytes;
+        }
+        else if( ( incomingPacket.type != MQTT_PACKET_TYPE_PUBACK ) && ( pubAckCount > 0U ) )
+        {
+            /* The callbacks of the PUBACKs before this packet come first. This
+             * packet is parsed again on the next iteration. */
+            status = handlePubAckBatch( pContext, pubAckPackets, pubAckIds, pubAckCount );
+            pubAckCount = 0U;
+        }
+        else
+        {
+            incomingPacket.pRemainingData = &( pContext->networkBuffer.pBuffer[ offset + incomingPacket.headerLength ] );
+
+            if( incomingPacket.type == MQTT_PACKET_TYPE_PUBACK )
+            {
+                status = MQTT_DeserializeAck( &incomingPacket, &packetIdentifier, NULL );
+
+                if( status == MQTTSuccess )
+                {
+                    pubAckPackets[ pubAckCount ] = incomingPacket;
+                    pubAckIds[ pubAckCount ] = packetIdentifier;
+                    pubAckCount++;
+                }
+            }
+            /* PUBLISH packets allow flags in the lower four bits. For other
+             * packet types, they are reserved. */
+            else if( ( incomingPacket.type & 0xF0U ) == MQTT_PACKET_TYPE_PUBLISH )
+            {
+                status = handleIncomingPublish( pContext, &incomingPacket );
+            }
+            else
+            {
+                status = handleIncomingAck( pContext, &incomingPacket, manageKeepAlive );
+            }
+
+            offset += totalMQTTPacketLength;
+            handledCount++;
+
+            if( status == MQTTSuccess )
+            {
+                pContext->lastPacketRxTime = pContext->getTime();
+            }
+
+            if( ( status == MQTTSuccess ) && ( pubAckCount == MQTT_PUBACK_BATCH_SIZE ) )
+            {
+                status = handlePubAckBatch( pContext, pubAckPackets, pubAckIds, pubAckCount );
+                pubAckCount = 0U;
+            }
+        }
+    }
+
+    /* The packets before an error are given to the application as usual. */
+    if( pubAckCount > 0U )
+    {
+        batchStatus = handlePubAckBatch( pContext, pubAckPackets, pubAckIds, pubAckCount );
+    }
+
+    if( offset > 0U )
+    {
+        /* Move the remaining bytes to the front of the buffer. */
+        pContext->index -= offset;
+        ( void ) memmove( pContext->networkBuffer.pBuffer,
+                          &( pContext->networkBuffer.pBuffer[ offset ] ),
+                          pContext->index );
+    }
+
+    if( ( status == MQTTNoDataAvailable ) ||
+        ( ( status == MQTTNeedMoreBytes ) && ( handledCount > 0U ) ) )
+    {
+        /* Running out of buffered packets is not an error. */
+        status = batchStatus;
+    }
+    else if( status == MQTTNeedMoreBytes )
+    {
+        /* Do nothing as there is nothing to be processed right now. */
+    }
+    else
+    {
+        LogError( ( "Call to receiveBatch failed. Status=%s",
+                    MQTT_Status_strerror( status ) ) );
+    }
+
+    *pPacketCount += handledCount;
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 static MQTTStatus_t validateSubscribeUnsubscribeParams( const MQTTContext_t * pContext,
                                                         const MQTTSubscribeInfo_t * pSubscriptionList,
                                                         size_t subscriptionCount,
@@ -2919,6 +3196,132 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_PublishPrepared( MQTTContext_t * pContext,
+                                   const MQTTPreparedPublish_t * pPrepared,
+                                   const void * pPayload,
+                                   size_t payloadLength,
+                                   uint16_t packetId )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    const uint8_t * pHeader = NULL;
+    size_t headerSize = 0UL;
+    size_t ioVectorLength = 1U;
+    MQTTPublishState_t publishStatus = MQTTStateNull;
+    bool stateUpdateHookExecuted = false;
+
+    /* The prepared header holds everything up to the payload. */
+    TransportOutVector_t pIoVector[ 2U ];
+
+    if( ( pContext == NULL ) || ( pPrepared == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, "
+                    "pPrepared=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pPrepared ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPayload == NULL ) && ( payloadLength != 0U ) )
+    {
+        LogError( ( "A nonzero payload length requires a non-NULL payload: "
+                    "payloadLength=%lu, pPayload=%p.",
+                    ( unsigned long ) payloadLength,
+                    pPayload ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pContext->outgoingPublishRecords == NULL ) && ( pPrepared->qos > MQTTQoS0 ) )
+    {
+        LogError( ( "Trying to publish a QoS > MQTTQoS0 packet when outgoing publishes "
+                    "for QoS1/QoS2 have not been enabled. Please, call MQTT_InitStatefulQoS "
+                    "to initialize and enable the use of QoS1/QoS2 publishes." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        status = MQTT_SerializePreparedPublishHeader( pPrepared,
+                                                      payloadLength,
+                                                      packetId,
+                                                      &pHeader,
+                                                      &headerSize );
+    }
+
+    if( ( status == MQTTSuccess ) && ( pPrepared->qos > MQTTQoS0 ) )
+    {
+        MQTT_PRE_STATE_UPDATE_HOOK( pContext );
+
+        /* Set the flag so that the corresponding hook can be called later. */
+        stateUpdateHookExecuted = true;
+
+        status = MQTT_ReserveState( pContext,
+                                    packetId,
+                                    pPrepared->qos );
+
+        /* State already exists for a duplicate packet. */
+        if( ( status == MQTTStateCollision ) && ( pPrepared->dup == true ) )
+        {
+            status = MQTTSuccess;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        pIoVector[ 0U ].iov_base = pHeader;
+        pIoVector[ 0U ].iov_len = headerSize;
+
+        /* Publish packets are allowed to contain no payload. */
+        if( payloadLength > 0U )
+        {
+            pIoVector[ 1U ].iov_base = pPayload;
+            pIoVector[ 1U ].iov_len = payloadLength;
+            ioVectorLength++;
+        }
+
+        MQTT_PRE_SEND_HOOK( pContext );
+
+        if( sendMessageVector( pContext, pIoVector, ioVectorLength ) !=
+            ( int32_t ) ( headerSize + payloadLength ) )
+        {
+            status = MQTTSendFailed;
+        }
+
+        MQTT_POST_SEND_HOOK( pContext );
+    }
+
+    if( ( status == MQTTSuccess ) && ( pPrepared->qos > MQTTQoS0 ) )
+    {
+        /* Update state machine after PUBLISH is sent.
+         * Only to be done for QoS1 or QoS2. */
+        status = MQTT_UpdateStatePublish( pContext,
+                                          packetId,
+                                          MQTT_SEND,
+                                          pPrepared->qos,
+                                          &publishStatus );
+
+        if( status != MQTTSuccess )
+        {
+            LogError( ( "Update state for publish failed with status %s."
+                        " However PUBLISH packet was sent to the broker."
+                        " Any further handling of ACKs for the packet Id"
+                        " will fail.",
+                        MQTT_Status_strerror( status ) ) );
+        }
+    }
+
+    if( stateUpdateHookExecuted == true )
+    {
+        MQTT_POST_STATE_UPDATE_HOOK( pContext );
+    }
+
+    if( status != MQTTSuccess )
+    {
+        LogError( ( "MQTT PUBLISH failed with status %s.",
+                    MQTT_Status_strerror( status ) ) );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_Ping( MQTTContext_t * pContext )
 {
     int32_t sendResult = 0;
@@ -3143,6 +3546,65 @@ MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext )
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_ProcessLoopBatch( MQTTContext_t * pContext,
+                                    size_t * pPacketCount )
+{
+    MQTTStatus_t status = MQTTBadParameter;
+
+    if( ( pContext == NULL ) || ( pPacketCount == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pContext=%p, pPacketCount=%p.",
+                    ( void * ) pContext,
+                    ( void * ) pPacketCount ) );
+    }
+    else if( pContext->getTime == NULL )
+    {
+        LogError( ( "Invalid input parameter: MQTT Context must have valid getTime." ) );
+    }
+    else if( pContext->networkBuffer.pBuffer == NULL )
+    {
+        LogError( ( "Invalid input parameter: The MQTT context's networkBuffer must not be NULL." ) );
+    }
+    else
+    {
+        *pPacketCount = 0U;
+        pContext->controlPacketSent = false;
+        status = receiveBatch( pContext, true, pPacketCount );
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SetPingInterval( MQTTContext_t * pContext,
+                                   uint32_t pingIntervalMs )
+{
+    MQTTStatus_t status = MQTTSuccess;
+
+    if( pContext == NULL )
+    {
+        LogError( ( "Invalid input parameter: MQTT Context cannot be NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pContext->keepAliveIntervalSec != 0U ) &&
+             ( pingIntervalMs > ( 1000U * ( uint32_t ) pContext->keepAliveIntervalSec ) ) )
+    {
+        LogError( ( "Ping interval of %lu ms exceeds the keep alive interval of %hu s.",
+                    ( unsigned long ) pingIntervalMs,
+                    ( unsigned short ) pContext->keepAliveIntervalSec ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        pContext->pingIntervalMs = pingIntervalMs;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_ReceiveLoop( MQTTContext_t * pContext )
 {
     MQTTStatus_t status = MQTTBadParameter;
@@ -2263,6 +2263,179 @@ MQTTStatus_t MQTT_SerializePublishHeader( const MQTTPublishInfo_t * pPublishInfo
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_PreparePublish( const MQTTPublishInfo_t * pPublishInfo,
+                                  const MQTTFixedBuffer_t * pFixedBuffer,
+                                  MQTTPreparedPublish_t * pPrepared )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t variableHeaderLength = 0U;
+    uint8_t publishFlags = MQTT_PACKET_TYPE_PUBLISH;
+
+    if( ( pPublishInfo == NULL ) || ( pFixedBuffer == NULL ) ||
+        ( pPrepared == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pPublishInfo=%p, "
+                    "pFixedBuffer=%p, pPrepared=%p.",
+                    ( void * ) pPublishInfo,
+                    ( void * ) pFixedBuffer,
+                    ( void * ) pPrepared ) );
+        status = MQTTBadParameter;
+    }
+    else if( pFixedBuffer->pBuffer == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pFixedBuffer->pBuffer is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->pTopicName == NULL ) || ( pPublishInfo->topicNameLength == 0U ) )
+    {
+        LogError( ( "Invalid topic name for publish: pTopicName=%p, "
+                    "topicNameLength=%hu.",
+                    ( void * ) pPublishInfo->pTopicName,
+                    ( unsigned short ) pPublishInfo->topicNameLength ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPublishInfo->dup == true ) && ( pPublishInfo->qos == MQTTQoS0 ) )
+    {
+        LogError( ( "Duplicate flag is set for PUBLISH with Qos 0." ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        /* The variable header holds the encoded topic name, followed by the
+         * packet identifier for QoS 1 and 2. */
+        variableHeaderLength = sizeof( uint16_t ) + pPublishInfo->topicNameLength;
+
+        if( pPublishInfo->qos > MQTTQoS0 )
+        {
+            variableHeaderLength += sizeof( uint16_t );
+        }
+
+        if( ( MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE + variableHeaderLength ) > pFixedBuffer->size )
+        {
+            LogError( ( "Buffer size of %lu is not sufficient to hold "
+                        "prepared PUBLISH header of size of %lu.",
+                        ( unsigned long ) pFixedBuffer->size,
+                        ( unsigned long ) ( MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE + variableHeaderLength ) ) );
+            status = MQTTNoMemory;
+        }
+    }
+
+    if( status == MQTTSuccess )
+    {
+        if( pPublishInfo->qos == MQTTQoS1 )
+        {
+            UINT8_SET_BIT( publishFlags, MQTT_PUBLISH_FLAG_QOS1 );
+        }
+        else if( pPublishInfo->qos == MQTTQoS2 )
+        {
+            UINT8_SET_BIT( publishFlags, MQTT_PUBLISH_FLAG_QOS2 );
+        }
+        else
+        {
+            /* Empty else MISRA 15.7 */
+        }
+
+        if( pPublishInfo->retain == true )
+        {
+            UINT8_SET_BIT( publishFlags, MQTT_PUBLISH_FLAG_RETAIN );
+        }
+
+        if( pPublishInfo->dup == true )
+        {
+            UINT8_SET_BIT( publishFlags, MQTT_PUBLISH_FLAG_DUP );
+        }
+
+        /* The topic name goes right after the space kept for the largest
+         * fixed header, each message writes its fixed header in front of it. */
+        ( void ) encodeString( &pFixedBuffer->pBuffer[ MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE ],
+                               pPublishInfo->pTopicName,
+                               pPublishInfo->topicNameLength );
+
+        pPrepared->pBuffer = pFixedBuffer->pBuffer;
+        pPrepared->variableHeaderLength = variableHeaderLength;
+        pPrepared->payloadLimit = MQTT_MAX_REMAINING_LENGTH - variableHeaderLength;
+        pPrepared->qos = pPublishInfo->qos;
+        pPrepared->dup = pPublishInfo->dup;
+        pPrepared->publishFlags = publishFlags;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
+MQTTStatus_t MQTT_SerializePreparedPublishHeader( const MQTTPreparedPublish_t * pPrepared,
+                                                  size_t payloadLength,
+                                                  uint16_t packetId,
+                                                  const uint8_t ** ppHeader,
+                                                  size_t * pHeaderSize )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    size_t remainingLength;
+    size_t headerStart;
+    uint8_t * pIndex;
+
+    if( ( pPrepared == NULL ) || ( ppHeader == NULL ) || ( pHeaderSize == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pPrepared=%p, "
+                    "ppHeader=%p, pHeaderSize=%p.",
+                    ( void * ) pPrepared,
+                    ( void * ) ppHeader,
+                    ( void * ) pHeaderSize ) );
+        status = MQTTBadParameter;
+    }
+    else if( pPrepared->pBuffer == NULL )
+    {
+        LogError( ( "Argument cannot be NULL: pPrepared->pBuffer is NULL." ) );
+        status = MQTTBadParameter;
+    }
+    else if( ( pPrepared->qos != MQTTQoS0 ) && ( packetId == 0U ) )
+    {
+        LogError( ( "Packet Id is 0 for publish with QoS=%hu.",
+                    ( unsigned short ) pPrepared->qos ) );
+        status = MQTTBadParameter;
+    }
+    else if( payloadLength > pPrepared->payloadLimit )
+    {
+        LogError( ( "PUBLISH payload length of %lu cannot exceed "
+                    "%lu so as not to exceed the maximum "
+                    "remaining length of MQTT 3.1.1 packet( %lu ).",
+                    ( unsigned long ) payloadLength,
+                    ( unsigned long ) pPrepared->payloadLimit,
+                    MQTT_MAX_REMAINING_LENGTH ) );
+        status = MQTTBadParameter;
+    }
+    else
+    {
+        remainingLength = pPrepared->variableHeaderLength + payloadLength;
+
+        /* The fixed header ends where the topic name begins. */
+        headerStart = MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE - 1U -
+                      remainingLengthEncodedSize( remainingLength );
+
+        pIndex = &pPrepared->pBuffer[ headerStart ];
+        *pIndex = pPrepared->publishFlags;
+        pIndex++;
+        ( void ) encodeRemainingLength( pIndex, remainingLength );
+
+        if( pPrepared->qos > MQTTQoS0 )
+        {
+            pIndex = &pPrepared->pBuffer[ MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE +
+                                          pPrepared->variableHeaderLength - sizeof( uint16_t ) ];
+            pIndex[ 0 ] = UINT16_HIGH_BYTE( packetId );
+            pIndex[ 1 ] = UINT16_LOW_BYTE( packetId );
+        }
+
+        *ppHeader = &pPrepared->pBuffer[ headerStart ];
+        *pHeaderSize = MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE - headerStart +
+                       pPrepared->variableHeaderLength;
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 MQTTStatus_t MQTT_SerializeAck( const MQTTFixedBuffer_t * pFixedBuffer,
                                 uint8_t packetType,
                                 uint16_t packetId )
@@ -1084,6 +1084,90 @@ MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
 
 /*-----------------------------------------------------------*/
 
+MQTTStatus_t MQTT_UpdateStatePubAcks( const MQTTContext_t * pMqttContext,
+                                      const uint16_t * pPacketIds,
+                                      MQTTStatus_t * pStatuses,
+                                      size_t packetIdCount )
+{
+    MQTTStatus_t status = MQTTSuccess;
+    MQTTPubAckInfo_t * records = NULL;
+    MQTTPublishState_t newState = MQTTStateNull;
+    size_t recordIndex = 0U;
+    size_t idIndex = 0U;
+    size_t pendingCount = packetIdCount;
+
+    if( ( pMqttContext == NULL ) || ( pPacketIds == NULL ) || ( pStatuses == NULL ) )
+    {
+        LogError( ( "Argument cannot be NULL: pMqttContext=%p, pPacketIds=%p, "
+                    "pStatuses=%p.",
+                    ( void * ) pMqttContext,
+                    ( void * ) pPacketIds,
+                    ( void * ) pStatuses ) );
+        status = MQTTBadParameter;
+        pendingCount = 0U;
+    }
+    else
+    {
+        records = pMqttContext->outgoingPublishRecords;
+
+        for( idIndex = 0U; idIndex < packetIdCount; idIndex++ )
+        {
+            pStatuses[ idIndex ] = MQTTBadResponse;
+        }
+
+        if( records == NULL )
+        {
+            pendingCount = 0U;
+        }
+    }
+
+    /* Records are visited once; each one settles the first PUBACK still
+     * pending for its packet ID. A second PUBACK for the same ID finds no
+     * record, as it would if the PUBACKs were handled one at a time. */
+    for( recordIndex = 0U;
+         ( pendingCount > 0U ) && ( recordIndex < pMqttContext->outgoingPublishRecordMaxCount );
+         recordIndex++ )
+    {
+        if( records[ recordIndex ].packetId != MQTT_PACKET_ID_INVALID )
+        {
+            for( idIndex = 0U; idIndex < packetIdCount; idIndex++ )
+            {
+                if( ( pPacketIds[ idIndex ] == records[ recordIndex ].packetId ) &&
+                    ( pStatuses[ idIndex ] == MQTTBadResponse ) )
+                {
+                    newState = MQTT_CalculateStateAck( MQTTPuback,
+                                                       MQTT_RECEIVE,
+                                                       records[ recordIndex ].qos );
+
+                    /* A PUBACK completes the publish, so the record is
+                     * removed and never moved. */
+                    pStatuses[ idIndex ] = updateStateAck( records,
+                                                           pMqttContext->outgoingPublishRecordMaxCount,
+                                                           recordIndex,
+                                                           pPacketIds[ idIndex ],
+                                                           records[ recordIndex ].publishState,
+                                                           newState );
+                    pendingCount--;
+                    break;
+                }
+            }
+        }
+    }
+
+    for( idIndex = 0U; ( status == MQTTSuccess ) && ( idIndex < packetIdCount ); idIndex++ )
+    {
+        if( pStatuses[ idIndex ] == MQTTBadResponse )
+        {
+            LogError( ( "No matching record found for publish: PacketId=%u.",
+                        ( unsigned int ) pPacketIds[ idIndex ] ) );
+        }
+    }
+
+    return status;
+}
+
+/*-----------------------------------------------------------*/
+
 uint16_t MQTT_PubrelToResend( const MQTTContext_t * pMqttContext,
                               MQTTStateCursor_t * pCursor,
                               MQTTPublishState_t * pState )
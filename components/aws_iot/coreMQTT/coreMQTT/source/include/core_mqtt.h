@@ -246,6 +246,7 @@ typedef struct MQTTContext
     uint16_t keepAliveIntervalSec; /**< @brief Keep Alive interval. */
     uint32_t pingReqSendTimeMs;    /**< @brief Timestamp of the last sent PINGREQ. */
     bool waitingForPingResp;       /**< @brief If the library is currently awaiting a PINGRESP. */
+    uint32_t pingIntervalMs;       /**< @brief Idle time before a PINGREQ, see #MQTT_SetPingInterval. */
 } MQTTContext_t;
 
 /**
@@ -629,6 +630,48 @@ MQTTStatus_t MQTT_Publish( MQTTContext_t * pContext,
                            uint16_t packetId );
 /* @[declare_mqtt_publish] */
 
+/**
+ * @brief Publishes a message using a header prepared by #MQTT_PreparePublish.
+ *
+ * The topic name is not encoded again, and the header goes out as one piece
+ * followed by the payload, so a message costs two transport writes when the
+ * transport has no writev.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pPrepared Header prepared by #MQTT_PreparePublish. Its buffer is
+ * written, so it must not be shared by concurrent publishes.
+ * @param[in] pPayload Payload of the message, may be NULL when
+ * @p payloadLength is 0.
+ * @param[in] payloadLength Length of the payload.
+ * @param[in] packetId packet ID generated by #MQTT_GetPacketId.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSendFailed if transport write failed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * // Prepared once for the topic, see MQTT_PreparePublish().
+ * MQTTPreparedPublish_t prepared;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * status = MQTT_PublishPrepared( pContext, &prepared, "Hello World!",
+ *                                strlen( "Hello World!" ),
+ *                                MQTT_GetPacketId( pContext ) );
+ * @endcode
+ */
+/* @[declare_mqtt_publishprepared] */
+MQTTStatus_t MQTT_PublishPrepared( MQTTContext_t * pContext,
+                                   const MQTTPreparedPublish_t * pPrepared,
+                                   const void * pPayload,
+                                   size_t payloadLength,
+                                   uint16_t packetId );
+/* @[declare_mqtt_publishprepared] */
+
 /**
  * @brief Cancels an outgoing publish callback (only for QoS > QoS0) by
  * removing it from the pending ACK list.
@@ -793,6 +836,82 @@ MQTTStatus_t MQTT_Disconnect( MQTTContext_t * pContext );
 MQTTStatus_t MQTT_ProcessLoop( MQTTContext_t * pContext );
 /* @[declare_mqtt_processloop] */
 
+/**
+ * @brief Loop to receive packets from the transport interface, handling every
+ * complete packet buffered by one read. Handles keep alive.
+ *
+ * #MQTT_ProcessLoop handles at most one packet per call, and so one transport
+ * read per packet. This function reads once and then handles all the complete
+ * packets in the network buffer. The state records of consecutive PUBACKs are
+ * updated together, up to #MQTT_PUBACK_BATCH_SIZE at a time, with one pass
+ * over the outgoing publish records. The callback still sees every packet,
+ * in the order received.
+ *
+ * @param[in] pContext Initialized and connected MQTT context.
+ * @param[out] pPacketCount Receives the number of packets handled.
+ *
+ * @return Same as #MQTT_ProcessLoop, except that #MQTTNeedMoreBytes is only
+ * returned when no packet was handled. When a PUBACK fails to update the
+ * state, the other PUBACKs of its batch are still given to the callback.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * size_t packetCount;
+ * // This context is assumed to be initialized and connected.
+ * MQTTContext_t * pContext;
+ *
+ * do
+ * {
+ *      status = MQTT_ProcessLoopBatch( pContext, &packetCount );
+ * } while( ( status == MQTTSuccess ) || ( status == MQTTNeedMoreBytes ) );
+ * @endcode
+ */
+/* @[declare_mqtt_processloopbatch] */
+MQTTStatus_t MQTT_ProcessLoopBatch( MQTTContext_t * pContext,
+                                    size_t * pPacketCount );
+/* @[declare_mqtt_processloopbatch] */
+
+/**
+ * @brief Send PINGREQs only after the connection has been idle for the given
+ * time, instead of on the fixed schedule of #PACKET_TX_TIMEOUT_MS and
+ * #PACKET_RX_TIMEOUT_MS.
+ *
+ * #MQTT_ProcessLoop then sends a PINGREQ when nothing was sent and nothing
+ * was received for @p pingIntervalMs milliseconds, so packets flowing in
+ * either direction postpone it. A PINGREQ is still sent when nothing was sent
+ * for the whole keep alive interval, which the server requires. Choosing an
+ * interval shorter than the idle timeout of the NATs on the path keeps the
+ * connection open with the fewest PINGREQs.
+ *
+ * The setting is cleared by #MQTT_Init, so call it after #MQTT_Connect.
+ *
+ * @param[in] pContext Initialized MQTT context.
+ * @param[in] pingIntervalMs Idle time before a PINGREQ, at most the keep
+ * alive interval; 0 restores the fixed schedule.
+ *
+ * @return #MQTTBadParameter if the context is NULL or the interval exceeds
+ * the keep alive interval; #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * // This context is assumed to be connected with a keep alive of 300 seconds.
+ * MQTTContext_t * pContext;
+ *
+ * // Idle connections are dropped after 2 minutes on this network.
+ * status = MQTT_SetPingInterval( pContext, 100000U );
+ * @endcode
+ */
+/* @[declare_mqtt_setpinginterval] */
+MQTTStatus_t MQTT_SetPingInterval( MQTTContext_t * pContext,
+                                   uint32_t pingIntervalMs );
+/* @[declare_mqtt_setpinginterval] */
+
 /**
  * @brief Loop to receive packets from the transport interface. Does not handle
  * keep alive.
@@ -76,6 +76,21 @@
     #define MQTT_SUB_UNSUB_MAX_VECTORS    ( 4U )
 #endif
 
+/**
+ * @brief Maximum number of PUBACK packets #MQTT_ProcessLoopBatch settles
+ * with a single pass over the outgoing publish records.
+ *
+ * Each queued PUBACK takes a few bytes of stack in #MQTT_ProcessLoopBatch.
+ * When more PUBACKs than this are buffered, they are settled in several
+ * passes.
+ *
+ * <b>Possible values:</b> Any positive integer. <br>
+ * <b>Default value:</b> `8`
+ */
+#ifndef MQTT_PUBACK_BATCH_SIZE
+    #define MQTT_PUBACK_BATCH_SIZE    ( 8U )
+#endif
+
 /**
  * @brief The number of retries for receiving CONNACK.
  *
@@ -263,6 +263,64 @@ typedef struct MQTTPacketInfo
     size_t headerLength;
 } MQTTPacketInfo_t;
 
+/**
+ * @ingroup mqtt_constants
+ * @brief Bytes a prepared PUBLISH header keeps in front of the topic for the
+ * fixed header: the packet type and flags, and up to 4 bytes of Remaining
+ * Length.
+ */
+#define MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE    ( 5U )
+
+/**
+ * @ingroup mqtt_constants
+ * @brief Size of the buffer #MQTT_PreparePublish needs for a topic name of
+ * the given length: the fixed header, the encoded topic name and a packet
+ * identifier.
+ */
+#define MQTT_PREPARED_PUBLISH_BUFFER_SIZE( topicNameLength ) \
+    ( MQTT_PREPARED_PUBLISH_FIXED_HEADER_SIZE + 2U + ( size_t ) ( topicNameLength ) + 2U )
+
+/**
+ * @ingroup mqtt_struct_types
+ * @brief PUBLISH packet header serialized once for a topic name, QoS and
+ * flags by #MQTT_PreparePublish.
+ *
+ * #MQTT_SerializePreparedPublishHeader completes it for each message by
+ * writing only the Remaining Length and the packet identifier.
+ */
+typedef struct MQTTPreparedPublish
+{
+    /**
+     * @brief Buffer holding the header, see #MQTT_PREPARED_PUBLISH_BUFFER_SIZE.
+     */
+    uint8_t * pBuffer;
+
+    /**
+     * @brief Length of the encoded topic name and packet identifier.
+     */
+    size_t variableHeaderLength;
+
+    /**
+     * @brief Largest payload the packet can carry.
+     */
+    size_t payloadLimit;
+
+    /**
+     * @brief Quality of Service of the packets.
+     */
+    MQTTQoS_t qos;
+
+    /**
+     * @brief Whether the packets are retransmissions.
+     */
+    bool dup;
+
+    /**
+     * @brief First byte of the packets: the packet type and flags.
+     */
+    uint8_t publishFlags;
+} MQTTPreparedPublish_t;
+
 /**
  * @brief Get the size and Remaining Length of an MQTT CONNECT packet.
  *
@@ -835,6 +893,88 @@ MQTTStatus_t MQTT_SerializePublishHeader( const MQTTPublishInfo_t * pPublishInfo
                                           size_t * pHeaderSize );
 /* @[declare_mqtt_serializepublishheader] */
 
+/**
+ * @brief Serialize the parts of a PUBLISH packet header that stay the same
+ * for every message sent to a topic.
+ *
+ * The topic name is encoded once, so a device which publishes to the same
+ * topic repeatedly does not size and encode it for each message. Complete the
+ * header of each message with #MQTT_SerializePreparedPublishHeader or send it
+ * with #MQTT_PublishPrepared. The payload of @p pPublishInfo is ignored.
+ *
+ * @param[in] pPublishInfo MQTT PUBLISH packet parameters: topic name, QoS,
+ * retain and dup flags.
+ * @param[in] pFixedBuffer Buffer for the header, of at least
+ * #MQTT_PREPARED_PUBLISH_BUFFER_SIZE( topicNameLength ) bytes; it must stay
+ * valid and unchanged while @p pPrepared is used.
+ * @param[out] pPrepared Receives the prepared header.
+ *
+ * @return #MQTTNoMemory if the buffer is too small;
+ * #MQTTBadParameter if invalid parameters are passed;
+ * #MQTTSuccess otherwise.
+ *
+ * <b>Example</b>
+ * @code{c}
+ *
+ * // Variables used in this example.
+ * MQTTStatus_t status;
+ * MQTTPublishInfo_t publishInfo = { 0 };
+ * MQTTPreparedPublish_t prepared;
+ * static uint8_t header[ MQTT_PREPARED_PUBLISH_BUFFER_SIZE( sizeof( "sensors/1" ) - 1U ) ];
+ * MQTTFixedBuffer_t fixedBuffer = { .pBuffer = header, .size = sizeof( header ) };
+ * const uint8_t * pHeader;
+ * size_t headerSize;
+ *
+ * publishInfo.qos = MQTTQoS1;
+ * publishInfo.pTopicName = "sensors/1";
+ * publishInfo.topicNameLength = ( uint16_t ) strlen( publishInfo.pTopicName );
+ *
+ * status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+ *
+ * while( status == MQTTSuccess )
+ * {
+ *      // Each message only costs the Remaining Length and the packet identifier.
+ *      status = MQTT_SerializePreparedPublishHeader( &prepared, payloadLength,
+ *                                                    getNextPacketId(),
+ *                                                    &pHeader, &headerSize );
+ *
+ *      if( status == MQTTSuccess )
+ *      {
+ *          // Send headerSize bytes of pHeader followed by the payload.
+ *      }
+ * }
+ * @endcode
+ */
+/* @[declare_mqtt_preparepublish] */
+MQTTStatus_t MQTT_PreparePublish( const MQTTPublishInfo_t * pPublishInfo,
+                                  const MQTTFixedBuffer_t * pFixedBuffer,
+                                  MQTTPreparedPublish_t * pPrepared );
+/* @[declare_mqtt_preparepublish] */
+
+/**
+ * @brief Complete a header prepared by #MQTT_PreparePublish for one message.
+ *
+ * Writes the Remaining Length for @p payloadLength and the packet identifier
+ * into the prepared buffer. The header returned is contiguous and holds
+ * everything up to the payload.
+ *
+ * @param[in] pPrepared Header prepared by #MQTT_PreparePublish.
+ * @param[in] payloadLength Length of the payload of the message.
+ * @param[in] packetId Packet identifier of the message, ignored for QoS 0.
+ * @param[out] ppHeader Receives the start of the header in the prepared buffer.
+ * @param[out] pHeaderSize Receives the size of the header.
+ *
+ * @return #MQTTBadParameter if invalid parameters are passed or the payload
+ * is too long for an MQTT packet; #MQTTSuccess otherwise.
+ */
+/* @[declare_mqtt_serializepreparedpublishheader] */
+MQTTStatus_t MQTT_SerializePreparedPublishHeader( const MQTTPreparedPublish_t * pPrepared,
+                                                  size_t payloadLength,
+                                                  uint16_t packetId,
+                                                  const uint8_t ** ppHeader,
+                                                  size_t * pHeaderSize );
+/* @[declare_mqtt_serializepreparedpublishheader] */
+
 /**
  * @brief Serialize an MQTT PUBACK, PUBREC, PUBREL, or PUBCOMP into the given
  * buffer.
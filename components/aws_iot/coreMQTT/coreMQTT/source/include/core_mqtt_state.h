@@ -191,6 +191,36 @@ MQTTStatus_t MQTT_UpdateStateAck( const MQTTContext_t * pMqttContext,
                                   MQTTPublishState_t * pNewState );
 /** @endcond */
 
+/**
+ * @fn MQTTStatus_t MQTT_UpdateStatePubAcks( const MQTTContext_t * pMqttContext, const uint16_t * pPacketIds, MQTTStatus_t * pStatuses, size_t packetIdCount );
+ * @brief Update the state records for several received PUBACKs at once.
+ *
+ * The outgoing publish records are scanned once for all the packet IDs,
+ * instead of once per PUBACK. Each packet ID gets the status that
+ * #MQTT_UpdateStateAck would return for it, were the PUBACKs handled one by
+ * one in order.
+ *
+ * @param[in] pMqttContext Initialized MQTT context.
+ * @param[in] pPacketIds IDs of the PUBACK packets.
+ * @param[out] pStatuses Receives the status of each PUBACK: #MQTTBadResponse
+ * if the packet is not found in the records; #MQTTIllegalState if it is not
+ * waiting for a PUBACK; #MQTTSuccess if its record was removed.
+ * @param[in] packetIdCount Number of packet IDs.
+ *
+ * @return #MQTTBadParameter if an invalid parameter is passed;
+ * #MQTTSuccess otherwise.
+ */
+
+/**
+ * @cond DOXYGEN_IGNORE
+ * Doxygen should ignore this definition, this function is private.
+ */
+MQTTStatus_t MQTT_UpdateStatePubAcks( const MQTTContext_t * pMqttContext,
+                                      const uint16_t * pPacketIds,
+                                      MQTTStatus_t * pStatuses,
+                                      size_t packetIdCount );
+/** @endcond */
+
 /**
  * @fn uint16_t MQTT_PubrelToResend( const MQTTContext_t * pMqttContext, MQTTStateCursor_t * pCursor, MQTTPublishState_t * pState );
  * @brief Get the packet ID of next pending PUBREL ack to be resent.
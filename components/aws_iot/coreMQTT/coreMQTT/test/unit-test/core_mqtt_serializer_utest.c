@@ -2480,6 +2480,224 @@ void test_MQTT_ProcessIncomingPacketTypeAndLength_NonConformingLength( void )
 
 /* ========================================================================== */
 
+/**
+ * @brief Tests that MQTT_PreparePublish rejects invalid parameters.
+ */
+void test_MQTT_PreparePublish_Invalid( void )
+{
+    MQTTPublishInfo_t publishInfo;
+    MQTTFixedBuffer_t fixedBuffer;
+    MQTTPreparedPublish_t prepared;
+    MQTTStatus_t status;
+
+    memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    fixedBuffer.pBuffer = mqttBuffer;
+    fixedBuffer.size = MQTT_PREPARED_PUBLISH_BUFFER_SIZE( TEST_TOPIC_NAME_LENGTH );
+
+    status = MQTT_PreparePublish( NULL, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PreparePublish( &publishInfo, NULL, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    fixedBuffer.pBuffer = NULL;
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    fixedBuffer.pBuffer = mqttBuffer;
+
+    /* A topic name is required. */
+    publishInfo.topicNameLength = 0;
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+
+    /* Duplicate flag cannot be set for QoS 0. */
+    publishInfo.dup = true;
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+    publishInfo.dup = false;
+
+    /* QoS 0 does not need room for a packet identifier, QoS 1 does. */
+    fixedBuffer.size = MQTT_PREPARED_PUBLISH_BUFFER_SIZE( TEST_TOPIC_NAME_LENGTH ) - 2U;
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    publishInfo.qos = MQTTQoS1;
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTNoMemory, status );
+}
+
+/**
+ * @brief Serialize a prepared PUBLISH header and check that it matches the
+ * start of the packet MQTT_SerializePublish serializes for the same message.
+ */
+static void verifyPreparedPublish( MQTTPublishInfo_t * pPublishInfo,
+                                   uint16_t packetId )
+{
+    uint8_t header[ MQTT_PREPARED_PUBLISH_BUFFER_SIZE( TEST_TOPIC_NAME_LENGTH ) ];
+    MQTTFixedBuffer_t fixedBuffer;
+    MQTTPreparedPublish_t prepared;
+    const uint8_t * pHeader = NULL;
+    size_t headerSize = 0;
+    size_t remainingLength = 0;
+    size_t packetSize = 0;
+    MQTTStatus_t status;
+
+    fixedBuffer.pBuffer = header;
+    fixedBuffer.size = sizeof( header );
+    status = MQTT_PreparePublish( pPublishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    status = MQTT_SerializePreparedPublishHeader( &prepared,
+                                                  pPublishInfo->payloadLength,
+                                                  packetId,
+                                                  &pHeader,
+                                                  &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    status = MQTT_GetPublishPacketSize( pPublishInfo, &remainingLength, &packetSize );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( packetSize - pPublishInfo->payloadLength, headerSize );
+
+    fixedBuffer.pBuffer = mqttBuffer;
+    fixedBuffer.size = MQTT_TEST_BUFFER_LENGTH;
+    status = MQTT_SerializePublish( pPublishInfo, packetId, remainingLength, &fixedBuffer );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_MEMORY( mqttBuffer, pHeader, headerSize );
+}
+
+/**
+ * @brief Tests that MQTT_SerializePreparedPublishHeader serializes the same
+ * header as MQTT_SerializePublish.
+ */
+void test_MQTT_SerializePreparedPublishHeader( void )
+{
+    MQTTPublishInfo_t publishInfo;
+
+    memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    publishInfo.pPayload = MQTT_SAMPLE_PAYLOAD;
+    publishInfo.payloadLength = MQTT_SAMPLE_PAYLOAD_LEN;
+
+    verifyPreparedPublish( &publishInfo, 0 );
+
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.retain = true;
+    verifyPreparedPublish( &publishInfo, 1 );
+
+    publishInfo.qos = MQTTQoS2;
+    publishInfo.dup = true;
+    verifyPreparedPublish( &publishInfo, 0xABCD );
+
+    /* Payloads which need 2 bytes of Remaining Length, and no payload. */
+    publishInfo.payloadLength = 200;
+    publishInfo.pPayload = encodedStringBuffer;
+    verifyPreparedPublish( &publishInfo, 2 );
+
+    publishInfo.payloadLength = 0;
+    publishInfo.pPayload = NULL;
+    verifyPreparedPublish( &publishInfo, 3 );
+}
+
+/**
+ * @brief Tests that the header of one message does not leak into the next.
+ */
+void test_MQTT_SerializePreparedPublishHeader_Reuse( void )
+{
+    uint8_t header[ MQTT_PREPARED_PUBLISH_BUFFER_SIZE( TEST_TOPIC_NAME_LENGTH ) ];
+    MQTTPublishInfo_t publishInfo;
+    MQTTFixedBuffer_t fixedBuffer;
+    MQTTPreparedPublish_t prepared;
+    const uint8_t * pHeader = NULL;
+    size_t headerSize = 0;
+    MQTTStatus_t status;
+
+    memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    fixedBuffer.pBuffer = header;
+    fixedBuffer.size = sizeof( header );
+
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    /* A long payload moves the start of the header back by one byte. */
+    status = MQTT_SerializePreparedPublishHeader( &prepared, 1000, 7, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &header[ 2 ], pHeader );
+    TEST_ASSERT_EQUAL( 3U + 2U + TEST_TOPIC_NAME_LENGTH + 2U, headerSize );
+
+    status = MQTT_SerializePreparedPublishHeader( &prepared, 10, 8, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &header[ 3 ], pHeader );
+    TEST_ASSERT_EQUAL( 2U + 2U + TEST_TOPIC_NAME_LENGTH + 2U, headerSize );
+    TEST_ASSERT_EQUAL( 0x32U, pHeader[ 0 ] );
+    TEST_ASSERT_EQUAL( 2U + TEST_TOPIC_NAME_LENGTH + 2U + 10U, pHeader[ 1 ] );
+    TEST_ASSERT_EQUAL( 0U, pHeader[ headerSize - 2U ] );
+    TEST_ASSERT_EQUAL( 8U, pHeader[ headerSize - 1U ] );
+}
+
+/**
+ * @brief Tests that MQTT_SerializePreparedPublishHeader rejects invalid
+ * parameters.
+ */
+void test_MQTT_SerializePreparedPublishHeader_Invalid( void )
+{
+    uint8_t header[ MQTT_PREPARED_PUBLISH_BUFFER_SIZE( TEST_TOPIC_NAME_LENGTH ) ];
+    MQTTPublishInfo_t publishInfo;
+    MQTTFixedBuffer_t fixedBuffer;
+    MQTTPreparedPublish_t prepared;
+    const uint8_t * pHeader = NULL;
+    size_t headerSize = 0;
+    MQTTStatus_t status;
+
+    memset( &publishInfo, 0x00, sizeof( publishInfo ) );
+    publishInfo.qos = MQTTQoS1;
+    publishInfo.pTopicName = TEST_TOPIC_NAME;
+    publishInfo.topicNameLength = TEST_TOPIC_NAME_LENGTH;
+    fixedBuffer.pBuffer = header;
+    fixedBuffer.size = sizeof( header );
+
+    status = MQTT_PreparePublish( &publishInfo, &fixedBuffer, &prepared );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    status = MQTT_SerializePreparedPublishHeader( NULL, 0, 1, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_SerializePreparedPublishHeader( &prepared, 0, 1, NULL, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_SerializePreparedPublishHeader( &prepared, 0, 1, &pHeader, NULL );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* Packet identifier is required for QoS 1. */
+    status = MQTT_SerializePreparedPublishHeader( &prepared, 0, 0, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* The packet cannot exceed the maximum Remaining Length. */
+    status = MQTT_SerializePreparedPublishHeader( &prepared, MQTT_MAX_REMAINING_LENGTH,
+                                                  1, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_SerializePreparedPublishHeader( &prepared, prepared.payloadLimit,
+                                                  1, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL_PTR( &header[ 0 ], pHeader );
+
+    prepared.pBuffer = NULL;
+    status = MQTT_SerializePreparedPublishHeader( &prepared, 0, 1, &pHeader, &headerSize );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+}
+
+/* ========================================================================== */
+
 /**
  * @brief Tests that MQTT_SerializeAck works as intended.
  */
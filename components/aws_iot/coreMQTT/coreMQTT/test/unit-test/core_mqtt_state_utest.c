@@ -935,6 +935,76 @@ void test_MQTT_UpdateStateAck( void )
 
 /* ========================================================================== */
 
+void test_MQTT_UpdateStatePubAcks( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTStatus_t status;
+    MQTTStatus_t statuses[ 5 ];
+    const uint16_t packetIds[ 5 ] = { 3, 1, 7, 1, 5 };
+
+    TransportInterface_t transport;
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+
+    transport.recv = transportRecvSuccess;
+    transport.send = transportSendSuccess;
+
+    MQTTPubAckInfo_t incomingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+    MQTTPubAckInfo_t outgoingRecords[ MQTT_STATE_ARRAY_MAX_COUNT ] = { 0 };
+
+    status = MQTT_Init( &mqttContext, &transport,
+                        getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* NULL parameters. */
+    status = MQTT_UpdateStatePubAcks( NULL, packetIds, statuses, 5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_UpdateStatePubAcks( &mqttContext, NULL, statuses, 5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+    status = MQTT_UpdateStatePubAcks( &mqttContext, packetIds, NULL, 5 );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, status );
+
+    /* No records for outgoing publishes. */
+    status = MQTT_UpdateStatePubAcks( &mqttContext, packetIds, statuses, 5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, statuses[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, statuses[ 4 ] );
+
+    status = MQTT_InitStatefulQoS( &mqttContext,
+                                   outgoingRecords, MQTT_STATE_ARRAY_MAX_COUNT,
+                                   incomingRecords, MQTT_STATE_ARRAY_MAX_COUNT );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* A hole left by an earlier PUBACK is skipped. */
+    addToRecord( mqttContext.outgoingPublishRecords, 1, 1, MQTTQoS1, MQTTPubAckPending );
+    addToRecord( mqttContext.outgoingPublishRecords, 2, 3, MQTTQoS1, MQTTPubAckPending );
+    addToRecord( mqttContext.outgoingPublishRecords, 3, 5, MQTTQoS2, MQTTPubRecPending );
+    addToRecord( mqttContext.outgoingPublishRecords, 4, 6, MQTTQoS1, MQTTPubAckPending );
+
+    status = MQTT_UpdateStatePubAcks( &mqttContext, packetIds, statuses, 5 );
+    TEST_ASSERT_EQUAL( MQTTSuccess, status );
+
+    /* Acknowledged QoS 1 publishes are done. */
+    TEST_ASSERT_EQUAL( MQTTSuccess, statuses[ 0 ] );
+    TEST_ASSERT_EQUAL( MQTTSuccess, statuses[ 1 ] );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, mqttContext.outgoingPublishRecords[ 1 ].packetId );
+    TEST_ASSERT_EQUAL( MQTT_PACKET_ID_INVALID, mqttContext.outgoingPublishRecords[ 2 ].packetId );
+
+    /* Unknown packet, and a second PUBACK for the same packet. */
+    TEST_ASSERT_EQUAL( MQTTBadResponse, statuses[ 2 ] );
+    TEST_ASSERT_EQUAL( MQTTBadResponse, statuses[ 3 ] );
+
+    /* A QoS 2 publish cannot be acknowledged with a PUBACK. */
+    TEST_ASSERT_EQUAL( MQTTIllegalState, statuses[ 4 ] );
+    TEST_ASSERT_EQUAL( 5, mqttContext.outgoingPublishRecords[ 3 ].packetId );
+    TEST_ASSERT_EQUAL( MQTTPubRecPending, mqttContext.outgoingPublishRecords[ 3 ].publishState );
+
+    /* Records not acknowledged are left alone. */
+    TEST_ASSERT_EQUAL( 6, mqttContext.outgoingPublishRecords[ 4 ].packetId );
+    TEST_ASSERT_EQUAL( MQTTPubAckPending, mqttContext.outgoingPublishRecords[ 4 ].publishState );
+}
+
+/* ========================================================================== */
+
 void test_MQTT_AckToResend( void )
 {
     MQTTContext_t mqttContext = { 0 };
@@ -81,6 +81,15 @@ struct NetworkContext
  */
 #define MQTT_SAMPLE_KEEPALIVE_INTERVAL_S       ( 1U )
 
+/**
+ * @brief Sample keep-alive interval, ping interval and current time of the
+ * ping interval tests. The ping interval must not exceed the keep-alive
+ * interval.
+ */
+#define MQTT_SAMPLE_PING_KEEPALIVE_S           ( 60U )
+#define MQTT_SAMPLE_PING_INTERVAL_MS           ( 20000U )
+#define MQTT_SAMPLE_PING_NOW_MS                ( 100000U )
+
 /**
  * @brief Length of time spent for single test case with
  * multiple iterations spent in the process loop for coverage.
@@ -2862,6 +2871,136 @@ void test_MQTT_Publish_Send_Timeout( void )
     TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
 }
 
+/**
+ * @brief Test that MQTT_PublishPrepared rejects invalid parameters.
+ */
+void test_MQTT_PublishPrepared_InvalidParams( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPreparedPublish_t prepared = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t status;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    status = MQTT_PublishPrepared( NULL, &prepared, "Test", 4, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    status = MQTT_PublishPrepared( &mqttContext, NULL, "Test", 4, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* Payload length is nonzero but the payload is NULL. */
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, NULL, 4, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* QoS 1 publishes need the outgoing publish records. */
+    prepared.qos = MQTTQoS1;
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 4, 1 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+
+    /* Errors of the serializer are returned. */
+    prepared.qos = MQTTQoS0;
+    MQTT_SerializePreparedPublishHeader_ExpectAnyArgsAndReturn( MQTTBadParameter );
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 4, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTBadParameter, status );
+}
+
+/**
+ * @brief Test that MQTT_PublishPrepared sends the prepared header and the
+ * payload and updates the state of a QoS 1 publish.
+ */
+void test_MQTT_PublishPrepared_HappyPath( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPreparedPublish_t prepared = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t status;
+    MQTTPubAckInfo_t outgoingPublishRecord[ 10 ];
+    uint8_t header[ 20 ] = { 0 };
+    const uint8_t * pHeader = header;
+    size_t headerSize = sizeof( header );
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    mqttContext.outgoingPublishRecordMaxCount = 10;
+    mqttContext.outgoingPublishRecords = outgoingPublishRecord;
+    prepared.qos = MQTTQoS1;
+
+    MQTT_SerializePreparedPublishHeader_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_ppHeader( &pHeader );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_pHeaderSize( &headerSize );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, "TestPublish", 11, 10 );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+
+    /* A QoS 0 publish without payload only sends the header. */
+    prepared.qos = MQTTQoS0;
+    MQTT_SerializePreparedPublishHeader_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_ppHeader( &pHeader );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_pHeaderSize( &headerSize );
+
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, NULL, 0, 0 );
+    TEST_ASSERT_EQUAL_INT( MQTTSuccess, status );
+}
+
+/**
+ * @brief Test that MQTT_PublishPrepared handles collisions, send failures and
+ * state update failures like MQTT_Publish.
+ */
+void test_MQTT_PublishPrepared_Failures( void )
+{
+    MQTTContext_t mqttContext = { 0 };
+    MQTTPreparedPublish_t prepared = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t status;
+    MQTTPubAckInfo_t outgoingPublishRecord[ 10 ];
+    uint8_t header[ 20 ] = { 0 };
+    const uint8_t * pHeader = header;
+    size_t headerSize = sizeof( header );
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+    MQTT_Init( &mqttContext, &transport, getTime, eventCallback, &networkBuffer );
+
+    mqttContext.outgoingPublishRecordMaxCount = 10;
+    mqttContext.outgoingPublishRecords = outgoingPublishRecord;
+    prepared.qos = MQTTQoS1;
+
+    /* The packet ID is in use and this is not a retransmission. */
+    MQTT_SerializePreparedPublishHeader_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTStateCollision );
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 4, 10 );
+    TEST_ASSERT_EQUAL_INT( MQTTStateCollision, status );
+
+    /* Retransmission whose state update fails after sending. */
+    prepared.dup = true;
+    MQTT_SerializePreparedPublishHeader_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_ppHeader( &pHeader );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_pHeaderSize( &headerSize );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTStateCollision );
+    MQTT_UpdateStatePublish_ExpectAnyArgsAndReturn( MQTTIllegalState );
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 4, 10 );
+    TEST_ASSERT_EQUAL_INT( MQTTIllegalState, status );
+
+    /* The transport fails. */
+    mqttContext.transportInterface.writev = transportWritevError;
+    MQTT_SerializePreparedPublishHeader_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_ppHeader( &pHeader );
+    MQTT_SerializePreparedPublishHeader_ReturnThruPtr_pHeaderSize( &headerSize );
+    MQTT_ReserveState_ExpectAnyArgsAndReturn( MQTTSuccess );
+    status = MQTT_PublishPrepared( &mqttContext, &prepared, "Test", 4, 10 );
+    TEST_ASSERT_EQUAL_INT( MQTTSendFailed, status );
+}
+
 /* ========================================================================== */
 
 /**
@@ -3875,6 +4014,178 @@ void test_MQTT_ProcessLoop_handleIncomingAck_Error_Paths( void )
     expectProcessLoopCalls( &context, &expectParams );
 }
 
+/**
+ * @brief Test that MQTT_SetPingInterval validates the interval against the
+ * keep alive interval.
+ */
+void test_MQTT_SetPingInterval( void )
+{
+    MQTTContext_t context = { 0 };
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, MQTT_SetPingInterval( NULL, 0U ) );
+
+    context.keepAliveIntervalSec = MQTT_SAMPLE_KEEPALIVE_INTERVAL_S;
+    TEST_ASSERT_EQUAL( MQTTBadParameter,
+                       MQTT_SetPingInterval( &context,
+                                             ( MQTT_SAMPLE_KEEPALIVE_INTERVAL_S * MQTT_ONE_SECOND_TO_MS ) + 1U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, context.pingIntervalMs );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess,
+                       MQTT_SetPingInterval( &context,
+                                             MQTT_SAMPLE_KEEPALIVE_INTERVAL_S * MQTT_ONE_SECOND_TO_MS ) );
+    TEST_ASSERT_EQUAL_UINT32( MQTT_SAMPLE_KEEPALIVE_INTERVAL_S * MQTT_ONE_SECOND_TO_MS, context.pingIntervalMs );
+
+    /* Any interval is accepted when keep alive is disabled. */
+    context.keepAliveIntervalSec = 0U;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetPingInterval( &context, UINT32_MAX ) );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetPingInterval( &context, 0U ) );
+    TEST_ASSERT_EQUAL_UINT32( 0U, context.pingIntervalMs );
+}
+
+/**
+ * @brief Test that with a ping interval set, no PINGREQ is sent while packets
+ * were recently sent and received.
+ */
+void test_MQTT_ProcessLoop_PingInterval_RecentTraffic( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.keepAliveIntervalSec = MQTT_SAMPLE_PING_KEEPALIVE_S;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetPingInterval( &context, MQTT_SAMPLE_PING_INTERVAL_MS ) );
+
+    /* Both directions were active a moment ago. PINGREQ should not be sent,
+     * any call to the serializer fails the test. */
+    globalEntryTime = MQTT_SAMPLE_PING_NOW_MS;
+    context.lastPacketTxTime = MQTT_SAMPLE_PING_NOW_MS - 1U;
+    context.lastPacketRxTime = MQTT_SAMPLE_PING_NOW_MS - 1U;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( context.waitingForPingResp );
+}
+
+/**
+ * @brief Test that with a ping interval set, a recently received packet
+ * postpones the PINGREQ while the client sent something within the keep
+ * alive interval.
+ */
+void test_MQTT_ProcessLoop_PingInterval_RecentRx( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.keepAliveIntervalSec = MQTT_SAMPLE_PING_KEEPALIVE_S;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetPingInterval( &context, MQTT_SAMPLE_PING_INTERVAL_MS ) );
+
+    /* Nothing sent for the ping interval, but a packet was just received. */
+    globalEntryTime = MQTT_SAMPLE_PING_NOW_MS;
+    context.lastPacketTxTime = MQTT_SAMPLE_PING_NOW_MS - MQTT_SAMPLE_PING_INTERVAL_MS;
+    context.lastPacketRxTime = MQTT_SAMPLE_PING_NOW_MS - 1U;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_FALSE( context.waitingForPingResp );
+}
+
+/**
+ * @brief Test that with a ping interval set, a PINGREQ is sent once nothing
+ * was sent or received for the ping interval.
+ */
+void test_MQTT_ProcessLoop_PingInterval_Idle( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.keepAliveIntervalSec = MQTT_SAMPLE_PING_KEEPALIVE_S;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetPingInterval( &context, MQTT_SAMPLE_PING_INTERVAL_MS ) );
+
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    /* Both directions idle for the ping interval, well within the keep alive
+     * interval. */
+    globalEntryTime = MQTT_SAMPLE_PING_NOW_MS;
+    context.lastPacketTxTime = MQTT_SAMPLE_PING_NOW_MS - MQTT_SAMPLE_PING_INTERVAL_MS;
+    context.lastPacketRxTime = MQTT_SAMPLE_PING_NOW_MS - MQTT_SAMPLE_PING_INTERVAL_MS;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( context.waitingForPingResp );
+}
+
+/**
+ * @brief Test that with a ping interval set, received packets do not postpone
+ * the PINGREQ past the keep alive interval, the server must hear from the
+ * client within it.
+ */
+void test_MQTT_ProcessLoop_PingInterval_TxIdleKeepAlive( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTStatus_t mqttStatus;
+    size_t pingreqSize = MQTT_PACKET_PINGREQ_SIZE;
+
+    setupTransportInterface( &transport );
+    transport.recv = transportRecvNoData;
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    context.keepAliveIntervalSec = MQTT_SAMPLE_PING_KEEPALIVE_S;
+    TEST_ASSERT_EQUAL( MQTTSuccess, MQTT_SetPingInterval( &context, MQTT_SAMPLE_PING_INTERVAL_MS ) );
+
+    MQTT_GetPingreqPacketSize_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_GetPingreqPacketSize_ReturnThruPtr_pPacketSize( &pingreqSize );
+    MQTT_SerializePingreq_ExpectAnyArgsAndReturn( MQTTSuccess );
+
+    /* A packet was just received, but nothing was sent for the keep alive
+     * interval. */
+    globalEntryTime = MQTT_SAMPLE_PING_NOW_MS;
+    context.lastPacketTxTime = MQTT_SAMPLE_PING_NOW_MS - ( MQTT_SAMPLE_PING_KEEPALIVE_S * MQTT_ONE_SECOND_TO_MS );
+    context.lastPacketRxTime = MQTT_SAMPLE_PING_NOW_MS - 1U;
+
+    mqttStatus = MQTT_ProcessLoop( &context );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_TRUE( context.waitingForPingResp );
+}
+
 /**
  * @brief This test case covers all calls to the private method,
  * handleKeepAlive(...),
@@ -4385,6 +4696,143 @@ void test_MQTT_ProcessLoop_Timer_Overflow( void )
     TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
 }
 
+/**
+ * @brief Test that MQTT_ProcessLoopBatch() rejects invalid parameters.
+ */
+void test_MQTT_ProcessLoopBatch_Invalid_Params( void )
+{
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    size_t packetCount = 0;
+    MQTTStatus_t mqttStatus = MQTT_ProcessLoopBatch( NULL, &packetCount );
+
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    setupTransportInterface( &transport );
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    mqttStatus = MQTT_ProcessLoopBatch( &context, NULL );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+
+    /* Get time function cannot be NULL. */
+    context.getTime = NULL;
+    mqttStatus = MQTT_ProcessLoopBatch( &context, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+    context.getTime = getTime;
+
+    /* The fixed network buffer cannot be NULL. */
+    context.networkBuffer.pBuffer = NULL;
+    mqttStatus = MQTT_ProcessLoopBatch( &context, &packetCount );
+    TEST_ASSERT_EQUAL( MQTTBadParameter, mqttStatus );
+}
+
+/**
+ * @brief Test that MQTT_ProcessLoopBatch() handles all the buffered PUBACKs
+ * with one state update.
+ */
+void test_MQTT_ProcessLoopBatch_PubAcks( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    MQTTStatus_t ackStatus[ 2 ] = { MQTTSuccess, MQTTSuccess };
+    uint16_t packetId1 = 1;
+    uint16_t packetId2 = 2;
+    size_t packetCount = 0;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    incomingPacket.type = MQTT_PACKET_TYPE_PUBACK;
+    incomingPacket.remainingLength = 2;
+    incomingPacket.headerLength = 2;
+
+    /* Two PUBACKs are buffered. */
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pPacketId( &packetId1 );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pPacketId( &packetId2 );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNoDataAvailable );
+    MQTT_UpdateStatePubAcks_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePubAcks_ReturnArrayThruPtr_pStatuses( ackStatus, 2 );
+
+    isEventCallbackInvoked = false;
+    mqttStatus = MQTT_ProcessLoopBatch( &context, &packetCount );
+
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+    TEST_ASSERT_EQUAL( 2, packetCount );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+    /* The handled packets are removed from the buffer. */
+    TEST_ASSERT_EQUAL( networkBuffer.size - 8U, context.index );
+
+    /* A PUBACK without a record fails, the others still reach the callback. */
+    ackStatus[ 0 ] = MQTTBadResponse;
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pPacketId( &packetId1 );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+    MQTT_DeserializeAck_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_DeserializeAck_ReturnThruPtr_pPacketId( &packetId2 );
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTNeedMoreBytes );
+    MQTT_UpdateStatePubAcks_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_UpdateStatePubAcks_ReturnArrayThruPtr_pStatuses( ackStatus, 2 );
+
+    isEventCallbackInvoked = false;
+    mqttStatus = MQTT_ProcessLoopBatch( &context, &packetCount );
+
+    TEST_ASSERT_EQUAL( MQTTBadResponse, mqttStatus );
+    TEST_ASSERT_EQUAL( 2, packetCount );
+    TEST_ASSERT_TRUE( isEventCallbackInvoked );
+}
+
+/**
+ * @brief Test that MQTT_ProcessLoopBatch() reports incomplete data only when
+ * no packet was handled.
+ */
+void test_MQTT_ProcessLoopBatch_NeedMoreBytes( void )
+{
+    MQTTStatus_t mqttStatus;
+    MQTTContext_t context = { 0 };
+    TransportInterface_t transport = { 0 };
+    MQTTFixedBuffer_t networkBuffer = { 0 };
+    MQTTPacketInfo_t incomingPacket = { 0 };
+    size_t packetCount = 0;
+
+    setupTransportInterface( &transport );
+    setupNetworkBuffer( &networkBuffer );
+
+    mqttStatus = MQTT_Init( &context, &transport, getTime, eventCallback, &networkBuffer );
+    TEST_ASSERT_EQUAL( MQTTSuccess, mqttStatus );
+
+    /* The packet is longer than what was received. */
+    incomingPacket.type = MQTT_PACKET_TYPE_SUBACK;
+    incomingPacket.remainingLength = networkBuffer.size - 1U;
+    incomingPacket.headerLength = 1;
+    context.transportInterface.recv = transportRecvOneByte;
+
+    MQTT_ProcessIncomingPacketTypeAndLength_ExpectAnyArgsAndReturn( MQTTSuccess );
+    MQTT_ProcessIncomingPacketTypeAndLength_ReturnThruPtr_pIncomingPacket( &incomingPacket );
+
+    mqttStatus = MQTT_ProcessLoopBatch( &context, &packetCount );
+
+    TEST_ASSERT_EQUAL( MQTTNeedMoreBytes, mqttStatus );
+    TEST_ASSERT_EQUAL( 0, packetCount );
+    TEST_ASSERT_EQUAL( 1, context.index );
+}
+
 /* ========================================================================== */
 
 /**
@@ -1,9 +1,13 @@
+#include <inttypes.h>
+#include <stdatomic.h>
 #include "esp_err.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/projdefs.h"
 #include "freertos/semphr.h"
 #include <string.h>
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_tls.h"
 #include "sys/socket.h"
 #include "network_transport.h"
@@ -11,6 +15,9 @@
 
 #define TAG "network_transport"
 
+/* How long xTlsConnect() yields between steps of a non-blocking handshake. */
+#define TLS_CONNECT_POLL_INTERVAL_MS 10
+
 Timeouts_t timeouts = { .connectionTimeoutMs = 4000, .sendTimeoutMs = 10000, .recvTimeoutMs = 2000 };
 
 void vTlsSetConnectTimeout( uint16_t connectionTimeoutMs )
@@ -28,40 +35,297 @@ void vTlsSetRecvTimeout( uint16_t recvTimeoutMs )
     timeouts.recvTimeoutMs = recvTimeoutMs;
 }
 
-TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
+/* Must be called with xTlsContextSemaphore held. */
+static void prvClearSession( NetworkContext_t* pxNetworkContext )
+{
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if( pxNetworkContext->pxTlsSession != NULL )
+    {
+        esp_tls_free_client_session( pxNetworkContext->pxTlsSession );
+        pxNetworkContext->pxTlsSession = NULL;
+    }
+#else
+    ( void ) pxNetworkContext;
+#endif
+}
+
+void vTlsClearSession( NetworkContext_t* pxNetworkContext )
+{
+    if( ( pxNetworkContext != NULL ) &&
+        ( xSemaphoreTake( pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY ) == pdTRUE ) )
+    {
+        prvClearSession( pxNetworkContext );
+        ( void ) xSemaphoreGive( pxNetworkContext->xTlsContextSemaphore );
+    }
+}
+
+uint32_t ulTlsGetCyclesSavedPerResume( const NetworkContext_t* pxNetworkContext )
+{
+    const TlsHandshakeMetrics_t * pxMetrics = &pxNetworkContext->xHandshakeMetrics;
+
+    if( ( pxMetrics->ulFullHandshakes == 0 ) || ( pxMetrics->ulResumedHandshakes == 0 ) )
+    {
+        return 0;
+    }
+
+    uint64_t ullFullAvg = pxMetrics->ullFullHandshakeCycles / pxMetrics->ulFullHandshakes;
+    uint64_t ullResumedAvg = pxMetrics->ullResumedHandshakeCycles / pxMetrics->ulResumedHandshakes;
+
+    return ( ullFullAvg > ullResumedAvg ) ? ( uint32_t ) ( ullFullAvg - ullResumedAvg ) : 0;
+}
+
+/* Starts an update of xStats, the sequence becomes odd. Updates are made with
+ * xTlsContextSemaphore held so there is a single writer at a time. */
+static void prvStatsBegin( NetworkContext_t* pxNetworkContext )
+{
+    uint_fast32_t uxSeq = atomic_load_explicit( &pxNetworkContext->uxStatsSeq, memory_order_relaxed );
+
+    atomic_store_explicit( &pxNetworkContext->uxStatsSeq, uxSeq + 1, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+}
+
+/* Publishes the update of xStats, the sequence becomes even again. */
+static void prvStatsEnd( NetworkContext_t* pxNetworkContext )
+{
+    uint_fast32_t uxSeq = atomic_load_explicit( &pxNetworkContext->uxStatsSeq, memory_order_relaxed );
+
+    atomic_store_explicit( &pxNetworkContext->uxStatsSeq, uxSeq + 1, memory_order_release );
+}
+
+static void prvHistogramAdd( uint32_t * pulBuckets, int64_t llDurationUs )
+{
+    size_t uxBucket = 0;
+    int64_t llBound = TLS_TRANSPORT_LATENCY_FIRST_BUCKET_US;
+
+    while( ( uxBucket < TLS_TRANSPORT_LATENCY_BUCKETS - 1 ) && ( llDurationUs >= llBound ) )
+    {
+        llBound <<= 2;
+        uxBucket++;
+    }
+
+    pulBuckets[ uxBucket ]++;
+}
+
+/* Takes xTlsContextSemaphore and records how long the caller waited for it. */
+static BaseType_t prvTakeContext( NetworkContext_t* pxNetworkContext, TickType_t xTicksToWait )
+{
+    int64_t llStartUs = esp_timer_get_time();
+
+    if( xSemaphoreTake( pxNetworkContext->xTlsContextSemaphore, xTicksToWait ) != pdTRUE )
+    {
+        /* Another task holds the semaphore and may be updating xStats. */
+        atomic_fetch_add_explicit( &pxNetworkContext->uxSemaphoreTimeouts, 1, memory_order_relaxed );
+        return pdFALSE;
+    }
+
+    int64_t llWaitUs = esp_timer_get_time() - llStartUs;
+    TlsTransportStats_t * pxStats = &pxNetworkContext->xStats;
+
+    prvStatsBegin( pxNetworkContext );
+    prvHistogramAdd( pxStats->pulSemaphoreWait, llWaitUs );
+    if( llWaitUs > pxStats->ulMaxSemaphoreWaitUs )
+    {
+        pxStats->ulMaxSemaphoreWaitUs = ( uint32_t ) llWaitUs;
+    }
+    prvStatsEnd( pxNetworkContext );
+
+    return pdTRUE;
+}
+
+static void prvCountRetry( NetworkContext_t* pxNetworkContext, ssize_t lTlsResult )
+{
+    prvStatsBegin( pxNetworkContext );
+    if( lTlsResult == MBEDTLS_ERR_SSL_WANT_READ )
+    {
+        pxNetworkContext->xStats.ulWantReadRetries++;
+    }
+    else if( lTlsResult == MBEDTLS_ERR_SSL_WANT_WRITE )
+    {
+        pxNetworkContext->xStats.ulWantWriteRetries++;
+    }
+    prvStatsEnd( pxNetworkContext );
+}
+
+bool xTlsGetStats( NetworkContext_t* pxNetworkContext, TlsTransportStats_t* pxStats )
+{
+    uint_fast32_t uxSeqBegin;
+    uint_fast32_t uxSeqEnd;
+
+    if( ( pxNetworkContext == NULL ) || ( pxStats == NULL ) )
+    {
+        return false;
+    }
+
+    for( ; ; )
+    {
+        uxSeqBegin = atomic_load_explicit( &pxNetworkContext->uxStatsSeq, memory_order_acquire );
+        if( ( uxSeqBegin & 1U ) == 0U )
+        {
+            memcpy( pxStats, ( const void * ) &pxNetworkContext->xStats, sizeof( *pxStats ) );
+            atomic_thread_fence( memory_order_acquire );
+            uxSeqEnd = atomic_load_explicit( &pxNetworkContext->uxStatsSeq, memory_order_relaxed );
+            if( uxSeqBegin == uxSeqEnd )
+            {
+                break;
+            }
+        }
+
+        /* The writer is inside a short update, let it finish even if it runs
+         * at a lower priority on this core. */
+        vTaskDelay( 1 );
+    }
+
+    pxStats->ulSemaphoreTimeouts = ( uint32_t ) atomic_load_explicit( &pxNetworkContext->uxSemaphoreTimeouts,
+                                                                     memory_order_relaxed );
+
+    return true;
+}
+
+void vTlsResetStats( NetworkContext_t* pxNetworkContext )
+{
+    if( ( pxNetworkContext != NULL ) &&
+        ( xSemaphoreTake( pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY ) == pdTRUE ) )
+    {
+        prvStatsBegin( pxNetworkContext );
+        memset( &pxNetworkContext->xStats, 0, sizeof( pxNetworkContext->xStats ) );
+        prvStatsEnd( pxNetworkContext );
+        atomic_store_explicit( &pxNetworkContext->uxSemaphoreTimeouts, 0, memory_order_relaxed );
+        ( void ) xSemaphoreGive( pxNetworkContext->xTlsContextSemaphore );
+    }
+}
+
+static void prvBuildTlsConfig( NetworkContext_t* pxNetworkContext, esp_tls_cfg_t* pxEspTlsConfig )
+{
+    memset( pxEspTlsConfig, 0, sizeof( esp_tls_cfg_t ) );
+
+    pxEspTlsConfig->cacert_buf = (const unsigned char*) ( pxNetworkContext->pcServerRootCA );
+    pxEspTlsConfig->cacert_bytes = pxNetworkContext->pcServerRootCASize;
+    pxEspTlsConfig->clientcert_buf = (const unsigned char*) ( pxNetworkContext->pcClientCert );
+    pxEspTlsConfig->clientcert_bytes = pxNetworkContext->pcClientCertSize;
+    pxEspTlsConfig->skip_common_name = pxNetworkContext->disableSni;
+    pxEspTlsConfig->alpn_protos = pxNetworkContext->pAlpnProtos;
+    pxEspTlsConfig->use_secure_element = pxNetworkContext->use_secure_element;
+    pxEspTlsConfig->ds_data = pxNetworkContext->ds_data;
+    pxEspTlsConfig->clientkey_buf = ( const unsigned char* )( pxNetworkContext->pcClientKey );
+    pxEspTlsConfig->clientkey_bytes = pxNetworkContext->pcClientKeySize;
+    pxEspTlsConfig->timeout_ms = timeouts.connectionTimeoutMs;
+    pxEspTlsConfig->non_block = true;
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    pxEspTlsConfig->client_session = pxNetworkContext->pxTlsSession;
+#endif
+}
+
+/* Replaces the cached session with the one negotiated on the current connection.
+ * Must be called with xTlsContextSemaphore held. */
+static void prvSaveSession( NetworkContext_t* pxNetworkContext )
+{
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    esp_tls_client_session_t * pxSession = esp_tls_get_client_session( pxNetworkContext->pxTls );
+
+    if( pxSession != NULL )
+    {
+        if( pxNetworkContext->pxTlsSession != NULL )
+        {
+            esp_tls_free_client_session( pxNetworkContext->pxTlsSession );
+        }
+        pxNetworkContext->pxTlsSession = pxSession;
+    }
+#else
+    ( void ) pxNetworkContext;
+#endif
+}
+
+static bool prvSessionCached( const NetworkContext_t* pxNetworkContext )
+{
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    return pxNetworkContext->pxTlsSession != NULL;
+#else
+    ( void ) pxNetworkContext;
+    return false;
+#endif
+}
+
+static bool prvHandshakeFailed( NetworkContext_t* pxNetworkContext )
+{
+    esp_tls_error_handle_t xErrorHandle = NULL;
+    esp_err_t xLastError = ESP_OK;
+
+    if( esp_tls_get_error_handle( pxNetworkContext->pxTls, &xErrorHandle ) == ESP_OK )
+    {
+        xLastError = esp_tls_get_and_clear_last_error( xErrorHandle, NULL, NULL );
+    }
+
+    return xLastError == ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED;
+}
+
+static void prvRecordHandshake( NetworkContext_t* pxNetworkContext )
+{
+    TlsHandshakeMetrics_t * pxMetrics = &pxNetworkContext->xHandshakeMetrics;
+
+    pxMetrics->ulLastHandshakeMs = ( uint32_t ) ( ( esp_timer_get_time() - pxNetworkContext->llConnectStartUs ) / 1000 );
+    pxMetrics->ulLastHandshakeCycles = pxNetworkContext->ulConnectCycles;
+    pxMetrics->xLastSessionOffered = prvSessionCached( pxNetworkContext );
+
+    if( pxMetrics->xLastSessionOffered )
+    {
+        pxMetrics->ulResumedHandshakes++;
+        pxMetrics->ullResumedHandshakeCycles += pxNetworkContext->ulConnectCycles;
+        APP_LOGI( TAG, "Resumed TLS handshake in %" PRIu32 " ms, %" PRIu32 " cycles (saved ~%" PRIu32 " cycles)",
+                  pxMetrics->ulLastHandshakeMs, pxMetrics->ulLastHandshakeCycles,
+                  ulTlsGetCyclesSavedPerResume( pxNetworkContext ) );
+    }
+    else
+    {
+        pxMetrics->ulFullHandshakes++;
+        pxMetrics->ullFullHandshakeCycles += pxNetworkContext->ulConnectCycles;
+        APP_LOGI( TAG, "Full TLS handshake in %" PRIu32 " ms, %" PRIu32 " cycles",
+                  pxMetrics->ulLastHandshakeMs, pxMetrics->ulLastHandshakeCycles );
+    }
+}
+
+TlsTransportStatus_t xTlsConnectAsync( NetworkContext_t* pxNetworkContext )
 {
     TlsTransportStatus_t xResult = TLS_TRANSPORT_CONNECT_FAILURE;
 
-    esp_tls_cfg_t xEspTlsConfig = {
-        .cacert_buf = (const unsigned char*) ( pxNetworkContext->pcServerRootCA ),
-        .cacert_bytes = pxNetworkContext->pcServerRootCASize,
-        .clientcert_buf = (const unsigned char*) ( pxNetworkContext->pcClientCert ),
-        .clientcert_bytes = pxNetworkContext->pcClientCertSize,
-        .skip_common_name = pxNetworkContext->disableSni,
-        .alpn_protos = pxNetworkContext->pAlpnProtos,
-        .use_secure_element = pxNetworkContext->use_secure_element,
-        .ds_data = pxNetworkContext->ds_data,
-        .clientkey_buf = ( const unsigned char* )( pxNetworkContext->pcClientKey ),
-        .clientkey_bytes = pxNetworkContext->pcClientKeySize,
-        .timeout_ms = timeouts.connectionTimeoutMs,
-        .non_block = false,
-    };
+    if( pxNetworkContext == NULL )
+    {
+        return TLS_TRANSPORT_INVALID_PARAMETER;
+    }
 
     if( xSemaphoreTake( pxNetworkContext->xTlsContextSemaphore, portMAX_DELAY ) == pdTRUE )
     {
-        int lConnectResult = -1;
-        esp_tls_t * pxTls = esp_tls_init();
+        if( ( pxNetworkContext->pxTls != NULL ) && !pxNetworkContext->xConnectInProgress )
+        {
+            /* Already connected. */
+            ( void ) xSemaphoreGive( pxNetworkContext->xTlsContextSemaphore );
+            return TLS_TRANSPORT_SUCCESS;
+        }
+
+        if( pxNetworkContext->pxTls == NULL )
+        {
+            pxNetworkContext->pxTls = esp_tls_init();
+            pxNetworkContext->xConnectInProgress = true;
+            pxNetworkContext->llConnectStartUs = esp_timer_get_time();
+            pxNetworkContext->ulConnectCycles = 0;
+        }
 
-        if( pxTls != NULL )
+        if( pxNetworkContext->pxTls != NULL )
         {
-            pxNetworkContext->pxTls = pxTls;
+            esp_tls_cfg_t xEspTlsConfig;
+            prvBuildTlsConfig( pxNetworkContext, &xEspTlsConfig );
 
-            lConnectResult = esp_tls_conn_new_sync( pxNetworkContext->pcHostname,
+            uint32_t ulStartCycles = esp_cpu_get_cycle_count();
+            int lConnectResult = esp_tls_conn_new_async( pxNetworkContext->pcHostname,
                 strlen( pxNetworkContext->pcHostname ),
                 pxNetworkContext->xPort,
-                &xEspTlsConfig, pxTls );
+                &xEspTlsConfig, pxNetworkContext->pxTls );
+            pxNetworkContext->ulConnectCycles += esp_cpu_get_cycle_count() - ulStartCycles;
 
-            if( lConnectResult == 1 )
+            if( lConnectResult == 0 )
+            {
+                xResult = TLS_TRANSPORT_CONNECT_IN_PROGRESS;
+            }
+            else if( lConnectResult == 1 )
             {
                 int lSockFd = -1;
                 if( esp_tls_get_conn_sockfd( pxNetworkContext->pxTls, &lSockFd ) == ESP_OK )
@@ -75,20 +339,67 @@ TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
                 }
             }
 
-            if( xResult != TLS_TRANSPORT_SUCCESS )
+            if( xResult == TLS_TRANSPORT_SUCCESS )
             {
+                pxNetworkContext->xConnectInProgress = false;
+                prvRecordHandshake( pxNetworkContext );
+                prvSaveSession( pxNetworkContext );
+            }
+            else if( xResult != TLS_TRANSPORT_CONNECT_IN_PROGRESS )
+            {
+                if( prvHandshakeFailed( pxNetworkContext ) )
+                {
+                    /* The server may have rejected a stale session, fall back to a full handshake next time.
+                     * Plain TCP failures (e.g. while roaming) keep the session for the next attempt. */
+                    prvClearSession( pxNetworkContext );
+                }
                 esp_tls_conn_destroy( pxNetworkContext->pxTls );
                 pxNetworkContext->pxTls = NULL;
-            } else 
-            {
+                pxNetworkContext->xConnectInProgress = false;
             }
         }
+        else
+        {
+            pxNetworkContext->xConnectInProgress = false;
+            xResult = TLS_TRANSPORT_INSUFFICIENT_MEMORY;
+        }
         ( void ) xSemaphoreGive( pxNetworkContext->xTlsContextSemaphore );
     }
 
     return xResult;
 }
 
+TlsTransportStatus_t xTlsConnect( NetworkContext_t* pxNetworkContext )
+{
+    TlsTransportStatus_t xResult;
+    TimeOut_t xTimeout;
+    TickType_t xTicksToWait = pdMS_TO_TICKS( timeouts.connectionTimeoutMs );
+
+    vTaskSetTimeOutState( &xTimeout );
+
+    for( ;; )
+    {
+        xResult = xTlsConnectAsync( pxNetworkContext );
+
+        if( ( xResult != TLS_TRANSPORT_CONNECT_IN_PROGRESS ) ||
+            ( xTaskCheckForTimeOut( &xTimeout, &xTicksToWait ) != pdFALSE ) )
+        {
+            break;
+        }
+
+        vTaskDelay( pdMS_TO_TICKS( TLS_CONNECT_POLL_INTERVAL_MS ) );
+    }
+
+    if( xResult == TLS_TRANSPORT_CONNECT_IN_PROGRESS )
+    {
+        APP_LOGE( TAG, "TLS connect timed out after %u ms", timeouts.connectionTimeoutMs );
+        ( void ) xTlsDisconnect( pxNetworkContext );
+        xResult = TLS_TRANSPORT_CONNECT_FAILURE;
+    }
+
+    return xResult;
+}
+
 TlsTransportStatus_t xTlsDisconnect( NetworkContext_t* pxNetworkContext )
 {
     BaseType_t xResult;
@@ -99,13 +410,25 @@ TlsTransportStatus_t xTlsDisconnect( NetworkContext_t* pxNetworkContext )
         {
             xResult = TLS_TRANSPORT_SUCCESS;
         }
-        else if( esp_tls_conn_destroy(pxNetworkContext->pxTls ) == 0)
-        {
-            xResult = TLS_TRANSPORT_SUCCESS;
-        }
         else
         {
-            xResult = TLS_TRANSPORT_DISCONNECT_FAILURE;
+            if( !pxNetworkContext->xConnectInProgress )
+            {
+                /* Pick up any ticket the server issued after the handshake. */
+                prvSaveSession( pxNetworkContext );
+            }
+
+            if( esp_tls_conn_destroy(pxNetworkContext->pxTls ) == 0)
+            {
+                xResult = TLS_TRANSPORT_SUCCESS;
+            }
+            else
+            {
+                xResult = TLS_TRANSPORT_DISCONNECT_FAILURE;
+            }
+
+            pxNetworkContext->pxTls = NULL;
+            pxNetworkContext->xConnectInProgress = false;
         }
 
         ( void ) xSemaphoreGive( pxNetworkContext->xTlsContextSemaphore );
@@ -118,6 +441,41 @@ TlsTransportStatus_t xTlsDisconnect( NetworkContext_t* pxNetworkContext )
     return xResult;
 }
 
+/**
+ * @brief Blocks until the socket is ready in the direction esp-tls asked for.
+ *
+ * @param[in] lSockFd Socket of the TLS connection.
+ * @param[in] lTlsResult The MBEDTLS_ERR_SSL_WANT_* code returned by esp-tls.
+ * @param[in] xTicksToWait Remaining time budget of the operation.
+ *
+ * @return Greater than 0 when ready, 0 on timeout and less than 0 on error.
+ */
+static int prvWaitForSocket( int lSockFd, ssize_t lTlsResult, TickType_t xTicksToWait )
+{
+    fd_set xReadyFds;
+    fd_set xErrorFds;
+    uint32_t ulTimeoutMs = xTicksToWait * portTICK_PERIOD_MS;
+    struct timeval xTimeout = { .tv_sec = ulTimeoutMs / 1000, .tv_usec = ( ulTimeoutMs % 1000 ) * 1000 };
+    bool xWantRead = ( lTlsResult == MBEDTLS_ERR_SSL_WANT_READ );
+
+    FD_ZERO( &xReadyFds );
+    FD_SET( lSockFd, &xReadyFds );
+    FD_ZERO( &xErrorFds );
+    FD_SET( lSockFd, &xErrorFds );
+
+    int lSelectResult = select( lSockFd + 1,
+                                xWantRead ? &xReadyFds : NULL,
+                                xWantRead ? NULL : &xReadyFds,
+                                &xErrorFds, &xTimeout );
+
+    if( ( lSelectResult > 0 ) && ( FD_ISSET( lSockFd, &xErrorFds ) != 0 ) )
+    {
+        lSelectResult = -1;
+    }
+
+    return lSelectResult;
+}
+
 int32_t espTlsTransportSend( NetworkContext_t* pxNetworkContext,
                              const void* pvData, size_t uxDataLen )
 {
@@ -131,67 +489,82 @@ int32_t espTlsTransportSend( NetworkContext_t* pxNetworkContext,
         TimeOut_t xTimeout;
         vTaskSetTimeOutState( &xTimeout );
 
-        struct timeval timeout = { .tv_usec = timeouts.sendTimeoutMs * 1000, .tv_sec = 0 };
         TickType_t xTicksToWait = pdMS_TO_TICKS( timeouts.sendTimeoutMs );
-        TickType_t start_tick = xTaskGetTickCount();
 
-        if( xSemaphoreTake( pxNetworkContext->xTlsContextSemaphore, xTicksToWait ) == pdTRUE )
+        if( prvTakeContext( pxNetworkContext, xTicksToWait ) == pdTRUE )
         {
+            TlsTransportStats_t * pxStats = &pxNetworkContext->xStats;
+            int64_t llStartUs = esp_timer_get_time();
             int lSockFd = -1;
             esp_err_t xError = esp_tls_get_conn_sockfd( pxNetworkContext->pxTls, &lSockFd );
             if( xError == ESP_OK )
             {
-                unsigned char * pucData = ( unsigned char * ) pvData;
+                const unsigned char * pucData = ( const unsigned char * ) pvData;
                 lBytesSent = 0;
-                do
-                {
-                    fd_set write_fds;
-                    fd_set error_fds;
-                    int lSelectResult = -1;
 
-                    FD_ZERO( &write_fds );
-                    FD_SET( lSockFd, &write_fds );
-                    FD_ZERO( &error_fds );
-                    FD_SET( lSockFd, &error_fds );
-
-                    suseconds_t elapsed_time_usec = ( xTaskGetTickCount() - start_tick ) * portTICK_PERIOD_MS * 1000;
-                    timeout.tv_usec = ( timeout.tv_usec - elapsed_time_usec >= 0 ) ? timeout.tv_usec - elapsed_time_usec : 0;
-                    lSelectResult = select( lSockFd + 1, NULL, &write_fds, &error_fds, &timeout );
+                /* Write optimistically and only wait on the socket when the TLS
+                 * layer reports that it cannot make progress. */
+                while( lBytesSent < ( int32_t ) uxDataLen )
+                {
+                    ssize_t lResult = esp_tls_conn_write( pxNetworkContext->pxTls,
+                                                          &( pucData[lBytesSent] ),
+                                                          uxDataLen - lBytesSent );
 
-                    if( lSelectResult < 0 )
+                    if( lResult > 0 )
                     {
-                        lBytesSent = -1;
-                        ESP_LOGE( TAG, "Error during call to select." );
+                        lBytesSent += ( int32_t ) lResult;
                     }
-                    else if( ( lSelectResult > 0 ) && ( FD_ISSET( lSockFd, &write_fds ) != 0 ) )
+                    else if( ( lResult == 0 ) ||
+                             ( lResult == MBEDTLS_ERR_SSL_WANT_WRITE ) ||
+                             ( lResult == MBEDTLS_ERR_SSL_WANT_READ ) )
                     {
-                        ssize_t lResult = esp_tls_conn_write( pxNetworkContext->pxTls,
-                                                        &( pucData[lBytesSent] ),
-                                                     uxDataLen - lBytesSent );
+                        prvCountRetry( pxNetworkContext, lResult );
 
-                        if( lResult >= 0 )
+                        if( xTaskCheckForTimeOut( &xTimeout, &xTicksToWait ) != pdFALSE )
                         {
-                            lBytesSent += ( int32_t ) lResult;
+                            /* Report the partial write, coreMQTT retries the remainder. */
+                            break;
                         }
-                        else if( ( lResult != MBEDTLS_ERR_SSL_WANT_WRITE ) &&
-                                ( lResult != MBEDTLS_ERR_SSL_WANT_READ ) )
+
+                        int lSelectResult = prvWaitForSocket( lSockFd, lResult, xTicksToWait );
+                        if( lSelectResult < 0 )
                         {
-                            lBytesSent = lResult;
+                            APP_LOGE( TAG, "Error during call to select." );
+                            lBytesSent = -1;
                         }
-                        else
+                        else if( lSelectResult == 0 )
                         {
-                            /* Empty when MBEDTLS_ERR_SSL_WANT_READ || MBEDTLS_ERR_SSL_WANT_WRITE */
+                            prvStatsBegin( pxNetworkContext );
+                            pxStats->ulSelectTimeouts++;
+                            pxStats->ulSendStalls++;
+                            prvStatsEnd( pxNetworkContext );
                         }
                     }
                     else
                     {
-                        /* Empty when lSelectResult == 0 */
+                        lBytesSent = ( int32_t ) lResult;
+                    }
+
+                    if( lBytesSent < 0 )
+                    {
+                        break;
                     }
                 }
-                while( ( xTaskCheckForTimeOut( &xTimeout, &xTicksToWait ) == pdFALSE ) &&
-                       ( lBytesSent < uxDataLen ) &&
-                       ( lBytesSent >= 0 ) );
+
+            }
+
+            prvStatsBegin( pxNetworkContext );
+            if( lBytesSent > 0 )
+            {
+                pxStats->ulBytesSent += ( uint32_t ) lBytesSent;
             }
+            if( ( lBytesSent >= 0 ) && ( lBytesSent < ( int32_t ) uxDataLen ) )
+            {
+                pxStats->ulPartialWrites++;
+            }
+            pxStats->ulSendCalls++;
+            prvHistogramAdd( pxStats->pulSendLatency, esp_timer_get_time() - llStartUs );
+            prvStatsEnd( pxNetworkContext );
             xSemaphoreGive(pxNetworkContext->xTlsContextSemaphore);
         }
     }
@@ -213,22 +586,16 @@ int32_t espTlsTransportRecv( NetworkContext_t* pxNetworkContext,
         vTaskSetTimeOutState( &xTimeout );
 
         TickType_t xTicksToWait = pdMS_TO_TICKS( timeouts.recvTimeoutMs );
-        struct timeval timeout = {.tv_usec = timeouts.recvTimeoutMs * 1000, .tv_sec = 0};
-        TickType_t start_tick = xTaskGetTickCount();
 
-        if( xSemaphoreTake( pxNetworkContext->xTlsContextSemaphore, xTicksToWait ) == pdTRUE )
+        if( prvTakeContext( pxNetworkContext, xTicksToWait ) == pdTRUE )
         {
+            TlsTransportStats_t * pxStats = &pxNetworkContext->xStats;
+            int64_t llStartUs = esp_timer_get_time();
             int lSockFd = -1;
-            fd_set read_fds;
-            fd_set error_fds;
 
             lBytesRead = 0;
 
             esp_tls_get_conn_sockfd( pxNetworkContext->pxTls, &lSockFd );
-            FD_ZERO( &read_fds );
-            FD_SET( lSockFd, &read_fds );
-            FD_ZERO( &error_fds );
-            FD_SET( lSockFd, &error_fds );
 
             do
             {
@@ -244,29 +611,47 @@ int32_t espTlsTransportRecv( NetworkContext_t* pxNetworkContext,
                 else if( ( lResult == MBEDTLS_ERR_SSL_WANT_WRITE ) ||
                          ( lResult == MBEDTLS_ERR_SSL_WANT_READ ) )
                 {
-                    suseconds_t elapsed_time_usec = ( xTaskGetTickCount() - start_tick ) * portTICK_PERIOD_MS * 1000;
-                    timeout.tv_usec = ( timeout.tv_usec - elapsed_time_usec >= 0 ) ? timeout.tv_usec - elapsed_time_usec : 0;
+                    prvCountRetry( pxNetworkContext, lResult );
 
-                    int lSelectResult = select( lSockFd + 1, &read_fds, NULL, &error_fds, &timeout );
-                    if ( ( lSelectResult < 0 ) || FD_ISSET( lSockFd, &error_fds ) ) {
-                        ESP_LOGE( TAG, "Error reading the message" );
-                        lBytesRead = lResult = -1;
+                    if( xTaskCheckForTimeOut( &xTimeout, &xTicksToWait ) != pdFALSE )
+                    {
+                        break;
+                    }
+
+                    int lSelectResult = prvWaitForSocket( lSockFd, lResult, xTicksToWait );
+                    if( lSelectResult < 0 )
+                    {
+                        APP_LOGE( TAG, "Error reading the message" );
+                        lBytesRead = -1;
+                    }
+                    else if( lSelectResult == 0 )
+                    {
+                        prvStatsBegin( pxNetworkContext );
+                        pxStats->ulSelectTimeouts++;
+                        prvStatsEnd( pxNetworkContext );
                     }
                 }
                 else if( lResult == 0 )
                 {
-                    ESP_LOGE( TAG, "Connection closed" );
+                    APP_LOGE( TAG, "Connection closed" );
                     lBytesRead = -1;
                 }
                 else
                 {
-                    ESP_LOGE( TAG, "Error reading: %d", ( int ) lResult );
+                    APP_LOGE( TAG, "Error reading: %d", ( int ) lResult );
                     lBytesRead = ( int32_t ) lResult;
                 }
             }
-            while ( ( xTaskCheckForTimeOut( &xTimeout, &xTicksToWait ) == pdFALSE ) &&
-                    ( lBytesRead == 0 ) );
+            while ( lBytesRead == 0 );
 
+            prvStatsBegin( pxNetworkContext );
+            if( lBytesRead > 0 )
+            {
+                pxStats->ulBytesReceived += ( uint32_t ) lBytesRead;
+            }
+            pxStats->ulRecvCalls++;
+            prvHistogramAdd( pxStats->pulRecvLatency, esp_timer_get_time() - llStartUs );
+            prvStatsEnd( pxNetworkContext );
 
             ( void ) xSemaphoreGive( pxNetworkContext->xTlsContextSemaphore );
         }
@@ -7,6 +7,8 @@
 #endif
 /* *INDENT-ON* */
 
+#include <stdatomic.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "transport_interface.h"
@@ -14,6 +16,7 @@
 
 typedef enum TlsTransportStatus
 {
+    TLS_TRANSPORT_CONNECT_IN_PROGRESS = 1,  /**< Non-blocking connect started, handshake not finished yet. */
     TLS_TRANSPORT_SUCCESS = 0,              /**< Function successfully completed. */
                                             /**< -1 is reserved for ESP_FAIL */
     TLS_TRANSPORT_INVALID_PARAMETER = -2,   /**< At least one parameter was invalid. */
@@ -25,6 +28,55 @@ typedef enum TlsTransportStatus
     TLS_TRANSPORT_DISCONNECT_FAILURE = -8   /**< Failed to disconnect from server. */
 } TlsTransportStatus_t;
 
+/**
+ * @brief Timing of the TLS handshakes performed on a network context.
+ *
+ * Cycle counts only include the time spent inside esp-tls while driving the
+ * handshake, not the time spent waiting for the network, so they reflect the
+ * CPU cost of the asymmetric crypto that session resumption avoids.
+ */
+typedef struct TlsHandshakeMetrics
+{
+    uint32_t ulLastHandshakeMs;          /**< @brief Wall-clock duration of the last completed handshake. */
+    uint32_t ulLastHandshakeCycles;      /**< @brief CPU cycles spent on the last completed handshake. */
+    bool xLastSessionOffered;            /**< @brief Whether a cached session was offered for the last handshake. */
+    uint32_t ulFullHandshakes;           /**< @brief Handshakes completed without a cached session. */
+    uint32_t ulResumedHandshakes;        /**< @brief Handshakes completed with a cached session offered. */
+    uint64_t ullFullHandshakeCycles;     /**< @brief Total CPU cycles of all full handshakes. */
+    uint64_t ullResumedHandshakeCycles;  /**< @brief Total CPU cycles of all resumed handshakes. */
+} TlsHandshakeMetrics_t;
+
+/**
+ * @brief Number of buckets in each latency histogram of TlsTransportStats_t.
+ *
+ * Bucket 0 counts durations below TLS_TRANSPORT_LATENCY_FIRST_BUCKET_US, each
+ * following bucket has a 4x larger upper bound and the last one is open ended:
+ * <256us, <1ms, <4ms, <16ms, <65ms, <262ms, <1s, >=1s.
+ */
+#define TLS_TRANSPORT_LATENCY_BUCKETS       8
+#define TLS_TRANSPORT_LATENCY_FIRST_BUCKET_US 256
+
+/**
+ * @brief Counters and latency histograms of the transport send/recv paths.
+ */
+typedef struct TlsTransportStats
+{
+    uint32_t ulBytesSent;            /**< @brief Bytes accepted by esp-tls for sending. */
+    uint32_t ulBytesReceived;        /**< @brief Bytes returned by esp-tls reads. */
+    uint32_t ulSendCalls;            /**< @brief Calls to espTlsTransportSend. */
+    uint32_t ulRecvCalls;            /**< @brief Calls to espTlsTransportRecv. */
+    uint32_t ulPartialWrites;        /**< @brief Sends that returned fewer bytes than requested. */
+    uint32_t ulWantReadRetries;      /**< @brief MBEDTLS_ERR_SSL_WANT_READ results. */
+    uint32_t ulWantWriteRetries;     /**< @brief MBEDTLS_ERR_SSL_WANT_WRITE results. */
+    uint32_t ulSelectTimeouts;       /**< @brief Socket waits that ran out of time. */
+    uint32_t ulSendStalls;           /**< @brief Socket waits of espTlsTransportSend that ran out of time. */
+    uint32_t ulSemaphoreTimeouts;    /**< @brief Calls that could not take xTlsContextSemaphore in time. */
+    uint32_t ulMaxSemaphoreWaitUs;   /**< @brief Longest wait for xTlsContextSemaphore. */
+    uint32_t pulSendLatency[ TLS_TRANSPORT_LATENCY_BUCKETS ];       /**< @brief Duration of send calls. */
+    uint32_t pulRecvLatency[ TLS_TRANSPORT_LATENCY_BUCKETS ];       /**< @brief Duration of recv calls. */
+    uint32_t pulSemaphoreWait[ TLS_TRANSPORT_LATENCY_BUCKETS ];     /**< @brief Wait for xTlsContextSemaphore. */
+} TlsTransportStats_t;
+
 struct NetworkContext
 {
     SemaphoreHandle_t xTlsContextSemaphore;
@@ -55,6 +107,23 @@ struct NetworkContext
     * @brief Disable server name indication (SNI) for a TLS session.
     */
     BaseType_t disableSni;
+
+    bool xConnectInProgress;         /**< @brief Set while a non-blocking handshake is being driven. */
+    int64_t llConnectStartUs;        /**< @brief Time the in-progress handshake was started. */
+    uint32_t ulConnectCycles;        /**< @brief CPU cycles accumulated by the in-progress handshake. */
+    TlsHandshakeMetrics_t xHandshakeMetrics; /**< @brief Timing of completed handshakes. */
+    TlsTransportStats_t xStats;      /**< @brief Send/recv statistics, read with xTlsGetStats(). */
+    atomic_uint_fast32_t uxStatsSeq; /**< @brief Sequence counter of xStats, odd while it is updated. */
+    atomic_uint_fast32_t uxSemaphoreTimeouts; /**< @brief ulSemaphoreTimeouts, counted without the semaphore. */
+
+#ifdef CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    /**
+    * @brief Session saved from the last connection, offered to the server on
+    * reconnect so that an abbreviated handshake can be used. Kept across
+    * xTlsDisconnect() and freed with vTlsClearSession().
+    */
+    esp_tls_client_session_t *pxTlsSession;
+#endif
 };
 
 /**
@@ -74,8 +143,25 @@ typedef struct Timeouts
     uint16_t recvTimeoutMs;
 } Timeouts_t;
 
+/**
+ * @brief Connects to the server, blocking for at most the connection timeout.
+ *
+ * Internally drives xTlsConnectAsync() and yields between steps so that other
+ * tasks at the same priority keep running during the handshake.
+ */
 TlsTransportStatus_t xTlsConnect(NetworkContext_t* pxNetworkContext );
 
+/**
+ * @brief Starts or continues a non-blocking connect.
+ *
+ * Call repeatedly until it stops returning TLS_TRANSPORT_CONNECT_IN_PROGRESS.
+ * A session cached from a previous connection is offered to the server.
+ *
+ * @return TLS_TRANSPORT_SUCCESS when connected, TLS_TRANSPORT_CONNECT_IN_PROGRESS
+ * while the handshake is ongoing, otherwise an error code.
+ */
+TlsTransportStatus_t xTlsConnectAsync( NetworkContext_t* pxNetworkContext );
+
 TlsTransportStatus_t xTlsDisconnect( NetworkContext_t* pxNetworkContext );
 
 int32_t espTlsTransportSend( NetworkContext_t* pxNetworkContext,
@@ -90,6 +176,32 @@ void vTlsSetSendTimeout( uint16_t sendTimeoutMs );
 
 void vTlsSetRecvTimeout( uint16_t recvTimeoutMs );
 
+/**
+ * @brief Drops the cached TLS session so the next connect performs a full handshake.
+ */
+void vTlsClearSession( NetworkContext_t* pxNetworkContext );
+
+/**
+ * @brief Copies a consistent snapshot of the transport statistics.
+ *
+ * Does not take xTlsContextSemaphore, so it does not wait for a send or
+ * recv blocked on the socket.
+ *
+ * @return true if the snapshot was taken, false if the context is invalid.
+ */
+bool xTlsGetStats( NetworkContext_t* pxNetworkContext, TlsTransportStats_t* pxStats );
+
+/**
+ * @brief Resets the transport statistics to zero.
+ */
+void vTlsResetStats( NetworkContext_t* pxNetworkContext );
+
+/**
+ * @brief Average CPU cycles saved by a resumed handshake compared to a full one.
+ * @return 0 until at least one full and one resumed handshake have completed.
+ */
+uint32_t ulTlsGetCyclesSavedPerResume( const NetworkContext_t* pxNetworkContext );
+
 /* *INDENT-OFF* */
 #ifdef __cplusplus
     }
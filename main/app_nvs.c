@@ -1,11 +1,31 @@
+/**
+ * @file app_nvs.c
+ * @brief Persisted settings, cached in RAM and written to NVS in batches.
+ *
+ * Everything lives in one configuration record (credential store, fast connect details and
+ * device settings) read once by app_nvs_init(). Setters only update the cache and mark it dirty,
+ * a one-shot timer then has the WiFi task write the record with a single commit, so a burst of
+ * updates (connect, save network, save access point) costs one flash write.
+ *
+ * The record starts with a header holding the schema version, the payload length and a CRC32
+ * of the payload. Fields are only ever appended to the payload, a reader decodes the fields its
+ * version knows and ignores the rest. app_nvs_migrations[] upgrades older records step by step.
+ */
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 
-#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "app_log.h"
+#include "esp_mac.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "app_nvs.h"
+#include "dht11.h"
 #include "wifi_app.h"
 
 static const char TAG[] = "app_nvs";
@@ -13,135 +33,924 @@ static const char TAG[] = "app_nvs";
 // NVS name space used for storing WiFi credentials
 const char app_nvs_sta_creds_namespace[] = "stacreds";
 
-esp_err_t app_nvs_save_sta_creds(void)
+// Configuration record
+static const char app_nvs_config_key[] = "config";
+
+// Default settings, used for fields missing from older records
+#define APP_NVS_DEFAULT_MQTT_PORT            8883
+#define APP_NVS_DEFAULT_SENSOR_PERIOD_MS     4000
+#define APP_NVS_DEFAULT_TIME_SYNC_PERIOD_MS  10000
+
+// Record header: version (u16), payload length (u16), payload CRC32 (u32), little endian
+#define APP_NVS_RECORD_HEADER_SIZE     8
+
+// Header of a saved network: SSID length, password length, priority and last_success
+#define APP_NVS_NETWORK_HEADER_SIZE    7
+
+// Largest payload of APP_NVS_CONFIG_VERSION
+#define APP_NVS_RECORD_MAX_SIZE        (APP_NVS_RECORD_HEADER_SIZE + \
+                                        1 + APP_NVS_MAX_NETWORKS * (APP_NVS_NETWORK_HEADER_SIZE + 32 + 64) + \
+                                        8 + APP_NVS_MQTT_ENDPOINT_SIZE + 2 + APP_NVS_MQTT_CLIENT_ID_SIZE + \
+                                        APP_NVS_TIMEZONE_SIZE + 1 + APP_NVS_MAX_SENSORS * 2 + 8)
+
+// Records written by newer firmware may be longer, the extra fields are skipped
+#define APP_NVS_RECORD_READ_SIZE       1024
+
+/**
+ * RAM copy of the configuration record.
+ */
+typedef struct app_nvs_config
 {
-  nvs_handle handle;
-  esp_err_t esp_err;
-  ESP_LOGI(TAG, "app_nvs_save_sta_creds: Saving station mode WiFi credentials to NVS");
+  app_nvs_network_t networks[APP_NVS_MAX_NETWORKS];
+  app_nvs_fast_connect_t fast_connect;
+  bool fast_connect_valid;
+  app_nvs_settings_t settings;
+  bool legacy_keys;         // Keys of older firmware to erase with the next write
+  bool dirty;
+} app_nvs_config_t;
 
-  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+/**
+ * Cursor over a serialized record, ok turns false on the first out of bounds access.
+ */
+typedef struct app_nvs_cursor
+{
+  uint8_t *data;
+  size_t size;
+  size_t pos;
+  bool ok;
+} app_nvs_cursor_t;
+
+/**
+ * Upgrades a configuration of version n to version n + 1.
+ * @param handle NVS handle opened on the credentials namespace, for migrations reading old keys.
+ * @param config configuration to upgrade.
+ */
+typedef void (*app_nvs_migration_t)(nvs_handle handle, app_nvs_config_t *config);
+
+static void app_nvs_migrate_v0(nvs_handle handle, app_nvs_config_t *config);
+
+// app_nvs_migrations[n] upgrades version n, version 0 being the separate keys written before the record
+static const app_nvs_migration_t app_nvs_migrations[APP_NVS_CONFIG_VERSION] = {
+  app_nvs_migrate_v0,
+};
+
+static app_nvs_config_t app_nvs_config;
+
+// Serialization buffer, only used with app_nvs_mutex held
+static uint8_t app_nvs_record[APP_NVS_RECORD_READ_SIZE];
+
+// Cache before the update app_nvs_save_config() is writing, only used with app_nvs_mutex held
+static app_nvs_config_t app_nvs_previous;
+
+// Protects app_nvs_config, held for the whole write so app_nvs_flush() returns once the data is on flash
+static SemaphoreHandle_t app_nvs_mutex = NULL;
+
+// Debounce timer, started by the first change after a commit
+static esp_timer_handle_t app_nvs_commit_timer = NULL;
+
+/**
+ * Length of a string field that is not necessarily NUL terminated.
+ */
+static size_t app_nvs_field_len(const uint8_t *field, size_t max)
+{
+  size_t len = 0;
 
-  if(wifi_sta_config)
+  while (len < max && field[len] != '\0')
   {
-    esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READWRITE, &handle);
-    if (esp_err != ESP_OK) {
-      ESP_LOGE(TAG, "app_nvs_save_sta_creds: Failed to open NVS namespace %s, error: %s", app_nvs_sta_creds_namespace, esp_err_to_name(esp_err));
-      return esp_err;
+    len++;
+  }
+
+  return len;
+}
+
+static void app_nvs_put(app_nvs_cursor_t *cursor, const void *data, size_t len)
+{
+  if (!cursor->ok || cursor->size - cursor->pos < len)
+  {
+    cursor->ok = false;
+    return;
+  }
+  memcpy(&cursor->data[cursor->pos], data, len);
+  cursor->pos += len;
+}
+
+static void app_nvs_put_u8(app_nvs_cursor_t *cursor, uint8_t value)
+{
+  app_nvs_put(cursor, &value, 1);
+}
+
+static void app_nvs_put_u16(app_nvs_cursor_t *cursor, uint16_t value)
+{
+  uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+  app_nvs_put(cursor, bytes, sizeof(bytes));
+}
+
+static void app_nvs_put_u32(app_nvs_cursor_t *cursor, uint32_t value)
+{
+  uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+  app_nvs_put(cursor, bytes, sizeof(bytes));
+}
+
+/**
+ * Writes a string as its length followed by its bytes.
+ */
+static void app_nvs_put_str(app_nvs_cursor_t *cursor, const char *str, size_t size)
+{
+  size_t len = app_nvs_field_len((const uint8_t *)str, size - 1);
+
+  app_nvs_put_u8(cursor, (uint8_t)len);
+  app_nvs_put(cursor, str, len);
+}
+
+static void app_nvs_get(app_nvs_cursor_t *cursor, void *data, size_t len)
+{
+  if (!cursor->ok || cursor->size - cursor->pos < len)
+  {
+    cursor->ok = false;
+    memset(data, 0x00, len);
+    return;
+  }
+  memcpy(data, &cursor->data[cursor->pos], len);
+  cursor->pos += len;
+}
+
+static uint8_t app_nvs_get_u8(app_nvs_cursor_t *cursor)
+{
+  uint8_t value;
+  app_nvs_get(cursor, &value, 1);
+  return value;
+}
+
+static uint16_t app_nvs_get_u16(app_nvs_cursor_t *cursor)
+{
+  uint8_t bytes[2];
+  app_nvs_get(cursor, bytes, sizeof(bytes));
+  return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t app_nvs_get_u32(app_nvs_cursor_t *cursor)
+{
+  uint8_t bytes[4];
+  app_nvs_get(cursor, bytes, sizeof(bytes));
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+/**
+ * Reads a string written by app_nvs_put_str(), always NUL terminated.
+ */
+static void app_nvs_get_str(app_nvs_cursor_t *cursor, char *str, size_t size)
+{
+  size_t len = app_nvs_get_u8(cursor);
+
+  if (len >= size)
+  {
+    cursor->ok = false;
+    len = 0;
+  }
+  app_nvs_get(cursor, str, len);
+  str[len] = '\0';
+}
+
+/**
+ * Writes a saved network as its header followed by the actual SSID and password bytes.
+ */
+static void app_nvs_put_network(app_nvs_cursor_t *cursor, const app_nvs_network_t *network)
+{
+  size_t ssid_len = app_nvs_field_len(network->ssid, sizeof(network->ssid));
+  size_t password_len = app_nvs_field_len(network->password, sizeof(network->password));
+
+  app_nvs_put_u8(cursor, (uint8_t)ssid_len);
+  app_nvs_put_u8(cursor, (uint8_t)password_len);
+  app_nvs_put_u8(cursor, network->priority);
+  app_nvs_put_u32(cursor, network->last_success);
+  app_nvs_put(cursor, network->ssid, ssid_len);
+  app_nvs_put(cursor, network->password, password_len);
+}
+
+static void app_nvs_get_network(app_nvs_cursor_t *cursor, app_nvs_network_t *network)
+{
+  size_t ssid_len = app_nvs_get_u8(cursor);
+  size_t password_len = app_nvs_get_u8(cursor);
+
+  memset(network, 0x00, sizeof(app_nvs_network_t));
+  network->priority = app_nvs_get_u8(cursor);
+  network->last_success = app_nvs_get_u32(cursor);
+
+  if (ssid_len == 0 || ssid_len > sizeof(network->ssid) || password_len > sizeof(network->password))
+  {
+    cursor->ok = false;
+    return;
+  }
+  app_nvs_get(cursor, network->ssid, ssid_len);
+  app_nvs_get(cursor, network->password, password_len);
+}
+
+/**
+ * Resets a configuration to the firmware defaults.
+ */
+static void app_nvs_set_defaults(app_nvs_config_t *config)
+{
+  memset(config, 0x00, sizeof(app_nvs_config_t));
+  config->settings.mqtt_port = APP_NVS_DEFAULT_MQTT_PORT;
+  config->settings.sensors[0].type = APP_NVS_SENSOR_DHT11;
+  config->settings.sensors[0].gpio = DHT_GPIO_PIN;
+  config->settings.sensor_period_ms = APP_NVS_DEFAULT_SENSOR_PERIOD_MS;
+  config->settings.time_sync_period_ms = APP_NVS_DEFAULT_TIME_SYNC_PERIOD_MS;
+}
+
+/**
+ * Serializes a configuration as a record of APP_NVS_CONFIG_VERSION.
+ * @param config configuration to write.
+ * @param buf receives the record.
+ * @param size size of buf.
+ * @return the size of the record, 0 if it did not fit.
+ */
+static size_t app_nvs_encode_config(const app_nvs_config_t *config, uint8_t *buf, size_t size)
+{
+  app_nvs_cursor_t cursor = { .data = buf, .size = size, .pos = APP_NVS_RECORD_HEADER_SIZE, .ok = size >= APP_NVS_RECORD_HEADER_SIZE };
+  app_nvs_cursor_t header = { .data = buf, .size = APP_NVS_RECORD_HEADER_SIZE, .pos = 0, .ok = cursor.ok };
+  uint8_t count = 0;
+  size_t payload_len;
+
+  for (size_t i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+  {
+    count += (config->networks[i].ssid[0] != '\0') ? 1 : 0;
+  }
+  app_nvs_put_u8(&cursor, count);
+  for (size_t i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+  {
+    if (config->networks[i].ssid[0] != '\0')
+    {
+      app_nvs_put_network(&cursor, &config->networks[i]);
     }
+  }
+
+  app_nvs_put_u8(&cursor, config->fast_connect_valid ? 1 : 0);
+  app_nvs_put(&cursor, config->fast_connect.bssid, sizeof(config->fast_connect.bssid));
+  app_nvs_put_u8(&cursor, config->fast_connect.channel);
+
+  app_nvs_put_str(&cursor, config->settings.mqtt_endpoint, sizeof(config->settings.mqtt_endpoint));
+  app_nvs_put_u16(&cursor, config->settings.mqtt_port);
+  app_nvs_put_str(&cursor, config->settings.mqtt_client_id, sizeof(config->settings.mqtt_client_id));
+  app_nvs_put_str(&cursor, config->settings.timezone, sizeof(config->settings.timezone));
+
+  app_nvs_put_u8(&cursor, APP_NVS_MAX_SENSORS);
+  for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+  {
+    app_nvs_put_u8(&cursor, config->settings.sensors[i].type);
+    app_nvs_put_u8(&cursor, config->settings.sensors[i].gpio);
+  }
+  app_nvs_put_u32(&cursor, config->settings.sensor_period_ms);
+  app_nvs_put_u32(&cursor, config->settings.time_sync_period_ms);
+
+  if (!cursor.ok)
+  {
+    return 0;
+  }
+
+  payload_len = cursor.pos - APP_NVS_RECORD_HEADER_SIZE;
+  app_nvs_put_u16(&header, APP_NVS_CONFIG_VERSION);
+  app_nvs_put_u16(&header, (uint16_t)payload_len);
+  app_nvs_put_u32(&header, esp_rom_crc32_le(0, &buf[APP_NVS_RECORD_HEADER_SIZE], payload_len));
+
+  return cursor.pos;
+}
+
+/**
+ * Parses a record, fields the record's version does not have keep their defaults.
+ * @param buf record.
+ * @param size size of the record.
+ * @param config receives the configuration.
+ * @return the version of the record, or -1 if it is damaged.
+ */
+static int app_nvs_decode_config(uint8_t *buf, size_t size, app_nvs_config_t *config)
+{
+  app_nvs_cursor_t header = { .data = buf, .size = size, .pos = 0, .ok = true };
+  app_nvs_cursor_t cursor;
+  uint16_t version = app_nvs_get_u16(&header);
+  uint16_t payload_len = app_nvs_get_u16(&header);
+  uint32_t crc = app_nvs_get_u32(&header);
+  uint8_t count;
+
+  if (!header.ok || version == 0 || payload_len > size - APP_NVS_RECORD_HEADER_SIZE ||
+      esp_rom_crc32_le(0, &buf[APP_NVS_RECORD_HEADER_SIZE], payload_len) != crc)
+  {
+    return -1;
+  }
+
+  cursor = (app_nvs_cursor_t){ .data = &buf[APP_NVS_RECORD_HEADER_SIZE], .size = payload_len, .pos = 0, .ok = true };
 
-    esp_err = nvs_set_blob(handle, "ssid", wifi_sta_config->sta.ssid, MAX_SSID_LENGTH);
-    if (esp_err != ESP_OK) {
-      ESP_LOGE(TAG, "app_nvs_save_sta_creds: Failed to save ssid to NVS, error: %s", esp_err_to_name(esp_err));
-      nvs_close(handle);
-      return esp_err;
+  // Version 1
+  count = app_nvs_get_u8(&cursor);
+  for (size_t i = 0; i < count && cursor.ok; i++)
+  {
+    app_nvs_network_t network;
+
+    app_nvs_get_network(&cursor, &network);
+    if (i < APP_NVS_MAX_NETWORKS)
+    {
+      config->networks[i] = network;
     }
+  }
 
-    esp_err = nvs_set_blob(handle, "password", wifi_sta_config->sta.password, MAX_PASSWORD_LENGTH);
-    if (esp_err != ESP_OK) {
-      ESP_LOGE(TAG, "app_nvs_save_sta_creds: Failed to save password to NVS, error: %s", esp_err_to_name(esp_err));
-      nvs_close(handle);
-      return esp_err;
+  config->fast_connect_valid = app_nvs_get_u8(&cursor) != 0;
+  app_nvs_get(&cursor, config->fast_connect.bssid, sizeof(config->fast_connect.bssid));
+  config->fast_connect.channel = app_nvs_get_u8(&cursor);
+  config->fast_connect_valid = config->fast_connect_valid && config->fast_connect.channel != 0;
+
+  app_nvs_get_str(&cursor, config->settings.mqtt_endpoint, sizeof(config->settings.mqtt_endpoint));
+  config->settings.mqtt_port = app_nvs_get_u16(&cursor);
+  app_nvs_get_str(&cursor, config->settings.mqtt_client_id, sizeof(config->settings.mqtt_client_id));
+  app_nvs_get_str(&cursor, config->settings.timezone, sizeof(config->settings.timezone));
+
+  count = app_nvs_get_u8(&cursor);
+  for (size_t i = 0; i < count && cursor.ok; i++)
+  {
+    app_nvs_sensor_t sensor;
+
+    sensor.type = app_nvs_get_u8(&cursor);
+    sensor.gpio = app_nvs_get_u8(&cursor);
+    if (i < APP_NVS_MAX_SENSORS)
+    {
+      config->settings.sensors[i] = sensor;
     }
+  }
+  config->settings.sensor_period_ms = app_nvs_get_u32(&cursor);
+  config->settings.time_sync_period_ms = app_nvs_get_u32(&cursor);
 
-    esp_err = nvs_commit(handle);
-    if (esp_err != ESP_OK) {
-      ESP_LOGE(TAG, "app_nvs_save_sta_creds: Failed to commit changes to NVS, error: %s", esp_err_to_name(esp_err));
+  // Fields of later versions are read here, guarded by the record version
+
+  return cursor.ok ? version : -1;
+}
+
+/**
+ * Version 0 to 1: moves the separate credential keys of older firmware into the record.
+ * Earlier firmware wrote "nets" (length prefixed networks), before that the fixed size "networks"
+ * blob and before that single ssid/password blobs. The fast connect details were in "fastconn".
+ */
+static void app_nvs_migrate_v0(nvs_handle handle, app_nvs_config_t *config)
+{
+  app_nvs_network_t *networks = config->networks;
+  size_t size = sizeof(app_nvs_record);
+  size_t networks_size = sizeof(config->networks);
+  size_t ssid_size = sizeof(networks[0].ssid);
+  size_t password_size = sizeof(networks[0].password);
+
+  if (nvs_get_blob(handle, "nets", app_nvs_record, &size) == ESP_OK)
+  {
+    app_nvs_cursor_t cursor = { .data = app_nvs_record, .size = size, .pos = 0, .ok = true };
+
+    for (size_t i = 0; i < APP_NVS_MAX_NETWORKS && cursor.pos < cursor.size; i++)
+    {
+      app_nvs_get_network(&cursor, &networks[i]);
+    }
+    if (!cursor.ok)
+    {
+      APP_LOGW(TAG, "app_nvs_migrate_v0: Ignoring unreadable credential store");
+      memset(networks, 0x00, sizeof(config->networks));
+    }
+    config->legacy_keys = true;
+  }
+  else if (nvs_get_blob(handle, "networks", networks, &networks_size) == ESP_OK)
+  {
+    if (networks_size != sizeof(config->networks))
+    {
+      memset(networks, 0x00, sizeof(config->networks));
     }
+    config->legacy_keys = true;
+  }
+  else if (nvs_get_blob(handle, "ssid", networks[0].ssid, &ssid_size) == ESP_OK &&
+           nvs_get_blob(handle, "password", networks[0].password, &password_size) == ESP_OK)
+  {
+    networks[0].last_success = 1;
+    config->legacy_keys = true;
+  }
 
-    nvs_close(handle);
-    ESP_LOGI(TAG, "app_nvs_save_sta_creds: Successfully saved station mode WiFi credentials: SSID: %s, Password: %s to NVS", 
-             wifi_sta_config->sta.ssid, wifi_sta_config->sta.password);
-    
-    return ESP_OK;
+  size = sizeof(app_nvs_fast_connect_t);
+  if (nvs_get_blob(handle, "fastconn", &config->fast_connect, &size) == ESP_OK)
+  {
+    config->fast_connect_valid = size == sizeof(app_nvs_fast_connect_t) && config->fast_connect.channel != 0;
+    config->legacy_keys = true;
+  }
+
+  if (networks[0].ssid[0] == '\0')
+  {
+    memset(networks, 0x00, sizeof(config->networks));
   }
   else
   {
-    ESP_LOGW(TAG, "app_nvs_save_sta_creds: No WiFi station configuration found to save");
-    return ESP_FAIL;
+    APP_LOGD(TAG, "app_nvs_migrate_v0: Migrated saved credentials, most recent SSID: %.32s", networks[0].ssid);
   }
 }
 
-bool app_nvs_load_sta_creds(void)
+/**
+ * Erases a key, a key that does not exist is not an error.
+ */
+static esp_err_t app_nvs_erase_key(nvs_handle handle, const char *key)
+{
+  esp_err_t esp_err = nvs_erase_key(handle, key);
+
+  return (esp_err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : esp_err;
+}
+
+/**
+ * Marks the cache dirty and starts the commit timer unless a commit is already scheduled.
+ * Called with app_nvs_mutex held.
+ */
+static void app_nvs_mark_dirty(void)
+{
+  app_nvs_config.dirty = true;
+
+  if (app_nvs_commit_timer != NULL && !esp_timer_is_active(app_nvs_commit_timer))
+  {
+    esp_timer_start_once(app_nvs_commit_timer, APP_NVS_COMMIT_DELAY_MS * 1000ULL);
+  }
+}
+
+/**
+ * Commit timer callback, runs in the esp_timer task. The write is handed to the WiFi task so the flash
+ * erase and write do not hold up the other timer callbacks.
+ */
+static void app_nvs_commit_timer_callback(void *arg)
+{
+  if (wifi_app_send_message(WIFI_APP_MSG_NVS_COMMIT) != pdTRUE)
+  {
+    // The WiFi task queue is full, try again after another delay
+    esp_timer_start_once(app_nvs_commit_timer, APP_NVS_COMMIT_DELAY_MS * 1000ULL);
+  }
+}
+
+esp_err_t app_nvs_init(void)
 {
   nvs_handle handle;
   esp_err_t esp_err;
-  ESP_LOGI(TAG, "app_nvs_load_sta_creds: Loading station mode WiFi credentials from NVS");
+  size_t size = sizeof(app_nvs_record);
+  int version = 0;
+  const esp_timer_create_args_t commit_timer_args = {
+      .callback = &app_nvs_commit_timer_callback,
+      .arg = NULL,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "app_nvs_commit",
+  };
 
-  if(nvs_open(app_nvs_sta_creds_namespace, NVS_READONLY, &handle) == ESP_OK)
+  if (app_nvs_mutex != NULL)
   {
-    wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
-    if (wifi_sta_config == NULL) {
-       wifi_sta_config = (wifi_config_t *)malloc(sizeof(wifi_config_t));
-    }
-    memset(wifi_sta_config, 0x00, sizeof(wifi_config_t));
+    return ESP_OK;
+  }
 
-    // Allocate buffers for SSID and password
-    size_t wifi_config_size = sizeof(wifi_config_t);
-    uint8_t *wifi_config_buff = (uint8_t *)malloc(sizeof(uint8_t) * wifi_config_size);
-    memset(wifi_config_buff, 0x00, wifi_config_size);
+  app_nvs_mutex = xSemaphoreCreateMutex();
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_NO_MEM;
+  }
 
-    // Load SSID
-    wifi_config_size = sizeof(wifi_sta_config->sta.ssid);
-    esp_err = nvs_get_blob(handle, "ssid", wifi_config_buff, &wifi_config_size);
-    if (esp_err != ESP_OK) {
-      free(wifi_config_buff);
-      ESP_LOGI(TAG, "app_nvs_load_sta_creds: No SSID found in NVS, error: %s", esp_err_to_name(esp_err));
-      nvs_close(handle);
-      return false;
-    }
-    memcpy(wifi_sta_config->sta.ssid, wifi_config_buff, wifi_config_size);
+  app_nvs_set_defaults(&app_nvs_config);
 
-    // Load password
-    wifi_config_size = sizeof(wifi_sta_config->sta.password);
-    esp_err = nvs_get_blob(handle, "password", wifi_config_buff, &wifi_config_size);
-    if (esp_err != ESP_OK) {
-      free(wifi_config_buff);
-      ESP_LOGI(TAG, "app_nvs_load_sta_creds: No password found in NVS, error: %s", esp_err_to_name(esp_err));
-      nvs_close(handle);
-      return false;
+  esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READONLY, &handle);
+  if (esp_err == ESP_OK)
+  {
+    esp_err = nvs_get_blob(handle, app_nvs_config_key, app_nvs_record, &size);
+    if (esp_err == ESP_OK)
+    {
+      version = app_nvs_decode_config(app_nvs_record, size, &app_nvs_config);
+      if (version < 0)
+      {
+        APP_LOGE(TAG, "app_nvs_init: Configuration record is damaged, using defaults");
+        app_nvs_set_defaults(&app_nvs_config);
+        version = APP_NVS_CONFIG_VERSION;
+      }
+      else if (version > APP_NVS_CONFIG_VERSION)
+      {
+        APP_LOGW(TAG, "app_nvs_init: Configuration record version %d is newer than %d, keeping known fields",
+                 version, APP_NVS_CONFIG_VERSION);
+        version = APP_NVS_CONFIG_VERSION;
+      }
+    }
+    else if (esp_err != ESP_ERR_NVS_NOT_FOUND)
+    {
+      APP_LOGE(TAG, "app_nvs_init: Failed to read the configuration record, error: %s", esp_err_to_name(esp_err));
+      version = APP_NVS_CONFIG_VERSION;
     }
-    memcpy(wifi_sta_config->sta.password, wifi_config_buff, wifi_config_size);
 
-    free(wifi_config_buff);
+    for (int v = version; v < APP_NVS_CONFIG_VERSION; v++)
+    {
+      APP_LOGI(TAG, "app_nvs_init: Migrating configuration from version %d to %d", v, v + 1);
+      app_nvs_migrations[v](handle, &app_nvs_config);
+    }
     nvs_close(handle);
-    ESP_LOGI(TAG, "app_nvs_load_sta_creds: Successfully loaded station mode WiFi credentials: SSID: %s, Password: %s from NVS", 
-             wifi_sta_config->sta.ssid, wifi_sta_config->sta.password);
+  }
+  else if (esp_err != ESP_ERR_NVS_NOT_FOUND)
+  {
+    APP_LOGE(TAG, "app_nvs_init: Failed to open NVS namespace %s, error: %s", app_nvs_sta_creds_namespace, esp_err_to_name(esp_err));
+    version = APP_NVS_CONFIG_VERSION;
+  }
 
-    return wifi_sta_config->sta.ssid[0] != '\0' && wifi_sta_config->sta.password[0] != '\0';
+  esp_err = esp_timer_create(&commit_timer_args, &app_nvs_commit_timer);
+  if (esp_err != ESP_OK)
+  {
+    APP_LOGE(TAG, "app_nvs_init: Failed to create the commit timer, error: %s", esp_err_to_name(esp_err));
+    return esp_err;
   }
-  else
+
+  // Write migrated records in the background, a device without any record keeps running on defaults
+  if (version != APP_NVS_CONFIG_VERSION && (app_nvs_config.legacy_keys || version > 0))
   {
-    ESP_LOGW(TAG, "app_nvs_load_sta_creds: No WiFi station configuration found to load");
-    return false;
+    app_nvs_mark_dirty();
   }
+
+  return ESP_OK;
 }
 
-esp_err_t app_nvs_clear_sta_creds(void)
+/**
+ * Writes the cache to NVS with a single commit if it is dirty. Called with app_nvs_mutex held.
+ */
+static esp_err_t app_nvs_write(void)
 {
   nvs_handle handle;
   esp_err_t esp_err;
-  ESP_LOGI(TAG, "app_nvs_clear_sta_creds: Clearing station mode WiFi credentials from NVS");
+  size_t size;
+
+  if (!app_nvs_config.dirty)
+  {
+    return ESP_OK;
+  }
+
+  size = app_nvs_encode_config(&app_nvs_config, app_nvs_record, sizeof(app_nvs_record));
+  if (size == 0)
+  {
+    APP_LOGE(TAG, "app_nvs_flush: Configuration record does not fit in %u bytes", (unsigned)sizeof(app_nvs_record));
+    return ESP_ERR_INVALID_SIZE;
+  }
 
   esp_err = nvs_open(app_nvs_sta_creds_namespace, NVS_READWRITE, &handle);
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "app_nvs_clear_sta_creds: Failed to open NVS namespace %s, error: %s", app_nvs_sta_creds_namespace, esp_err_to_name(esp_err));
+  if (esp_err != ESP_OK)
+  {
+    APP_LOGE(TAG, "app_nvs_flush: Failed to open NVS namespace %s, error: %s", app_nvs_sta_creds_namespace, esp_err_to_name(esp_err));
     return esp_err;
   }
 
-  esp_err = nvs_erase_all(handle);
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "app_nvs_clear_sta_creds: Failed to erase NVS namespace %s, error: %s", app_nvs_sta_creds_namespace, esp_err_to_name(esp_err));
-    nvs_close(handle);
-    return esp_err;
+  esp_err = nvs_set_blob(handle, app_nvs_config_key, app_nvs_record, size);
+
+  if (esp_err == ESP_OK && app_nvs_config.legacy_keys)
+  {
+    app_nvs_erase_key(handle, "nets");
+    app_nvs_erase_key(handle, "networks");
+    app_nvs_erase_key(handle, "ssid");
+    app_nvs_erase_key(handle, "password");
+    app_nvs_erase_key(handle, "fastconn");
   }
 
-  esp_err = nvs_commit(handle);
-  if (esp_err != ESP_OK) {
-    ESP_LOGE(TAG, "app_nvs_clear_sta_creds: Failed to commit changes to NVS, error: %s", esp_err_to_name(esp_err));
+  if (esp_err == ESP_OK)
+  {
+    esp_err = nvs_commit(handle);
   }
 
   nvs_close(handle);
-  ESP_LOGI(TAG, "app_nvs_clear_sta_creds: Successfully cleared station mode WiFi credentials from NVS");
-  
+
+  if (esp_err == ESP_OK)
+  {
+    app_nvs_config.dirty = false;
+    app_nvs_config.legacy_keys = false;
+    APP_LOGI(TAG, "app_nvs_flush: Committed %u byte configuration record", (unsigned)size);
+  }
+  else
+  {
+    // Keep the cache dirty, the next change schedules another attempt
+    APP_LOGE(TAG, "app_nvs_flush: Failed to write the configuration record, error: %s", esp_err_to_name(esp_err));
+  }
+
+  return esp_err;
+}
+
+esp_err_t app_nvs_flush(void)
+{
+  esp_err_t esp_err;
+
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  esp_err = app_nvs_write();
+  xSemaphoreGive(app_nvs_mutex);
+
+  return esp_err;
+}
+
+void app_nvs_get_settings(app_nvs_settings_t *settings)
+{
+  if (app_nvs_mutex == NULL)
+  {
+    app_nvs_config_t defaults;
+
+    app_nvs_set_defaults(&defaults);
+    *settings = defaults.settings;
+    return;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  *settings = app_nvs_config.settings;
+  xSemaphoreGive(app_nvs_mutex);
+}
+
+/**
+ * Checks a string setting is NUL terminated within its buffer.
+ */
+static bool app_nvs_str_valid(const char *str, size_t size)
+{
+  return memchr(str, '\0', size) != NULL;
+}
+
+esp_err_t app_nvs_save_config(const app_nvs_settings_t *settings, app_nvs_merge_networks_t merge, void *arg)
+{
+  esp_err_t esp_err;
+
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  if (!app_nvs_str_valid(settings->mqtt_endpoint, sizeof(settings->mqtt_endpoint)) ||
+      !app_nvs_str_valid(settings->mqtt_client_id, sizeof(settings->mqtt_client_id)) ||
+      !app_nvs_str_valid(settings->timezone, sizeof(settings->timezone)) ||
+      settings->mqtt_port == 0 ||
+      settings->sensor_period_ms < APP_NVS_MIN_SENSOR_PERIOD_MS || settings->sensor_period_ms > APP_NVS_MAX_PERIOD_MS ||
+      settings->time_sync_period_ms < APP_NVS_MIN_TIME_SYNC_PERIOD_MS || settings->time_sync_period_ms > APP_NVS_MAX_PERIOD_MS)
+  {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+  {
+    if (settings->sensors[i].type > APP_NVS_SENSOR_SI7021)
+    {
+      return ESP_ERR_INVALID_ARG;
+    }
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+
+  // The store is rebuilt from its current content, so a network saved meanwhile is not lost
+  app_nvs_previous = app_nvs_config;
+  app_nvs_config.settings = *settings;
+  if (merge != NULL)
+  {
+    merge(app_nvs_config.networks, arg);
+  }
+  app_nvs_config.dirty = true;
+
+  esp_err = app_nvs_write();
+  if (esp_err != ESP_OK)
+  {
+    // Changes pending before the update stay dirty, the update itself is dropped
+    app_nvs_config = app_nvs_previous;
+  }
+
+  xSemaphoreGive(app_nvs_mutex);
+
+  if (esp_err == ESP_OK)
+  {
+    APP_LOGI(TAG, "app_nvs_save_config: Configuration saved%s", (merge != NULL) ? " with credential store" : "");
+  }
+
+  return esp_err;
+}
+
+esp_err_t app_nvs_save_sta_creds(void)
+{
+  app_nvs_network_t *networks = app_nvs_config.networks;
+  uint32_t last_success = 0;
+  int slot = -1;
+  int most_recent = -1;
+
+  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+
+  if (wifi_sta_config == NULL || wifi_sta_config->sta.ssid[0] == '\0')
+  {
+    APP_LOGW(TAG, "app_nvs_save_sta_creds: No WiFi station configuration found to save");
+    return ESP_FAIL;
+  }
+
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+
+  for (int i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+  {
+    if (networks[i].last_success > last_success)
+    {
+      last_success = networks[i].last_success;
+      most_recent = i;
+    }
+    if (slot < 0 && memcmp(networks[i].ssid, wifi_sta_config->sta.ssid, MAX_SSID_LENGTH) == 0)
+    {
+      slot = i;
+    }
+  }
+
+  if (slot >= 0 && slot == most_recent &&
+      memcmp(networks[slot].password, wifi_sta_config->sta.password, MAX_PASSWORD_LENGTH) == 0)
+  {
+    // Already the most recent network, nothing to write
+    xSemaphoreGive(app_nvs_mutex);
+    return ESP_OK;
+  }
+
+  if (slot < 0)
+  {
+    // Take a free slot, otherwise evict the lowest priority, least recently successful network
+    for (int i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+    {
+      if (networks[i].ssid[0] == '\0')
+      {
+        slot = i;
+        break;
+      }
+      if (slot < 0 || networks[i].priority < networks[slot].priority ||
+          (networks[i].priority == networks[slot].priority && networks[i].last_success < networks[slot].last_success))
+      {
+        slot = i;
+      }
+    }
+
+    if (networks[slot].ssid[0] != '\0')
+    {
+      APP_LOGD(TAG, "app_nvs_save_sta_creds: Credential store full, replacing SSID: %.32s", networks[slot].ssid);
+    }
+    memset(&networks[slot], 0x00, sizeof(app_nvs_network_t));
+    memcpy(networks[slot].ssid, wifi_sta_config->sta.ssid, MAX_SSID_LENGTH);
+  }
+
+  memcpy(networks[slot].password, wifi_sta_config->sta.password, MAX_PASSWORD_LENGTH);
+  networks[slot].last_success = last_success + 1;
+  app_nvs_mark_dirty();
+
+  xSemaphoreGive(app_nvs_mutex);
+
+  APP_LOGD(TAG, "app_nvs_save_sta_creds: Saved station mode WiFi credentials: SSID: %.32s to slot %d",
+           wifi_sta_config->sta.ssid, slot);
+
   return ESP_OK;
-}
\ No newline at end of file
+}
+
+bool app_nvs_load_sta_creds(void)
+{
+  app_nvs_network_t network;
+  int most_recent = -1;
+
+  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+
+  if (wifi_sta_config == NULL || app_nvs_mutex == NULL)
+  {
+    APP_LOGW(TAG, "app_nvs_load_sta_creds: No WiFi station configuration found to load");
+    return false;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+
+  // Prefer the network that connected most recently, otherwise the first used slot
+  for (int i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+  {
+    if (app_nvs_config.networks[i].ssid[0] != '\0' &&
+        (most_recent < 0 || app_nvs_config.networks[i].last_success > app_nvs_config.networks[most_recent].last_success))
+    {
+      most_recent = i;
+    }
+  }
+  if (most_recent >= 0)
+  {
+    network = app_nvs_config.networks[most_recent];
+  }
+
+  xSemaphoreGive(app_nvs_mutex);
+
+  if (most_recent < 0)
+  {
+    APP_LOGI(TAG, "app_nvs_load_sta_creds: No saved networks found");
+    return false;
+  }
+
+  memset(wifi_sta_config, 0x00, sizeof(wifi_config_t));
+  memcpy(wifi_sta_config->sta.ssid, network.ssid, MAX_SSID_LENGTH);
+  memcpy(wifi_sta_config->sta.password, network.password, MAX_PASSWORD_LENGTH);
+  APP_LOGD(TAG, "app_nvs_load_sta_creds: Loaded station mode WiFi credentials: SSID: %.32s",
+           wifi_sta_config->sta.ssid);
+
+  return true;
+}
+
+size_t app_nvs_load_networks(app_nvs_network_t *networks)
+{
+  size_t count = 0;
+
+  if (app_nvs_mutex == NULL)
+  {
+    memset(networks, 0x00, sizeof(app_nvs_network_t) * APP_NVS_MAX_NETWORKS);
+    return 0;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  memcpy(networks, app_nvs_config.networks, sizeof(app_nvs_config.networks));
+  xSemaphoreGive(app_nvs_mutex);
+
+  for (size_t i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+  {
+    if (networks[i].ssid[0] != '\0')
+    {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+esp_err_t app_nvs_clear_sta_creds(void)
+{
+  APP_LOGI(TAG, "app_nvs_clear_sta_creds: Clearing station mode WiFi credentials");
+
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  memset(app_nvs_config.networks, 0x00, sizeof(app_nvs_config.networks));
+  app_nvs_config.fast_connect_valid = false;
+  app_nvs_mark_dirty();
+  xSemaphoreGive(app_nvs_mutex);
+
+  return ESP_OK;
+}
+
+esp_err_t app_nvs_save_fast_connect(const app_nvs_fast_connect_t *fast_connect)
+{
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  if (!app_nvs_config.fast_connect_valid ||
+      memcmp(&app_nvs_config.fast_connect, fast_connect, sizeof(app_nvs_fast_connect_t)) != 0)
+  {
+    APP_LOGD(TAG, "app_nvs_save_fast_connect: Saving BSSID " MACSTR " on channel %d",
+             MAC2STR(fast_connect->bssid), fast_connect->channel);
+    app_nvs_config.fast_connect = *fast_connect;
+    app_nvs_config.fast_connect_valid = true;
+    app_nvs_mark_dirty();
+  }
+  xSemaphoreGive(app_nvs_mutex);
+
+  return ESP_OK;
+}
+
+bool app_nvs_load_fast_connect(app_nvs_fast_connect_t *fast_connect)
+{
+  bool valid = false;
+
+  if (app_nvs_mutex == NULL)
+  {
+    return false;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  if (app_nvs_config.fast_connect_valid)
+  {
+    *fast_connect = app_nvs_config.fast_connect;
+    valid = true;
+  }
+  xSemaphoreGive(app_nvs_mutex);
+
+  if (!valid)
+  {
+    APP_LOGI(TAG, "app_nvs_load_fast_connect: No fast connect details found");
+    return false;
+  }
+
+  APP_LOGD(TAG, "app_nvs_load_fast_connect: Loaded BSSID " MACSTR " on channel %d",
+           MAC2STR(fast_connect->bssid), fast_connect->channel);
+  return true;
+}
+
+esp_err_t app_nvs_clear_fast_connect(void)
+{
+  if (app_nvs_mutex == NULL)
+  {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  xSemaphoreTake(app_nvs_mutex, portMAX_DELAY);
+  if (app_nvs_config.fast_connect_valid)
+  {
+    APP_LOGI(TAG, "app_nvs_clear_fast_connect: Clearing fast connect details");
+    app_nvs_config.fast_connect_valid = false;
+    app_nvs_mark_dirty();
+  }
+  xSemaphoreGive(app_nvs_mutex);
+
+  return ESP_OK;
+}
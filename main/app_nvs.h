@@ -2,24 +2,174 @@
 #define MAIN_APP_NVS_H_
 
 #include <esp_err.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of networks held by the station credential store
+#define APP_NVS_MAX_NETWORKS           4
+
+// Changes are written to flash with a single commit this long after the first one
+#define APP_NVS_COMMIT_DELAY_MS        2000
+
+// Schema version of the configuration record, bump it and add a migration when the layout changes
+#define APP_NVS_CONFIG_VERSION         1
+
+// Sizes of the string settings, including the terminator
+#define APP_NVS_MQTT_ENDPOINT_SIZE     128
+#define APP_NVS_MQTT_CLIENT_ID_SIZE    64
+#define APP_NVS_TIMEZONE_SIZE          32
+
+// Number of entries in the sensor table
+#define APP_NVS_MAX_SENSORS            4
+
+// Sampling periods accepted by app_nvs_save_config(), the DHT sensors need 2 s between reads
+#define APP_NVS_MIN_SENSOR_PERIOD_MS   2000
+#define APP_NVS_MIN_TIME_SYNC_PERIOD_MS 1000
+#define APP_NVS_MAX_PERIOD_MS          86400000
+
+/**
+ * A known network in the station credential store, a slot is free when ssid[0] is zero.
+ */
+typedef struct app_nvs_network
+{
+  uint8_t ssid[32];
+  uint8_t password[64];
+  uint8_t priority;         // Added to the RSSI (in units of WIFI_APP_PRIORITY_RSSI_BONUS) when ranking scan results
+  uint8_t reserved[3];
+  uint32_t last_success;    // Sequence number of the last successful connection, 0 if never connected
+} app_nvs_network_t;
+
+/**
+ * Access point details of the last successful station connection, used to skip the channel scan on boot.
+ */
+typedef struct app_nvs_fast_connect
+{
+  uint8_t bssid[6];
+  uint8_t channel;
+} app_nvs_fast_connect_t;
+
+/**
+ * Sensor models of the sensor table.
+ */
+typedef enum app_nvs_sensor_type
+{
+  APP_NVS_SENSOR_NONE = 0,      // Unused entry
+  APP_NVS_SENSOR_DHT11,
+  APP_NVS_SENSOR_AM2301,
+  APP_NVS_SENSOR_SI7021,
+} app_nvs_sensor_type_e;
 
 /**
- * Saves station mode WiFi credentials to NVS.
+ * An entry of the sensor table.
+ */
+typedef struct app_nvs_sensor
+{
+  uint8_t type;             // app_nvs_sensor_type_e
+  uint8_t gpio;
+} app_nvs_sensor_t;
+
+/**
+ * Device settings held by the configuration record next to the credential store.
+ * Empty strings select the firmware defaults.
+ */
+typedef struct app_nvs_settings
+{
+  char mqtt_endpoint[APP_NVS_MQTT_ENDPOINT_SIZE];
+  uint16_t mqtt_port;
+  char mqtt_client_id[APP_NVS_MQTT_CLIENT_ID_SIZE];
+  char timezone[APP_NVS_TIMEZONE_SIZE];       // POSIX TZ string
+  app_nvs_sensor_t sensors[APP_NVS_MAX_SENSORS];
+  uint32_t sensor_period_ms;
+  uint32_t time_sync_period_ms;
+} app_nvs_settings_t;
+
+/**
+ * Loads the configuration record into the RAM cache with a single NVS read and creates the commit timer.
+ * Records of older schema versions, and the separate keys written before the record existed,
+ * are migrated to APP_NVS_CONFIG_VERSION and written back.
+ * Must be called once after nvs_flash_init() and before any other app_nvs function.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t app_nvs_init(void);
+
+/**
+ * Writes the pending changes to NVS now, e.g. before a restart.
+ * @return ESP_OK on success or if nothing was pending, or an error code on failure.
+ */
+esp_err_t app_nvs_flush(void);
+
+/**
+ * Saves the station mode WiFi credentials of the current configuration to the credential store
+ * and marks them as the last successful network. Evicts the lowest priority, least recently
+ * successful network when the store is full. Nothing is written if the network is already
+ * the most recent one with the same password. Written to NVS by the next commit.
  * @return ESP_OK on success, or an error code on failure.
  */
 esp_err_t app_nvs_save_sta_creds(void);
 
 /**
- * Loads the previously saved station mode WiFi credentials from NVS.
+ * Loads the credentials of the most recently successful network into the station configuration.
+ * Credentials saved by older firmware as single ssid/password blobs are migrated to the store.
  * @return true if previously saved credentials were found, false otherwise.
  */
 bool app_nvs_load_sta_creds(void);
 
 /**
- * Clears the saved station mode WiFi credentials from NVS.
+ * Clears all saved station mode WiFi credentials and the fast connect details.
  * @return ESP_OK on success, or an error code on failure.
  */
 esp_err_t app_nvs_clear_sta_creds(void);
 
+/**
+ * Loads the station credential store.
+ * @param networks receives APP_NVS_MAX_NETWORKS entries, unused slots are zeroed.
+ * @return the number of used slots.
+ */
+size_t app_nvs_load_networks(app_nvs_network_t *networks);
+
+/**
+ * Copies the device settings out of the cache.
+ * @param settings receives the settings.
+ */
+void app_nvs_get_settings(app_nvs_settings_t *settings);
+
+/**
+ * Rebuilds the credential store for app_nvs_save_config(), called with the app_nvs lock held.
+ * @param networks APP_NVS_MAX_NETWORKS entries holding the current store, receives the new one.
+ * @param arg argument given to app_nvs_save_config().
+ */
+typedef void (*app_nvs_merge_networks_t)(app_nvs_network_t *networks, void *arg);
+
+/**
+ * Replaces the device settings and optionally rebuilds the credential store, and writes them to
+ * NVS before returning. Either everything is applied and on flash or the cache is left as it was.
+ * @param settings new settings.
+ * @param merge rebuilds the credential store from its current content, NULL to keep it.
+ * @param arg passed to merge.
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if a value is out of range, or the NVS error.
+ */
+esp_err_t app_nvs_save_config(const app_nvs_settings_t *settings, app_nvs_merge_networks_t merge, void *arg);
+
+/**
+ * Saves the access point details of the current connection, written to NVS by the next commit.
+ * @param fast_connect BSSID and channel to save.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t app_nvs_save_fast_connect(const app_nvs_fast_connect_t *fast_connect);
+
+/**
+ * Loads the access point details saved by app_nvs_save_fast_connect().
+ * @param fast_connect receives the BSSID and channel.
+ * @return true if previously saved details were found, false otherwise.
+ */
+bool app_nvs_load_fast_connect(app_nvs_fast_connect_t *fast_connect);
+
+/**
+ * Clears the saved access point details, the next connection performs a full scan.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t app_nvs_clear_fast_connect(void);
+
 
 #endif /* MAIN_APP_NVS_H_ */
\ No newline at end of file
@@ -1,41 +1,169 @@
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
+#include <sys/param.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "app_log.h"
+#include "app_nvs.h"
 #include "aws_iot.h"
+#include "aws_shadow.h"
+#include "aws_telemetry.h"
 #include "core_mqtt.h"
-#include "esp_log.h"
 #include "esp_err.h"
 #include "esp_timer.h"
+#include "tasks_common.h"
+#include "trace.h"
 
 static const char *TAG = "AWS_IOT";
 
+// Network context of the MQTT transport, owned here so its statistics can be queried
+static NetworkContext_t network_context;
+
+// Broker settings of the configuration record, referenced by the network context and the connect packet
+static app_nvs_settings_t settings;
+
+// Device credentials embedded by main/CMakeLists.txt, NUL terminated as mbedTLS expects for PEM
+extern const char aws_root_ca_pem_start[] asm("_binary_aws_root_ca_pem_start");
+extern const char aws_root_ca_pem_end[] asm("_binary_aws_root_ca_pem_end");
+extern const char certificate_pem_crt_start[] asm("_binary_certificate_pem_crt_start");
+extern const char certificate_pem_crt_end[] asm("_binary_certificate_pem_crt_end");
+extern const char private_pem_key_start[] asm("_binary_private_pem_key_start");
+extern const char private_pem_key_end[] asm("_binary_private_pem_key_end");
+
+// Used to report the boot to first publish latency once
+static bool first_publish_done = false;
+
+/**
+ * Route of a subscribed topic filter to its handler.
+ */
+typedef struct aws_iot_subscription
+{
+    const char *topicFilter;
+    uint16_t topicFilterLength;
+    aws_iot_publish_handler_t handler;
+} aws_iot_subscription_t;
+
+// Routes of the current session, cleared when it ends
+static aws_iot_subscription_t subscriptions[AWS_IOT_MAX_SUBSCRIPTIONS];
+static size_t subscription_count = 0;
+
+// Task owning the MQTT session
+static TaskHandle_t task_handle = NULL;
+
+/**
+ * Ping interval learning. Pings are only sent on idle connections, so each PINGRESP shows that
+ * the path kept the connection through ping_idle_ms of silence. After AWS_IOT_PING_PROBES of them
+ * the interval is stretched, up to ping_bound_s. A ping lost after such an idle period means a NAT
+ * on the path times out sooner: the bound is lowered between the last good interval and this one.
+ */
+static uint16_t ping_interval_s = AWS_IOT_PING_INTERVAL_INITIAL_S;
+static uint16_t ping_good_s = AWS_IOT_PING_INTERVAL_MIN_S;
+static uint16_t ping_bound_s = AWS_IOT_KEEP_ALIVE_SECONDS;
+static uint8_t ping_survived = 0;
+static uint32_t ping_idle_ms = 0;
+
 static uint32_t get_time_ms(void)
 {
     return (uint32_t)(esp_timer_get_time() / 1000);
 }
 
+/**
+ * MQTT event callback, routes incoming publishes to the handler of the first matching topic filter.
+ * Acknowledgements need no handling, QoS 0 is used throughout.
+ */
+static void aws_iot_event_callback(MQTTContext_t *mqttContext,
+                                   MQTTPacketInfo_t *packetInfo,
+                                   MQTTDeserializedInfo_t *deserializedInfo)
+{
+    const MQTTPublishInfo_t *publishInfo = deserializedInfo->pPublishInfo;
+
+    if ((packetInfo->type & 0xF0U) != MQTT_PACKET_TYPE_PUBLISH)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < subscription_count; i++)
+    {
+        bool match = false;
+
+        MQTT_MatchTopic(publishInfo->pTopicName, publishInfo->topicNameLength,
+                        subscriptions[i].topicFilter, subscriptions[i].topicFilterLength, &match);
+        if (match)
+        {
+            if (subscriptions[i].handler != NULL)
+            {
+                subscriptions[i].handler(mqttContext, publishInfo);
+            }
+            return;
+        }
+    }
+
+    APP_LOGW(TAG, "Dropped a publish on %s", APP_LOG_STRN(publishInfo->pTopicName, publishInfo->topicNameLength));
+}
+
 esp_err_t aws_iot_mqtt_connect(MQTTContext_t *mqttContext,
                                TransportInterface_t *transport,
                                MQTTFixedBuffer_t *networkBuffer)
 {
     MQTTStatus_t mqttStatus;
 
+    if (network_context.xTlsContextSemaphore == NULL)
+    {
+        network_context.xTlsContextSemaphore = xSemaphoreCreateMutex();
+    }
+
+    app_nvs_get_settings(&settings);
+    if (settings.mqtt_endpoint[0] == '\0')
+    {
+        APP_LOGE(TAG, "No MQTT endpoint configured");
+        return ESP_FAIL;
+    }
+    if (settings.mqtt_client_id[0] == '\0')
+    {
+        strcpy(settings.mqtt_client_id, AWS_IOT_CLIENT_IDENTIFIER);
+    }
+
+    network_context.pcHostname = settings.mqtt_endpoint;
+    network_context.xPort = settings.mqtt_port;
+    network_context.pcServerRootCA = aws_root_ca_pem_start;
+    network_context.pcServerRootCASize = aws_root_ca_pem_end - aws_root_ca_pem_start;
+    network_context.pcClientCert = certificate_pem_crt_start;
+    network_context.pcClientCertSize = certificate_pem_crt_end - certificate_pem_crt_start;
+    network_context.pcClientKey = private_pem_key_start;
+    network_context.pcClientKeySize = private_pem_key_end - private_pem_key_start;
+
+    // Offers the session saved by the last disconnect, if any
+    if (xTlsConnect(&network_context) != TLS_TRANSPORT_SUCCESS)
+    {
+        APP_LOGE(TAG, "TLS connect to %s:%u failed", settings.mqtt_endpoint, settings.mqtt_port);
+        return ESP_FAIL;
+    }
+
+    transport->pNetworkContext = &network_context;
+    transport->send = espTlsTransportSend;
+    transport->recv = espTlsTransportRecv;
+    transport->writev = NULL;
+
     MQTTStatus_t status = MQTT_Init(mqttContext,
                                     transport,
                                     get_time_ms,
-                                    NULL,
+                                    aws_iot_event_callback,
                                     networkBuffer);
 
     if (status != MQTTSuccess)
     {
-        ESP_LOGE(TAG, "MQTT_Init failed: %d", status);
+        APP_LOGE(TAG, "MQTT_Init failed: %d", status);
         return ESP_FAIL;
     }
 
     MQTTConnectInfo_t connectParams = {
         .cleanSession = true,
-        .keepAliveSeconds = 60,
-        .pClientIdentifier = AWS_IOT_CLIENT_IDENTIFIER,
-        .clientIdentifierLength = strlen(AWS_IOT_CLIENT_IDENTIFIER),
+        .keepAliveSeconds = AWS_IOT_KEEP_ALIVE_SECONDS,
+        .pClientIdentifier = settings.mqtt_client_id,
+        .clientIdentifierLength = strlen(settings.mqtt_client_id),
     };
 
     bool sessionPresent;
@@ -47,58 +175,388 @@ esp_err_t aws_iot_mqtt_connect(MQTTContext_t *mqttContext,
 
     if (mqttStatus != MQTTSuccess)
     {
-        ESP_LOGE(TAG, "MQTT_Connect failed: %d", mqttStatus);
+        APP_LOGE(TAG, "MQTT_Connect failed: %d", mqttStatus);
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "MQTT connected to broker!");
+    // Only idle connections are pinged, at the interval learned so far
+    MQTT_SetPingInterval(mqttContext, (uint32_t)ping_interval_s * 1000);
+
+    APP_LOGI(TAG, "MQTT connected to broker, ping interval %u s", ping_interval_s);
     return ESP_OK;
 }
 
-esp_err_t aws_iot_mqtt_publish(MQTTContext_t *mqttContext,
-                               const char *message)
+/**
+ * Logs the outcome of a publish.
+ * @param status status returned by the MQTT library.
+ * @param message payload of the publish, NULL if it is not text.
+ * @return ESP_OK if the publish was sent, ESP_FAIL otherwise.
+ */
+static esp_err_t publish_result(MQTTStatus_t status, const char *message)
+{
+    trace_record(TRACE_EVENT_MQTT_PUBLISH_END, status, 0);
+
+    if (status != MQTTSuccess)
+    {
+        APP_LOGE(TAG, "MQTT_Publish failed: %d", status);
+        return ESP_FAIL;
+    }
+
+    if (message != NULL)
+    {
+        APP_LOGI(TAG, "Published: %s", message);
+    }
+
+    if (!first_publish_done)
+    {
+        first_publish_done = true;
+        APP_LOGI(TAG, "First publish %lld ms after boot", (long long)(esp_timer_get_time() / 1000));
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t aws_iot_mqtt_publish_topic(MQTTContext_t *mqttContext,
+                                     const char *topic,
+                                     uint16_t topicLength,
+                                     const char *message)
 {
     MQTTPublishInfo_t publishInfo = {
         .qos = MQTTQoS0,
         .retain = false,
         .dup = false,
-        .pTopicName = AWS_IOT_TOPIC,
-        .topicNameLength = AWS_IOT_TOPIC_LENGTH,
+        .pTopicName = topic,
+        .topicNameLength = topicLength,
         .pPayload = message,
         .payloadLength = strlen(message),
     };
 
-    MQTTStatus_t status = MQTT_Publish(mqttContext,
-                                       &publishInfo,
-                                       0);
+    trace_record(TRACE_EVENT_MQTT_PUBLISH_BEGIN, publishInfo.payloadLength, 0);
+    return publish_result(MQTT_Publish(mqttContext, &publishInfo, 0), message);
+}
+
+esp_err_t aws_iot_mqtt_prepare_publish(const char *topic,
+                                       uint16_t topicLength,
+                                       uint8_t *header,
+                                       size_t headerSize,
+                                       MQTTPreparedPublish_t *prepared)
+{
+    MQTTPublishInfo_t publishInfo = {
+        .qos = MQTTQoS0,
+        .pTopicName = topic,
+        .topicNameLength = topicLength,
+    };
+    MQTTFixedBuffer_t buffer = {
+        .pBuffer = header,
+        .size = headerSize,
+    };
+
+    MQTTStatus_t status = MQTT_PreparePublish(&publishInfo, &buffer, prepared);
     if (status != MQTTSuccess)
     {
-        ESP_LOGE(TAG, "MQTT_Publish failed: %d", status);
+        APP_LOGE(TAG, "MQTT_PreparePublish failed: %d", status);
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Published: %s", message);
     return ESP_OK;
 }
 
+esp_err_t aws_iot_mqtt_publish_prepared(MQTTContext_t *mqttContext,
+                                        const MQTTPreparedPublish_t *prepared,
+                                        const void *payload,
+                                        size_t payloadLength)
+{
+    trace_record(TRACE_EVENT_MQTT_PUBLISH_BEGIN, payloadLength, 0);
+    return publish_result(MQTT_PublishPrepared(mqttContext, prepared, payload, payloadLength, 0), NULL);
+}
+
+esp_err_t aws_iot_mqtt_publish(MQTTContext_t *mqttContext,
+                               const char *message)
+{
+    // The topic never changes, its header is serialized on the first publish only
+    static uint8_t header[MQTT_PREPARED_PUBLISH_BUFFER_SIZE(AWS_IOT_TOPIC_LENGTH)];
+    static MQTTPreparedPublish_t prepared;
+    static bool is_prepared = false;
+
+    if (!is_prepared)
+    {
+        if (aws_iot_mqtt_prepare_publish(AWS_IOT_TOPIC, AWS_IOT_TOPIC_LENGTH,
+                                         header, sizeof(header), &prepared) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+        is_prepared = true;
+    }
+
+    size_t length = strlen(message);
+
+    trace_record(TRACE_EVENT_MQTT_PUBLISH_BEGIN, length, 0);
+    return publish_result(MQTT_PublishPrepared(mqttContext, &prepared, message, length, 0), message);
+}
+
+esp_err_t aws_iot_mqtt_publish_status(MQTTContext_t *mqttContext)
+{
+    char statusJSON[AWS_IOT_TRANSPORT_STATS_JSON_SIZE];
+
+    aws_iot_transport_stats_json(statusJSON, sizeof(statusJSON));
+
+    return aws_iot_mqtt_publish_topic(mqttContext, AWS_IOT_STATUS_TOPIC, AWS_IOT_STATUS_TOPIC_LENGTH, statusJSON);
+}
+
 esp_err_t aws_iot_mqtt_subscribe(MQTTContext_t *mqttContext)
 {
+    return aws_iot_mqtt_subscribe_topic(mqttContext, AWS_IOT_TOPIC, AWS_IOT_TOPIC_LENGTH, NULL);
+}
+
+esp_err_t aws_iot_mqtt_subscribe_topic(MQTTContext_t *mqttContext,
+                                       const char *topicFilter,
+                                       uint16_t topicFilterLength,
+                                       aws_iot_publish_handler_t handler)
+{
+    if (subscription_count >= AWS_IOT_MAX_SUBSCRIPTIONS)
+    {
+        APP_LOGE(TAG, "No room to route %s", APP_LOG_STRN(topicFilter, topicFilterLength));
+        return ESP_ERR_NO_MEM;
+    }
+
     MQTTSubscribeInfo_t subscribeInfo = {
         .qos = MQTTQoS0,
-        .pTopicFilter = AWS_IOT_TOPIC,
-        .topicFilterLength = AWS_IOT_TOPIC_LENGTH,
+        .pTopicFilter = topicFilter,
+        .topicFilterLength = topicFilterLength,
     };
 
+    // Route first, a publish may arrive right behind the SUBACK
+    subscriptions[subscription_count].topicFilter = topicFilter;
+    subscriptions[subscription_count].topicFilterLength = topicFilterLength;
+    subscriptions[subscription_count].handler = handler;
+    subscription_count++;
+
     MQTTStatus_t status = MQTT_Subscribe(mqttContext,
                                          &subscribeInfo,
                                          1,
-                                         0);
+                                         MQTT_GetPacketId(mqttContext));
     if (status != MQTTSuccess)
     {
-        ESP_LOGE(TAG, "MQTT_Subscribe failed: %d", status);
+        subscription_count--;
+        APP_LOGE(TAG, "MQTT_Subscribe failed: %d", status);
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Subscribed to topic: %s", AWS_IOT_TOPIC);
+    APP_LOGI(TAG, "Subscribed to topic: %s", APP_LOG_STRN(topicFilter, topicFilterLength));
     return ESP_OK;
 }
+
+const char *aws_iot_get_client_id(void)
+{
+    return settings.mqtt_client_id;
+}
+
+uint16_t aws_iot_get_ping_interval(void)
+{
+    return ping_interval_s;
+}
+
+/**
+ * Records a PINGRESP, and stretches the ping interval once the connection survived enough idle
+ * periods of the current length.
+ * @param mqttContext connected MQTT context.
+ */
+static void ping_interval_survived(MQTTContext_t *mqttContext)
+{
+    // Pings forced by the keep alive while data was received do not prove anything
+    if (ping_idle_ms < (uint32_t)ping_interval_s * 1000)
+    {
+        return;
+    }
+
+    ping_good_s = ping_interval_s;
+    if (++ping_survived < AWS_IOT_PING_PROBES || ping_interval_s >= ping_bound_s)
+    {
+        return;
+    }
+
+    ping_survived = 0;
+    ping_interval_s = MIN(ping_interval_s + ping_interval_s / 2, ping_bound_s);
+    MQTT_SetPingInterval(mqttContext, (uint32_t)ping_interval_s * 1000);
+    APP_LOGI(TAG, "Ping interval stretched to %u s", ping_interval_s);
+}
+
+/**
+ * Shortens the ping interval when the session ended with a ping lost after an idle period.
+ * @param mqttContext MQTT context of the ended session.
+ * @param status status the receive loop ended with.
+ */
+static void ping_interval_failed(const MQTTContext_t *mqttContext, MQTTStatus_t status)
+{
+    if ((status != MQTTKeepAliveTimeout && !mqttContext->waitingForPingResp) ||
+        ping_idle_ms < (uint32_t)ping_interval_s * 1000)
+    {
+        return;
+    }
+
+    if (ping_interval_s > ping_good_s)
+    {
+        // The idle timeout lies between the last interval which worked and this one
+        ping_bound_s = ping_good_s + (ping_interval_s - ping_good_s) / 2;
+    }
+    else
+    {
+        // Even the known good interval failed, the network changed
+        ping_bound_s = ping_interval_s;
+        ping_good_s = MAX(ping_interval_s / 2, AWS_IOT_PING_INTERVAL_MIN_S);
+    }
+
+    ping_survived = 0;
+    ping_interval_s = ping_good_s;
+    APP_LOGW(TAG, "Idle connection dropped, ping interval %u s, at most %u s", ping_interval_s, ping_bound_s);
+}
+
+/**
+ * Runs one MQTT session after another: connects, announces the device, subscribes and
+ * receives until the connection fails.
+ * @param pvParam Pointer to task parameters (not used).
+ */
+static void aws_iot_task(void *pvParam)
+{
+    static uint8_t buffer[AWS_IOT_NETWORK_BUFFER_SIZE];
+    static MQTTContext_t mqttContext;
+    MQTTFixedBuffer_t networkBuffer = {
+        .pBuffer = buffer,
+        .size = sizeof(buffer),
+    };
+    TransportInterface_t transport;
+    MQTTStatus_t status;
+    size_t packetCount;
+
+    while (1)
+    {
+        subscription_count = 0;
+
+        if (aws_iot_mqtt_connect(&mqttContext, &transport, &networkBuffer) == ESP_OK &&
+            aws_telemetry_prepare() == ESP_OK &&
+            aws_iot_mqtt_publish(&mqttContext, "Hello from ESP32") == ESP_OK &&
+            aws_iot_mqtt_publish_status(&mqttContext) == ESP_OK &&
+            aws_iot_mqtt_subscribe(&mqttContext) == ESP_OK &&
+            aws_shadow_start(&mqttContext) == ESP_OK)
+        {
+            bool waitingForPingResp = false;
+            uint32_t lastTxTime;
+
+            do
+            {
+                // A PINGREQ overwrites lastPacketTxTime, keep the time of the send before it
+                lastTxTime = mqttContext.lastPacketTxTime;
+
+                // Everything one read brought in is handled before reading again
+                status = MQTT_ProcessLoopBatch(&mqttContext, &packetCount);
+                if (packetCount > 0 || (status != MQTTSuccess && status != MQTTNeedMoreBytes))
+                {
+                    trace_record(TRACE_EVENT_MQTT_RECEIVE, packetCount, status);
+                }
+
+                if (!waitingForPingResp && mqttContext.waitingForPingResp)
+                {
+                    // Silence in both directions before the ping, measured from the later of the last
+                    // receive and send. Elapsed times are unsigned differences, correct across a wrap
+                    ping_idle_ms = MIN(mqttContext.pingReqSendTimeMs - mqttContext.lastPacketRxTime,
+                                       mqttContext.pingReqSendTimeMs - lastTxTime);
+                    trace_record(TRACE_EVENT_MQTT_PING_BEGIN, ping_idle_ms, 0);
+                }
+                else if (waitingForPingResp && !mqttContext.waitingForPingResp)
+                {
+                    trace_record(TRACE_EVENT_MQTT_PING_END, 0, 0);
+                    ping_interval_survived(&mqttContext);
+                }
+                waitingForPingResp = mqttContext.waitingForPingResp;
+
+                if ((status == MQTTSuccess || status == MQTTNeedMoreBytes) &&
+                    aws_telemetry_publish(&mqttContext) != ESP_OK)
+                {
+                    status = MQTTSendFailed;
+                }
+            } while (status == MQTTSuccess || status == MQTTNeedMoreBytes);
+
+            APP_LOGW(TAG, "MQTT session ended: %s", MQTT_Status_strerror(status));
+            ping_interval_failed(&mqttContext, status);
+        }
+
+        // Frees the socket of a failed step or ended session, saving its TLS session for the next connect
+        (void)xTlsDisconnect(&network_context);
+        vTaskDelay(pdMS_TO_TICKS(AWS_IOT_RECONNECT_DELAY_MS));
+    }
+
+    vTaskDelete(NULL);
+}
+
+void aws_iot_task_start(void)
+{
+    if (task_handle == NULL)
+    {
+        xTaskCreatePinnedToCore(&aws_iot_task, "aws_iot", AWS_IOT_TASK_STACK_SIZE, NULL, AWS_IOT_TASK_PRIORITY, &task_handle, AWS_IOT_TASK_CORE_ID);
+    }
+}
+
+NetworkContext_t *aws_iot_get_network_context(void)
+{
+    return &network_context;
+}
+
+// Appends a histogram as a JSON array, returns the new write offset
+static size_t aws_iot_append_histogram(char *buf, size_t len, size_t offset,
+                                       const char *name, const uint32_t *buckets)
+{
+    offset += snprintf(buf + offset, len - offset, ", \"%s\": [", name);
+    for (size_t i = 0; i < TLS_TRANSPORT_LATENCY_BUCKETS && offset < len; i++)
+    {
+        offset += snprintf(buf + offset, len - offset, "%s%" PRIu32, (i == 0) ? "" : ", ", buckets[i]);
+    }
+    if (offset < len)
+    {
+        offset += snprintf(buf + offset, len - offset, "]");
+    }
+
+    return offset;
+}
+
+size_t aws_iot_transport_stats_json(char *buf, size_t len)
+{
+    TlsTransportStats_t stats;
+    size_t offset;
+
+    // Lock free snapshot, consistent even while a send/recv holds the transport
+    (void)xTlsGetStats(&network_context, &stats);
+
+    offset = snprintf(buf, len,
+                      "{\"bytes_sent\": %" PRIu32 ", \"bytes_received\": %" PRIu32
+                      ", \"send_calls\": %" PRIu32 ", \"recv_calls\": %" PRIu32
+                      ", \"partial_writes\": %" PRIu32 ", \"want_read\": %" PRIu32
+                      ", \"want_write\": %" PRIu32 ", \"select_timeouts\": %" PRIu32
+                      ", \"send_stalls\": %" PRIu32
+                      ", \"sem_timeouts\": %" PRIu32 ", \"sem_wait_max_us\": %" PRIu32
+                      ", \"keep_alive_s\": %u, \"ping_interval_s\": %u",
+                      stats.ulBytesSent, stats.ulBytesReceived,
+                      stats.ulSendCalls, stats.ulRecvCalls,
+                      stats.ulPartialWrites, stats.ulWantReadRetries,
+                      stats.ulWantWriteRetries, stats.ulSelectTimeouts, stats.ulSendStalls,
+                      stats.ulSemaphoreTimeouts, stats.ulMaxSemaphoreWaitUs,
+                      AWS_IOT_KEEP_ALIVE_SECONDS, ping_interval_s);
+
+    if (offset < len)
+    {
+        offset = aws_iot_append_histogram(buf, len, offset, "send_latency", stats.pulSendLatency);
+    }
+    if (offset < len)
+    {
+        offset = aws_iot_append_histogram(buf, len, offset, "recv_latency", stats.pulRecvLatency);
+    }
+    if (offset < len)
+    {
+        offset = aws_iot_append_histogram(buf, len, offset, "sem_wait", stats.pulSemaphoreWait);
+    }
+    if (offset < len)
+    {
+        offset += snprintf(buf + offset, len - offset, "}");
+    }
+
+    return (offset < len) ? offset : len - 1;
+}
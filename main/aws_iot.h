@@ -3,11 +3,45 @@
 
 #include "core_mqtt.h"
 #include "transport_interface.h"
+#include "network_transport.h"
 #include "esp_err.h"
 
 #define AWS_IOT_CLIENT_IDENTIFIER "esp32-client"
 #define AWS_IOT_TOPIC            "esp32/topic"
 #define AWS_IOT_TOPIC_LENGTH     (sizeof(AWS_IOT_TOPIC) - 1)
+#define AWS_IOT_STATUS_TOPIC     "esp32/status"
+#define AWS_IOT_STATUS_TOPIC_LENGTH (sizeof(AWS_IOT_STATUS_TOPIC) - 1)
+
+// Size of the buffer needed by aws_iot_transport_stats_json()
+#define AWS_IOT_TRANSPORT_STATS_JSON_SIZE 704
+
+// Size of the MQTT network buffer, incoming publishes are handled in place and must fit
+#define AWS_IOT_NETWORK_BUFFER_SIZE 2048
+
+// Most topic filters aws_iot_mqtt_subscribe_topic() can route to a handler
+#define AWS_IOT_MAX_SUBSCRIPTIONS 4
+
+// Wait before connecting again after the session failed
+#define AWS_IOT_RECONNECT_DELAY_MS 5000
+
+// Keep alive interval sent to the broker, the longest the ping interval can be stretched to
+#define AWS_IOT_KEEP_ALIVE_SECONDS 300
+
+// Ping interval of the first session, and the shortest one used after idle connections are dropped
+#define AWS_IOT_PING_INTERVAL_INITIAL_S 60
+#define AWS_IOT_PING_INTERVAL_MIN_S 30
+
+// Idle periods a ping interval has to survive before it is stretched by half
+#define AWS_IOT_PING_PROBES 3
+
+/**
+ * Handles a publish received on a subscribed topic filter.
+ * Topic and payload point into the network buffer and are only valid during the call.
+ * @param mqttContext MQTT context the publish was received on, may be used to publish a reply.
+ * @param publishInfo topic, payload and QoS of the publish.
+ */
+typedef void (*aws_iot_publish_handler_t)(MQTTContext_t *mqttContext,
+                                          const MQTTPublishInfo_t *publishInfo);
 
 esp_err_t aws_iot_mqtt_connect(MQTTContext_t *mqttContext,
                                TransportInterface_t *transport,
@@ -18,4 +52,97 @@ esp_err_t aws_iot_mqtt_publish(MQTTContext_t *mqttContext,
 
 esp_err_t aws_iot_mqtt_subscribe(MQTTContext_t *mqttContext);
 
+/**
+ * Publishes a message to a topic with QoS 0.
+ * @param mqttContext connected MQTT context.
+ * @param topic topic name, not NUL terminated.
+ * @param topicLength length of topic.
+ * @param message NUL terminated payload.
+ * @return ESP_OK on success, ESP_FAIL otherwise.
+ */
+esp_err_t aws_iot_mqtt_publish_topic(MQTTContext_t *mqttContext,
+                                     const char *topic,
+                                     uint16_t topicLength,
+                                     const char *message);
+
+/**
+ * Serializes the PUBLISH header of a topic once, for QoS 0 publishes with
+ * aws_iot_mqtt_publish_prepared().
+ * @param topic topic name, not NUL terminated, not copied.
+ * @param topicLength length of topic.
+ * @param header buffer of MQTT_PREPARED_PUBLISH_BUFFER_SIZE(topicLength) bytes, must outlive prepared.
+ * @param headerSize size of header.
+ * @param prepared receives the prepared header.
+ * @return ESP_OK on success, ESP_FAIL otherwise.
+ */
+esp_err_t aws_iot_mqtt_prepare_publish(const char *topic,
+                                       uint16_t topicLength,
+                                       uint8_t *header,
+                                       size_t headerSize,
+                                       MQTTPreparedPublish_t *prepared);
+
+/**
+ * Publishes a binary payload with QoS 0 using a header from aws_iot_mqtt_prepare_publish().
+ * @param mqttContext connected MQTT context.
+ * @param prepared prepared header, only used by the calling task.
+ * @param payload payload, sent as is.
+ * @param payloadLength length of payload.
+ * @return ESP_OK on success, ESP_FAIL otherwise.
+ */
+esp_err_t aws_iot_mqtt_publish_prepared(MQTTContext_t *mqttContext,
+                                        const MQTTPreparedPublish_t *prepared,
+                                        const void *payload,
+                                        size_t payloadLength);
+
+/**
+ * Subscribes to a topic filter with QoS 0 and routes the publishes it matches to a handler.
+ * Routes last until the session ends and have to be subscribed again after a reconnect.
+ * @param mqttContext connected MQTT context.
+ * @param topicFilter topic filter, not copied, must outlive the session.
+ * @param topicFilterLength length of topicFilter.
+ * @param handler called for each matching publish, NULL to drop them.
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if AWS_IOT_MAX_SUBSCRIPTIONS are in use, ESP_FAIL otherwise.
+ */
+esp_err_t aws_iot_mqtt_subscribe_topic(MQTTContext_t *mqttContext,
+                                       const char *topicFilter,
+                                       uint16_t topicFilterLength,
+                                       aws_iot_publish_handler_t handler);
+
+/**
+ * Returns the MQTT client identifier of the current session, which is also the thing name.
+ */
+const char *aws_iot_get_client_id(void);
+
+/**
+ * Starts the task which owns the MQTT session: it connects, subscribes, runs the receive loop
+ * and reconnects after a failure. Calling it again while the task runs does nothing.
+ */
+void aws_iot_task_start(void);
+
+/**
+ * Returns the idle time in seconds after which the MQTT session sends a PINGREQ. It starts at
+ * AWS_IOT_PING_INTERVAL_INITIAL_S and adapts to how long idle connections survive on the network.
+ */
+uint16_t aws_iot_get_ping_interval(void);
+
+/**
+ * Publishes the transport statistics to AWS_IOT_STATUS_TOPIC.
+ * @param mqttContext connected MQTT context.
+ * @return ESP_OK on success, ESP_FAIL otherwise.
+ */
+esp_err_t aws_iot_mqtt_publish_status(MQTTContext_t *mqttContext);
+
+/**
+ * Returns the network context used by the MQTT transport.
+ */
+NetworkContext_t *aws_iot_get_network_context(void);
+
+/**
+ * Formats the transport statistics of the MQTT connection as JSON.
+ * @param buf output buffer, AWS_IOT_TRANSPORT_STATS_JSON_SIZE bytes is enough.
+ * @param len size of buf.
+ * @return number of characters written, excluding the terminator.
+ */
+size_t aws_iot_transport_stats_json(char *buf, size_t len);
+
 #endif // MAIN_AWS_IOT_H
@@ -0,0 +1,413 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+
+#include "app_log.h"
+
+#include "app_nvs.h"
+#include "aws_iot.h"
+#include "aws_shadow.h"
+#include "core_json.h"
+
+static const char TAG[] = "aws_shadow";
+
+// Topics of the classic shadow, the thing name goes in between
+#define AWS_SHADOW_TOPIC_PREFIX        "$aws/things/"
+#define AWS_SHADOW_UPDATE_SUFFIX       "/shadow/update"
+#define AWS_SHADOW_DELTA_SUFFIX        "/shadow/update/delta"
+#define AWS_SHADOW_TOPIC_SIZE          (sizeof(AWS_SHADOW_TOPIC_PREFIX) - 1 + APP_NVS_MQTT_CLIENT_ID_SIZE + \
+                                        sizeof(AWS_SHADOW_DELTA_SUFFIX))
+
+/**
+ * Value types of a shadow field.
+ */
+typedef enum aws_shadow_field_type
+{
+    AWS_SHADOW_FIELD_UINT = 0,    // unsigned integer of 2 or 4 bytes
+    AWS_SHADOW_FIELD_STRING,      // char array, NUL terminated
+} aws_shadow_field_type_e;
+
+/**
+ * Maps a key of the shadow state to a member of app_nvs_settings_t.
+ */
+typedef struct aws_shadow_field
+{
+    const char *key;
+    uint16_t offset;
+    uint8_t size;
+    uint8_t type;                 // aws_shadow_field_type_e
+    uint32_t min;                 // Range of an unsigned integer, unused for strings
+    uint32_t max;
+} aws_shadow_field_t;
+
+// Field of the settings record, the key is the member name
+#define AWS_SHADOW_FIELD(field_type, member, min_value, max_value) \
+    { .key = #member, .offset = offsetof(app_nvs_settings_t, member), \
+      .size = sizeof(((app_nvs_settings_t *)0)->member), .type = (field_type), \
+      .min = (min_value), .max = (max_value) }
+
+// Settings in the shadow. The broker settings are left out, a wrong value pushed from the cloud
+// would cut the device off from it. The ranges are the ones app_nvs_save_config() accepts, checking
+// them per key keeps one bad value from failing the whole delta.
+static const aws_shadow_field_t aws_shadow_fields[] = {
+    AWS_SHADOW_FIELD(AWS_SHADOW_FIELD_UINT, sensor_period_ms, APP_NVS_MIN_SENSOR_PERIOD_MS, APP_NVS_MAX_PERIOD_MS),
+    AWS_SHADOW_FIELD(AWS_SHADOW_FIELD_UINT, time_sync_period_ms, APP_NVS_MIN_TIME_SYNC_PERIOD_MS, APP_NVS_MAX_PERIOD_MS),
+    AWS_SHADOW_FIELD(AWS_SHADOW_FIELD_STRING, timezone, 0, 0),
+};
+
+#define AWS_SHADOW_FIELD_COUNT         (sizeof(aws_shadow_fields) / sizeof(aws_shadow_fields[0]))
+
+// Fields are tracked in 32 bit masks
+_Static_assert(AWS_SHADOW_FIELD_COUNT <= 32, "Too many shadow fields");
+
+static char update_topic[AWS_SHADOW_TOPIC_SIZE];
+static uint16_t update_topic_length;
+static char delta_topic[AWS_SHADOW_TOPIC_SIZE];
+static uint16_t delta_topic_length;
+
+// Settings as last reported in this session, only the differences are reported
+static app_nvs_settings_t reported;
+static bool reported_valid = false;
+
+// Version of the last delta applied in this session, older deltas arriving late are ignored
+static uint32_t delta_version = 0;
+
+/**
+ * Converts a JSON number holding an unsigned integer.
+ * @return false if the value is not an integer of at most max.
+ */
+static bool aws_shadow_parse_uint(const JSONPair_t *pair, uint32_t max, uint32_t *out)
+{
+    uint32_t result = 0;
+
+    if (pair->jsonType != JSONNumber || pair->valueLength == 0)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < pair->valueLength; i++)
+    {
+        uint32_t digit = (uint32_t)(pair->value[i] - '0');
+
+        if (pair->value[i] < '0' || pair->value[i] > '9' || result > (max - digit) / 10)
+        {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+
+    *out = result;
+    return true;
+}
+
+/**
+ * Returns the index of the field of a key, or AWS_SHADOW_FIELD_COUNT if the key is not part of the shadow.
+ */
+static size_t aws_shadow_find_field(const char *key, size_t key_len)
+{
+    size_t i;
+
+    for (i = 0; i < AWS_SHADOW_FIELD_COUNT; i++)
+    {
+        if (strlen(aws_shadow_fields[i].key) == key_len && memcmp(aws_shadow_fields[i].key, key, key_len) == 0)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * Stores a desired value into its settings member.
+ * Strings with escape sequences are refused, no setting of the shadow needs them.
+ * @return false if the value has the wrong type, is out of range or does not fit.
+ */
+static bool aws_shadow_set_field(app_nvs_settings_t *settings, const aws_shadow_field_t *field, const JSONPair_t *pair)
+{
+    uint8_t *member = (uint8_t *)settings + field->offset;
+    uint32_t value;
+
+    if (field->type == AWS_SHADOW_FIELD_UINT)
+    {
+        uint32_t max = (field->size == sizeof(uint16_t)) ? MIN(field->max, UINT16_MAX) : field->max;
+
+        if (!aws_shadow_parse_uint(pair, max, &value) || value < field->min)
+        {
+            return false;
+        }
+        if (field->size == sizeof(uint16_t))
+        {
+            uint16_t value16 = (uint16_t)value;
+            memcpy(member, &value16, sizeof(value16));
+        }
+        else
+        {
+            memcpy(member, &value, sizeof(value));
+        }
+        return true;
+    }
+
+    if (pair->jsonType != JSONString || pair->valueLength >= field->size ||
+        memchr(pair->value, '\\', pair->valueLength) != NULL)
+    {
+        return false;
+    }
+    memset(member, 0x00, field->size);
+    memcpy(member, pair->value, pair->valueLength);
+
+    return true;
+}
+
+/**
+ * Compares a field of two settings records.
+ */
+static bool aws_shadow_field_equal(const app_nvs_settings_t *a, const app_nvs_settings_t *b, const aws_shadow_field_t *field)
+{
+    const char *value_a = (const char *)a + field->offset;
+    const char *value_b = (const char *)b + field->offset;
+
+    if (field->type == AWS_SHADOW_FIELD_STRING)
+    {
+        return strncmp(value_a, value_b, field->size) == 0;
+    }
+
+    return memcmp(value_a, value_b, field->size) == 0;
+}
+
+/**
+ * Appends formatted text, offset is left at size once the buffer is full.
+ */
+static void aws_shadow_printf(char *buf, size_t size, size_t *offset, const char *format, ...)
+{
+    va_list args;
+    int len;
+
+    if (*offset >= size)
+    {
+        return;
+    }
+
+    va_start(args, format);
+    len = vsnprintf(buf + *offset, size - *offset, format, args);
+    va_end(args);
+
+    *offset = (len < 0 || (size_t)len >= size - *offset) ? size : *offset + (size_t)len;
+}
+
+/**
+ * Appends a field value as JSON.
+ */
+static void aws_shadow_write_field(char *buf, size_t size, size_t *offset,
+                                   const app_nvs_settings_t *settings, const aws_shadow_field_t *field)
+{
+    const uint8_t *member = (const uint8_t *)settings + field->offset;
+
+    if (field->type == AWS_SHADOW_FIELD_UINT)
+    {
+        uint32_t value;
+
+        if (field->size == sizeof(uint16_t))
+        {
+            uint16_t value16;
+            memcpy(&value16, member, sizeof(value16));
+            value = value16;
+        }
+        else
+        {
+            memcpy(&value, member, sizeof(value));
+        }
+        aws_shadow_printf(buf, size, offset, "%lu", (unsigned long)value);
+        return;
+    }
+
+    aws_shadow_printf(buf, size, offset, "\"");
+    for (size_t i = 0; i < field->size && member[i] != '\0'; i++)
+    {
+        if (member[i] == '"' || member[i] == '\\')
+        {
+            aws_shadow_printf(buf, size, offset, "\\%c", member[i]);
+        }
+        else if (member[i] < 0x20)
+        {
+            aws_shadow_printf(buf, size, offset, "\\u%04x", member[i]);
+        }
+        else
+        {
+            aws_shadow_printf(buf, size, offset, "%c", member[i]);
+        }
+    }
+    aws_shadow_printf(buf, size, offset, "\"");
+}
+
+/**
+ * Publishes the settings which differ from the last reported state, nothing if none do.
+ * @param mqttContext connected MQTT context.
+ * @param force_mask fields reported even if unchanged, bit n for aws_shadow_fields[n].
+ * @return ESP_OK on success, or an error code on failure.
+ */
+static esp_err_t aws_shadow_report(MQTTContext_t *mqttContext, uint32_t force_mask)
+{
+    char doc[AWS_SHADOW_REPORT_SIZE];
+    app_nvs_settings_t settings;
+    size_t offset = 0;
+    size_t changed = 0;
+    esp_err_t esp_err;
+
+    app_nvs_get_settings(&settings);
+
+    aws_shadow_printf(doc, sizeof(doc), &offset, "{\"state\":{\"reported\":{");
+    for (size_t i = 0; i < AWS_SHADOW_FIELD_COUNT; i++)
+    {
+        if (reported_valid && (force_mask & (1U << i)) == 0 &&
+            aws_shadow_field_equal(&settings, &reported, &aws_shadow_fields[i]))
+        {
+            continue;
+        }
+        aws_shadow_printf(doc, sizeof(doc), &offset, "%s\"%s\":", (changed > 0) ? "," : "", aws_shadow_fields[i].key);
+        aws_shadow_write_field(doc, sizeof(doc), &offset, &settings, &aws_shadow_fields[i]);
+        changed++;
+    }
+    aws_shadow_printf(doc, sizeof(doc), &offset, "}}}");
+
+    if (changed == 0)
+    {
+        return ESP_OK;
+    }
+    if (offset >= sizeof(doc))
+    {
+        APP_LOGE(TAG, "Reported state does not fit in %d bytes", AWS_SHADOW_REPORT_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err = aws_iot_mqtt_publish_topic(mqttContext, update_topic, update_topic_length, doc);
+    if (esp_err == ESP_OK)
+    {
+        reported = settings;
+        reported_valid = true;
+    }
+
+    return esp_err;
+}
+
+/**
+ * Handles a publish of the delta topic, e.g. {"version":12,"timestamp":1700000000,"state":{"timezone":"CET"}}.
+ * The document is walked where it was received. Known keys are applied with a single configuration
+ * commit, unknown keys and invalid values are logged and skipped. The applied keys are reported even if
+ * unchanged, the delta shows the cloud does not have them.
+ */
+static void aws_shadow_on_delta(MQTTContext_t *mqttContext, const MQTTPublishInfo_t *publishInfo)
+{
+    const char *payload = publishInfo->pPayload;
+    size_t length = publishInfo->payloadLength;
+    size_t start = 0, next = 0;
+    JSONPair_t pair;
+    JSONPair_t state = { 0 };
+    uint32_t version = 0;
+    app_nvs_settings_t settings;
+    uint32_t applied_mask = 0;
+    esp_err_t esp_err;
+
+    if (JSON_Validate(payload, length) != JSONSuccess)
+    {
+        APP_LOGW(TAG, "Invalid delta document");
+        return;
+    }
+
+    while (JSON_Iterate(payload, length, &start, &next, &pair) == JSONSuccess)
+    {
+        if (pair.keyLength == 5 && memcmp(pair.key, "state", 5) == 0 && pair.jsonType == JSONObject)
+        {
+            state = pair;
+        }
+        else if (pair.keyLength == 7 && memcmp(pair.key, "version", 7) == 0)
+        {
+            aws_shadow_parse_uint(&pair, UINT32_MAX, &version);
+        }
+    }
+
+    if (state.value == NULL)
+    {
+        APP_LOGW(TAG, "Delta without a state");
+        return;
+    }
+    if (version != 0 && version <= delta_version)
+    {
+        APP_LOGI(TAG, "Ignored delta version %lu, %lu is applied", (unsigned long)version, (unsigned long)delta_version);
+        return;
+    }
+
+    app_nvs_get_settings(&settings);
+
+    start = 0;
+    next = 0;
+    while (JSON_Iterate(state.value, state.valueLength, &start, &next, &pair) == JSONSuccess)
+    {
+        size_t index = aws_shadow_find_field(pair.key, pair.keyLength);
+
+        if (index >= AWS_SHADOW_FIELD_COUNT)
+        {
+            APP_LOGW(TAG, "Ignored unknown key %s", APP_LOG_STRN(pair.key, pair.keyLength));
+        }
+        else if (!aws_shadow_set_field(&settings, &aws_shadow_fields[index], &pair))
+        {
+            APP_LOGW(TAG, "Ignored invalid value of %s", aws_shadow_fields[index].key);
+        }
+        else
+        {
+            applied_mask |= 1U << index;
+        }
+    }
+
+    if (applied_mask != 0)
+    {
+        esp_err = app_nvs_save_config(&settings, NULL, NULL);
+        if (esp_err != ESP_OK)
+        {
+            APP_LOGE(TAG, "Failed to apply delta version %lu: %s", (unsigned long)version, esp_err_to_name(esp_err));
+            return;
+        }
+        APP_LOGI(TAG, "Applied delta version %lu", (unsigned long)version);
+    }
+
+    delta_version = version;
+    aws_shadow_report(mqttContext, applied_mask);
+}
+
+/**
+ * Formats the topic of a shadow operation.
+ * @return length of the topic.
+ */
+static uint16_t aws_shadow_topic(char *topic, size_t size, const char *thing_name, const char *suffix)
+{
+    int len = snprintf(topic, size, AWS_SHADOW_TOPIC_PREFIX "%s%s", thing_name, suffix);
+
+    return (len < 0 || (size_t)len >= size) ? 0 : (uint16_t)len;
+}
+
+esp_err_t aws_shadow_start(MQTTContext_t *mqttContext)
+{
+    const char *thing_name = aws_iot_get_client_id();
+    esp_err_t esp_err;
+
+    update_topic_length = aws_shadow_topic(update_topic, sizeof(update_topic), thing_name, AWS_SHADOW_UPDATE_SUFFIX);
+    delta_topic_length = aws_shadow_topic(delta_topic, sizeof(delta_topic), thing_name, AWS_SHADOW_DELTA_SUFFIX);
+    if (update_topic_length == 0 || delta_topic_length == 0)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // The shadow may have changed while disconnected, so the whole state is reported again
+    reported_valid = false;
+    delta_version = 0;
+
+    esp_err = aws_iot_mqtt_subscribe_topic(mqttContext, delta_topic, delta_topic_length, aws_shadow_on_delta);
+    if (esp_err == ESP_OK)
+    {
+        esp_err = aws_shadow_report(mqttContext, 0);
+    }
+
+    return esp_err;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file aws_shadow.h
+ * @brief AWS IoT classic device shadow of the device settings.
+ *
+ * Desired values of the update/delta topic are applied to the configuration record, and the
+ * settings which differ from the last reported state are published to the update topic.
+ * Deltas are parsed in place in the MQTT network buffer, nothing is copied or allocated.
+ */
+#ifndef MAIN_AWS_SHADOW_H_
+#define MAIN_AWS_SHADOW_H_
+
+#include "core_mqtt.h"
+#include "esp_err.h"
+
+// Size of a reported state document
+#define AWS_SHADOW_REPORT_SIZE   256
+
+/**
+ * Subscribes to the delta topic of the thing named after the MQTT client identifier and
+ * reports the current settings. Called for each new MQTT session.
+ * @param mqttContext connected MQTT context.
+ * @return ESP_OK on success, or an error code on failure.
+ */
+esp_err_t aws_shadow_start(MQTTContext_t *mqttContext);
+
+#endif /* MAIN_AWS_SHADOW_H_ */
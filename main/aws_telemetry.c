@@ -0,0 +1,157 @@
+#include <stdbool.h>
+#include <sys/time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "app_log.h"
+#include "esp_timer.h"
+
+#include "aws_iot.h"
+#include "aws_telemetry.h"
+#include "telemetry_codec.h"
+
+static const char TAG[] = "aws_telemetry";
+
+#if AWS_TELEMETRY_ENCODING == AWS_TELEMETRY_ENCODING_JSON
+#define AWS_TELEMETRY_SUFFIX           "json"
+#define AWS_TELEMETRY_PAYLOAD_SIZE     TELEMETRY_JSON_MAX_SIZE(AWS_TELEMETRY_BATCH_SIZE)
+#else
+#define AWS_TELEMETRY_SUFFIX           "ts1"
+#define AWS_TELEMETRY_PAYLOAD_SIZE     TELEMETRY_SERIES_MAX_SIZE(AWS_TELEMETRY_BATCH_SIZE)
+#endif
+#define AWS_TELEMETRY_LZ4_SUFFIX       ".lz4"
+
+#define AWS_TELEMETRY_PLAIN_TOPIC      AWS_TELEMETRY_TOPIC AWS_TELEMETRY_SUFFIX
+#define AWS_TELEMETRY_PLAIN_TOPIC_LENGTH (sizeof(AWS_TELEMETRY_PLAIN_TOPIC) - 1)
+#define AWS_TELEMETRY_LZ4_TOPIC        AWS_TELEMETRY_PLAIN_TOPIC AWS_TELEMETRY_LZ4_SUFFIX
+#define AWS_TELEMETRY_LZ4_TOPIC_LENGTH (sizeof(AWS_TELEMETRY_LZ4_TOPIC) - 1)
+
+/**
+ * Samples waiting to be published. Sample number n of all samples ever added is held in
+ * batch[n % AWS_TELEMETRY_BATCH_SIZE], the ones from sent up to added are pending.
+ */
+static telemetry_sample_t batch[AWS_TELEMETRY_BATCH_SIZE];
+static uint32_t added = 0;
+static uint32_t sent = 0;
+static uint32_t dropped = 0;
+static int64_t batch_start_us = 0;    // Uptime when the oldest pending sample was added
+static portMUX_TYPE batch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// PUBLISH headers of the two telemetry topics, serialized once and only used by the MQTT task
+static uint8_t plain_header[MQTT_PREPARED_PUBLISH_BUFFER_SIZE(AWS_TELEMETRY_PLAIN_TOPIC_LENGTH)];
+static uint8_t lz4_header[MQTT_PREPARED_PUBLISH_BUFFER_SIZE(AWS_TELEMETRY_LZ4_TOPIC_LENGTH)];
+static MQTTPreparedPublish_t plain_prepared;
+static MQTTPreparedPublish_t lz4_prepared;
+static bool is_prepared = false;
+
+void aws_telemetry_add_sample(uint8_t sensor, int16_t humidity, int16_t temperature)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+
+    taskENTER_CRITICAL(&batch_lock);
+    if (added - sent == AWS_TELEMETRY_BATCH_SIZE)
+    {
+        sent++;
+        dropped++;
+    }
+    if (added == sent)
+    {
+        batch_start_us = esp_timer_get_time();
+    }
+    batch[added % AWS_TELEMETRY_BATCH_SIZE] = (telemetry_sample_t){
+        .time_ms = (int64_t)now.tv_sec * 1000 + now.tv_usec / 1000,
+        .sensor = sensor,
+        .temperature = temperature,
+        .humidity = humidity,
+    };
+    added++;
+    taskEXIT_CRITICAL(&batch_lock);
+}
+
+esp_err_t aws_telemetry_prepare(void)
+{
+    if (is_prepared)
+    {
+        return ESP_OK;
+    }
+
+    if (aws_iot_mqtt_prepare_publish(AWS_TELEMETRY_PLAIN_TOPIC, AWS_TELEMETRY_PLAIN_TOPIC_LENGTH,
+                                     plain_header, sizeof(plain_header), &plain_prepared) != ESP_OK ||
+        aws_iot_mqtt_prepare_publish(AWS_TELEMETRY_LZ4_TOPIC, AWS_TELEMETRY_LZ4_TOPIC_LENGTH,
+                                     lz4_header, sizeof(lz4_header), &lz4_prepared) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    is_prepared = true;
+
+    return ESP_OK;
+}
+
+esp_err_t aws_telemetry_publish(MQTTContext_t *mqttContext)
+{
+    // Only used by the MQTT task, static to keep them off its stack
+    static telemetry_sample_t samples[AWS_TELEMETRY_BATCH_SIZE];
+    static uint8_t payload[AWS_TELEMETRY_PAYLOAD_SIZE];
+    static uint8_t compressed[AWS_TELEMETRY_PAYLOAD_SIZE];
+    uint32_t first;
+    size_t count;
+    size_t length;
+    size_t compressed_length = 0;
+
+    taskENTER_CRITICAL(&batch_lock);
+    first = sent;
+    count = added - sent;
+    if (count < AWS_TELEMETRY_BATCH_SIZE &&
+        (count == 0 || esp_timer_get_time() - batch_start_us < (int64_t)AWS_TELEMETRY_MAX_DELAY_MS * 1000))
+    {
+        count = 0;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        samples[i] = batch[(first + i) % AWS_TELEMETRY_BATCH_SIZE];
+    }
+    taskEXIT_CRITICAL(&batch_lock);
+
+    if (count == 0)
+    {
+        return ESP_OK;
+    }
+
+#if AWS_TELEMETRY_ENCODING == AWS_TELEMETRY_ENCODING_JSON
+    length = telemetry_encode_json(samples, count, (char *)payload, sizeof(payload));
+#else
+    length = telemetry_encode_series(samples, count, payload, sizeof(payload));
+#endif
+
+    if (length >= AWS_TELEMETRY_COMPRESS_MIN_SIZE)
+    {
+        compressed_length = telemetry_compress(payload, length, compressed, sizeof(compressed));
+    }
+
+    if (aws_iot_mqtt_publish_prepared(mqttContext,
+                                      (compressed_length > 0) ? &lz4_prepared : &plain_prepared,
+                                      (compressed_length > 0) ? compressed : payload,
+                                      (compressed_length > 0) ? compressed_length : length) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    APP_LOGI(TAG, "Published %u samples to %s, %u bytes, %u dropped so far", (unsigned)count,
+             (compressed_length > 0) ? AWS_TELEMETRY_LZ4_TOPIC : AWS_TELEMETRY_PLAIN_TOPIC,
+             (unsigned)((compressed_length > 0) ? compressed_length : length), (unsigned)dropped);
+
+    taskENTER_CRITICAL(&batch_lock);
+    // Samples dropped meanwhile were sent already
+    if ((int32_t)(first + count - sent) > 0)
+    {
+        sent = first + count;
+    }
+    if (added != sent)
+    {
+        batch_start_us = esp_timer_get_time();
+    }
+    taskEXIT_CRITICAL(&batch_lock);
+
+    return ESP_OK;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file aws_telemetry.h
+ * @brief Batched sensor telemetry published to AWS IoT.
+ *
+ * Sensor readings are collected in a batch which the MQTT task publishes once it is full or its
+ * oldest sample is AWS_TELEMETRY_MAX_DELAY_MS old. The batch is encoded with
+ * AWS_TELEMETRY_ENCODING and compressed with LZ4 when that saves bytes. MQTT 3.1.1 has no content
+ * type property, so the encoding is the last level of the topic: json, ts1, json.lz4 or ts1.lz4,
+ * see telemetry_codec.h and tools/telemetry_decode.py.
+ */
+#ifndef MAIN_AWS_TELEMETRY_H_
+#define MAIN_AWS_TELEMETRY_H_
+
+#include <stdint.h>
+
+#include "core_mqtt.h"
+#include "esp_err.h"
+
+#define AWS_TELEMETRY_TOPIC            "esp32/telemetry/"
+
+// Encodings of a batch
+#define AWS_TELEMETRY_ENCODING_JSON    0
+#define AWS_TELEMETRY_ENCODING_SERIES  1
+
+// Encoding of the published batches
+#define AWS_TELEMETRY_ENCODING         AWS_TELEMETRY_ENCODING_SERIES
+
+// Samples in a full batch, and the longest a sample waits for its batch to be published
+#define AWS_TELEMETRY_BATCH_SIZE       32
+#define AWS_TELEMETRY_MAX_DELAY_MS     60000
+
+// Smallest encoded batch worth compressing
+#define AWS_TELEMETRY_COMPRESS_MIN_SIZE 64
+
+/**
+ * Adds a sensor reading to the batch. Safe to call from any task. When the batch cannot be
+ * published for a while, the oldest samples are dropped.
+ * @param sensor index in the sensor table.
+ * @param humidity humidity in tenths of a percent.
+ * @param temperature temperature in tenths of a degree Celsius.
+ */
+void aws_telemetry_add_sample(uint8_t sensor, int16_t humidity, int16_t temperature);
+
+/**
+ * Serializes the PUBLISH headers of the telemetry topics, so a batch is published without
+ * encoding its topic again. Called by the task which owns the MQTT session once it is connected,
+ * later calls do nothing.
+ * @return ESP_OK on success, ESP_FAIL otherwise.
+ */
+esp_err_t aws_telemetry_prepare(void);
+
+/**
+ * Publishes the batch if it is due. Called by the task which owns the MQTT session.
+ * @param mqttContext connected MQTT context.
+ * @return ESP_OK if the batch was published or is not due yet, ESP_FAIL if the publish failed,
+ *         the samples are then kept for the next session.
+ */
+esp_err_t aws_telemetry_publish(MQTTContext_t *mqttContext);
+
+#endif /* MAIN_AWS_TELEMETRY_H_ */
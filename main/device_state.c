@@ -0,0 +1,101 @@
+/**
+ * @file device_state.c
+ * @brief Seqlock protected device state.
+ *
+ * The sequence counter is odd while the writer updates the state. Readers retry their copy
+ * until they observe the same even counter before and after it, so they never block the
+ * writer and never return a torn snapshot. The version exposed to clients is the counter / 2.
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "device_state.h"
+#include "http_handlers_ota.h"
+#include "http_handlers_wifi.h"
+
+static device_state_t device_state = {
+  .wifi_connect_status = NONE,
+  .fw_update_status = OTA_UPDATE_PENDING,
+  .is_local_time_set = false,
+  .wifi_link_degraded = false,
+  .wifi_roam_count = 0,
+};
+
+static atomic_uint_fast32_t device_state_seq = 0;
+
+/**
+ * Marks the start of an update, the sequence becomes odd.
+ */
+static void device_state_write_begin(void)
+{
+  uint32_t seq = atomic_load_explicit(&device_state_seq, memory_order_relaxed);
+  atomic_store_explicit(&device_state_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+/**
+ * Publishes the update, the sequence becomes even again.
+ */
+static void device_state_write_end(void)
+{
+  uint32_t seq = atomic_load_explicit(&device_state_seq, memory_order_relaxed);
+  atomic_store_explicit(&device_state_seq, seq + 1, memory_order_release);
+}
+
+uint32_t device_state_get(device_state_t *out)
+{
+  uint32_t seq_begin;
+  uint32_t seq_end;
+  device_state_t copy;
+
+  do
+  {
+    seq_begin = atomic_load_explicit(&device_state_seq, memory_order_acquire);
+    memcpy(&copy, (const void *)&device_state, sizeof(copy));
+    atomic_thread_fence(memory_order_acquire);
+    seq_end = atomic_load_explicit(&device_state_seq, memory_order_relaxed);
+  } while ((seq_begin & 1) || seq_begin != seq_end);
+
+  if (out != NULL)
+  {
+    *out = copy;
+  }
+
+  return seq_begin >> 1;
+}
+
+void device_state_set_wifi_connect_status(int status)
+{
+  device_state_write_begin();
+  device_state.wifi_connect_status = status;
+  device_state_write_end();
+}
+
+void device_state_set_fw_update_status(int status)
+{
+  device_state_write_begin();
+  device_state.fw_update_status = status;
+  device_state_write_end();
+}
+
+void device_state_set_local_time_set(bool is_set)
+{
+  device_state_write_begin();
+  device_state.is_local_time_set = is_set;
+  device_state_write_end();
+}
+
+void device_state_set_wifi_link_degraded(bool degraded)
+{
+  device_state_write_begin();
+  device_state.wifi_link_degraded = degraded;
+  device_state_write_end();
+}
+
+void device_state_add_wifi_roam(void)
+{
+  device_state_write_begin();
+  device_state.wifi_roam_count++;
+  device_state_write_end();
+}
@@ -0,0 +1,38 @@
+/**
+ * @file device_state.h
+ * @brief Versioned snapshot of the device status shared between tasks.
+ */
+#ifndef MAIN_DEVICE_STATE_H_
+#define MAIN_DEVICE_STATE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Device status published by the HTTP server monitor task.
+ * @note Only the monitor task writes it, every other task reads a snapshot with device_state_get().
+ */
+typedef struct device_state
+{
+  int wifi_connect_status;    // http_server_wifi_connect_status_e
+  int fw_update_status;       // OTA_UPDATE_* status code
+  bool is_local_time_set;     // true once SNTP has been initialized
+  bool wifi_link_degraded;    // true while the link monitor reports a weak station link
+  uint32_t wifi_roam_count;   // Number of completed roams to another access point
+} device_state_t;
+
+/**
+ * Copies a consistent snapshot of the device state without taking a lock.
+ * @param out receives the snapshot, may be NULL to only read the version.
+ * @return the version of the snapshot, incremented on every change.
+ */
+uint32_t device_state_get(device_state_t *out);
+
+// Setters, to be called from the HTTP server monitor task only
+void device_state_set_wifi_connect_status(int status);
+void device_state_set_fw_update_status(int status);
+void device_state_set_local_time_set(bool is_set);
+void device_state_set_wifi_link_degraded(bool degraded);
+void device_state_add_wifi_roam(void);
+
+#endif /* MAIN_DEVICE_STATE_H_ */
@@ -1,45 +1,108 @@
-#define LOG_LOCAL_LEVEL ESP_LOG_VERBOSE
-
 #include <stdio.h>
-#include "esp_log.h"
+#include <stdbool.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "driver/gpio.h"
 
+#include "app_log.h"
+#include "app_nvs.h"
+#include "aws_telemetry.h"
 #include "dht.h"
 #include "dht11.h"
 #include "tasks_common.h"
 
+static const char TAG[] = "dht11";
+
+// Sensor task, started once a sensor is configured
+static TaskHandle_t DHT11_task_handle = NULL;
+
+/**
+ * Reads one entry of the sensor table.
+ */
+static esp_err_t DHT11_read_sensor(const app_nvs_sensor_t *sensor, int16_t *humidity, int16_t *temperature)
+{
+	// app_nvs_sensor_type_e follows the order of dht_sensor_type_t, offset by APP_NVS_SENSOR_NONE
+	return dht_read_data((dht_sensor_type_t)(sensor->type - APP_NVS_SENSOR_DHT11), (gpio_num_t)sensor->gpio,
+						 humidity, temperature);
+}
+
+esp_err_t DHT11_read(int16_t *humidity, int16_t *temperature)
+{
+	app_nvs_settings_t settings;
+
+	app_nvs_get_settings(&settings);
+
+	for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+	{
+		if (settings.sensors[i].type != APP_NVS_SENSOR_NONE)
+		{
+			return DHT11_read_sensor(&settings.sensors[i], humidity, temperature);
+		}
+	}
+
+	return ESP_ERR_NOT_FOUND;
+}
+
 /**
  * DHT11 Sensor task
  */
 static void DHT11_task(void *pvParameter)
 {
 	// printf("Starting DHT task\n\n");
+	app_nvs_settings_t settings;
 
 	for (;;)
 	{
+		app_nvs_get_settings(&settings);
+
 		// printf("=== Reading DHT ===\n");
-		int16_t temperature = 0;
-		int16_t humidity = 0;
-
-		esp_err_t res = dht_read_data(DHT_TYPE_DHT11, DHT_GPIO_PIN, &humidity, &temperature);
-		if (res == ESP_OK) {
-				printf("🌡️ Temp: %.1f°C\n", temperature / 10.0);
-				printf("💧 Hum: %.1f%%\n", humidity / 10.0);
-		} else {
-				printf("❌ DHT read error: %d\n", res);
-		}
+		for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+		{
+			int16_t temperature = 0;
+			int16_t humidity = 0;
+
+			if (settings.sensors[i].type == APP_NVS_SENSOR_NONE)
+			{
+				continue;
+			}
 
+			esp_err_t res = DHT11_read_sensor(&settings.sensors[i], &humidity, &temperature);
+			if (res == ESP_OK) {
+					aws_telemetry_add_sample((uint8_t)i, humidity, temperature);
+					APP_LOGD(TAG, "Sensor %u: %.1f C, %.1f%%", (unsigned)i, temperature / 10.0, humidity / 10.0);
+			} else {
+					APP_LOGW(TAG, "Sensor %u read error: %s", (unsigned)i, esp_err_to_name(res));
+			}
+		}
 
 		// Wait at least 2 seconds before reading again
-		// The interval of the whole process must be more than 2 seconds
-		vTaskDelay(4000 / portTICK_PERIOD_MS);
+		// The interval of the whole process must be more than 2 seconds, enforced by app_nvs_save_config()
+		vTaskDelay(pdMS_TO_TICKS(settings.sensor_period_ms));
 	}
 }
 
 void DHT11_task_start(void)
 {
-	xTaskCreatePinnedToCore(&DHT11_task, "DHT11_task", DHT11_TASK_STACK_SIZE, NULL, DHT11_TASK_PRIORITY, NULL, DHT11_TASK_CORE_ID);
+	app_nvs_settings_t settings;
+	bool configured = false;
+
+	if (DHT11_task_handle != NULL)
+	{
+		return;
+	}
+
+	app_nvs_get_settings(&settings);
+	for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+	{
+		configured |= settings.sensors[i].type != APP_NVS_SENSOR_NONE;
+	}
+
+	if (!configured)
+	{
+		APP_LOGI(TAG, "No sensor configured, telemetry stays inactive");
+		return;
+	}
+
+	xTaskCreatePinnedToCore(&DHT11_task, "DHT11_task", DHT11_TASK_STACK_SIZE, NULL, DHT11_TASK_PRIORITY, &DHT11_task_handle, DHT11_TASK_CORE_ID);
 }
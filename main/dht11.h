@@ -1,15 +1,26 @@
 #ifndef DHT11_H_  
 #define DHT11_H_
 
+#include <stdint.h>
+#include "esp_err.h"
 
 #define DHT_OK 0
 #define DHT_CHECKSUM_ERROR -1
 #define DHT_TIMEOUT_ERROR -2
 
-#define DHT_GPIO_PIN			33
+#define DHT_GPIO_PIN			33		// Default of the sensor table
 
 /**
- * Starts DHT11 sensor task
+ * Reads the first sensor of the sensor table in the configuration record.
+ * @param humidity receives the humidity in tenths of a percent.
+ * @param temperature receives the temperature in tenths of a degree Celsius.
+ * @return ESP_OK on success, ESP_ERR_NOT_FOUND if no sensor is configured, or the error of the read.
+ */
+esp_err_t DHT11_read(int16_t *humidity, int16_t *temperature);
+
+/**
+ * Starts the sensor task if the sensor table has an entry and the task is not running yet.
+ * Called at boot and after the sensor table is changed.
  */
 void DHT11_task_start(void);
 
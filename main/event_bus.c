@@ -0,0 +1,153 @@
+/**
+ * @file event_bus.c
+ * @brief Non-blocking publish/subscribe event bus.
+ */
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "app_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "event_bus.h"
+
+static const char TAG[] = "event_bus";
+
+struct event_bus_subscriber
+{
+  const char *name;
+  uint32_t topic_mask;
+  QueueHandle_t queue;
+  atomic_uint_fast32_t pending[EVENT_BUS_TOPIC_COUNT];  // Coalesced IDs currently queued, one bit per ID
+  atomic_uint_fast32_t delivered;
+  atomic_uint_fast32_t coalesced;
+  atomic_uint_fast32_t dropped;
+};
+
+static struct event_bus_subscriber event_bus_subscribers[EVENT_BUS_MAX_SUBSCRIBERS];
+static atomic_int event_bus_subscriber_count = 0;
+static portMUX_TYPE event_bus_lock = portMUX_INITIALIZER_UNLOCKED;
+
+event_bus_subscriber_handle_t event_bus_subscribe(const char *name, uint32_t topic_mask, UBaseType_t queue_depth)
+{
+  QueueHandle_t queue = xQueueCreate(queue_depth, sizeof(event_bus_event_t));
+  struct event_bus_subscriber *subscriber = NULL;
+
+  if (queue == NULL)
+  {
+    APP_LOGE(TAG, "event_bus_subscribe: Failed to create the queue for %s", name);
+    return NULL;
+  }
+
+  taskENTER_CRITICAL(&event_bus_lock);
+  int index = atomic_load(&event_bus_subscriber_count);
+  if (index < EVENT_BUS_MAX_SUBSCRIBERS)
+  {
+    subscriber = &event_bus_subscribers[index];
+    subscriber->name = name;
+    subscriber->topic_mask = topic_mask;
+    subscriber->queue = queue;
+    // Publish the subscriber only once it is fully initialized
+    atomic_store(&event_bus_subscriber_count, index + 1);
+  }
+  taskEXIT_CRITICAL(&event_bus_lock);
+
+  if (subscriber == NULL)
+  {
+    APP_LOGE(TAG, "event_bus_subscribe: No free subscriber slot for %s", name);
+    vQueueDelete(queue);
+  }
+
+  return subscriber;
+}
+
+/**
+ * Queues an event to one subscriber.
+ * @return pdFALSE if the event had to be dropped.
+ */
+static BaseType_t event_bus_deliver(struct event_bus_subscriber *subscriber, const event_bus_event_t *event, uint32_t flags)
+{
+  uint32_t id_bit = (event->id < 32) ? (1u << event->id) : 0;
+  bool coalesce = (flags & EVENT_BUS_FLAG_COALESCE) && id_bit != 0;
+  BaseType_t sent;
+
+  if (coalesce &&
+      (atomic_fetch_or(&subscriber->pending[event->topic], id_bit) & id_bit))
+  {
+    // An identical event is still queued, handling it once does the same work. Only requests for work
+    // are published this way, a state change merged here would lose its order with other IDs
+    atomic_fetch_add(&subscriber->coalesced, 1);
+    return pdTRUE;
+  }
+
+  if (flags & EVENT_BUS_FLAG_HIGH_PRIORITY)
+  {
+    sent = xQueueSendToFront(subscriber->queue, event, 0);
+  }
+  else
+  {
+    sent = xQueueSend(subscriber->queue, event, 0);
+  }
+
+  if (sent != pdTRUE)
+  {
+    if (coalesce)
+    {
+      atomic_fetch_and(&subscriber->pending[event->topic], ~id_bit);
+    }
+    atomic_fetch_add(&subscriber->dropped, 1);
+    APP_LOGW(TAG, "event_bus_deliver: %s queue full, dropped topic %d id %d", subscriber->name, event->topic, event->id);
+    return pdFALSE;
+  }
+
+  atomic_fetch_add(&subscriber->delivered, 1);
+  return pdTRUE;
+}
+
+BaseType_t event_bus_publish(event_bus_topic_e topic, uint8_t id, int32_t arg, uint32_t flags)
+{
+  event_bus_event_t event = {
+    .topic = topic,
+    .id = id,
+    .arg = arg,
+  };
+  BaseType_t result = pdTRUE;
+  int count = atomic_load(&event_bus_subscriber_count);
+
+  for (int i = 0; i < count; i++)
+  {
+    struct event_bus_subscriber *subscriber = &event_bus_subscribers[i];
+
+    if ((subscriber->topic_mask & EVENT_BUS_TOPIC_BIT(topic)) &&
+        event_bus_deliver(subscriber, &event, flags) != pdTRUE)
+    {
+      result = pdFALSE;
+    }
+  }
+
+  return result;
+}
+
+BaseType_t event_bus_receive(event_bus_subscriber_handle_t subscriber, event_bus_event_t *event, TickType_t ticks_to_wait)
+{
+  if (xQueueReceive(subscriber->queue, event, ticks_to_wait) != pdTRUE)
+  {
+    return pdFALSE;
+  }
+
+  // Clear before handling, so a change published while handling queues a new event
+  if (event->id < 32)
+  {
+    atomic_fetch_and(&subscriber->pending[event->topic], ~(1u << event->id));
+  }
+
+  return pdTRUE;
+}
+
+void event_bus_get_stats(event_bus_subscriber_handle_t subscriber, event_bus_stats_t *stats)
+{
+  stats->delivered = atomic_load(&subscriber->delivered);
+  stats->coalesced = atomic_load(&subscriber->coalesced);
+  stats->dropped = atomic_load(&subscriber->dropped);
+}
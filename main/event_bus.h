@@ -0,0 +1,95 @@
+/**
+ * @file event_bus.h
+ * @brief Publish/subscribe event bus used between the application tasks.
+ *
+ * Every subscriber owns a bounded queue. Publishing never blocks: if a subscriber queue is full
+ * the event is dropped for that subscriber and counted. High priority events are queued ahead of
+ * normal ones, and coalesced events are not queued again while an identical one is still pending.
+ */
+#ifndef MAIN_EVENT_BUS_H_
+#define MAIN_EVENT_BUS_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+// Maximum number of subscribers on the bus
+#define EVENT_BUS_MAX_SUBSCRIBERS      4
+
+// Publish flags
+#define EVENT_BUS_FLAG_NONE            0x00
+#define EVENT_BUS_FLAG_HIGH_PRIORITY   0x01 // Queue ahead of normal priority events
+#define EVENT_BUS_FLAG_COALESCE        0x02 // Skip if the same topic/id is already pending, not for state changes
+
+/**
+ * Event topics, each topic has its own message ID space.
+ * @note A subscriber can receive at most 32 message IDs per topic with coalescing.
+ */
+typedef enum event_bus_topic
+{
+  EVENT_BUS_TOPIC_WIFI_APP = 0,       // wifi_app_message_e
+  EVENT_BUS_TOPIC_HTTP_MONITOR,       // http_server_message_e
+  EVENT_BUS_TOPIC_COUNT,
+} event_bus_topic_e;
+
+// Subscription mask bit of a topic
+#define EVENT_BUS_TOPIC_BIT(topic)     (1u << (topic))
+
+/**
+ * Event delivered to the subscribers.
+ */
+typedef struct event_bus_event
+{
+  event_bus_topic_e topic;
+  uint8_t id;
+  int32_t arg;                        // Optional payload, meaning depends on the topic and ID
+} event_bus_event_t;
+
+/**
+ * Per-subscriber counters.
+ */
+typedef struct event_bus_stats
+{
+  uint32_t delivered;                 // Events queued to the subscriber
+  uint32_t coalesced;                 // Events skipped because an identical one was pending
+  uint32_t dropped;                   // Events lost because the queue was full
+} event_bus_stats_t;
+
+typedef struct event_bus_subscriber *event_bus_subscriber_handle_t;
+
+/**
+ * Registers a subscriber.
+ * @param name name used in the log messages.
+ * @param topic_mask EVENT_BUS_TOPIC_BIT() of every topic to receive.
+ * @param queue_depth number of events the subscriber can have pending.
+ * @return the subscriber handle, or NULL if the bus is full or out of memory.
+ */
+event_bus_subscriber_handle_t event_bus_subscribe(const char *name, uint32_t topic_mask, UBaseType_t queue_depth);
+
+/**
+ * Publishes an event to every subscriber of the topic without blocking.
+ * Safe to call from tasks and from the esp_event loop, not from ISRs.
+ * @param topic topic of the event.
+ * @param id message ID within the topic.
+ * @param arg optional payload.
+ * @param flags EVENT_BUS_FLAG_* values.
+ * @return pdTRUE if no subscriber dropped the event, otherwise pdFALSE.
+ */
+BaseType_t event_bus_publish(event_bus_topic_e topic, uint8_t id, int32_t arg, uint32_t flags);
+
+/**
+ * Receives the next event of a subscriber.
+ * @param subscriber subscriber handle.
+ * @param event receives the event.
+ * @param ticks_to_wait maximum time to block.
+ * @return pdTRUE if an event was received, otherwise pdFALSE.
+ */
+BaseType_t event_bus_receive(event_bus_subscriber_handle_t subscriber, event_bus_event_t *event, TickType_t ticks_to_wait);
+
+/**
+ * Copies the counters of a subscriber.
+ */
+void event_bus_get_stats(event_bus_subscriber_handle_t subscriber, event_bus_stats_t *stats);
+
+#endif /* MAIN_EVENT_BUS_H_ */
@@ -1,22 +1,24 @@
-#include "esp_log.h"
+#include "app_log.h"
 
 #include "wifi_app.h"
 #include "http_handlers_ap_ssid.h"
+#include "http_json_writer.h"
 
 static const char TAG[] = "http_handlers_ap_ssid";
 
 esp_err_t http_server_get_ap_ssid_json_handler(httpd_req_t *req)
 {
-  ESP_LOGI(TAG, "/apSSID.json requested");
+  APP_LOGD(TAG, "/apSSID.json requested");
 
-  char ssidJSON[50];
+  http_json_writer_t writer;
   wifi_config_t *wifi_config = wifi_app_get_wifi_config();
-  char *ssid = (char *)wifi_config->ap.ssid;
 
-  sprintf(ssidJSON, "{\"ssid\": \"%s\"}", ssid);
-
-  httpd_resp_set_type(req, "application/json");
-  httpd_resp_send(req, ssidJSON, strlen(ssidJSON));
+  // A 32 character SSID is not NUL terminated
+  http_json_writer_init(&writer, req);
+  http_json_writer_begin_object(&writer, NULL);
+  http_json_writer_string_n(&writer, "ssid", (const char *)wifi_config->ap.ssid, sizeof(wifi_config->ap.ssid));
+  http_json_writer_end_object(&writer);
+  http_json_writer_finish(&writer);
 
   return ESP_OK;
 }
\ No newline at end of file
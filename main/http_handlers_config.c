@@ -0,0 +1,619 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_log.h"
+#include "esp_http_server.h"
+
+#include "app_nvs.h"
+#include "core_json.h"
+#include "dht11.h"
+#include "http_handlers_config.h"
+#include "http_json_writer.h"
+
+static const char TAG[] = "http_handlers_config";
+
+// Sensor type names used in the JSON document, indexed by app_nvs_sensor_type_e
+static const char *const http_config_sensor_types[] = { "none", "dht11", "am2301", "si7021" };
+
+// Highest GPIO of the ESP32 that can drive a single-wire sensor
+#define HTTP_CONFIG_MAX_GPIO           39
+
+// Members of app_nvs_settings_t sent in the "mqtt" object
+static const http_json_field_t http_config_mqtt_fields[] = {
+	HTTP_JSON_STRING(app_nvs_settings_t, mqtt_endpoint, "endpoint"),
+	HTTP_JSON_UINT(app_nvs_settings_t, mqtt_port, "port"),
+	HTTP_JSON_STRING(app_nvs_settings_t, mqtt_client_id, "client_id"),
+};
+
+// Members of app_nvs_settings_t sent at the top level
+static const http_json_field_t http_config_settings_fields[] = {
+	HTTP_JSON_STRING(app_nvs_settings_t, timezone, "timezone"),
+	HTTP_JSON_UINT(app_nvs_settings_t, sensor_period_ms, "sensor_period_ms"),
+	HTTP_JSON_UINT(app_nvs_settings_t, time_sync_period_ms, "time_sync_period_ms"),
+};
+
+// Members of a saved network, the password is left out on purpose
+static const http_json_field_t http_config_network_fields[] = {
+	HTTP_JSON_STRING(app_nvs_network_t, ssid, "ssid"),
+	HTTP_JSON_UINT(app_nvs_network_t, priority, "priority"),
+};
+
+/**
+ * config.json GET handler which responds with the configuration record. Passwords are never sent.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK
+ */
+esp_err_t http_server_get_config_json_handler(httpd_req_t *req)
+{
+	APP_LOGD(TAG, "/config.json requested");
+
+	http_json_writer_t writer;
+	app_nvs_settings_t settings;
+	app_nvs_network_t networks[APP_NVS_MAX_NETWORKS];
+
+	app_nvs_get_settings(&settings);
+	app_nvs_load_networks(networks);
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+	http_json_writer_int(&writer, "version", APP_NVS_CONFIG_VERSION);
+
+	http_json_writer_object(&writer, "mqtt", &settings, http_config_mqtt_fields, HTTP_JSON_FIELD_COUNT(http_config_mqtt_fields));
+	http_json_writer_fields(&writer, &settings, http_config_settings_fields, HTTP_JSON_FIELD_COUNT(http_config_settings_fields));
+
+	http_json_writer_begin_array(&writer, "sensors");
+	for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+	{
+		if (settings.sensors[i].type == APP_NVS_SENSOR_NONE)
+		{
+			continue;
+		}
+		http_json_writer_begin_object(&writer, NULL);
+		http_json_writer_string(&writer, "type", http_config_sensor_types[settings.sensors[i].type]);
+		http_json_writer_uint(&writer, "gpio", settings.sensors[i].gpio);
+		http_json_writer_end_object(&writer);
+	}
+	http_json_writer_end_array(&writer);
+
+	http_json_writer_begin_array(&writer, "networks");
+	for (size_t i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+	{
+		if (networks[i].ssid[0] != '\0')
+		{
+			http_json_writer_object(&writer, NULL, &networks[i], http_config_network_fields, HTTP_JSON_FIELD_COUNT(http_config_network_fields));
+		}
+	}
+	http_json_writer_end_array(&writer);
+
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
+
+	return ESP_OK;
+}
+
+// Longest sensor type name accepted, including the NUL
+#define HTTP_CONFIG_SENSOR_TYPE_SIZE   8
+
+// Bytes of the body received and parsed at a time
+#define HTTP_CONFIG_CHUNK_SIZE         256
+
+/**
+ * A "networks" entry as received, checked and merged with the store once the body is complete.
+ */
+typedef struct http_config_network
+{
+	char ssid[sizeof(((app_nvs_network_t *)0)->ssid) + 1];
+	char password[sizeof(((app_nvs_network_t *)0)->password) + 1];
+	bool has_password;
+	uint32_t priority;
+} http_config_network_t;
+
+/**
+ * Update being received by the PUT handler. The body is never held in memory, each value is
+ * applied here as the parser reports it.
+ */
+typedef struct http_config_update
+{
+	JSONStream_t stream;
+	app_nvs_settings_t settings;
+	uint32_t port;
+	bool has_sensors;
+	size_t sensor_count;
+	char sensor_types[APP_NVS_MAX_SENSORS][HTTP_CONFIG_SENSOR_TYPE_SIZE];
+	uint32_t sensor_gpios[APP_NVS_MAX_SENSORS];
+	bool has_networks;
+	size_t network_count;
+	http_config_network_t networks[APP_NVS_MAX_NETWORKS];
+	const char *error;            // First reason to reject the update
+} http_config_update_t;
+
+/**
+ * Copies a string value unescaped. \u escapes are not supported.
+ * @param pair value reported by the parser.
+ * @param out receives the NUL terminated value.
+ * @param size size of out.
+ * @return false if the value is not a string or does not fit, true otherwise.
+ */
+static bool http_config_get_string(const JSONPair_t *pair, char *out, size_t size)
+{
+	const char *value = pair->value;
+	size_t value_len = pair->valueLength;
+	size_t offset = 0;
+
+	// A value too long for the parser has no text and would not fit either
+	if (pair->jsonType != JSONString || value == NULL)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < value_len; i++)
+	{
+		char c = value[i];
+
+		if (c == '\\')
+		{
+			if (++i >= value_len)
+			{
+				return false;
+			}
+			switch (value[i])
+			{
+				case '"': case '\\': case '/': c = value[i]; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				default: return false;
+			}
+		}
+		if (offset + 1 >= size)
+		{
+			return false;
+		}
+		out[offset++] = c;
+	}
+	out[offset] = '\0';
+
+	return true;
+}
+
+/**
+ * Converts an unsigned integer value.
+ * @param pair value reported by the parser.
+ * @param max largest accepted value.
+ * @param out receives the value.
+ * @return false if the value is not an integer in range, true otherwise.
+ */
+static bool http_config_get_uint(const JSONPair_t *pair, uint32_t max, uint32_t *out)
+{
+	const char *value = pair->value;
+	size_t value_len = pair->valueLength;
+	uint32_t result = 0;
+
+	if (pair->jsonType != JSONNumber || value == NULL || value_len == 0)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < value_len; i++)
+	{
+		if (value[i] < '0' || value[i] > '9' || result > (max - (uint32_t)(value[i] - '0')) / 10)
+		{
+			return false;
+		}
+		result = result * 10 + (uint32_t)(value[i] - '0');
+	}
+
+	*out = result;
+	return true;
+}
+
+/**
+ * Compares the path of a reported value, e.g. "mqtt.port", with a name.
+ */
+static bool http_config_path_is(const JSONPair_t *pair, const char *name)
+{
+	return pair->keyLength == strlen(name) && memcmp(pair->key, name, pair->keyLength) == 0;
+}
+
+/**
+ * Matches the path of an entry of a top-level array or of one of its members, e.g. "sensors[1]"
+ * or "sensors[1].gpio".
+ * @param pair value reported by the parser.
+ * @param array name of the array.
+ * @param index receives the index of the entry.
+ * @return the member name, "" for the entry itself, or NULL if the path is not within the array.
+ */
+static const char *http_config_entry(const JSONPair_t *pair, const char *array, size_t *index)
+{
+	static char member[16];
+	size_t len = strlen(array);
+	size_t i = len + 1;
+
+	if (pair->keyLength <= i || memcmp(pair->key, array, len) != 0 || pair->key[len] != '[')
+	{
+		return NULL;
+	}
+
+	// The parser writes indexes as plain decimals that fit a size_t
+	*index = 0;
+	while (i < pair->keyLength && pair->key[i] >= '0' && pair->key[i] <= '9')
+	{
+		*index = *index * 10 + (size_t)(pair->key[i++] - '0');
+	}
+	if (i >= pair->keyLength || pair->key[i++] != ']')
+	{
+		return NULL;
+	}
+	if (i == pair->keyLength)
+	{
+		return "";
+	}
+	if (pair->key[i] != '.' || pair->keyLength - i > sizeof(member))
+	{
+		return NULL;
+	}
+
+	memcpy(member, &pair->key[i + 1], pair->keyLength - i - 1);
+	member[pair->keyLength - i - 1] = '\0';
+	return member;
+}
+
+/**
+ * Applies a value within the "sensors" array.
+ * @return false if the value is invalid or there are more than APP_NVS_MAX_SENSORS entries.
+ */
+static bool http_config_on_sensor(http_config_update_t *update, size_t index, const char *member, const JSONPair_t *pair)
+{
+	if (index >= APP_NVS_MAX_SENSORS)
+	{
+		return false;
+	}
+	if (member[0] == '\0')
+	{
+		update->sensor_count = index + 1;
+		return true;
+	}
+	if (strcmp(member, "type") == 0)
+	{
+		return http_config_get_string(pair, update->sensor_types[index], sizeof(update->sensor_types[index]));
+	}
+	if (strcmp(member, "gpio") == 0)
+	{
+		return http_config_get_uint(pair, HTTP_CONFIG_MAX_GPIO, &update->sensor_gpios[index]);
+	}
+
+	return true;
+}
+
+/**
+ * Applies a value within the "networks" array.
+ * @return false if the value is invalid or there are more than APP_NVS_MAX_NETWORKS entries.
+ */
+static bool http_config_on_network(http_config_update_t *update, size_t index, const char *member, const JSONPair_t *pair)
+{
+	http_config_network_t *network;
+
+	if (index >= APP_NVS_MAX_NETWORKS)
+	{
+		return false;
+	}
+	network = &update->networks[index];
+
+	if (member[0] == '\0')
+	{
+		update->network_count = index + 1;
+		return true;
+	}
+	if (strcmp(member, "ssid") == 0)
+	{
+		return http_config_get_string(pair, network->ssid, sizeof(network->ssid));
+	}
+	if (strcmp(member, "password") == 0)
+	{
+		network->has_password = true;
+		return http_config_get_string(pair, network->password, sizeof(network->password));
+	}
+	if (strcmp(member, "priority") == 0)
+	{
+		return http_config_get_uint(pair, UINT8_MAX, &network->priority);
+	}
+
+	return true;
+}
+
+/**
+ * Parser callback, called for every value of the body in document order. Unknown keys are
+ * ignored, a key given twice takes the last value.
+ * @param context the update being received.
+ * @param pair path, value and type.
+ */
+static void http_config_on_value(void *context, const JSONPair_t *pair)
+{
+	http_config_update_t *update = context;
+	app_nvs_settings_t *settings = &update->settings;
+	const char *member;
+	size_t index;
+	bool valid = true;
+
+	if (update->error != NULL)
+	{
+		return;
+	}
+
+	if (http_config_path_is(pair, "mqtt.endpoint"))
+	{
+		valid = http_config_get_string(pair, settings->mqtt_endpoint, sizeof(settings->mqtt_endpoint));
+	}
+	else if (http_config_path_is(pair, "mqtt.client_id"))
+	{
+		valid = http_config_get_string(pair, settings->mqtt_client_id, sizeof(settings->mqtt_client_id));
+	}
+	else if (http_config_path_is(pair, "mqtt.port"))
+	{
+		valid = http_config_get_uint(pair, UINT16_MAX, &update->port);
+	}
+	else if (http_config_path_is(pair, "timezone"))
+	{
+		valid = http_config_get_string(pair, settings->timezone, sizeof(settings->timezone));
+	}
+	else if (http_config_path_is(pair, "sensor_period_ms"))
+	{
+		valid = http_config_get_uint(pair, UINT32_MAX, &settings->sensor_period_ms);
+	}
+	else if (http_config_path_is(pair, "time_sync_period_ms"))
+	{
+		valid = http_config_get_uint(pair, UINT32_MAX, &settings->time_sync_period_ms);
+	}
+	else if (http_config_path_is(pair, "sensors"))
+	{
+		if (pair->jsonType != JSONArray)
+		{
+			update->error = "Invalid sensors";
+			return;
+		}
+		update->has_sensors = true;
+		update->sensor_count = 0;
+		memset(update->sensor_types, 0x00, sizeof(update->sensor_types));
+		for (size_t i = 0; i < APP_NVS_MAX_SENSORS; i++)
+		{
+			update->sensor_gpios[i] = HTTP_CONFIG_MAX_GPIO + 1;
+		}
+	}
+	else if (http_config_path_is(pair, "networks"))
+	{
+		if (pair->jsonType != JSONArray)
+		{
+			update->error = "Invalid networks";
+			return;
+		}
+		update->has_networks = true;
+		update->network_count = 0;
+		memset(update->networks, 0x00, sizeof(update->networks));
+	}
+	else if (update->has_sensors && (member = http_config_entry(pair, "sensors", &index)) != NULL)
+	{
+		if (!http_config_on_sensor(update, index, member, pair))
+		{
+			update->error = "Invalid sensors";
+		}
+	}
+	else if (update->has_networks && (member = http_config_entry(pair, "networks", &index)) != NULL)
+	{
+		if (!http_config_on_network(update, index, member, pair))
+		{
+			update->error = "Invalid networks";
+		}
+	}
+
+	if (!valid)
+	{
+		update->error = "Invalid setting";
+	}
+}
+
+/**
+ * Checks the received "sensors" entries, which replace the whole sensor table.
+ * @return false if an entry has an unknown type or an invalid GPIO.
+ */
+static bool http_config_apply_sensors(http_config_update_t *update)
+{
+	const size_t type_count = sizeof(http_config_sensor_types) / sizeof(http_config_sensor_types[0]);
+
+	memset(update->settings.sensors, 0x00, sizeof(update->settings.sensors));
+
+	for (size_t i = 0; i < update->sensor_count; i++)
+	{
+		size_t type;
+
+		for (type = APP_NVS_SENSOR_DHT11; type < type_count; type++)
+		{
+			if (strcmp(update->sensor_types[i], http_config_sensor_types[type]) == 0)
+			{
+				break;
+			}
+		}
+		if (type >= type_count || update->sensor_gpios[i] > HTTP_CONFIG_MAX_GPIO)
+		{
+			return false;
+		}
+
+		update->settings.sensors[i].type = (uint8_t)type;
+		update->settings.sensors[i].gpio = (uint8_t)update->sensor_gpios[i];
+	}
+
+	return true;
+}
+
+/**
+ * Checks the received "networks" entries, which replace the whole credential store.
+ * @return false if an entry has no SSID.
+ */
+static bool http_config_check_networks(const http_config_update_t *update)
+{
+	for (size_t i = 0; i < update->network_count; i++)
+	{
+		if (update->networks[i].ssid[0] == '\0')
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Builds the credential store from the received "networks" entries. An entry without a password
+ * keeps the stored password of that SSID, entries keep their connection history. Called by
+ * app_nvs_save_config() with the store locked.
+ * @param networks holds the current store on entry, receives the new one.
+ * @param arg the http_config_update_t.
+ */
+static void http_config_merge_networks(app_nvs_network_t *networks, void *arg)
+{
+	const http_config_update_t *update = arg;
+	app_nvs_network_t current[APP_NVS_MAX_NETWORKS];
+
+	memcpy(current, networks, sizeof(current));
+	memset(networks, 0x00, sizeof(current));
+
+	for (size_t i = 0; i < update->network_count; i++)
+	{
+		const http_config_network_t *network = &update->networks[i];
+
+		memcpy(networks[i].ssid, network->ssid, sizeof(networks[i].ssid));
+		networks[i].priority = (uint8_t)network->priority;
+		if (network->has_password)
+		{
+			memcpy(networks[i].password, network->password, sizeof(networks[i].password));
+		}
+
+		for (size_t j = 0; j < APP_NVS_MAX_NETWORKS; j++)
+		{
+			if (memcmp(current[j].ssid, networks[i].ssid, sizeof(networks[i].ssid)) == 0)
+			{
+				networks[i].last_success = current[j].last_success;
+				if (!network->has_password)
+				{
+					memcpy(networks[i].password, current[j].password, sizeof(networks[i].password));
+				}
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * config.json PUT handler which updates the configuration record. Keys missing from the body keep
+ * their value, "sensors" and "networks" replace the whole table. The body is validated and applied
+ * chunk by chunk as it is received, so its size does not cost memory. The update is checked as a whole
+ * and written with a single commit before the response, so a rejected, interrupted or unsaved push
+ * changes nothing. The credential store is merged under the app_nvs lock, a network saved by the WiFi
+ * task while the body is received is kept.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK, or ESP_FAIL if the body could not be received.
+ */
+esp_err_t http_server_put_config_json_handler(httpd_req_t *req)
+{
+	APP_LOGI(TAG, "/config.json update requested");
+
+	http_config_update_t *update;
+	char chunk[HTTP_CONFIG_CHUNK_SIZE];
+	size_t received = 0;
+	const char *error = NULL;
+	char response[48];
+	esp_err_t esp_err;
+
+	if (req->content_len == 0 || req->content_len > HTTP_CONFIG_MAX_BODY_SIZE)
+	{
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid body size");
+		return ESP_OK;
+	}
+
+	update = calloc(1, sizeof(*update));
+	if (update == NULL)
+	{
+		httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+		return ESP_OK;
+	}
+
+	app_nvs_get_settings(&update->settings);
+	update->port = update->settings.mqtt_port;
+	JSON_StreamInit(&update->stream, http_config_on_value, update);
+
+	// Stop reading once the update is rejected, the server discards the rest of the body
+	while (received < req->content_len && update->error == NULL && update->stream.status <= JSONSuccess)
+	{
+		size_t want = req->content_len - received;
+		int recv_len = httpd_req_recv(req, chunk, want < sizeof(chunk) ? want : sizeof(chunk));
+
+		if (recv_len == HTTPD_SOCK_ERR_TIMEOUT)
+		{
+			continue;
+		}
+		if (recv_len <= 0)
+		{
+			APP_LOGE(TAG, "http_server_put_config_json_handler: Failed to receive the body");
+			free(update);
+			return ESP_FAIL;
+		}
+		received += recv_len;
+		JSON_StreamFeed(&update->stream, chunk, recv_len);
+	}
+
+	if (JSON_StreamFinish(&update->stream) != JSONSuccess)
+	{
+		error = "Invalid JSON";
+	}
+	else if (update->error != NULL)
+	{
+		error = update->error;
+	}
+	else if (update->has_sensors && !http_config_apply_sensors(update))
+	{
+		error = "Invalid sensors";
+	}
+	else if (update->has_networks && !http_config_check_networks(update))
+	{
+		error = "Invalid networks";
+	}
+
+	if (error == NULL)
+	{
+		update->settings.mqtt_port = (uint16_t)update->port;
+		esp_err = app_nvs_save_config(&update->settings, update->has_networks ? http_config_merge_networks : NULL, update);
+		if (esp_err == ESP_ERR_INVALID_ARG)
+		{
+			error = "Setting out of range";
+		}
+		else if (esp_err != ESP_OK)
+		{
+			free(update);
+			httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save the configuration");
+			return ESP_OK;
+		}
+	}
+
+	if (error == NULL && update->has_sensors)
+	{
+		// The first sensor added starts the sensor task, later changes are read by the task itself
+		DHT11_task_start();
+	}
+
+	free(update);
+
+	if (error != NULL)
+	{
+		APP_LOGW(TAG, "http_server_put_config_json_handler: Rejected update: %s", error);
+		httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, error);
+		return ESP_OK;
+	}
+
+	snprintf(response, sizeof(response), "{\"status\": \"ok\", \"version\": %d}", APP_NVS_CONFIG_VERSION);
+	httpd_resp_set_type(req, "application/json");
+	httpd_resp_send(req, response, strlen(response));
+
+	return ESP_OK;
+}
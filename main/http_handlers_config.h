@@ -0,0 +1,14 @@
+#ifndef HTTP_HANDLERS_CONFIG_H_
+#define HTTP_HANDLERS_CONFIG_H_
+
+#include "esp_http_server.h"
+
+// Largest request body accepted by PUT /config.json, the body is parsed as it arrives and never buffered
+#define HTTP_CONFIG_MAX_BODY_SIZE      16384
+
+// URI handlers for the configuration record
+esp_err_t http_server_get_config_json_handler(httpd_req_t *req);
+esp_err_t http_server_put_config_json_handler(httpd_req_t *req);
+
+
+#endif // HTTP_HANDLERS_CONFIG_H_
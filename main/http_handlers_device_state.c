@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_log.h"
+#include "esp_http_server.h"
+
+#include "device_state.h"
+#include "http_handlers_device_state.h"
+#include "http_json_writer.h"
+
+static const char TAG[] = "http_handlers_device_state";
+
+// Members of device_state_t sent to the web page
+static const http_json_field_t device_state_fields[] = {
+	HTTP_JSON_INT(device_state_t, wifi_connect_status, "wifi_connect_status"),
+	HTTP_JSON_INT(device_state_t, fw_update_status, "ota_update_status"),
+	HTTP_JSON_BOOL(device_state_t, is_local_time_set, "local_time_set"),
+	HTTP_JSON_BOOL(device_state_t, wifi_link_degraded, "wifi_link_degraded"),
+	HTTP_JSON_UINT(device_state_t, wifi_roam_count, "wifi_roam_count"),
+};
+
+/**
+ * deviceState.json handler which responds with the device state and its version.
+ * With a "since" query parameter equal to the current version only {"version": N, "changed": false} is returned,
+ * so the web page can poll cheaply and only refresh when something changed.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK
+ */
+esp_err_t http_server_get_device_state_json_handler(httpd_req_t *req)
+{
+	APP_LOGD(TAG, "/deviceState.json requested");
+
+	http_json_writer_t writer;
+	char query[32];
+	char since_str[12];
+	device_state_t state;
+	uint32_t version = device_state_get(&state);
+	bool changed = !(httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+					 httpd_query_key_value(query, "since", since_str, sizeof(since_str)) == ESP_OK &&
+					 strtoul(since_str, NULL, 10) == version);
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+	http_json_writer_uint(&writer, "version", version);
+	http_json_writer_bool(&writer, "changed", changed);
+	if (changed)
+	{
+		http_json_writer_fields(&writer, &state, device_state_fields, HTTP_JSON_FIELD_COUNT(device_state_fields));
+	}
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
+
+	return ESP_OK;
+}
@@ -0,0 +1,10 @@
+#ifndef HTTP_HANDLERS_DEVICE_STATE_H_
+#define HTTP_HANDLERS_DEVICE_STATE_H_
+
+#include "esp_http_server.h"
+
+// URI handler for the versioned device state
+esp_err_t http_server_get_device_state_json_handler(httpd_req_t *req);
+
+
+#endif // HTTP_HANDLERS_DEVICE_STATE_H_
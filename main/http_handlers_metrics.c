@@ -0,0 +1,64 @@
+#include <string.h>
+
+#include "app_log.h"
+#include "esp_http_server.h"
+
+#include "aws_iot.h"
+#include "http_handlers_metrics.h"
+#include "http_json_writer.h"
+#include "http_server_conn.h"
+
+static const char TAG[] = "http_handlers_metrics";
+
+// Members of http_server_conn_stats_t sent by httpStats.json
+static const http_json_field_t http_stats_fields[] = {
+	HTTP_JSON_UINT(http_server_conn_stats_t, open, "open"),
+	HTTP_JSON_UINT(http_server_conn_stats_t, peak, "peak"),
+	HTTP_JSON_UINT(http_server_conn_stats_t, opened, "opened"),
+	HTTP_JSON_UINT(http_server_conn_stats_t, requests, "requests"),
+	HTTP_JSON_UINT(http_server_conn_stats_t, reused, "reused"),
+	HTTP_JSON_UINT(http_server_conn_stats_t, client_evictions, "client_evictions"),
+	HTTP_JSON_UINT(http_server_conn_stats_t, idle_closes, "idle_closes"),
+};
+
+/**
+ * transportStats.json handler which responds with the counters and latency histograms of the MQTT TLS transport.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK
+ */
+esp_err_t http_server_get_transport_stats_json_handler(httpd_req_t *req)
+{
+	APP_LOGD(TAG, "/transportStats.json requested");
+
+	char statsJSON[AWS_IOT_TRANSPORT_STATS_JSON_SIZE];
+	size_t len = aws_iot_transport_stats_json(statsJSON, sizeof(statsJSON));
+
+	httpd_resp_set_type(req, "application/json");
+	httpd_resp_send(req, statsJSON, len);
+
+	return ESP_OK;
+}
+
+/**
+ * httpStats.json handler which responds with the connection counters of the HTTP server.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK
+ */
+esp_err_t http_server_get_http_stats_json_handler(httpd_req_t *req)
+{
+	APP_LOGD(TAG, "/httpStats.json requested");
+
+	http_json_writer_t writer;
+	http_server_conn_stats_t stats;
+
+	http_server_conn_get_stats(&stats);
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+	http_json_writer_uint(&writer, "max_sockets", HTTP_SERVER_CONN_MAX_SOCKETS);
+	http_json_writer_fields(&writer, &stats, http_stats_fields, HTTP_JSON_FIELD_COUNT(http_stats_fields));
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
+
+	return ESP_OK;
+}
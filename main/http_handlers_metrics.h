@@ -0,0 +1,13 @@
+#ifndef HTTP_HANDLERS_METRICS_H_
+#define HTTP_HANDLERS_METRICS_H_
+
+#include "esp_http_server.h"
+
+// URI handler for the MQTT transport statistics
+esp_err_t http_server_get_transport_stats_json_handler(httpd_req_t *req);
+
+// URI handler for the connection statistics of the HTTP server
+esp_err_t http_server_get_http_stats_json_handler(httpd_req_t *req);
+
+
+#endif // HTTP_HANDLERS_METRICS_H_
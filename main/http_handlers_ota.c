@@ -5,21 +5,22 @@
 #include <string.h>
 
 #include "esp_err.h"
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_http_server.h"
 #include "esp_ota_ops.h"
 #include "esp_timer.h"
 #include "esp_app_format.h"
 #include "sys/param.h"
 
+#include "app_nvs.h"
+#include "device_state.h"
 #include "http_handlers_ota.h"
+#include "http_json_writer.h"
 #include "http_server_monitor.h"
+#include "trace.h"
 
 static const char TAG[] = "http_handlers_ota";
 
-// Firmware update status
-int g_fw_update_status = OTA_UPDATE_PENDING;
-
 // ESP32 timer configuration passed to esp_timer_create() to reset the ESP32 after a successful OTA update
 const esp_timer_create_args_t fw_update_reset_args = {
 		.callback = &http_server_fw_update_reset_callback,
@@ -55,29 +56,29 @@ esp_err_t http_server_OTA_update_handler(httpd_req_t *req)
 		// {
 		// 	if (recv_len == HTTPD_SOCK_ERR_TIMEOUT)
 		// 	{
-		// 		ESP_LOGE(TAG, "http_server_OTA_update_handler: Timeout while receiving data");
+		// 		APP_LOGE(TAG, "http_server_OTA_update_handler: Timeout while receiving data");
 		// 		continue; // Retry receiving if timeout occurred
 		// 	}
-		// 	ESP_LOGE(TAG, "http_server_OTA_update_handler: OTA other Error %d", recv_len);
+		// 	APP_LOGE(TAG, "http_server_OTA_update_handler: OTA other Error %d", recv_len);
 		// 	return ESP_FAIL;
 		// }
 		recv_len = httpd_req_recv(req, ota_buff, MIN(content_length - content_received, sizeof(ota_buff)));
 		if (recv_len < 0) {
 			if (recv_len == HTTPD_SOCK_ERR_TIMEOUT) {
-				ESP_LOGW(TAG, "http_server_OTA_update_handler: Timeout while receiving data");
+				APP_LOGW(TAG, "http_server_OTA_update_handler: Timeout while receiving data");
 				continue; // Retry
 			} else {
-				ESP_LOGE(TAG, "http_server_OTA_update_handler: OTA recv error %d", recv_len);
-				g_fw_update_status = OTA_UPDATE_FAILED;
+				APP_LOGE(TAG, "http_server_OTA_update_handler: OTA recv error %d", recv_len);
+				http_server_monitor_send_message(HTTP_MSG_OTA_UPDATE_FAILED);
 				return ESP_FAIL;
 			}
 		} else if (recv_len == 0) {
 			// No more data, may be end of transmission
-			ESP_LOGI(TAG, "http_server_OTA_update_handler: All data received");
+			APP_LOGI(TAG, "http_server_OTA_update_handler: All data received");
 			break;
 		}
 
-		printf("http_server_OTA_update_handler: OTA RX %d of %d bytes\n",content_received, recv_len);
+		trace_record(TRACE_EVENT_OTA_CHUNK, content_received, recv_len);
 
 		// Check if this is the first data we are receiving, If so, it will have the information in the handler that we need to start the OTA update
 		if (!is_req_body_started)
@@ -88,27 +89,30 @@ esp_err_t http_server_OTA_update_handler(httpd_req_t *req)
 			char *body_start_p = strstr(ota_buff, "\r\n\r\n") + 4;
 			int body_part_len = recv_len - (body_start_p - ota_buff);
 
-			printf("http_server_OTA_update_handler: OTA file size %d\r\n", content_length);
+			APP_LOGI(TAG, "http_server_OTA_update_handler: OTA file size %d", content_length);
 
+			trace_record(TRACE_EVENT_OTA_BEGIN_BEGIN, content_length, 0);
 			esp_err_t err = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &ota_handle);
+			trace_record(TRACE_EVENT_OTA_BEGIN_END, err, 0);
 			if (err != ESP_OK)
 			{
-				ESP_LOGE(TAG, "http_server_OTA_update_handler: esp_ota_begin failed %d", err);
-				printf("http_server_OTA_update_handler: Error with OTA begin, cancelling OTA\r\n");
+				APP_LOGE(TAG, "http_server_OTA_update_handler: esp_ota_begin failed %d, cancelling OTA", err);
 				return ESP_FAIL;
 			} 
 			else 
 			{
-				printf("http_server_OTA_update_handler: Writing to partition subtype %d at offset 0x%" PRIx32 "\r\n",
-       update_partition->subtype, update_partition->address);
+				APP_LOGI(TAG, "http_server_OTA_update_handler: Writing to partition subtype %d at offset 0x%" PRIx32,
+						update_partition->subtype, update_partition->address);
 			}
 
 			// Write the first part of the data to the OTA partition
 			// esp_ota_write(ota_handle, body_start_p, body_part_len);
 			// content_received += body_part_len;
+			trace_record(TRACE_EVENT_OTA_WRITE_BEGIN, body_part_len, 0);
 			esp_err_t write_err = esp_ota_write(ota_handle, body_start_p, body_part_len);
+			trace_record(TRACE_EVENT_OTA_WRITE_END, write_err, 0);
 			if (write_err != ESP_OK) {
-				ESP_LOGE(TAG, "esp_ota_write failed! (%s)", esp_err_to_name(write_err));
+				APP_LOGE(TAG, "esp_ota_write failed! (%s)", esp_err_to_name(write_err));
 				esp_ota_end(ota_handle);  // Clean up handle even if failed
 				return ESP_FAIL;
 			}
@@ -119,9 +123,11 @@ esp_err_t http_server_OTA_update_handler(httpd_req_t *req)
 			// Write OTA data to the OTA partition
 			// esp_ota_write(ota_handle, ota_buff, recv_len);
 			// content_received += recv_len;
+			trace_record(TRACE_EVENT_OTA_WRITE_BEGIN, recv_len, 0);
 			esp_err_t write_err = esp_ota_write(ota_handle, ota_buff, recv_len);
+			trace_record(TRACE_EVENT_OTA_WRITE_END, write_err, 0);
 			if (write_err != ESP_OK) {
-					ESP_LOGE(TAG, "esp_ota_write failed! (%s)", esp_err_to_name(write_err));
+					APP_LOGE(TAG, "esp_ota_write failed! (%s)", esp_err_to_name(write_err));
 					esp_ota_end(ota_handle);  // Clean up
 					return ESP_FAIL;
 			}
@@ -135,25 +141,22 @@ esp_err_t http_server_OTA_update_handler(httpd_req_t *req)
 		if (esp_ota_set_boot_partition(update_partition) == ESP_OK)
 		{
 			const esp_partition_t *boot_partition = esp_ota_get_boot_partition();
-			ESP_LOGI(TAG, "http_server_OTA_update_handler: Next booting from partition subtype %d at offset 0x%" PRIx32,
+			APP_LOGI(TAG, "http_server_OTA_update_handler: Next booting from partition subtype %d at offset 0x%" PRIx32,
 					boot_partition->subtype, boot_partition->address);
 
-			g_fw_update_status = OTA_UPDATE_SUCCESSFUL; 
 			flash_successful = true;
 		}
 		else 
 		{
-			ESP_LOGE(TAG, "http_server_OTA_update_handler: FLASH ERROR");
-			g_fw_update_status = OTA_UPDATE_FAILED;
+			APP_LOGE(TAG, "http_server_OTA_update_handler: FLASH ERROR");
 		}
 	}
 	else 
 	{
-		ESP_LOGE(TAG, "http_server_OTA_update_handler: esp_ota_end failed");
-		g_fw_update_status = OTA_UPDATE_FAILED;
+		APP_LOGE(TAG, "http_server_OTA_update_handler: esp_ota_end failed");
 	}
 
-	// We won't update the global variables throughout the file, so send the message about the status of the OTA update
+	// The monitor task owns the device state, so send the message about the status of the OTA update
 	if (flash_successful)
 	{
 		http_server_monitor_send_message(HTTP_MSG_OTA_UPDATE_SUCCESSFUL);
@@ -172,36 +175,47 @@ esp_err_t http_server_OTA_update_handler(httpd_req_t *req)
  */
 esp_err_t http_server_OTA_status_handler(httpd_req_t *req)
 {
-	char otaJSON[100];
-	ESP_LOGI(TAG, "http_server_OTA_status_handler: requested OTA status\n");
-	snprintf(otaJSON, sizeof(otaJSON), "{\"ota_update_status\": %d, \"compile_time\": \"%s\", \"compile_date\": \"%s\"}", g_fw_update_status, __TIME__, __DATE__);
-
-	httpd_resp_set_type(req, "application/json");
-	httpd_resp_send(req, otaJSON, strlen(otaJSON));
+	http_json_writer_t writer;
+	device_state_t state;
+	device_state_get(&state);
+	APP_LOGD(TAG, "http_server_OTA_status_handler: requested OTA status");
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+	http_json_writer_int(&writer, "ota_update_status", state.fw_update_status);
+	http_json_writer_string(&writer, "compile_time", __TIME__);
+	http_json_writer_string(&writer, "compile_date", __DATE__);
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
 
 	return ESP_OK;
 }
 
 
-// Checks the g_fw_update_status and creates the fw_update_reset timer if g_fw_update_status is OTA_UPDATE_SUCCESSFUL
+// Checks the firmware update status and creates the fw_update_reset timer if it is OTA_UPDATE_SUCCESSFUL
 void http_server_fw_update_reset_timer(void)
 {
-	if (g_fw_update_status == OTA_UPDATE_SUCCESSFUL)
+	device_state_t state;
+	device_state_get(&state);
+
+	if (state.fw_update_status == OTA_UPDATE_SUCCESSFUL)
 	{
-		ESP_LOGI(TAG, "http_server_fw_update_reset_timer: Creating fw_update_reset timer");
+		APP_LOGI(TAG, "http_server_fw_update_reset_timer: Creating fw_update_reset timer");
 		// Give the web page a chance to  receive an acknowledgment back and initialize the timer
 		ESP_ERROR_CHECK(esp_timer_create(&fw_update_reset_args, &fw_update_reset));
 		ESP_ERROR_CHECK(esp_timer_start_once(fw_update_reset, 8000000));
 	}
 	else
 	{
-		ESP_LOGI(TAG, "http_server_fw_update_reset_timer: g_fw_update_status is unsuccessful");
+		APP_LOGI(TAG, "http_server_fw_update_reset_timer: firmware update is unsuccessful");
 	}
 }
 
 
 void http_server_fw_update_reset_callback(void *arg)
 {
-	ESP_LOGI(TAG, "http_server_fw_update_reset_callback: Timer timed out, Resetting ESP32 after successful OTA update");
+	APP_LOGI(TAG, "http_server_fw_update_reset_callback: Timer timed out, Resetting ESP32 after successful OTA update");
+	app_nvs_flush();
+	app_log_flush(OTA_RESET_LOG_FLUSH_MS);
 	esp_restart();
 }
\ No newline at end of file
@@ -9,8 +9,8 @@
 #define OTA_UPDATE_SUCCESSFUL   1
 #define OTA_UPDATE_FAILED       -1
 
-// Expose these for external use
-extern int g_fw_update_status;
+// Longest wait for the queued log records before the restart after an update
+#define OTA_RESET_LOG_FLUSH_MS  500
 
 // Handler for OTA update
 esp_err_t http_server_OTA_update_handler(httpd_req_t *req);
@@ -1,10 +1,11 @@
 #include <stdio.h>
 #include <string.h>
 
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_http_server.h"
 
 #include "http_handlers_sensor.h"
+#include "http_json_writer.h"
 #include "dht.h"
 #include "dht11.h"
 
@@ -17,26 +18,28 @@ static const char *TAG = "HTTP_HANDLERS_SENSOR";
  */
 esp_err_t http_server_get_dht_sensor_readings_json_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "/dhtSensor.json requested");
+	APP_LOGD(TAG, "/dhtSensor.json requested");
 	
-	char dhtSensorJSON[100];
+	http_json_writer_t writer;
 	int16_t temperature = 0;
 	int16_t humidity = 0;
 
-	if (dht_read_data(DHT_TYPE_DHT11, DHT_GPIO_PIN, &humidity, &temperature) == ESP_OK)
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+
+	if (DHT11_read(&humidity, &temperature) == ESP_OK)
 	{
-		snprintf(dhtSensorJSON, sizeof(dhtSensorJSON),
-							"{\"temperature\": %.1f, \"humidity\": %.1f }",
-							temperature / 10.0, humidity / 10.0);
+		// Readings are in tenths
+		http_json_writer_decimal(&writer, "temperature", temperature, 1);
+		http_json_writer_decimal(&writer, "humidity", humidity, 1);
 	}
 	else
 	{
-		snprintf(dhtSensorJSON, sizeof(dhtSensorJSON),
-							"{\"error\": \"DHT sensor read failed\"}");
+		http_json_writer_string(&writer, "error", "DHT sensor read failed");
 	}
-	
-	httpd_resp_set_type(req, "application/json");
-	httpd_resp_send(req, dhtSensorJSON, strlen(dhtSensorJSON));
+
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
 
 	return ESP_OK;
 }
\ No newline at end of file
@@ -1,30 +1,32 @@
-#include "esp_log.h"
+#include "app_log.h"
 
+#include "device_state.h"
 #include "sntp_time_sync.h"
 #include "http_handlers_sntp.h"
+#include "http_json_writer.h"
 
 static const char TAG[] = "http_handlers_sntp";
 
-// Local time set status
-bool g_is_local_time_set = false;
-
 /**
  * localTime.json handler which responds with the local time.
  * @param req HTTP request for which the uri needs to be handled.
  * @return ESP_OK if successful, otherwise ESP_FAIL if timeout occurs and the update cannot be started.
  */
 esp_err_t http_server_get_local_time_json_handler(httpd_req_t *req) {
-  ESP_LOGI(TAG, "/localTime.json requested");
+  APP_LOGD(TAG, "/localTime.json requested");
 
-  char localTimeJSON[100] = {0};
+  http_json_writer_t writer;
+  device_state_t state;
+  device_state_get(&state);
 
-  if (g_is_local_time_set)
+  http_json_writer_init(&writer, req);
+  http_json_writer_begin_object(&writer, NULL);
+  if (state.is_local_time_set)
   {
-    snprintf(localTimeJSON, sizeof(localTimeJSON), "{\"time\": \"%s\"}", sntp_time_sync_get_time());
+    http_json_writer_string(&writer, "time", sntp_time_sync_get_time());
   }
+  http_json_writer_end_object(&writer);
+  http_json_writer_finish(&writer);
 
-  httpd_resp_set_type(req, "application/json");
-  httpd_resp_send(req, localTimeJSON, strlen(localTimeJSON));
-  
   return ESP_OK;
 }
\ No newline at end of file
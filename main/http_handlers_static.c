@@ -1,4 +1,4 @@
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_http_server.h"
 
 #include "http_handlers_static.h"
@@ -26,7 +26,7 @@ extern const uint8_t favicon_ico_end[]				asm("_binary_favicon_ico_end");
  */
 esp_err_t http_server_jquery_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "Jquery requested");
+	APP_LOGD(TAG, "Jquery requested");
 
 	httpd_resp_set_type(req, "application/javascript");
 	httpd_resp_send(req, (const char *)jquery_3_3_1_min_js_start, jquery_3_3_1_min_js_end - jquery_3_3_1_min_js_start);
@@ -41,7 +41,7 @@ esp_err_t http_server_jquery_handler(httpd_req_t *req)
  */
 esp_err_t http_server_index_html_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "index.html requested");
+	APP_LOGD(TAG, "index.html requested");
 
 	httpd_resp_set_type(req, "text/html");
 	httpd_resp_send(req, (const char *)index_html_start, index_html_end - index_html_start);
@@ -56,7 +56,7 @@ esp_err_t http_server_index_html_handler(httpd_req_t *req)
  */
 esp_err_t http_server_app_css_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "app.css requested");
+	APP_LOGD(TAG, "app.css requested");
 
 	httpd_resp_set_type(req, "text/css");
 	httpd_resp_send(req, (const char *)app_css_start, app_css_end - app_css_start);
@@ -71,7 +71,7 @@ esp_err_t http_server_app_css_handler(httpd_req_t *req)
  */
 esp_err_t http_server_app_js_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "app.js requested");
+	APP_LOGD(TAG, "app.js requested");
 
 	httpd_resp_set_type(req, "application/javascript");
 	httpd_resp_send(req, (const char *)app_js_start, app_js_end - app_js_start);
@@ -86,7 +86,7 @@ esp_err_t http_server_app_js_handler(httpd_req_t *req)
  */
 esp_err_t http_server_favicon_ico_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "favicon.ico requested");
+	APP_LOGD(TAG, "favicon.ico requested");
 
 	httpd_resp_set_type(req, "image/x-icon");
 	httpd_resp_send(req, (const char *)favicon_ico_start, favicon_ico_end - favicon_ico_start);
@@ -0,0 +1,33 @@
+#include "esp_http_server.h"
+
+#include "http_handlers_trace.h"
+#include "trace.h"
+
+// Bytes of the trace sent per chunk
+#define HTTP_TRACE_CHUNK_SIZE	512
+
+/**
+ * trace.bin handler which streams the event trace ring, see trace.h for the format.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK, or ESP_FAIL if the connection failed.
+ */
+esp_err_t http_server_get_trace_handler(httpd_req_t *req)
+{
+	uint8_t chunk[HTTP_TRACE_CHUNK_SIZE];
+	trace_export_t export;
+	size_t len;
+
+	httpd_resp_set_type(req, "application/octet-stream");
+	httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"trace.bin\"");
+
+	trace_export_begin(&export);
+	while ((len = trace_export_read(&export, chunk, sizeof(chunk))) > 0)
+	{
+		if (httpd_resp_send_chunk(req, (const char *)chunk, len) != ESP_OK)
+		{
+			return ESP_FAIL;
+		}
+	}
+
+	return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,10 @@
+#ifndef HTTP_HANDLERS_TRACE_H_
+#define HTTP_HANDLERS_TRACE_H_
+
+#include "esp_http_server.h"
+
+// URI handler for the download of the event trace
+esp_err_t http_server_get_trace_handler(httpd_req_t *req);
+
+
+#endif // HTTP_HANDLERS_TRACE_H_
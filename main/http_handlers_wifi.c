@@ -1,19 +1,28 @@
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_http_server.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
 
+#include "device_state.h"
 #include "wifi_app.h"
 #include "http_handlers_wifi.h"
+#include "http_json_writer.h"
 #include "http_server_monitor.h"
+#include "wifi_scan_cache.h"
 
 static const char TAG[] = "http_handlers_wifi";
 
-// Expose global status, WiFi connection status
-int g_wifi_connect_status = NONE;
+// Members of a scan cache entry sent to the web page
+static const http_json_field_t wifi_scan_entry_fields[] = {
+	HTTP_JSON_STRING(wifi_scan_cache_entry_t, ssid, "ssid"),
+	HTTP_JSON_INT(wifi_scan_cache_entry_t, rssi, "rssi"),
+	HTTP_JSON_UINT(wifi_scan_cache_entry_t, channel, "channel"),
+	HTTP_JSON_UINT(wifi_scan_cache_entry_t, authmode, "auth"),
+};
 
 
 /**
@@ -23,7 +32,7 @@ int g_wifi_connect_status = NONE;
  */
 esp_err_t http_server_wifi_connect_json_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "/wifiConnect.json requested");
+	APP_LOGI(TAG, "/wifiConnect.json requested");
 	size_t len_ssid = 0, len_pass = 0;
 	char *ssid_str = NULL, *pass_str = NULL;
 
@@ -34,7 +43,7 @@ esp_err_t http_server_wifi_connect_json_handler(httpd_req_t *req)
 		ssid_str = malloc(len_ssid);
 		if (httpd_req_get_hdr_value_str(req, "my-connect-ssid", ssid_str, len_ssid) == ESP_OK)
 		{
-			ESP_LOGI(TAG, "http_server_wifi_connect_json_handler: Found header => my-connect-ssid: %s", ssid_str);
+			APP_LOGI(TAG, "http_server_wifi_connect_json_handler: Found header => my-connect-ssid: %s", ssid_str);
 		}
 	}
 
@@ -45,7 +54,7 @@ esp_err_t http_server_wifi_connect_json_handler(httpd_req_t *req)
 		pass_str = malloc(len_pass);
 		if (httpd_req_get_hdr_value_str(req, "my-connect-pwd", pass_str, len_pass) == ESP_OK)
 		{
-			ESP_LOGI(TAG, "http_server_wifi_connect_json_handler: Found header => my-connect-pwd: %s", pass_str);
+			APP_LOGI(TAG, "http_server_wifi_connect_json_handler: Found header => my-connect-pwd");
 		}
 	}
 	
@@ -66,12 +75,16 @@ esp_err_t http_server_wifi_connect_json_handler(httpd_req_t *req)
  */
 esp_err_t http_server_wifi_connect_status_json_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "/wifiConnectStatus requested");
-	char statusJSON[100];
-	sprintf(statusJSON, "{\"wifi_connect_status\": %d}", g_wifi_connect_status);
-
-	httpd_resp_set_type(req, "application/json");
-	httpd_resp_send(req, statusJSON, strlen(statusJSON));
+	APP_LOGD(TAG, "/wifiConnectStatus requested");
+	http_json_writer_t writer;
+	device_state_t state;
+	device_state_get(&state);
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+	http_json_writer_int(&writer, "wifi_connect_status", state.wifi_connect_status);
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
 	return ESP_OK;
 }
 
@@ -82,20 +95,23 @@ esp_err_t http_server_wifi_connect_status_json_handler(httpd_req_t *req)
  */
 esp_err_t http_server_get_wifi_connect_info_json_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "/wifiConnectInfo.json requested");
-
-	char ipInfoJSON[200];
-	memset(ipInfoJSON, 0, sizeof(ipInfoJSON));
+	APP_LOGD(TAG, "/wifiConnectInfo.json requested");
 
+	http_json_writer_t writer;
 	char ip[IP4ADDR_STRLEN_MAX];
 	char netmask[IP4ADDR_STRLEN_MAX];
 	char gw[IP4ADDR_STRLEN_MAX];
 
-	if (g_wifi_connect_status == HTTP_WIFI_STATUS_CONNECT_SUCCESS)
+	device_state_t state;
+	device_state_get(&state);
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+
+	if (state.wifi_connect_status == HTTP_WIFI_STATUS_CONNECT_SUCCESS)
 	{
 		wifi_ap_record_t wifi_data;
 		ESP_ERROR_CHECK(esp_wifi_sta_get_ap_info(&wifi_data));
-		char *ssid = (char *)wifi_data.ssid;
 
 		esp_netif_ip_info_t ip_info;
 		ESP_ERROR_CHECK(esp_netif_get_ip_info(esp_netif_sta, &ip_info));
@@ -103,11 +119,14 @@ esp_err_t http_server_get_wifi_connect_info_json_handler(httpd_req_t *req)
 		esp_ip4addr_ntoa(&ip_info.netmask, netmask, IP4ADDR_STRLEN_MAX);
 		esp_ip4addr_ntoa(&ip_info.gw, gw, IP4ADDR_STRLEN_MAX);
 
-		sprintf(ipInfoJSON, "{\"ip\": \"%s\", \"netmask\": \"%s\", \"gw\": \"%s\", \"ap\": \"%s\"}", ip, netmask, gw, ssid);
+		http_json_writer_string(&writer, "ip", ip);
+		http_json_writer_string(&writer, "netmask", netmask);
+		http_json_writer_string(&writer, "gw", gw);
+		http_json_writer_string_n(&writer, "ap", (const char *)wifi_data.ssid, sizeof(wifi_data.ssid));
 	}
-	
-	httpd_resp_set_type(req, "application/json");
-	httpd_resp_send(req, ipInfoJSON, strlen(ipInfoJSON));
+
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
 
 	return ESP_OK;
 }
@@ -119,7 +138,47 @@ esp_err_t http_server_get_wifi_connect_info_json_handler(httpd_req_t *req)
  */
 esp_err_t http_server_wifi_disconnect_json_handler(httpd_req_t *req)
 {
-	ESP_LOGI(TAG, "/wifiDisconnect.json requested");
+	APP_LOGI(TAG, "/wifiDisconnect.json requested");
 	wifi_app_send_message(WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT);
 	return ESP_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * wifiScan.json handler which responds with the networks of the last scan, strongest first.
+ * Results are served from the scan cache right away, stale results make the Wi-Fi application
+ * refresh them in the background and "scanning" tells the page to ask again shortly.
+ * @param req HTTP request for which the uri needs to be handled.
+ * @return ESP_OK
+ */
+esp_err_t http_server_wifi_scan_json_handler(httpd_req_t *req)
+{
+	APP_LOGD(TAG, "/wifiScan.json requested");
+
+	wifi_scan_cache_entry_t entries[WIFI_SCAN_CACHE_MAX_ENTRIES];
+	http_json_writer_t writer;
+	int32_t age_ms;
+	bool scanning;
+	size_t count;
+
+	if (wifi_scan_cache_is_stale())
+	{
+		wifi_app_send_message(WIFI_APP_MSG_REFRESH_SCAN_CACHE);
+	}
+
+	count = wifi_scan_cache_get(entries, WIFI_SCAN_CACHE_MAX_ENTRIES, &age_ms, &scanning);
+
+	http_json_writer_init(&writer, req);
+	http_json_writer_begin_object(&writer, NULL);
+	http_json_writer_bool(&writer, "scanning", scanning || age_ms < 0);
+	http_json_writer_int(&writer, "age_ms", age_ms);
+	http_json_writer_begin_array(&writer, "networks");
+	for (size_t i = 0; i < count; i++)
+	{
+		http_json_writer_object(&writer, NULL, &entries[i], wifi_scan_entry_fields, HTTP_JSON_FIELD_COUNT(wifi_scan_entry_fields));
+	}
+	http_json_writer_end_array(&writer);
+	http_json_writer_end_object(&writer);
+	http_json_writer_finish(&writer);
+
+	return ESP_OK;
+}
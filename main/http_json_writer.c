@@ -0,0 +1,304 @@
+/**
+ * @file http_json_writer.c
+ * @brief Streaming JSON writer for HTTP responses.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "http_json_writer.h"
+
+static const char http_json_writer_hex[] = "0123456789abcdef";
+
+/**
+ * Sends the buffered output as one chunk.
+ */
+static void http_json_writer_flush(http_json_writer_t *writer)
+{
+	if (writer->len > 0 && writer->err == ESP_OK)
+	{
+		writer->err = httpd_resp_send_chunk(writer->req, writer->buf, writer->len);
+	}
+	writer->len = 0;
+}
+
+static void http_json_writer_put(http_json_writer_t *writer, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+		size_t n = sizeof(writer->buf) - writer->len;
+
+		if (n == 0)
+		{
+			http_json_writer_flush(writer);
+			continue;
+		}
+		if (n > len)
+		{
+			n = len;
+		}
+		memcpy(&writer->buf[writer->len], data, n);
+		writer->len += n;
+		data += n;
+		len -= n;
+	}
+}
+
+static void http_json_writer_putc(http_json_writer_t *writer, char c)
+{
+	if (writer->len == sizeof(writer->buf))
+	{
+		http_json_writer_flush(writer);
+	}
+	writer->buf[writer->len++] = c;
+}
+
+/**
+ * Writes a quoted, escaped string of at most max_len bytes, stopping at the first NUL.
+ */
+static void http_json_writer_quoted(http_json_writer_t *writer, const char *value, size_t max_len)
+{
+	http_json_writer_putc(writer, '"');
+
+	for (size_t i = 0; i < max_len && value[i] != '\0'; i++)
+	{
+		unsigned char c = (unsigned char)value[i];
+
+		if (c == '"' || c == '\\')
+		{
+			http_json_writer_putc(writer, '\\');
+			http_json_writer_putc(writer, (char)c);
+		}
+		else if (c < 0x20)
+		{
+			char escaped[6] = { '\\', 'u', '0', '0', http_json_writer_hex[c >> 4], http_json_writer_hex[c & 0x0f] };
+			http_json_writer_put(writer, escaped, sizeof(escaped));
+		}
+		else
+		{
+			http_json_writer_putc(writer, (char)c);
+		}
+	}
+
+	http_json_writer_putc(writer, '"');
+}
+
+/**
+ * Writes the separator and the key that precede a value.
+ */
+static void http_json_writer_prefix(http_json_writer_t *writer, const char *key)
+{
+	uint16_t bit = (uint16_t)(1u << writer->depth);
+
+	if (writer->has_members & bit)
+	{
+		http_json_writer_put(writer, ", ", 2);
+	}
+	writer->has_members |= bit;
+
+	if (key != NULL)
+	{
+		http_json_writer_quoted(writer, key, SIZE_MAX);
+		http_json_writer_put(writer, ": ", 2);
+	}
+}
+
+static void http_json_writer_begin(http_json_writer_t *writer, const char *key, char open)
+{
+	http_json_writer_prefix(writer, key);
+	http_json_writer_putc(writer, open);
+
+	if (writer->depth < HTTP_JSON_WRITER_MAX_DEPTH)
+	{
+		writer->depth++;
+		writer->has_members &= (uint16_t)~(1u << writer->depth);
+	}
+}
+
+static void http_json_writer_end(http_json_writer_t *writer, char close)
+{
+	if (writer->depth > 0)
+	{
+		writer->depth--;
+	}
+	http_json_writer_putc(writer, close);
+}
+
+void http_json_writer_init(http_json_writer_t *writer, httpd_req_t *req)
+{
+	writer->req = req;
+	writer->err = ESP_OK;
+	writer->len = 0;
+	writer->depth = 0;
+	writer->has_members = 0;
+
+	httpd_resp_set_type(req, "application/json");
+}
+
+void http_json_writer_begin_object(http_json_writer_t *writer, const char *key)
+{
+	http_json_writer_begin(writer, key, '{');
+}
+
+void http_json_writer_begin_array(http_json_writer_t *writer, const char *key)
+{
+	http_json_writer_begin(writer, key, '[');
+}
+
+void http_json_writer_end_object(http_json_writer_t *writer)
+{
+	http_json_writer_end(writer, '}');
+}
+
+void http_json_writer_end_array(http_json_writer_t *writer)
+{
+	http_json_writer_end(writer, ']');
+}
+
+void http_json_writer_string(http_json_writer_t *writer, const char *key, const char *value)
+{
+	http_json_writer_string_n(writer, key, value, SIZE_MAX);
+}
+
+void http_json_writer_string_n(http_json_writer_t *writer, const char *key, const char *value, size_t max_len)
+{
+	http_json_writer_prefix(writer, key);
+	http_json_writer_quoted(writer, (value != NULL) ? value : "", max_len);
+}
+
+void http_json_writer_int(http_json_writer_t *writer, const char *key, int64_t value)
+{
+	char digits[24];
+	int len = snprintf(digits, sizeof(digits), "%" PRId64, value);
+
+	http_json_writer_prefix(writer, key);
+	http_json_writer_put(writer, digits, (size_t)len);
+}
+
+void http_json_writer_uint(http_json_writer_t *writer, const char *key, uint64_t value)
+{
+	char digits[24];
+	size_t pos = sizeof(digits);
+
+	// Digits are produced backwards, no snprintf needed for the common case
+	do
+	{
+		digits[--pos] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value != 0);
+
+	http_json_writer_prefix(writer, key);
+	http_json_writer_put(writer, &digits[pos], sizeof(digits) - pos);
+}
+
+void http_json_writer_bool(http_json_writer_t *writer, const char *key, bool value)
+{
+	http_json_writer_prefix(writer, key);
+	if (value)
+	{
+		http_json_writer_put(writer, "true", 4);
+	}
+	else
+	{
+		http_json_writer_put(writer, "false", 5);
+	}
+}
+
+void http_json_writer_decimal(http_json_writer_t *writer, const char *key, int32_t value, uint8_t decimals)
+{
+	char digits[24];
+	uint32_t scale = 1;
+	uint32_t magnitude = (value < 0) ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+	int len;
+
+	for (uint8_t i = 0; i < decimals && i < 9; i++)
+	{
+		scale *= 10;
+	}
+
+	if (scale == 1)
+	{
+		len = snprintf(digits, sizeof(digits), "%s%" PRIu32, (value < 0) ? "-" : "", magnitude);
+	}
+	else
+	{
+		len = snprintf(digits, sizeof(digits), "%s%" PRIu32 ".%0*" PRIu32, (value < 0) ? "-" : "",
+					   magnitude / scale, (int)((decimals < 9) ? decimals : 9), magnitude % scale);
+	}
+
+	http_json_writer_prefix(writer, key);
+	http_json_writer_put(writer, digits, (size_t)len);
+}
+
+/**
+ * Reads an integer member of size 1, 2, 4 or 8 bytes.
+ */
+static uint64_t http_json_writer_read_uint(const uint8_t *p, size_t size)
+{
+	switch (size)
+	{
+		case 1: return *p;
+		case 2: { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+		case 4: { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+		default: { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+	}
+}
+
+static int64_t http_json_writer_read_int(const uint8_t *p, size_t size)
+{
+	switch (size)
+	{
+		case 1: return (int8_t)*p;
+		case 2: { int16_t v; memcpy(&v, p, sizeof(v)); return v; }
+		case 4: { int32_t v; memcpy(&v, p, sizeof(v)); return v; }
+		default: { int64_t v; memcpy(&v, p, sizeof(v)); return v; }
+	}
+}
+
+void http_json_writer_fields(http_json_writer_t *writer, const void *base, const http_json_field_t *fields, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const http_json_field_t *field = &fields[i];
+		const uint8_t *p = (const uint8_t *)base + field->offset;
+
+		switch (field->type)
+		{
+			case HTTP_JSON_FIELD_STRING:
+				http_json_writer_string_n(writer, field->key, (const char *)p, field->size);
+				break;
+			case HTTP_JSON_FIELD_INT:
+				http_json_writer_int(writer, field->key, http_json_writer_read_int(p, field->size));
+				break;
+			case HTTP_JSON_FIELD_UINT:
+				http_json_writer_uint(writer, field->key, http_json_writer_read_uint(p, field->size));
+				break;
+			case HTTP_JSON_FIELD_BOOL:
+				http_json_writer_bool(writer, field->key, *(const bool *)p);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+void http_json_writer_object(http_json_writer_t *writer, const char *key, const void *base,
+							 const http_json_field_t *fields, size_t count)
+{
+	http_json_writer_begin_object(writer, key);
+	http_json_writer_fields(writer, base, fields, count);
+	http_json_writer_end_object(writer);
+}
+
+esp_err_t http_json_writer_finish(http_json_writer_t *writer)
+{
+	http_json_writer_flush(writer);
+
+	if (writer->err == ESP_OK)
+	{
+		writer->err = httpd_resp_send_chunk(writer->req, NULL, 0);
+	}
+
+	return writer->err;
+}
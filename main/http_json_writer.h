@@ -0,0 +1,133 @@
+/**
+ * @file http_json_writer.h
+ * @brief Streaming JSON writer for HTTP responses.
+ *
+ * Output is escaped and collected in a small buffer inside the writer, every full buffer is sent
+ * with httpd_resp_send_chunk(). Handlers never size a response buffer and nothing is allocated.
+ * Flat structs can be described once with a table of http_json_field_t instead of a format string.
+ */
+#ifndef MAIN_HTTP_JSON_WRITER_H_
+#define MAIN_HTTP_JSON_WRITER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Bytes collected before a chunk is sent
+#define HTTP_JSON_WRITER_BUFFER_SIZE   128
+
+// Deepest nesting of objects and arrays
+#define HTTP_JSON_WRITER_MAX_DEPTH     8
+
+/**
+ * Value types of a field descriptor.
+ */
+typedef enum http_json_field_type
+{
+	HTTP_JSON_FIELD_STRING = 0,   // char array, up to the first NUL or the size of the member
+	HTTP_JSON_FIELD_INT,          // signed integer of 1, 2, 4 or 8 bytes
+	HTTP_JSON_FIELD_UINT,         // unsigned integer of 1, 2, 4 or 8 bytes
+	HTTP_JSON_FIELD_BOOL,
+} http_json_field_type_e;
+
+/**
+ * Describes one member of a struct written as a JSON object member.
+ */
+typedef struct http_json_field
+{
+	const char *key;
+	uint16_t offset;
+	uint8_t size;
+	uint8_t type;                 // http_json_field_type_e
+} http_json_field_t;
+
+// Field descriptor initializers, e.g. HTTP_JSON_UINT(device_state_t, wifi_roam_count, "wifi_roam_count")
+#define HTTP_JSON_FIELD(field_type, struct_type, member, name) \
+	{ .key = (name), .offset = offsetof(struct_type, member), .size = sizeof(((struct_type *)0)->member), .type = (field_type) }
+#define HTTP_JSON_STRING(struct_type, member, name)  HTTP_JSON_FIELD(HTTP_JSON_FIELD_STRING, struct_type, member, name)
+#define HTTP_JSON_INT(struct_type, member, name)     HTTP_JSON_FIELD(HTTP_JSON_FIELD_INT, struct_type, member, name)
+#define HTTP_JSON_UINT(struct_type, member, name)    HTTP_JSON_FIELD(HTTP_JSON_FIELD_UINT, struct_type, member, name)
+#define HTTP_JSON_BOOL(struct_type, member, name)    HTTP_JSON_FIELD(HTTP_JSON_FIELD_BOOL, struct_type, member, name)
+
+// Number of entries of a field descriptor table
+#define HTTP_JSON_FIELD_COUNT(fields)  (sizeof(fields) / sizeof((fields)[0]))
+
+/**
+ * Writer state, lives on the stack of the handler.
+ */
+typedef struct http_json_writer
+{
+	httpd_req_t *req;
+	esp_err_t err;                // First error returned by httpd_resp_send_chunk()
+	size_t len;                   // Bytes in buf
+	uint8_t depth;
+	uint16_t has_members;         // Bit n is set once the container at depth n holds a value
+	char buf[HTTP_JSON_WRITER_BUFFER_SIZE];
+} http_json_writer_t;
+
+/**
+ * Starts a response and sets its content type to application/json.
+ * @param writer writer to initialize.
+ * @param req HTTP request being answered.
+ */
+void http_json_writer_init(http_json_writer_t *writer, httpd_req_t *req);
+
+/**
+ * Opens an object or an array.
+ * @param writer writer.
+ * @param key member name inside an object, NULL at the top level or inside an array.
+ */
+void http_json_writer_begin_object(http_json_writer_t *writer, const char *key);
+void http_json_writer_begin_array(http_json_writer_t *writer, const char *key);
+
+/**
+ * Closes the innermost object or array.
+ */
+void http_json_writer_end_object(http_json_writer_t *writer);
+void http_json_writer_end_array(http_json_writer_t *writer);
+
+/**
+ * Writes a value, key as for http_json_writer_begin_object().
+ * Strings are escaped, http_json_writer_string_n() stops at max_len for fields that are not NUL terminated.
+ */
+void http_json_writer_string(http_json_writer_t *writer, const char *key, const char *value);
+void http_json_writer_string_n(http_json_writer_t *writer, const char *key, const char *value, size_t max_len);
+void http_json_writer_int(http_json_writer_t *writer, const char *key, int64_t value);
+void http_json_writer_uint(http_json_writer_t *writer, const char *key, uint64_t value);
+void http_json_writer_bool(http_json_writer_t *writer, const char *key, bool value);
+
+/**
+ * Writes a fixed point value, e.g. 215 with one decimal is written as 21.5.
+ * @param writer writer.
+ * @param key as for http_json_writer_begin_object().
+ * @param value value scaled by 10^decimals.
+ * @param decimals number of decimals, at most 9.
+ */
+void http_json_writer_decimal(http_json_writer_t *writer, const char *key, int32_t value, uint8_t decimals);
+
+/**
+ * Writes the members described by a field table into the current object.
+ * @param writer writer.
+ * @param base struct the offsets of the fields refer to.
+ * @param fields field descriptors.
+ * @param count number of descriptors.
+ */
+void http_json_writer_fields(http_json_writer_t *writer, const void *base, const http_json_field_t *fields, size_t count);
+
+/**
+ * Writes a struct as an object, shorthand for begin_object(), fields() and end_object().
+ */
+void http_json_writer_object(http_json_writer_t *writer, const char *key, const void *base,
+							 const http_json_field_t *fields, size_t count);
+
+/**
+ * Sends the buffered output and ends the chunked response.
+ * @param writer writer.
+ * @return ESP_OK, or the first error of httpd_resp_send_chunk().
+ */
+esp_err_t http_json_writer_finish(http_json_writer_t *writer);
+
+#endif /* MAIN_HTTP_JSON_WRITER_H_ */
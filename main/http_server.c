@@ -3,10 +3,12 @@
  *  Author: Greg
  */
 
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_http_server.h"
 
+#include "event_bus.h"
 #include "http_server.h"
+#include "http_server_conn.h"
 #include "http_handlers_static.h"
 #include "http_handlers_wifi.h"
 #include "http_handlers_ota.h"
@@ -14,18 +16,76 @@
 #include "http_server_monitor.h"
 #include "http_handlers_sntp.h"
 #include "http_handlers_ap_ssid.h"
+#include "http_handlers_metrics.h"
+#include "http_handlers_device_state.h"
+#include "http_handlers_config.h"
+#include "http_handlers_trace.h"
 #include "tasks_common.h"
+#include "trace.h"
 
 static const char TAG[] = "http_server";
 
+// Most URI handlers the server can register
+#define HTTP_SERVER_MAX_URI_HANDLERS 24
+
 // HTTP server task handle
 static httpd_handle_t http_server_handle = NULL;
 
 // HTTP server monitor task handle
 static TaskHandle_t task_http_server_monitor = NULL;
 
-// HTTP server message queue, used to manipulate the main queue of events
-QueueHandle_t http_server_monitor_queue_handle = NULL;
+// HTTP server monitor event bus subscription
+event_bus_subscriber_handle_t http_server_monitor_subscriber = NULL;
+
+// Handlers of the registered URIs, indexed by the route number passed in user_ctx
+static esp_err_t (*http_server_routes[HTTP_SERVER_MAX_URI_HANDLERS])(httpd_req_t *req);
+static size_t http_server_route_count = 0;
+
+/**
+ * Accounts the request to its session and runs the handler of the route between the trace
+ * events of the request.
+ * @param req HTTP request, user_ctx holds the route number.
+ * @return the result of the route handler.
+ */
+static esp_err_t http_server_traced_handler(httpd_req_t *req)
+{
+    uint32_t route = (uint32_t)(uintptr_t)req->user_ctx;
+
+    http_server_conn_request(req);
+    trace_record(TRACE_EVENT_HTTP_REQUEST_BEGIN, route, req->method);
+    esp_err_t err = http_server_routes[route](req);
+    trace_record(TRACE_EVENT_HTTP_REQUEST_END, route, (uint32_t)err);
+
+    return err;
+}
+
+/**
+ * Registers a URI handler, traced under the next route number.
+ * @param uri URI, method and handler, user_ctx is not passed on.
+ */
+static void http_server_register_uri(const httpd_uri_t *uri)
+{
+    httpd_uri_t traced = *uri;
+    size_t route = http_server_route_count;
+
+    if (route >= HTTP_SERVER_MAX_URI_HANDLERS)
+    {
+        APP_LOGE(TAG, "No room to register %s", uri->uri);
+        return;
+    }
+
+    // Routes keep their numbers when the server is started again, label them once
+    if (http_server_routes[route] == NULL)
+    {
+        trace_set_label(TRACE_EVENT_HTTP_REQUEST_BEGIN, route, uri->uri);
+    }
+    http_server_routes[route] = uri->handler;
+    http_server_route_count++;
+
+    traced.handler = http_server_traced_handler;
+    traced.user_ctx = (void *)(uintptr_t)route;
+    httpd_register_uri_handler(http_server_handle, &traced);
+}
 
 /**
  * Sets up the HTTP server configuration and starts the server.
@@ -35,6 +95,14 @@ static httpd_handle_t http_server_configure(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
+    // Subscribe the monitor before it starts so no message is lost
+    if (http_server_monitor_subscriber == NULL)
+    {
+        http_server_monitor_subscriber = event_bus_subscribe("http_server_monitor",
+                                                             EVENT_BUS_TOPIC_BIT(EVENT_BUS_TOPIC_HTTP_MONITOR),
+                                                             HTTP_SERVER_MONITOR_QUEUE_DEPTH);
+    }
+
     // Create HTTP server monitor task
     xTaskCreatePinnedToCore(
         http_server_monitor,
@@ -46,9 +114,6 @@ static httpd_handle_t http_server_configure(void)
         HTTP_SERVER_MONITOR_TASK_CORE_ID
     );
 
-    // Create the message queue
-    http_server_monitor_queue_handle = xQueueCreate(3, sizeof(http_server_queue_message_t));
-
     // The core that the HTTP server will run on
     config.core_id = HTTP_SERVER_TASK_CORE_ID;
     // Adjust the default priority to 1 less than the wifi application task
@@ -56,103 +121,147 @@ static httpd_handle_t http_server_configure(void)
     // Bump up the stack size (because the default is 4096)
     config.stack_size = HTTP_SERVER_TASK_STACK_SIZE;
     // Increase uri handlers
-    config.max_uri_handlers = 20;
-    // Increase the timeout limits
-    config.recv_wait_timeout = 10;
-    config.send_wait_timeout = 10;
+    config.max_uri_handlers = HTTP_SERVER_MAX_URI_HANDLERS;
+    // Socket pool, eviction and timeouts, see http_server_conn.h
+    http_server_conn_configure(&config);
+    http_server_conn_reset();
 
-    ESP_LOGI(TAG, "Starting server on port %d, with task priority %d", config.server_port, config.task_priority);
+    APP_LOGI(TAG, "Starting server on port %d, with task priority %d, %d sockets", config.server_port,
+             config.task_priority, config.max_open_sockets);
 
     // Start the HTTP server
     if (httpd_start(&http_server_handle, &config) == ESP_OK)
     {
-        ESP_LOGI(TAG, "Registering URI handlers");
+        APP_LOGI(TAG, "Registering URI handlers");
+        http_server_route_count = 0;
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/",
             .method = HTTP_GET,
             .handler = http_server_index_html_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/jquery-3.3.1.min.js",
             .method = HTTP_GET,
             .handler = http_server_jquery_handler,
             .user_ctx = NULL
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/app.css",
             .method = HTTP_GET,
             .handler = http_server_app_css_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/app.js",
             .method = HTTP_GET,
             .handler = http_server_app_js_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/favicon.ico",
             .method = HTTP_GET,
             .handler = http_server_favicon_ico_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/OTAupdate",
             .method = HTTP_POST,
             .handler = http_server_OTA_update_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/OTAstatus",
             .method = HTTP_POST,
             .handler = http_server_OTA_status_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/dhtSensor.json",
             .method = HTTP_GET,
             .handler = http_server_get_dht_sensor_readings_json_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/wifiConnect.json",
             .method = HTTP_POST,
             .handler = http_server_wifi_connect_json_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/wifiConnectStatus",
             .method = HTTP_POST,
             .handler = http_server_wifi_connect_status_json_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/wifiConnectInfo.json",
             .method = HTTP_GET,
             .handler = http_server_get_wifi_connect_info_json_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/wifiDisconnect.json",
             .method = HTTP_DELETE,
             .handler = http_server_wifi_disconnect_json_handler
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/wifiScan.json",
+            .method = HTTP_GET,
+            .handler = http_server_wifi_scan_json_handler
+        });
+
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/localTime.json",
             .method = HTTP_GET,
             .handler = http_server_get_local_time_json_handler,
         });
 
-        httpd_register_uri_handler(http_server_handle, &(httpd_uri_t){
+        http_server_register_uri(&(httpd_uri_t){
             .uri = "/apSSID.json",
             .method = HTTP_GET,
             .handler = http_server_get_ap_ssid_json_handler,
         });
 
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/transportStats.json",
+            .method = HTTP_GET,
+            .handler = http_server_get_transport_stats_json_handler,
+        });
+
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/httpStats.json",
+            .method = HTTP_GET,
+            .handler = http_server_get_http_stats_json_handler,
+        });
+
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/deviceState.json",
+            .method = HTTP_GET,
+            .handler = http_server_get_device_state_json_handler,
+        });
+
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/config.json",
+            .method = HTTP_GET,
+            .handler = http_server_get_config_json_handler,
+        });
+
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/config.json",
+            .method = HTTP_PUT,
+            .handler = http_server_put_config_json_handler,
+        });
+
+        http_server_register_uri(&(httpd_uri_t){
+            .uri = "/trace.bin",
+            .method = HTTP_GET,
+            .handler = http_server_get_trace_handler,
+        });
+
         return http_server_handle;
     }
 
@@ -173,13 +282,13 @@ void http_server_stop(void)
     {
         httpd_stop(http_server_handle);
         http_server_handle = NULL;
-        ESP_LOGI(TAG, "HTTP server stopped");
+        APP_LOGI(TAG, "HTTP server stopped");
     }
 
     if (task_http_server_monitor)
     {
         vTaskDelete(task_http_server_monitor);
         task_http_server_monitor = NULL;
-        ESP_LOGI(TAG, "HTTP server monitor task deleted");
+        APP_LOGI(TAG, "HTTP server monitor task deleted");
     }
 }
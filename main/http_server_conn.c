@@ -0,0 +1,240 @@
+/**
+ * @file http_server_conn.c
+ * @brief Connection management of the HTTP server.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_log.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+
+#include "http_server_conn.h"
+
+static const char TAG[] = "http_server_conn";
+
+/**
+ * A session of the pool. Only used by the server task, which runs the hooks and handlers.
+ */
+typedef struct http_server_conn
+{
+	int fd;                       // -1 when the entry is free
+	bool closing;                 // Close requested, waiting for the close hook
+	uint8_t peer[16];             // Client address, IPv4 as an IPv4-mapped IPv6 address
+	int64_t last_active_us;       // Accept or last request
+	uint32_t requests;
+} http_server_conn_t;
+
+static http_server_conn_t http_server_conns[HTTP_SERVER_CONN_MAX_SOCKETS];
+static http_server_conn_stats_t http_server_conn_stats;
+
+/**
+ * Returns the session of a socket, NULL if it is not tracked.
+ */
+static http_server_conn_t *http_server_conn_find(int fd)
+{
+	for (size_t i = 0; i < HTTP_SERVER_CONN_MAX_SOCKETS; i++)
+	{
+		if (http_server_conns[i].fd == fd)
+		{
+			return &http_server_conns[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Reads the client address of a socket.
+ * @param peer output, 16 bytes, zeroed if the address is unknown.
+ */
+static void http_server_conn_get_peer(int fd, uint8_t *peer)
+{
+	struct sockaddr_storage addr;
+	socklen_t len = sizeof(addr);
+
+	memset(peer, 0, 16);
+	if (getpeername(fd, (struct sockaddr *)&addr, &len) != 0)
+	{
+		return;
+	}
+
+	if (addr.ss_family == AF_INET)
+	{
+		peer[10] = 0xFF;
+		peer[11] = 0xFF;
+		memcpy(peer + 12, &((struct sockaddr_in *)&addr)->sin_addr, 4);
+	}
+#if LWIP_IPV6
+	else if (addr.ss_family == AF_INET6)
+	{
+		memcpy(peer, &((struct sockaddr_in6 *)&addr)->sin6_addr, 16);
+	}
+#endif
+}
+
+/**
+ * Asks the server to close a session, its entry is freed by the close hook.
+ */
+static void http_server_conn_close(httpd_handle_t hd, http_server_conn_t *conn)
+{
+	conn->closing = true;
+	httpd_sess_trigger_close(hd, conn->fd);
+}
+
+/**
+ * Closes the sessions idle for longer than HTTP_SERVER_CONN_IDLE_TIMEOUT_S.
+ */
+static void http_server_conn_close_idle(httpd_handle_t hd, int64_t now_us)
+{
+	for (size_t i = 0; i < HTTP_SERVER_CONN_MAX_SOCKETS; i++)
+	{
+		http_server_conn_t *conn = &http_server_conns[i];
+
+		if (conn->fd >= 0 && !conn->closing &&
+			now_us - conn->last_active_us > (int64_t)HTTP_SERVER_CONN_IDLE_TIMEOUT_S * 1000000)
+		{
+			http_server_conn_close(hd, conn);
+			http_server_conn_stats.idle_closes++;
+		}
+	}
+}
+
+/**
+ * Closes the least recently used session of a client which holds more than its share.
+ * @param conn session just opened by the client, kept.
+ */
+static void http_server_conn_limit_client(httpd_handle_t hd, const http_server_conn_t *conn)
+{
+	http_server_conn_t *oldest = NULL;
+	size_t count = 0;
+
+	for (size_t i = 0; i < HTTP_SERVER_CONN_MAX_SOCKETS; i++)
+	{
+		http_server_conn_t *other = &http_server_conns[i];
+
+		if (other->fd < 0 || other->closing || memcmp(other->peer, conn->peer, sizeof(conn->peer)) != 0)
+		{
+			continue;
+		}
+		count++;
+		if (other != conn && (oldest == NULL || other->last_active_us < oldest->last_active_us))
+		{
+			oldest = other;
+		}
+	}
+
+	if (count > HTTP_SERVER_CONN_MAX_PER_CLIENT && oldest != NULL)
+	{
+		APP_LOGD(TAG, "Client holds %u sockets, closing socket %d", (unsigned)count, oldest->fd);
+		http_server_conn_close(hd, oldest);
+		http_server_conn_stats.client_evictions++;
+	}
+}
+
+/**
+ * Open hook of the server, tracks the new session and enforces the idle timeout and the share
+ * of each client.
+ * @param hd server handle.
+ * @param sockfd socket of the session.
+ * @return ESP_OK to keep the session.
+ */
+static esp_err_t http_server_conn_open(httpd_handle_t hd, int sockfd)
+{
+	int64_t now_us = esp_timer_get_time();
+	http_server_conn_t *conn = http_server_conn_find(-1);
+
+	http_server_conn_stats.opened++;
+	http_server_conn_close_idle(hd, now_us);
+
+	// The server never holds more sessions than the table, keep the socket untracked otherwise
+	if (conn == NULL)
+	{
+		APP_LOGW(TAG, "No free entry for socket %d", sockfd);
+		return ESP_OK;
+	}
+
+	conn->fd = sockfd;
+	conn->closing = false;
+	conn->last_active_us = now_us;
+	conn->requests = 0;
+	http_server_conn_get_peer(sockfd, conn->peer);
+
+	http_server_conn_stats.open++;
+	if (http_server_conn_stats.open > http_server_conn_stats.peak)
+	{
+		http_server_conn_stats.peak = http_server_conn_stats.open;
+	}
+
+	http_server_conn_limit_client(hd, conn);
+
+	return ESP_OK;
+}
+
+/**
+ * Close hook of the server, frees the entry of the session and closes its socket.
+ * @param hd server handle.
+ * @param sockfd socket of the session, may already be closed by the network stack.
+ */
+static void http_server_conn_closed(httpd_handle_t hd, int sockfd)
+{
+	http_server_conn_t *conn = http_server_conn_find(sockfd);
+
+	if (conn != NULL)
+	{
+		conn->fd = -1;
+		http_server_conn_stats.open--;
+	}
+
+	// The server leaves closing the socket to the hook when one is set
+	close(sockfd);
+}
+
+void http_server_conn_configure(httpd_config_t *config)
+{
+	config->max_open_sockets = HTTP_SERVER_CONN_MAX_SOCKETS;
+	config->backlog_conn = HTTP_SERVER_CONN_BACKLOG;
+	config->lru_purge_enable = true;
+	config->recv_wait_timeout = HTTP_SERVER_CONN_RECV_TIMEOUT_S;
+	config->send_wait_timeout = HTTP_SERVER_CONN_SEND_TIMEOUT_S;
+	config->keep_alive_enable = true;
+	config->keep_alive_idle = HTTP_SERVER_CONN_KEEPALIVE_IDLE_S;
+	config->keep_alive_interval = HTTP_SERVER_CONN_KEEPALIVE_INTERVAL_S;
+	config->keep_alive_count = HTTP_SERVER_CONN_KEEPALIVE_COUNT;
+	config->open_fn = http_server_conn_open;
+	config->close_fn = http_server_conn_closed;
+}
+
+void http_server_conn_reset(void)
+{
+	for (size_t i = 0; i < HTTP_SERVER_CONN_MAX_SOCKETS; i++)
+	{
+		http_server_conns[i].fd = -1;
+	}
+	memset(&http_server_conn_stats, 0, sizeof(http_server_conn_stats));
+}
+
+void http_server_conn_request(httpd_req_t *req)
+{
+	http_server_conn_t *conn = http_server_conn_find(httpd_req_to_sockfd(req));
+
+	http_server_conn_stats.requests++;
+	if (conn == NULL)
+	{
+		return;
+	}
+
+	if (conn->requests > 0)
+	{
+		http_server_conn_stats.reused++;
+	}
+	conn->requests++;
+	conn->last_active_us = esp_timer_get_time();
+}
+
+void http_server_conn_get_stats(http_server_conn_stats_t *stats)
+{
+	*stats = http_server_conn_stats;
+}
@@ -0,0 +1,81 @@
+/**
+ * @file http_server_conn.h
+ * @brief Connection management of the HTTP server.
+ *
+ * The server task serves every socket, so each socket held by an idle browser tab is one less
+ * for the next phone joining the SoftAP. Sessions are tracked from the open and close hooks of
+ * the server:
+ *  - a client keeps at most HTTP_SERVER_CONN_MAX_PER_CLIENT sockets, opening another closes its
+ *    least recently used one, so one phone cannot take the whole pool,
+ *  - sessions idle for HTTP_SERVER_CONN_IDLE_TIMEOUT_S are closed when a new client connects,
+ *  - when the pool is full the server itself closes the least recently used session
+ *    (lru_purge_enable).
+ * Requests are counted per session to tell how often keep-alive connections are reused.
+ */
+#ifndef MAIN_HTTP_SERVER_CONN_H_
+#define MAIN_HTTP_SERVER_CONN_H_
+
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Sockets of the pool, at most CONFIG_LWIP_MAX_SOCKETS - 3, see sdkconfig.defaults
+#define HTTP_SERVER_CONN_MAX_SOCKETS      10
+
+// Sockets a single client address may hold, browsers open up to six
+#define HTTP_SERVER_CONN_MAX_PER_CLIENT   4
+
+// Connections waiting to be accepted
+#define HTTP_SERVER_CONN_BACKLOG          8
+
+// Idle time after which a session is closed
+#define HTTP_SERVER_CONN_IDLE_TIMEOUT_S   20
+
+// Longest a stalled client can hold the server task in a single receive or send
+#define HTTP_SERVER_CONN_RECV_TIMEOUT_S   5
+#define HTTP_SERVER_CONN_SEND_TIMEOUT_S   5
+
+// TCP keep-alive probes, sockets of clients which left the SoftAP are closed after about 15 s
+#define HTTP_SERVER_CONN_KEEPALIVE_IDLE_S      5
+#define HTTP_SERVER_CONN_KEEPALIVE_INTERVAL_S  5
+#define HTTP_SERVER_CONN_KEEPALIVE_COUNT       3
+
+/**
+ * Connection counters since the server started.
+ */
+typedef struct http_server_conn_stats
+{
+	uint32_t open;                // Sessions open now
+	uint32_t peak;                // Most sessions open at once
+	uint32_t opened;              // Sessions accepted
+	uint32_t requests;            // Requests handled
+	uint32_t reused;              // Requests on a session which had served one before
+	uint32_t client_evictions;    // Sessions closed to keep a client within its share
+	uint32_t idle_closes;         // Sessions closed for being idle
+} http_server_conn_stats_t;
+
+/**
+ * Sets the pool, timeouts and hooks of the server configuration.
+ * @param config configuration passed to httpd_start().
+ */
+void http_server_conn_configure(httpd_config_t *config);
+
+/**
+ * Clears the session table and counters. Called before the server starts.
+ */
+void http_server_conn_reset(void);
+
+/**
+ * Accounts a request to its session. Called by the server task for every request.
+ * @param req HTTP request.
+ */
+void http_server_conn_request(httpd_req_t *req);
+
+/**
+ * Copies the counters. Only called by the server task, e.g. from a URI handler.
+ * @param stats output.
+ */
+void http_server_conn_get_stats(http_server_conn_stats_t *stats);
+
+#endif /* MAIN_HTTP_SERVER_CONN_H_ */
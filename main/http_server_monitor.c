@@ -1,6 +1,8 @@
-#include "esp_log.h"
+#include "app_log.h"
 #include "esp_timer.h"
 
+#include "device_state.h"
+#include "event_bus.h"
 #include "http_server_monitor.h"
 #include "http_handlers_ota.h"
 #include "http_handlers_wifi.h"
@@ -8,8 +10,8 @@
 
 static const char TAG[] = "http_server_monitor";
 
-// Externally accessible handlers (declared in http_server.c)
-extern QueueHandle_t http_server_monitor_queue_handle;
+// Event bus subscription (declared in http_server.c)
+extern event_bus_subscriber_handle_t http_server_monitor_subscriber;
 
 /**
  * HTTP server monitor task used to track events of the HTTP server
@@ -17,48 +19,63 @@ extern QueueHandle_t http_server_monitor_queue_handle;
  */
 void http_server_monitor(void *pvParameters)
 {
-	http_server_queue_message_t msg;
+	event_bus_event_t msg;
 
 	for (;;)
 	{
-		if (xQueueReceive(http_server_monitor_queue_handle, &msg, portMAX_DELAY))
+		if (event_bus_receive(http_server_monitor_subscriber, &msg, portMAX_DELAY))
 		{
-			switch (msg.msgID)
+			switch (msg.id)
 			{
 				case HTTP_MSG_WIFI_CONNECT_INIT:
-					ESP_LOGI(TAG, "HTTP_MSG_WIFI_CONNECT_INIT");
-					g_wifi_connect_status = HTTP_WIFI_STATUS_CONNECTING;
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_CONNECT_INIT");
+					device_state_set_wifi_connect_status(HTTP_WIFI_STATUS_CONNECTING);
 
 					break;
 				case HTTP_MSG_WIFI_CONNECT_SUCCESS:
-					ESP_LOGI(TAG, "HTTP_MSG_WIFI_CONNECT_SUCCESS");
-					g_wifi_connect_status = HTTP_WIFI_STATUS_CONNECT_SUCCESS;
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_CONNECT_SUCCESS");
+					device_state_set_wifi_connect_status(HTTP_WIFI_STATUS_CONNECT_SUCCESS);
 
 					break;
 				case HTTP_MSG_WIFI_CONNECT_FAIL:
-					ESP_LOGI(TAG, "HTTP_MSG_WIFI_CONNECT_FAIL");
-					g_wifi_connect_status = HTTP_WIFI_STATUS_CONNECT_FAILED;
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_CONNECT_FAIL");
+					device_state_set_wifi_connect_status(HTTP_WIFI_STATUS_CONNECT_FAILED);
 
 					break;
 				case HTTP_MSG_WIFI_USER_DISCONNECT:
-					ESP_LOGI(TAG, "HTTP_MSG_WIFI_USER_DISCONNECT");
-					g_wifi_connect_status = HTTP_WIFI_STATUS_DISCONNECTED;
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_USER_DISCONNECT");
+					device_state_set_wifi_connect_status(HTTP_WIFI_STATUS_DISCONNECTED);
 
 					break;
 				case HTTP_MSG_OTA_UPDATE_SUCCESSFUL:
-					ESP_LOGI(TAG, "HTTP_MSG_OTA_UPDATE_SUCCESSFUL");
-					g_fw_update_status = OTA_UPDATE_SUCCESSFUL;
+					APP_LOGI(TAG, "HTTP_MSG_OTA_UPDATE_SUCCESSFUL");
+					device_state_set_fw_update_status(OTA_UPDATE_SUCCESSFUL);
 					http_server_fw_update_reset_timer();
 
 					break;
 				case HTTP_MSG_OTA_UPDATE_FAILED:
-					ESP_LOGI(TAG, "HTTP_MSG_OTA_UPDATE_FAILED");
-					g_fw_update_status = OTA_UPDATE_FAILED;
+					APP_LOGI(TAG, "HTTP_MSG_OTA_UPDATE_FAILED");
+					device_state_set_fw_update_status(OTA_UPDATE_FAILED);
 					
 					break;
 				case HTTP_MSG_TIME_SERVICE_INITIALIZED:
-					ESP_LOGI(TAG, "HTTP_MSG_TIME_SERVICE_INITIALIZED");
-					g_is_local_time_set = true;
+					APP_LOGI(TAG, "HTTP_MSG_TIME_SERVICE_INITIALIZED");
+					device_state_set_local_time_set(true);
+
+					break;
+				case HTTP_MSG_WIFI_LINK_DEGRADED:
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_LINK_DEGRADED");
+					device_state_set_wifi_link_degraded(true);
+
+					break;
+				case HTTP_MSG_WIFI_LINK_RECOVERED:
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_LINK_RECOVERED");
+					device_state_set_wifi_link_degraded(false);
+
+					break;
+				case HTTP_MSG_WIFI_ROAMED:
+					APP_LOGI(TAG, "HTTP_MSG_WIFI_ROAMED");
+					device_state_add_wifi_roam();
 
 					break;
 				default:
@@ -68,10 +85,21 @@ void http_server_monitor(void *pvParameters)
 	}
 }
 
-// Sends a message to the HTTP server monitor task
+// Publishes a message to the HTTP server monitor task
 BaseType_t http_server_monitor_send_message(http_server_message_e msgID)
 {
-	http_server_queue_message_t msg;
-	msg.msgID = msgID;
-	return xQueueSend(http_server_monitor_queue_handle, &msg, portMAX_DELAY);
+	uint32_t flags = EVENT_BUS_FLAG_NONE;
+
+	switch (msgID)
+	{
+		case HTTP_MSG_OTA_UPDATE_SUCCESSFUL:
+		case HTTP_MSG_OTA_UPDATE_FAILED:
+			flags = EVENT_BUS_FLAG_HIGH_PRIORITY;
+			break;
+		// State changes carry no value, the monitor applies them in publish order so none is merged
+		default:
+			break;
+	}
+
+	return event_bus_publish(EVENT_BUS_TOPIC_HTTP_MONITOR, msgID, 0, flags);
 }
\ No newline at end of file
@@ -14,22 +14,22 @@ typedef enum htpp_server_message {
 	HTTP_MSG_OTA_UPDATE_SUCCESSFUL,
 	HTTP_MSG_OTA_UPDATE_FAILED,
 	HTTP_MSG_TIME_SERVICE_INITIALIZED,
+	HTTP_MSG_WIFI_LINK_DEGRADED,
+	HTTP_MSG_WIFI_LINK_RECOVERED,
+	HTTP_MSG_WIFI_ROAMED,
 } http_server_message_e;
 
-// Struct for a message queue item
-typedef struct http_server_queue_message {
-    http_server_message_e msgID; 
-} http_server_queue_message_t;
+// Number of messages the monitor task can have pending
+#define HTTP_SERVER_MONITOR_QUEUE_DEPTH 8
 
 // Starts the HTTP server monitor task
 void http_server_monitor(void *pvParameters);
 
 
 /**
- * Sends a message to the HTTP server monitor task
+ * Publishes a message to the HTTP server monitor task on the event bus, never blocks.
  * @param msgID message ID from the http_server_message_e enum.
- * @return pdTRUE if an item was successfully sent to the queue, otherwise pdFALSE.
- * @note Expand the parameter list based on your requirements e.g. how you've expanded the http_server_queue_message_t.
+ * @return pdTRUE if the message was queued or coalesced, pdFALSE if it was dropped.
  */
 BaseType_t http_server_monitor_send_message(http_server_message_e msgID);
 
@@ -5,9 +5,10 @@
  * Author: Greg
  */
 
-#include "esp_log.h"
+#include "app_log.h"
 #include "nvs_flash.h"
 
+#include "app_nvs.h"
 #include "sntp_time_sync.h"
 #include "wifi_app.h"
 #include "dht11.h"
@@ -18,17 +19,11 @@ static const char TAG[] = "main";
 
 void wifi_application_connected_events(void)
 {
-    ESP_LOGI(TAG, "Wi-Fi application connected");
+    APP_LOGI(TAG, "Wi-Fi application connected");
     sntp_time_sync_task_start();
 
-    // aws
-    MQTTContext_t mqttContext;
-    MQTTFixedBuffer_t networkBuffer;
-    TransportInterface_t transport;
-
-    aws_iot_mqtt_connect(&mqttContext, &transport, &networkBuffer);
-    aws_iot_mqtt_publish(&mqttContext, "Hello from ESP32");
-    aws_iot_mqtt_subscribe(&mqttContext);
+    // AWS IoT session, including the device shadow
+    aws_iot_task_start();
 }
 
 void app_main(void)
@@ -47,6 +42,9 @@ void app_main(void)
     // }
 
 
+    // Log records are formatted by a background task from here on
+    app_log_init();
+
     // Initialize NVS (Non-Volatile Storage) for storing Wi-Fi credentials and other settings
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -56,14 +54,17 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
+    // Load the persisted settings once, later changes are committed in batches
+    ESP_ERROR_CHECK(app_nvs_init());
+
     // Start WiFi
     wifi_app_start();
 
     // Configure WiFi reset button
     wifi_reset_button_config();
 
-    // Start DHT11 sensor task
-    // DHT11_task_start();
+    // Start the sensor task, which feeds the telemetry, if the configuration has a sensor
+    DHT11_task_start();
 
     // Set connected event callback
     wifi_app_set_callback(&wifi_application_connected_events);
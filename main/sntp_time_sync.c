@@ -1,8 +1,11 @@
-#include "esp_log.h"
+#include <string.h>
+
+#include "app_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "lwip/apps/sntp.h"
 
+#include "app_nvs.h"
 #include "tasks_common.h"
 #include "http_server_monitor.h"
 #include "sntp_time_sync.h"
@@ -10,13 +13,16 @@
 
 static const char TAG[] = "sntp_time_sync";
 
+// Used when the configuration record has no timezone
+#define SNTP_TIME_SYNC_DEFAULT_TIMEZONE "GMT4"
+
 // SNTP operating mode set sstatus
 static bool sntp_op_mode_set = false;
 
 // Initialize SNTP service using SNTP_OPMODE_POLL
 static void sntp_time_sync_init_sntp(void)
 {
-  ESP_LOGI(TAG, "SNTP operating mode set to SNTP_OPMODE_POLL");
+  APP_LOGI(TAG, "SNTP operating mode set to SNTP_OPMODE_POLL");
   if (!sntp_op_mode_set) {
     sntp_setoperatingmode(SNTP_OPMODE_POLL);
     sntp_op_mode_set = true;
@@ -28,6 +34,24 @@ static void sntp_time_sync_init_sntp(void)
   http_server_monitor_send_message(HTTP_MSG_TIME_SERVICE_INITIALIZED);
 }
 
+/**
+ * Applies the timezone of the configuration record, so a changed setting takes effect without a restart.
+ * @param settings current device settings.
+ */
+static void sntp_time_sync_apply_timezone(const app_nvs_settings_t *settings)
+{
+  static char applied_timezone[APP_NVS_TIMEZONE_SIZE] = {0};
+  const char *timezone = (settings->timezone[0] != '\0') ? settings->timezone : SNTP_TIME_SYNC_DEFAULT_TIMEZONE;
+
+  if (strcmp(applied_timezone, timezone) != 0)
+  {
+    APP_LOGI(TAG, "Timezone set to %s", timezone);
+    strlcpy(applied_timezone, timezone, sizeof(applied_timezone));
+    setenv("TZ", timezone, 1);
+    tzset(); // Apply the timezone setting
+  }
+}
+
 /**
  * Gets the current time if the current time is not up to date.
  */
@@ -40,11 +64,9 @@ static void sntp_time_sync_obtain_time(void)
 
   // Check the time, in case we need to initialize/reinitialize SNTP
   if (time_info.tm_year < (2016 - 1900)) {
-    ESP_LOGI(TAG, "Time not set yet. Initializing SNTP...");
+    APP_LOGI(TAG, "Time not set yet. Initializing SNTP...");
     
     sntp_time_sync_init_sntp();
-    setenv("TZ", "GMT4", 1); // Set timezone to GMT+4
-    tzset(); // Apply the timezone setting
 
     sntp_setservername(0, "pool.ntp.org");
   }
@@ -56,9 +78,13 @@ static void sntp_time_sync_obtain_time(void)
  */
 static void sntp_time_sync(void *pvParam)
 {
+  app_nvs_settings_t settings;
+
   while (1) {
+    app_nvs_get_settings(&settings);
+    sntp_time_sync_apply_timezone(&settings);
     sntp_time_sync_obtain_time();
-    vTaskDelay(10000 / portTICK_PERIOD_MS);
+    vTaskDelay(pdMS_TO_TICKS(settings.time_sync_period_ms));
   }
 
   vTaskDelete(NULL);
@@ -74,11 +100,11 @@ char *sntp_time_sync_get_time(void)
   localtime_r(&now, &time_info);
 
   if(time_info.tm_year < (2016 - 1900) ) {
-    ESP_LOGI(TAG, "Time not set yet. Initializing SNTP...");
+    APP_LOGI(TAG, "Time not set yet. Initializing SNTP...");
   } else {
     // Format the time into a string
     strftime(time_buffer, sizeof(time_buffer), "%Y-%m-%d %H:%M:%S", &time_info);
-    ESP_LOGI(TAG, "Current time: %s", time_buffer);
+    APP_LOGI(TAG, "Current time: %s", time_buffer);
   }
   return time_buffer;
 }
@@ -0,0 +1,283 @@
+/**
+ * @file telemetry_codec.c
+ * @brief Encodings of sensor telemetry batches.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry_codec.h"
+
+// LZ4 block format limits: a match is at least 4 bytes long, the last one starts at least
+// 12 bytes before the end and the last 5 bytes are always literals
+#define TELEMETRY_LZ4_MIN_MATCH        4
+#define TELEMETRY_LZ4_MF_LIMIT         12
+#define TELEMETRY_LZ4_LAST_LITERALS    5
+#define TELEMETRY_LZ4_HASH_BITS        9
+
+/**
+ * Output cursor, writes past the end are dropped and mark the output as overflowed.
+ */
+typedef struct telemetry_writer
+{
+  uint8_t *buf;
+  size_t len;
+  size_t offset;
+  bool overflow;
+} telemetry_writer_t;
+
+static void telemetry_put_u8(telemetry_writer_t *writer, uint8_t value)
+{
+  if (writer->offset < writer->len)
+  {
+    writer->buf[writer->offset++] = value;
+  }
+  else
+  {
+    writer->overflow = true;
+  }
+}
+
+static void telemetry_put_bytes(telemetry_writer_t *writer, const uint8_t *data, size_t len)
+{
+  if (len > writer->len - writer->offset)
+  {
+    writer->overflow = true;
+    return;
+  }
+
+  memcpy(writer->buf + writer->offset, data, len);
+  writer->offset += len;
+}
+
+static void telemetry_put_uvarint(telemetry_writer_t *writer, uint64_t value)
+{
+  while (value >= 0x80)
+  {
+    telemetry_put_u8(writer, (uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  telemetry_put_u8(writer, (uint8_t)value);
+}
+
+static void telemetry_put_svarint(telemetry_writer_t *writer, int64_t value)
+{
+  telemetry_put_uvarint(writer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+size_t telemetry_encode_json(const telemetry_sample_t *samples, size_t count, char *buf, size_t len)
+{
+  size_t offset = snprintf(buf, len, "{\"samples\":[");
+
+  for (size_t i = 0; i < count && offset < len; i++)
+  {
+    offset += snprintf(buf + offset, len - offset,
+                       "%s{\"ts\":%" PRId64 ",\"sensor\":%u,\"temperature\":%d,\"humidity\":%d}",
+                       (i == 0) ? "" : ",", samples[i].time_ms, samples[i].sensor,
+                       samples[i].temperature, samples[i].humidity);
+  }
+  if (offset < len)
+  {
+    offset += snprintf(buf + offset, len - offset, "]}");
+  }
+
+  return (offset < len) ? offset : 0;
+}
+
+/**
+ * Returns true if samples[i] is the first sample of its sensor, which starts a series.
+ */
+static bool telemetry_series_start(const telemetry_sample_t *samples, size_t i)
+{
+  for (size_t j = 0; j < i; j++)
+  {
+    if (samples[j].sensor == samples[i].sensor)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Writes the series of one sensor.
+ */
+static void telemetry_put_series(telemetry_writer_t *writer, const telemetry_sample_t *samples, size_t count,
+                                 uint8_t sensor)
+{
+  const telemetry_sample_t *prev = NULL;
+  size_t n = 0;
+  int64_t delta = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    n += (samples[i].sensor == sensor) ? 1 : 0;
+  }
+
+  telemetry_put_u8(writer, sensor);
+  telemetry_put_uvarint(writer, n);
+
+  // Times, then the temperature and humidity columns, each column holds similar values
+  for (size_t i = 0; i < count; i++)
+  {
+    if (samples[i].sensor != sensor)
+    {
+      continue;
+    }
+    if (prev == NULL)
+    {
+      telemetry_put_uvarint(writer, (uint64_t)samples[i].time_ms);
+    }
+    else
+    {
+      int64_t next = (int64_t)((uint64_t)samples[i].time_ms - (uint64_t)prev->time_ms);
+
+      telemetry_put_svarint(writer, (int64_t)((uint64_t)next - (uint64_t)delta));
+      delta = next;
+    }
+    prev = &samples[i];
+  }
+
+  prev = NULL;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (samples[i].sensor == sensor)
+    {
+      telemetry_put_svarint(writer, samples[i].temperature - ((prev != NULL) ? prev->temperature : 0));
+      prev = &samples[i];
+    }
+  }
+
+  prev = NULL;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (samples[i].sensor == sensor)
+    {
+      telemetry_put_svarint(writer, samples[i].humidity - ((prev != NULL) ? prev->humidity : 0));
+      prev = &samples[i];
+    }
+  }
+}
+
+size_t telemetry_encode_series(const telemetry_sample_t *samples, size_t count, uint8_t *buf, size_t len)
+{
+  telemetry_writer_t writer = { .buf = buf, .len = len };
+  size_t series = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    series += telemetry_series_start(samples, i) ? 1 : 0;
+  }
+
+  telemetry_put_u8(&writer, TELEMETRY_SERIES_VERSION);
+  telemetry_put_uvarint(&writer, series);
+
+  // Series follow the first appearance of their sensor in the batch
+  for (size_t i = 0; i < count; i++)
+  {
+    if (telemetry_series_start(samples, i))
+    {
+      telemetry_put_series(&writer, samples, count, samples[i].sensor);
+    }
+  }
+
+  return writer.overflow ? 0 : writer.offset;
+}
+
+/**
+ * Writes the remainder of an LZ4 length which did not fit in its token nibble.
+ */
+static void telemetry_put_lz4_length(telemetry_writer_t *writer, size_t len)
+{
+  while (len >= 255)
+  {
+    telemetry_put_u8(writer, 255);
+    len -= 255;
+  }
+  telemetry_put_u8(writer, (uint8_t)len);
+}
+
+/**
+ * Writes one LZ4 sequence: literals, then a match unless match_len is 0.
+ */
+static void telemetry_put_lz4_sequence(telemetry_writer_t *writer, const uint8_t *literals, size_t literal_len,
+                                       uint16_t offset, size_t match_len)
+{
+  size_t match_code = (match_len > 0) ? match_len - TELEMETRY_LZ4_MIN_MATCH : 0;
+
+  telemetry_put_u8(writer, (uint8_t)(((literal_len < 15) ? literal_len : 15) << 4 |
+                                     ((match_code < 15) ? match_code : 15)));
+  if (literal_len >= 15)
+  {
+    telemetry_put_lz4_length(writer, literal_len - 15);
+  }
+  telemetry_put_bytes(writer, literals, literal_len);
+
+  if (match_len > 0)
+  {
+    telemetry_put_u8(writer, (uint8_t)offset);
+    telemetry_put_u8(writer, (uint8_t)(offset >> 8));
+    if (match_code >= 15)
+    {
+      telemetry_put_lz4_length(writer, match_code - 15);
+    }
+  }
+}
+
+static uint32_t telemetry_read_u32(const uint8_t *p)
+{
+  uint32_t value;
+
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+size_t telemetry_compress(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len)
+{
+  // Last position + 1 of each hash, 0 if none
+  uint16_t table[1 << TELEMETRY_LZ4_HASH_BITS] = { 0 };
+  telemetry_writer_t writer = { .buf = dst, .len = (dst_len < src_len) ? dst_len : src_len };
+  size_t anchor = 0;
+  size_t pos = 0;
+
+  if (src_len > TELEMETRY_COMPRESS_MAX_INPUT)
+  {
+    return 0;
+  }
+
+  telemetry_put_uvarint(&writer, src_len);
+
+  while (src_len > TELEMETRY_LZ4_MF_LIMIT && pos < src_len - TELEMETRY_LZ4_MF_LIMIT && !writer.overflow)
+  {
+    uint32_t sequence = telemetry_read_u32(src + pos);
+    uint32_t hash = (sequence * 2654435761u) >> (32 - TELEMETRY_LZ4_HASH_BITS);
+    size_t candidate = table[hash];
+
+    table[hash] = (uint16_t)(pos + 1);
+    if (candidate == 0 || telemetry_read_u32(src + candidate - 1) != sequence)
+    {
+      pos++;
+      continue;
+    }
+
+    size_t match = candidate - 1;
+    size_t match_len = TELEMETRY_LZ4_MIN_MATCH;
+
+    while (pos + match_len < src_len - TELEMETRY_LZ4_LAST_LITERALS && src[match + match_len] == src[pos + match_len])
+    {
+      match_len++;
+    }
+
+    telemetry_put_lz4_sequence(&writer, src + anchor, pos - anchor, (uint16_t)(pos - match), match_len);
+    pos += match_len;
+    anchor = pos;
+  }
+
+  telemetry_put_lz4_sequence(&writer, src + anchor, src_len - anchor, 0, 0);
+
+  // Equal length counts as a failure too, the compressed form would only cost the decoder time
+  return (writer.overflow || writer.offset >= src_len) ? 0 : writer.offset;
+}
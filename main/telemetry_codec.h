@@ -0,0 +1,80 @@
+/**
+ * @file telemetry_codec.h
+ * @brief Encodings of sensor telemetry batches.
+ *
+ * A batch is published either as JSON or as a compact binary time series, and either one can be
+ * compressed with LZ4. The publish topic names the encoding, see aws_telemetry.h, and
+ * tools/telemetry_decode.py is the reference decoder of all of them.
+ *
+ * Time series (version 1), samples grouped by sensor in the order of the batch:
+ *   u8      version, TELEMETRY_SERIES_VERSION
+ *   uvarint number of series
+ *   per series:
+ *     u8      sensor index
+ *     uvarint number of samples n
+ *     uvarint time of the first sample, milliseconds since the epoch
+ *     svarint n - 1 delta-of-deltas of the time, the delta before the first one counts as zero
+ *     svarint first temperature, then n - 1 deltas
+ *     svarint first humidity, then n - 1 deltas
+ * uvarint is unsigned LEB128, svarint is a zigzag encoded uvarint. Samples taken at a steady
+ * period with slowly changing values encode to about three bytes each.
+ *
+ * Compressed payloads are the uvarint size of the original payload followed by one LZ4 block.
+ */
+#ifndef MAIN_TELEMETRY_CODEC_H_
+#define MAIN_TELEMETRY_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TELEMETRY_SERIES_VERSION       1
+
+// Buffer sizes which fit any batch of n samples
+#define TELEMETRY_JSON_MAX_SIZE(n)     (16 + (n) * 80)
+#define TELEMETRY_SERIES_MAX_SIZE(n)   (11 + (n) * 27)
+
+// Largest payload telemetry_compress() accepts
+#define TELEMETRY_COMPRESS_MAX_INPUT   UINT16_MAX
+
+/**
+ * A sensor reading.
+ */
+typedef struct telemetry_sample
+{
+  int64_t time_ms;          // Milliseconds since the epoch
+  uint8_t sensor;           // Index in the sensor table
+  int16_t temperature;      // Tenths of a degree Celsius
+  int16_t humidity;         // Tenths of a percent
+} telemetry_sample_t;
+
+/**
+ * Encodes a batch as a JSON object with a "samples" array, values in tenths as read.
+ * @param samples samples of the batch.
+ * @param count number of samples.
+ * @param buf output buffer, TELEMETRY_JSON_MAX_SIZE(count) bytes is enough.
+ * @param len size of buf.
+ * @return length of the NUL terminated output, or 0 if it does not fit.
+ */
+size_t telemetry_encode_json(const telemetry_sample_t *samples, size_t count, char *buf, size_t len);
+
+/**
+ * Encodes a batch as a version 1 time series.
+ * @param samples samples of the batch, in time order per sensor.
+ * @param count number of samples.
+ * @param buf output buffer, TELEMETRY_SERIES_MAX_SIZE(count) bytes is enough.
+ * @param len size of buf.
+ * @return length of the output, or 0 if it does not fit.
+ */
+size_t telemetry_encode_series(const telemetry_sample_t *samples, size_t count, uint8_t *buf, size_t len);
+
+/**
+ * Compresses a payload with LZ4, using about 1 KB of stack.
+ * @param src payload, at most TELEMETRY_COMPRESS_MAX_INPUT bytes.
+ * @param src_len length of the payload.
+ * @param dst output buffer.
+ * @param dst_len size of dst.
+ * @return length of the output, or 0 if it would not be shorter than the payload or not fit.
+ */
+size_t telemetry_compress(const uint8_t *src, size_t src_len, uint8_t *dst, size_t dst_len);
+
+#endif /* MAIN_TELEMETRY_CODEC_H_ */
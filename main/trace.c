@@ -0,0 +1,309 @@
+/**
+ * @file trace.c
+ * @brief Binary event trace of the hot paths.
+ */
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+// Sequence number of a record header while the record is being written
+#define TRACE_SEQ_BUSY                 0x8000
+#define TRACE_SEQ_MASK                 0x7FFF
+
+// Export stages, in the order they are written
+#define TRACE_STAGE_HEADER             0
+#define TRACE_STAGE_TASKS              1
+#define TRACE_STAGE_EVENTS             2
+#define TRACE_STAGE_LABELS             3
+#define TRACE_STAGE_RECORDS            4
+#define TRACE_STAGE_DONE               5
+
+#define TRACE_HEADER_SIZE              16
+#define TRACE_LABEL_ENTRY_SIZE         (8 + TRACE_LABEL_SIZE)
+
+/**
+ * A record in the ring. The header packs the sequence number, task and event and is written
+ * last, a reader copies the record and keeps it only if the header did not change meanwhile.
+ */
+typedef struct trace_slot
+{
+  _Atomic uint32_t header;            // sequence << 16 | task << 8 | event
+  _Atomic uint32_t timestamp_us;      // Relaxed atomics, plain loads and stores on the target
+  _Atomic uint32_t arg0;
+  _Atomic uint32_t arg1;
+} trace_slot_t;
+
+/**
+ * Name and Chrome trace phase of an event.
+ */
+typedef struct trace_event_info
+{
+  char phase;
+  const char *name;
+} trace_event_info_t;
+
+/**
+ * Name of an argument value of an event.
+ */
+typedef struct trace_label
+{
+  uint8_t event;
+  uint32_t arg0;
+  const char *label;
+} trace_label_t;
+
+static const trace_event_info_t trace_events[TRACE_EVENT_COUNT] = {
+  [TRACE_EVENT_HTTP_REQUEST_BEGIN] = { 'B', "http_request" },
+  [TRACE_EVENT_HTTP_REQUEST_END]   = { 'E', "http_request" },
+  [TRACE_EVENT_OTA_BEGIN_BEGIN]    = { 'B', "ota_begin" },
+  [TRACE_EVENT_OTA_BEGIN_END]      = { 'E', "ota_begin" },
+  [TRACE_EVENT_OTA_CHUNK]          = { 'i', "ota_chunk" },
+  [TRACE_EVENT_OTA_WRITE_BEGIN]    = { 'B', "ota_write" },
+  [TRACE_EVENT_OTA_WRITE_END]      = { 'E', "ota_write" },
+  [TRACE_EVENT_WIFI_EVENT]         = { 'i', "wifi_event" },
+  [TRACE_EVENT_WIFI_SM_BEGIN]      = { 'B', "wifi_sm" },
+  [TRACE_EVENT_WIFI_SM_END]        = { 'E', "wifi_sm" },
+  [TRACE_EVENT_MQTT_RECEIVE]       = { 'i', "mqtt_receive" },
+  [TRACE_EVENT_MQTT_PUBLISH_BEGIN] = { 'B', "mqtt_publish" },
+  [TRACE_EVENT_MQTT_PUBLISH_END]   = { 'E', "mqtt_publish" },
+  [TRACE_EVENT_MQTT_PING_BEGIN]    = { 'B', "mqtt_ping" },
+  [TRACE_EVENT_MQTT_PING_END]      = { 'E', "mqtt_ping" },
+};
+
+static trace_slot_t trace_ring[TRACE_BUFFER_RECORDS];
+static _Atomic uint32_t trace_next = 0;
+
+// Tasks which recorded events, a slot is claimed once and never released
+static atomic_uintptr_t trace_tasks[TRACE_MAX_TASKS];
+static char trace_task_names[TRACE_MAX_TASKS][TRACE_TASK_NAME_SIZE];
+
+static trace_label_t trace_labels[TRACE_MAX_LABELS];
+static atomic_uint trace_label_count = 0;
+static portMUX_TYPE trace_label_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Returns the index of the calling task in the task table, claiming a slot on its first event.
+ */
+static uint8_t trace_task_index(void)
+{
+  uintptr_t self = (uintptr_t)xTaskGetCurrentTaskHandle();
+
+  for (uint8_t i = 0; i < TRACE_MAX_TASKS; i++)
+  {
+    uintptr_t task = atomic_load_explicit(&trace_tasks[i], memory_order_acquire);
+
+    if (task == 0)
+    {
+      // Another task may claim the slot first, it is then checked like any other
+      if (atomic_compare_exchange_strong(&trace_tasks[i], &task, self))
+      {
+        strlcpy(trace_task_names[i], pcTaskGetName(NULL), TRACE_TASK_NAME_SIZE);
+        return i;
+      }
+    }
+    if (task == self)
+    {
+      return i;
+    }
+  }
+
+  return TRACE_TASK_OTHER;
+}
+
+void trace_record(trace_event_e event, uint32_t arg0, uint32_t arg1)
+{
+  uint32_t number = atomic_fetch_add_explicit(&trace_next, 1, memory_order_relaxed);
+  trace_slot_t *slot = &trace_ring[number % TRACE_BUFFER_RECORDS];
+  uint32_t header = (number & TRACE_SEQ_MASK) << 16 | (uint32_t)trace_task_index() << 8 | (uint8_t)event;
+
+  atomic_store_explicit(&slot->header, (uint32_t)TRACE_SEQ_BUSY << 16, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->timestamp_us, (uint32_t)esp_timer_get_time(), memory_order_relaxed);
+  atomic_store_explicit(&slot->arg0, arg0, memory_order_relaxed);
+  atomic_store_explicit(&slot->arg1, arg1, memory_order_relaxed);
+  atomic_store_explicit(&slot->header, header, memory_order_release);
+}
+
+void trace_set_label(trace_event_e event, uint32_t arg0, const char *label)
+{
+  taskENTER_CRITICAL(&trace_label_lock);
+  unsigned count = atomic_load(&trace_label_count);
+  if (count < TRACE_MAX_LABELS)
+  {
+    trace_labels[count] = (trace_label_t){ .event = event, .arg0 = arg0, .label = label };
+    atomic_store(&trace_label_count, count + 1);
+  }
+  taskEXIT_CRITICAL(&trace_label_lock);
+}
+
+static void trace_put_u32(uint8_t *buf, uint32_t value)
+{
+  buf[0] = (uint8_t)value;
+  buf[1] = (uint8_t)(value >> 8);
+  buf[2] = (uint8_t)(value >> 16);
+  buf[3] = (uint8_t)(value >> 24);
+}
+
+/**
+ * Returns the number of claimed slots of the task table.
+ */
+static uint8_t trace_task_count(void)
+{
+  uint8_t count = 0;
+
+  while (count < TRACE_MAX_TASKS && atomic_load(&trace_tasks[count]) != 0)
+  {
+    count++;
+  }
+
+  return count;
+}
+
+/**
+ * Copies record number of the ring into buf.
+ * @return true if the record is still in the ring and was not being written.
+ */
+static bool trace_copy_record(uint32_t number, uint8_t *buf)
+{
+  trace_slot_t *slot = &trace_ring[number % TRACE_BUFFER_RECORDS];
+  uint32_t header = atomic_load_explicit(&slot->header, memory_order_acquire);
+
+  if (header >> 16 != (number & TRACE_SEQ_MASK))
+  {
+    return false;
+  }
+
+  trace_put_u32(buf, atomic_load_explicit(&slot->timestamp_us, memory_order_relaxed));
+  trace_put_u32(buf + 4, header);
+  trace_put_u32(buf + 8, atomic_load_explicit(&slot->arg0, memory_order_relaxed));
+  trace_put_u32(buf + 12, atomic_load_explicit(&slot->arg1, memory_order_relaxed));
+
+  atomic_thread_fence(memory_order_acquire);
+  return atomic_load_explicit(&slot->header, memory_order_relaxed) == header;
+}
+
+void trace_export_begin(trace_export_t *export)
+{
+  export->stage = TRACE_STAGE_HEADER;
+  export->item = 0;
+  export->end = atomic_load(&trace_next);
+  export->first = (export->end > TRACE_BUFFER_RECORDS) ? export->end - TRACE_BUFFER_RECORDS : 0;
+  export->tasks = trace_task_count();
+  export->labels = (uint8_t)atomic_load(&trace_label_count);
+}
+
+size_t trace_export_read(trace_export_t *export, uint8_t *buf, size_t len)
+{
+  size_t offset = 0;
+
+  while (export->stage != TRACE_STAGE_DONE)
+  {
+    uint8_t *out = buf + offset;
+    size_t size;
+
+    switch (export->stage)
+    {
+      case TRACE_STAGE_HEADER:
+        size = TRACE_HEADER_SIZE;
+        if (len - offset < size)
+        {
+          return offset;
+        }
+        memcpy(out, "TRC1", 4);
+        out[4] = export->tasks;
+        out[5] = TRACE_EVENT_COUNT;
+        out[6] = export->labels;
+        out[7] = 0;
+        trace_put_u32(out + 8, export->first);
+        trace_put_u32(out + 12, export->end);
+        export->stage = TRACE_STAGE_TASKS;
+        break;
+
+      case TRACE_STAGE_TASKS:
+        if (export->item >= export->tasks)
+        {
+          export->stage = TRACE_STAGE_EVENTS;
+          export->item = 0;
+          continue;
+        }
+        size = TRACE_TASK_NAME_SIZE;
+        if (len - offset < size)
+        {
+          return offset;
+        }
+        memset(out, 0, size);
+        strlcpy((char *)out, trace_task_names[export->item++], size);
+        break;
+
+      case TRACE_STAGE_EVENTS:
+        if (export->item >= TRACE_EVENT_COUNT)
+        {
+          export->stage = TRACE_STAGE_LABELS;
+          export->item = 0;
+          continue;
+        }
+        size = TRACE_EVENT_NAME_SIZE;
+        if (len - offset < size)
+        {
+          return offset;
+        }
+        memset(out, 0, size);
+        out[0] = (uint8_t)trace_events[export->item].phase;
+        strlcpy((char *)out + 1, trace_events[export->item].name, size - 1);
+        export->item++;
+        break;
+
+      case TRACE_STAGE_LABELS:
+        if (export->item >= export->labels)
+        {
+          export->stage = TRACE_STAGE_RECORDS;
+          export->item = export->first;
+          continue;
+        }
+        size = TRACE_LABEL_ENTRY_SIZE;
+        if (len - offset < size)
+        {
+          return offset;
+        }
+        memset(out, 0, size);
+        out[0] = trace_labels[export->item].event;
+        trace_put_u32(out + 4, trace_labels[export->item].arg0);
+        strlcpy((char *)out + 8, trace_labels[export->item].label, TRACE_LABEL_SIZE);
+        export->item++;
+        break;
+
+      default:
+        if (export->item == export->end)
+        {
+          export->stage = TRACE_STAGE_DONE;
+          continue;
+        }
+        size = TRACE_RECORD_SIZE;
+        if (len - offset < size)
+        {
+          return offset;
+        }
+        // Records overwritten since the export began are left out
+        if (!trace_copy_record(export->item++, out))
+        {
+          size = 0;
+        }
+        break;
+    }
+
+    offset += size;
+  }
+
+  return offset;
+}
+
+#endif
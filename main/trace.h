@@ -0,0 +1,146 @@
+/**
+ * @file trace.h
+ * @brief Binary event trace of the hot paths.
+ *
+ * Events are written to a ring of fixed size records without locks or formatting, so they can
+ * be recorded from request handlers and data loops where a log line would cost more than the
+ * work it describes. The newest TRACE_BUFFER_RECORDS events are kept. The ring is downloaded
+ * as /trace.bin and tools/trace_to_chrome.py turns it into a Chrome trace.
+ *
+ * Export format, all integers little endian:
+ *   header        "TRC1", u8 task count, u8 event count, u8 label count, u8 reserved,
+ *                 u32 number of the first record, u32 records written since boot
+ *   tasks         task count x char[TRACE_TASK_NAME_SIZE], NUL padded, indexed by the record task
+ *   events        event count x (u8 phase 'B', 'E' or 'i', char[TRACE_EVENT_NAME_SIZE - 1])
+ *   labels        label count x (u8 event, u8 reserved[3], u32 arg0, char[TRACE_LABEL_SIZE])
+ *   records       u32 timestamp in microseconds since boot (wraps), u8 event, u8 task,
+ *                 u16 sequence number, u32 arg0, u32 arg1
+ */
+#ifndef MAIN_TRACE_H_
+#define MAIN_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Set to 0 to compile the trace points out
+#define TRACE_ENABLED                  1
+
+// Records kept by the ring, a power of two
+#define TRACE_BUFFER_RECORDS           512
+
+// Tasks told apart by the records, further tasks share TRACE_TASK_OTHER
+#define TRACE_MAX_TASKS                16
+#define TRACE_TASK_OTHER               0xFF
+
+// Labels naming event arguments, e.g. the URI of an HTTP route
+#define TRACE_MAX_LABELS               24
+
+// Field sizes of the export, including the terminator
+#define TRACE_TASK_NAME_SIZE           16
+#define TRACE_EVENT_NAME_SIZE          24
+#define TRACE_LABEL_SIZE               32
+
+// Size of one exported record
+#define TRACE_RECORD_SIZE              16
+
+/**
+ * Trace events. Begin and end events are recorded by the same task and show as one slice.
+ */
+typedef enum trace_event
+{
+  TRACE_EVENT_HTTP_REQUEST_BEGIN = 0, // arg0 route, arg1 HTTP method
+  TRACE_EVENT_HTTP_REQUEST_END,       // arg0 route, arg1 esp_err_t of the handler
+  TRACE_EVENT_OTA_BEGIN_BEGIN,        // arg0 content length
+  TRACE_EVENT_OTA_BEGIN_END,          // arg0 esp_err_t
+  TRACE_EVENT_OTA_CHUNK,              // arg0 bytes received so far, arg1 chunk length
+  TRACE_EVENT_OTA_WRITE_BEGIN,        // arg0 length
+  TRACE_EVENT_OTA_WRITE_END,          // arg0 esp_err_t
+  TRACE_EVENT_WIFI_EVENT,             // arg0 0 for WIFI_EVENT, 1 for IP_EVENT, arg1 event ID
+  TRACE_EVENT_WIFI_SM_BEGIN,          // arg0 wifi_sm_event_id_e, arg1 event value
+  TRACE_EVENT_WIFI_SM_END,            // arg0 previous wifi_sm_state_e, arg1 new state
+  TRACE_EVENT_MQTT_RECEIVE,           // arg0 packets handled, arg1 MQTTStatus_t
+  TRACE_EVENT_MQTT_PUBLISH_BEGIN,     // arg0 payload length
+  TRACE_EVENT_MQTT_PUBLISH_END,       // arg0 MQTTStatus_t
+  TRACE_EVENT_MQTT_PING_BEGIN,        // PINGREQ sent, arg0 idle time before it in ms
+  TRACE_EVENT_MQTT_PING_END,          // PINGRESP received
+  TRACE_EVENT_COUNT,
+} trace_event_e;
+
+/**
+ * Position of a download of the trace, the ring keeps recording meanwhile.
+ */
+typedef struct trace_export
+{
+  uint32_t stage;
+  uint32_t item;                      // Next item of the stage
+  uint32_t first;                     // Number of the first record in the export
+  uint32_t end;                       // Number of the first record written after trace_export_begin()
+  uint8_t tasks;                      // Tasks and labels announced by the header
+  uint8_t labels;
+} trace_export_t;
+
+#if TRACE_ENABLED
+
+/**
+ * Records an event. Lock-free, safe to call from any task.
+ * @param event event to record.
+ * @param arg0 first argument, meaning depends on the event.
+ * @param arg1 second argument.
+ */
+void trace_record(trace_event_e event, uint32_t arg0, uint32_t arg1);
+
+/**
+ * Names an argument value of an event in the export, e.g. the URI of an HTTP route.
+ * @param event event whose arg0 is named.
+ * @param arg0 value of arg0.
+ * @param label name, not copied, must stay valid.
+ */
+void trace_set_label(trace_event_e event, uint32_t arg0, const char *label);
+
+/**
+ * Starts an export of the records in the ring.
+ * @param export export state.
+ */
+void trace_export_begin(trace_export_t *export);
+
+/**
+ * Reads the next part of an export. Records overwritten since trace_export_begin() are skipped.
+ * @param export export state.
+ * @param buf output buffer, at least TRACE_LABEL_SIZE + 8 bytes.
+ * @param len size of buf.
+ * @return number of bytes written, 0 once the export is complete.
+ */
+size_t trace_export_read(trace_export_t *export, uint8_t *buf, size_t len);
+
+#else
+
+static inline void trace_record(trace_event_e event, uint32_t arg0, uint32_t arg1)
+{
+  (void)event;
+  (void)arg0;
+  (void)arg1;
+}
+
+static inline void trace_set_label(trace_event_e event, uint32_t arg0, const char *label)
+{
+  (void)event;
+  (void)arg0;
+  (void)label;
+}
+
+static inline void trace_export_begin(trace_export_t *export)
+{
+  (void)export;
+}
+
+static inline size_t trace_export_read(trace_export_t *export, uint8_t *buf, size_t len)
+{
+  (void)export;
+  (void)buf;
+  (void)len;
+  return 0;
+}
+
+#endif
+
+#endif /* MAIN_TRACE_H_ */
@@ -4,6 +4,7 @@
 var seconds = null;
 var otaTimerVar = null;
 var wifiConnectInterval = null;
+var wifiScanRetries = 0;
 
 /**
  * Initialize functions here.
@@ -14,6 +15,7 @@ $(document).ready(function () {
   startDHTSensorInterval();
   startLocalTimeInterval();
   getConnectInfo();
+  getWifiScan();
 
   $("#connect_wifi").on("click", function () {
     checkCredentials();
@@ -307,6 +309,27 @@ function getLocalTime() {
   });
 }
 
+/**
+ * Gets the networks seen by the last scan and offers them as SSID suggestions.
+ * Polls again while the ESP32 refreshes the results in the background.
+ */
+function getWifiScan() {
+  $.getJSON("/wifiScan.json", function (data) {
+    var list = $("#scan_ssids");
+    list.empty();
+    $.each(data["networks"], function (i, network) {
+      list.append($("<option>").attr("value", network["ssid"]).text(network["rssi"] + " dBm"));
+    });
+
+    if (data["scanning"] && wifiScanRetries < 5) {
+      wifiScanRetries++;
+      setTimeout(getWifiScan, 2000);
+    } else {
+      wifiScanRetries = 0;
+    }
+  });
+}
+
 /**
  * Gets the esp32's access point SSID for display on the web page.
  */
@@ -6,22 +6,33 @@
  */
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/event_groups.h"
 #include "freertos/task.h"
+#include "freertos/timers.h"
 #include "nvs_flash.h"
 #include "inttypes.h"
 
 #include "esp_err.h"
 #include "esp_log.h"
+#include "app_log.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "lwip/netdb.h"
+#include "sdkconfig.h"
+#if CONFIG_ESP_WIFI_WNM_SUPPORT
+#include "esp_wnm.h"
+#endif
 
 #include "app_nvs.h"
+#include "event_bus.h"
 #include "http_server.h"
 #include "http_server_monitor.h"
 #include "rgb_led.h"
 #include "tasks_common.h"
+#include "trace.h"
 #include "wifi_app.h"
+#include "wifi_link_monitor.h"
+#include "wifi_scan_cache.h"
+#include "wifi_sm.h"
 
 // Tag used for ESP serial console logging messages
 static const char TAG[] = "wifi_app";
@@ -32,18 +43,49 @@ static wifi_connected_event_callback_t wifi_connected_event_cb = NULL;
 // Used for returning the WiFi configuration
 wifi_config_t *wifi_config = NULL;
 
-// Used to track the number for retries when a connection attempt fails
-static int g_retry_number = 0;
+// Connection state machine, only used from the Wi-Fi application task
+static wifi_sm_t g_wifi_sm;
 
-// Wifi application event group handle and status bits
-static EventGroupHandle_t wifi_app_event_group;
-const int WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT = BIT0; // Bit for indicating that the app is connecting using saved credentials
-const int WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT = BIT1; // Bit for indicating that the app is connecting from the HTTP server
-const int WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT = BIT2; // Bit for indicating that the user requested a disconnect
-const int WIFI_APP_STA_CONNECTED_GOT_IP_BIT = BIT3; // Bit for indicating that the station has connected and got an IP address
+// Event raised by an action and fed to the state machine once the current action list is done
+static wifi_sm_event_t g_followup_event;
+static bool g_followup_pending = false;
 
-//Queue handle used to manipulate the main queue of events
-static QueueHandle_t wifi_app_queue_handle;
+// Access point of the last successful connection, used to connect without a full channel scan
+static app_nvs_fast_connect_t g_fast_connect;
+static bool g_fast_connect_valid = false;
+
+/**
+ * A saved network seen by the last scan, with the strongest access point advertising it.
+ */
+typedef struct wifi_app_candidate
+{
+  app_nvs_network_t network;
+  uint8_t bssid[6];
+  uint8_t channel;
+  int score;
+} wifi_app_candidate_t;
+
+// Saved networks in range, best first
+static wifi_app_candidate_t g_candidates[APP_NVS_MAX_NETWORKS];
+static size_t g_candidate_count = 0;
+
+// Set while a scan requested by the HTTP server to refresh the scan cache is running
+static bool g_scanning_for_cache = false;
+
+// Set while a roaming scan is running, and the access point it found
+static bool g_scanning_for_roam = false;
+static uint8_t g_roam_bssid[6];
+static uint8_t g_roam_channel = 0;
+
+// Set once the current access point was asked for a BSS transition (802.11v)
+static bool g_btm_query_sent = false;
+
+// Periodic link quality sampling and the backoff delay before rescanning for saved networks
+static TimerHandle_t wifi_link_timer = NULL;
+static TimerHandle_t wifi_retry_timer = NULL;
+
+// Event bus subscription of the Wi-Fi application task
+static event_bus_subscriber_handle_t wifi_app_subscriber;
 
 // netif objects for the Station and Access Point
 esp_netif_t *esp_netif_sta = NULL;
@@ -59,48 +101,47 @@ esp_netif_t *esp_netif_ap = NULL;
  */
 static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
+  trace_record(TRACE_EVENT_WIFI_EVENT, (event_base == WIFI_EVENT) ? 0 : 1, (uint32_t)event_id);
+
   if (event_base == WIFI_EVENT)
   {
     switch (event_id)
     {
       case WIFI_EVENT_AP_START:
-        ESP_LOGI(TAG, "WIFI_EVENT_AP_START");
+        APP_LOGI(TAG, "WIFI_EVENT_AP_START");
         break;
       case WIFI_EVENT_AP_STOP:
-        ESP_LOGI(TAG, "WIFI_EVENT_AP_STOP");
+        APP_LOGI(TAG, "WIFI_EVENT_AP_STOP");
         break;
       case WIFI_EVENT_AP_STACONNECTED:
-        ESP_LOGI(TAG, "WIFI_EVENT_AP_STACONNECTED");
+        APP_LOGI(TAG, "WIFI_EVENT_AP_STACONNECTED");
         break;
       case WIFI_EVENT_AP_STADISCONNECTED:
-        ESP_LOGI(TAG, "WIFI_EVENT_AP_STADISCONNECTED");
+        APP_LOGI(TAG, "WIFI_EVENT_AP_STADISCONNECTED");
+        break;
+
+      case WIFI_EVENT_SCAN_DONE:
+        APP_LOGI(TAG, "WIFI_EVENT_SCAN_DONE");
+        wifi_app_send_message(WIFI_APP_MSG_SCAN_DONE);
         break;
 
       case WIFI_EVENT_STA_START:
-        ESP_LOGI(TAG, "WIFI_EVENT_STA_START");
+        APP_LOGI(TAG, "WIFI_EVENT_STA_START");
         break;
       case WIFI_EVENT_STA_CONNECTED:
-        ESP_LOGI(TAG, "WIFI_EVENT_STA_CONNECTED");
+        APP_LOGI(TAG, "WIFI_EVENT_STA_CONNECTED");
+        break;
+      case WIFI_EVENT_STA_BSS_RSSI_LOW:
+        APP_LOGI(TAG, "WIFI_EVENT_STA_BSS_RSSI_LOW");
+        // Sample right away instead of waiting for the next period
+        wifi_app_send_message(WIFI_APP_MSG_LINK_SAMPLE);
         break;
       case WIFI_EVENT_STA_DISCONNECTED:
-        ESP_LOGI(TAG, "WIFI_EVENT_STA_DISCONNECTED");
-
-        wifi_event_sta_disconnected_t *wifi_event_sta_disconnected = (wifi_event_sta_disconnected_t *)malloc(sizeof(wifi_event_sta_disconnected_t));
-        *wifi_event_sta_disconnected = *((wifi_event_sta_disconnected_t *)event_data);
-        printf("WIFI_EVENT_STA_DISCONNECTED, Reason code: %d\n", wifi_event_sta_disconnected->reason);
+        wifi_event_sta_disconnected_t *wifi_event_sta_disconnected = (wifi_event_sta_disconnected_t *)event_data;
+        APP_LOGI(TAG, "WIFI_EVENT_STA_DISCONNECTED, reason code: %d", wifi_event_sta_disconnected->reason);
 
-        if (g_retry_number < MAX_CONNECTION_RETRIES)
-        {
-          g_retry_number++;
-          ESP_LOGI(TAG, "Retrying to connect to the AP, attempt %d", g_retry_number);
-          // Retry connecting to the AP
-          esp_wifi_connect();
-        }
-        else
-        {
-          ESP_LOGE(TAG, "Failed to connect to the AP after %d attempts", g_retry_number);
-          wifi_app_send_message(WIFI_APP_MSG_STA_DISCONNECTED);
-        }
+        // Retries and fallbacks are decided by the state machine in the task
+        wifi_app_send_message(WIFI_APP_MSG_STA_DISCONNECTED);
         break;
       
       default:
@@ -112,7 +153,7 @@ static void wifi_app_event_handler(void *arg, esp_event_base_t event_base, int32
     switch (event_id)
     {
       case IP_EVENT_STA_GOT_IP:
-        ESP_LOGI(TAG, "IP_EVENT_STA_GOT_IP");
+        APP_LOGI(TAG, "IP_EVENT_STA_GOT_IP");
         // Send a message to the queue indicating that the station has connected and got an IP address
         wifi_app_send_message(WIFI_APP_MSG_STA_CONNECTED_GOT_IP);
         break;
@@ -138,6 +179,23 @@ static void wifi_app_default_wifi_init(void)
   // Initialize the station netif
   esp_netif_sta = esp_netif_create_default_wifi_sta();
 
+#if WIFI_STA_STATIC_IP_ENABLED
+  // Skip the DHCP exchange, the GOT_IP event is raised as soon as the station connects
+  esp_netif_ip_info_t sta_ip_info;
+  esp_netif_dns_info_t sta_dns_info;
+  memset(&sta_ip_info, 0x00, sizeof(sta_ip_info));
+  memset(&sta_dns_info, 0x00, sizeof(sta_dns_info));
+
+  esp_netif_dhcpc_stop(esp_netif_sta);
+  inet_pton(AF_INET, WIFI_STA_STATIC_IP, &sta_ip_info.ip);
+  inet_pton(AF_INET, WIFI_STA_STATIC_GATEWAY, &sta_ip_info.gw);
+  inet_pton(AF_INET, WIFI_STA_STATIC_NETMASK, &sta_ip_info.netmask);
+  inet_pton(AF_INET, WIFI_STA_STATIC_DNS, &sta_dns_info.ip.u_addr.ip4);
+  sta_dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+  ESP_ERROR_CHECK(esp_netif_set_ip_info(esp_netif_sta, &sta_ip_info));
+  ESP_ERROR_CHECK(esp_netif_set_dns_info(esp_netif_sta, ESP_NETIF_DNS_MAIN, &sta_dns_info));
+#endif
+
   // ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
   
   // wifi_config_t sta_config = {
@@ -211,22 +269,519 @@ static void wifi_app_event_handler_init(void)
 
 /**
  * Connects to the ESP32 to an external AP using the updated station configuration.
+ * @param bssid access point to join without scanning every channel, NULL to scan for the SSID.
+ * @param channel channel of the access point, ignored when bssid is NULL.
  */
-static void wifi_app_connect_sta(void)
+static void wifi_app_connect_sta(const uint8_t *bssid, uint8_t channel)
 {
-  ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, wifi_app_get_wifi_config()));
+  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+
+  if (bssid != NULL)
+  {
+    memcpy(wifi_sta_config->sta.bssid, bssid, sizeof(wifi_sta_config->sta.bssid));
+    wifi_sta_config->sta.bssid_set = true;
+    wifi_sta_config->sta.channel = channel;
+    wifi_sta_config->sta.scan_method = WIFI_FAST_SCAN;
+  }
+  else
+  {
+    wifi_sta_config->sta.bssid_set = false;
+    wifi_sta_config->sta.channel = 0;
+    wifi_sta_config->sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+  }
+
+  // Let access points supporting 802.11k/v steer the station, used when supported by the driver configuration
+  wifi_sta_config->sta.rm_enabled = 1;
+  wifi_sta_config->sta.btm_enabled = 1;
+
+  ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, wifi_sta_config));
   ESP_ERROR_CHECK(esp_wifi_connect());
 }
 
+/**
+ * Queues an event for the state machine, fed once the current action list is done.
+ */
+static void wifi_app_sm_followup(wifi_sm_event_id_e id, uint8_t value)
+{
+  g_followup_event.id = id;
+  g_followup_event.value = value;
+  g_followup_pending = true;
+}
+
+/**
+ * Starts a single scan of all channels, the saved network to join is chosen when it completes.
+ */
+static void wifi_app_scan_known_networks(void)
+{
+  esp_err_t esp_err;
+
+  g_candidate_count = 0;
+
+  // A running cache refresh is a full scan as well, use its results
+  if (g_scanning_for_cache)
+  {
+    return;
+  }
+
+  esp_err = esp_wifi_scan_start(NULL, false);
+  if (esp_err != ESP_OK)
+  {
+    APP_LOGE(TAG, "Failed to start the scan for saved networks, error: %s", esp_err_to_name(esp_err));
+    wifi_app_sm_followup(WIFI_SM_EV_SCAN_DONE, 0);
+    return;
+  }
+
+  wifi_scan_cache_set_scanning(true);
+}
+
+/**
+ * Starts a full scan to refresh the scan cache served to the HTTP server.
+ * Scanning takes the radio off the SoftAP channel, so requests are ignored while a scan runs
+ * or the cached results are younger than WIFI_SCAN_CACHE_MAX_AGE_MS.
+ */
+static void wifi_app_refresh_scan_cache(void)
+{
+  esp_err_t esp_err;
+
+  if (g_wifi_sm.state == WIFI_SM_STATE_SCANNING || g_scanning_for_roam || g_scanning_for_cache ||
+      !wifi_scan_cache_is_stale())
+  {
+    return;
+  }
+
+  esp_err = esp_wifi_scan_start(NULL, false);
+  if (esp_err != ESP_OK)
+  {
+    APP_LOGW(TAG, "Failed to start the scan cache refresh, error: %s", esp_err_to_name(esp_err));
+    return;
+  }
+
+  g_scanning_for_cache = true;
+  wifi_scan_cache_set_scanning(true);
+}
+
+/**
+ * Matches the scan results against the saved networks and ranks the ones in range.
+ * A network scores the RSSI of its strongest access point plus WIFI_APP_PRIORITY_RSSI_BONUS per priority step,
+ * ties go to the network that connected most recently.
+ * @param records scan results.
+ * @param record_count number of scan results.
+ * @return the number of candidates written to g_candidates.
+ */
+static size_t wifi_app_rank_known_networks(const wifi_ap_record_t *records, uint16_t record_count)
+{
+  app_nvs_network_t networks[APP_NVS_MAX_NETWORKS];
+  size_t count = 0;
+
+  app_nvs_load_networks(networks);
+
+  for (size_t i = 0; i < APP_NVS_MAX_NETWORKS; i++)
+  {
+    const wifi_ap_record_t *best = NULL;
+
+    if (networks[i].ssid[0] == '\0')
+    {
+      continue;
+    }
+
+    for (uint16_t j = 0; j < record_count; j++)
+    {
+      if (strncmp((const char *)records[j].ssid, (const char *)networks[i].ssid, MAX_SSID_LENGTH) == 0 &&
+          (best == NULL || records[j].rssi > best->rssi))
+      {
+        best = &records[j];
+      }
+    }
+
+    if (best == NULL)
+    {
+      continue;
+    }
+
+    // Insert sorted, best first
+    wifi_app_candidate_t candidate;
+    size_t pos = count;
+
+    candidate.network = networks[i];
+    memcpy(candidate.bssid, best->bssid, sizeof(candidate.bssid));
+    candidate.channel = best->primary;
+    candidate.score = best->rssi + networks[i].priority * WIFI_APP_PRIORITY_RSSI_BONUS;
+
+    while (pos > 0 &&
+           (g_candidates[pos - 1].score < candidate.score ||
+            (g_candidates[pos - 1].score == candidate.score &&
+             g_candidates[pos - 1].network.last_success < candidate.network.last_success)))
+    {
+      g_candidates[pos] = g_candidates[pos - 1];
+      pos--;
+    }
+    g_candidates[pos] = candidate;
+    count++;
+  }
+
+  return count;
+}
+
+/**
+ * Reads the results of the last scan.
+ * @param record_count receives the number of records.
+ * @return the records, to be freed by the caller, or NULL on failure.
+ */
+static wifi_ap_record_t *wifi_app_get_scan_records(uint16_t *record_count)
+{
+  wifi_ap_record_t *records = (wifi_ap_record_t *)malloc(sizeof(wifi_ap_record_t) * WIFI_APP_SCAN_MAX_RECORDS);
+
+  *record_count = WIFI_APP_SCAN_MAX_RECORDS;
+
+  if (records == NULL)
+  {
+    esp_wifi_clear_ap_list();
+    *record_count = 0;
+    return NULL;
+  }
+
+  if (esp_wifi_scan_get_ap_records(record_count, records) != ESP_OK)
+  {
+    free(records);
+    *record_count = 0;
+    return NULL;
+  }
+
+  return records;
+}
+
+/**
+ * Reads the results of a full scan into the scan cache and ranks the saved networks in range.
+ * @return the number of saved networks in range.
+ */
+static size_t wifi_app_select_known_networks(void)
+{
+  uint16_t record_count;
+  wifi_ap_record_t *records = wifi_app_get_scan_records(&record_count);
+
+  g_candidate_count = 0;
+
+  if (records != NULL)
+  {
+    wifi_scan_cache_update(records, record_count);
+    g_candidate_count = wifi_app_rank_known_networks(records, record_count);
+    free(records);
+  }
+
+  for (size_t i = 0; i < g_candidate_count; i++)
+  {
+    APP_LOGI(TAG, "Saved network in range: SSID: %s, channel: %d, score: %d",
+             g_candidates[i].network.ssid, g_candidates[i].channel, g_candidates[i].score);
+  }
+
+  return g_candidate_count;
+}
+
+/**
+ * Connects to a ranked saved network.
+ * @param index position in g_candidates.
+ */
+static void wifi_app_connect_candidate(uint8_t index)
+{
+  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+  const wifi_app_candidate_t *candidate;
+
+  if (index >= g_candidate_count)
+  {
+    wifi_app_sm_followup(WIFI_SM_EV_LINK_DOWN, 0);
+    return;
+  }
+
+  candidate = &g_candidates[index];
+
+  memset(wifi_sta_config, 0x00, sizeof(wifi_config_t));
+  memcpy(wifi_sta_config->sta.ssid, candidate->network.ssid, MAX_SSID_LENGTH);
+  memcpy(wifi_sta_config->sta.password, candidate->network.password, MAX_PASSWORD_LENGTH);
+  APP_LOGI(TAG, "Connecting to saved network SSID: %s", wifi_sta_config->sta.ssid);
+
+  wifi_app_connect_sta(candidate->bssid, candidate->channel);
+}
+
+/**
+ * Timer callbacks, they run in the timer task so they only publish a message.
+ */
+static void wifi_app_link_timer_callback(TimerHandle_t xTimer)
+{
+  wifi_app_send_message(WIFI_APP_MSG_LINK_SAMPLE);
+}
+
+static void wifi_app_retry_timer_callback(TimerHandle_t xTimer)
+{
+  wifi_app_send_message(WIFI_APP_MSG_RETRY_TIMER);
+}
+
+/**
+ * Looks for a better access point of the current network after the link stayed weak.
+ * An access point supporting 802.11v is first asked for a BSS transition, otherwise
+ * the channels are scanned for the SSID and the station switches if a stronger access point answers.
+ */
+static void wifi_app_start_roam(void)
+{
+  wifi_scan_config_t scan_config;
+  esp_err_t esp_err;
+
+  wifi_link_monitor_roam_started();
+
+#if CONFIG_ESP_WIFI_WNM_SUPPORT
+  if (!g_btm_query_sent && esp_wnm_is_btm_supported_connection())
+  {
+    APP_LOGI(TAG, "Requesting a BSS transition from the access point");
+    g_btm_query_sent = true;
+    if (esp_wnm_send_bss_transition_mgmt_query(REASON_RSSI, NULL, 0) == 0)
+    {
+      // The access point steers the station itself if it knows a better one
+      wifi_app_sm_followup(WIFI_SM_EV_ROAM_SCAN_DONE, 0);
+      return;
+    }
+  }
+#endif
+
+  if (g_scanning_for_cache)
+  {
+    wifi_app_sm_followup(WIFI_SM_EV_ROAM_SCAN_DONE, 0);
+    return;
+  }
+
+  memset(&scan_config, 0x00, sizeof(scan_config));
+  scan_config.ssid = wifi_app_get_wifi_config()->sta.ssid;
+
+  esp_err = esp_wifi_scan_start(&scan_config, false);
+  if (esp_err != ESP_OK)
+  {
+    APP_LOGE(TAG, "Failed to start the roaming scan, error: %s", esp_err_to_name(esp_err));
+    wifi_app_sm_followup(WIFI_SM_EV_ROAM_SCAN_DONE, 0);
+    return;
+  }
+
+  g_scanning_for_roam = true;
+}
+
+/**
+ * Picks the strongest other access point of the roaming scan if it beats the current one.
+ * @return true if an access point was stored in g_roam_bssid and g_roam_channel.
+ */
+static bool wifi_app_find_roam_target(void)
+{
+  wifi_link_quality_t link;
+  const wifi_ap_record_t *best = NULL;
+  uint16_t record_count;
+  wifi_ap_record_t *records = wifi_app_get_scan_records(&record_count);
+  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+  bool found = false;
+
+  if (records == NULL)
+  {
+    return false;
+  }
+
+  wifi_link_monitor_get(&link);
+
+  for (uint16_t i = 0; i < record_count; i++)
+  {
+    if (strncmp((const char *)records[i].ssid, (const char *)wifi_sta_config->sta.ssid, MAX_SSID_LENGTH) == 0 &&
+        memcmp(records[i].bssid, link.bssid, sizeof(link.bssid)) != 0 &&
+        (best == NULL || records[i].rssi > best->rssi))
+    {
+      best = &records[i];
+    }
+  }
+
+  if (best != NULL && wifi_link_monitor_is_better(best->rssi))
+  {
+    APP_LOGI(TAG, "Roaming from RSSI %d dBm to access point on channel %d at %d dBm",
+             link.rssi_avg, best->primary, best->rssi);
+    memcpy(g_roam_bssid, best->bssid, sizeof(g_roam_bssid));
+    g_roam_channel = best->primary;
+    found = true;
+  }
+  else
+  {
+    APP_LOGI(TAG, "No better access point found, staying at RSSI %d dBm", link.rssi_avg);
+  }
+
+  free(records);
+  return found;
+}
+
+/**
+ * Leaves the current access point for the one found by the roaming scan, the disconnect event joins it.
+ */
+static void wifi_app_roam_switch(void)
+{
+  wifi_config_t *wifi_sta_config = wifi_app_get_wifi_config();
+
+  memcpy(wifi_sta_config->sta.bssid, g_roam_bssid, sizeof(wifi_sta_config->sta.bssid));
+  wifi_sta_config->sta.bssid_set = true;
+  wifi_sta_config->sta.channel = g_roam_channel;
+  wifi_sta_config->sta.scan_method = WIFI_FAST_SCAN;
+
+  if (esp_wifi_set_config(ESP_IF_WIFI_STA, wifi_sta_config) != ESP_OK || esp_wifi_disconnect() != ESP_OK)
+  {
+    APP_LOGE(TAG, "Failed to leave the access point");
+  }
+}
+
+/**
+ * Saves the BSSID and channel of the current connection if they differ from the cached ones.
+ */
+static void wifi_app_save_fast_connect(void)
+{
+  wifi_ap_record_t ap_info;
+
+  if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+  {
+    return;
+  }
+
+  if (!g_fast_connect_valid ||
+      g_fast_connect.channel != ap_info.primary ||
+      memcmp(g_fast_connect.bssid, ap_info.bssid, sizeof(g_fast_connect.bssid)) != 0)
+  {
+    memcpy(g_fast_connect.bssid, ap_info.bssid, sizeof(g_fast_connect.bssid));
+    g_fast_connect.channel = ap_info.primary;
+    g_fast_connect_valid = (app_nvs_save_fast_connect(&g_fast_connect) == ESP_OK);
+  }
+}
+
+/**
+ * Carries out one action requested by the state machine.
+ * @param actions action list, holds the arguments of the action.
+ * @param action the action to run.
+ */
+static void wifi_app_run_action(const wifi_sm_actions_t *actions, wifi_sm_action_e action)
+{
+  switch (action)
+  {
+    case WIFI_SM_ACTION_START_HTTP_SERVER:
+      http_server_start();
+      rgb_led_http_server_started();
+      break;
+    case WIFI_SM_ACTION_CONNECT_FAST:
+      APP_LOGI(TAG, "Fast connect to cached access point on channel %d", g_fast_connect.channel);
+      wifi_app_connect_sta(g_fast_connect.bssid, g_fast_connect.channel);
+      break;
+    case WIFI_SM_ACTION_CONNECT_CANDIDATE:
+      wifi_app_connect_candidate(actions->candidate);
+      break;
+    case WIFI_SM_ACTION_CONNECT_CONFIG:
+      wifi_app_connect_sta(NULL, 0);
+      break;
+    case WIFI_SM_ACTION_RECONNECT:
+      APP_LOGI(TAG, "Retrying to connect to the AP, attempt %d", g_wifi_sm.retries);
+      esp_wifi_connect();
+      break;
+    case WIFI_SM_ACTION_START_SCAN:
+      wifi_app_scan_known_networks();
+      break;
+    case WIFI_SM_ACTION_START_RETRY_TIMER:
+      APP_LOGW(TAG, "No saved network could be joined, scanning again in %lu ms", (unsigned long)actions->delay_ms);
+      xTimerChangePeriod(wifi_retry_timer, pdMS_TO_TICKS(actions->delay_ms), 0);
+      break;
+    case WIFI_SM_ACTION_CLEAR_FAST_CONNECT:
+      g_fast_connect_valid = false;
+      app_nvs_clear_fast_connect();
+      break;
+    case WIFI_SM_ACTION_SAVE_CONNECTION:
+      wifi_app_save_fast_connect();
+      // Record the network as the last successful one, new credentials from the HTTP server are added to the store
+      app_nvs_save_sta_creds();
+      // Start tracking the link quality of the new connection, the driver reports when RSSI drops below the threshold
+      wifi_link_monitor_reset();
+      g_btm_query_sent = false;
+      esp_wifi_set_rssi_threshold(WIFI_LINK_WEAK_RSSI);
+      break;
+    case WIFI_SM_ACTION_CLEAR_CREDENTIALS:
+      // Written at once, a restart within the commit delay must not bring the credentials back
+      app_nvs_clear_sta_creds();
+      app_nvs_flush();
+      g_fast_connect_valid = false;
+      break;
+    case WIFI_SM_ACTION_DISCONNECT:
+      ESP_ERROR_CHECK(esp_wifi_disconnect());
+      rgb_led_http_server_started();
+      break;
+    case WIFI_SM_ACTION_START_ROAM:
+      wifi_app_start_roam();
+      break;
+    case WIFI_SM_ACTION_ROAM_SWITCH:
+      wifi_app_roam_switch();
+      break;
+    case WIFI_SM_ACTION_NOTIFY_CONNECTING:
+      http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_INIT);
+      break;
+    case WIFI_SM_ACTION_NOTIFY_CONNECTED:
+      rgb_led_wifi_connected();
+      http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_SUCCESS);
+      if (wifi_connected_event_cb != NULL)
+      {
+        wifi_app_call_callback();
+      }
+      break;
+    case WIFI_SM_ACTION_NOTIFY_CONNECT_FAILED:
+      http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_FAIL);
+      break;
+    case WIFI_SM_ACTION_NOTIFY_USER_DISCONNECTED:
+      http_server_monitor_send_message(HTTP_MSG_WIFI_USER_DISCONNECT);
+      break;
+    case WIFI_SM_ACTION_NOTIFY_ROAMED:
+      http_server_monitor_send_message(HTTP_MSG_WIFI_ROAMED);
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Feeds an event to the state machine and carries out the resulting actions, then any follow-up event they raised.
+ * @param id event to feed.
+ * @param value event argument.
+ */
+static void wifi_app_sm_dispatch(wifi_sm_event_id_e id, uint8_t value)
+{
+  wifi_sm_event_t event = { .id = id, .value = value };
+  wifi_sm_actions_t actions;
+
+  for (;;)
+  {
+    wifi_sm_state_e prev = g_wifi_sm.state;
+
+    trace_record(TRACE_EVENT_WIFI_SM_BEGIN, event.id, event.value);
+    wifi_sm_handle(&g_wifi_sm, &event, &actions);
+    if (prev != g_wifi_sm.state)
+    {
+      APP_LOGI(TAG, "%s: %s -> %s", wifi_sm_event_name(event.id),
+               wifi_sm_state_name(prev), wifi_sm_state_name(g_wifi_sm.state));
+    }
+
+    for (uint8_t i = 0; i < actions.count; i++)
+    {
+      wifi_app_run_action(&actions, actions.list[i]);
+    }
+    trace_record(TRACE_EVENT_WIFI_SM_END, prev, g_wifi_sm.state);
+
+    if (!g_followup_pending)
+    {
+      break;
+    }
+    g_followup_pending = false;
+    event = g_followup_event;
+  }
+}
+
 /**
  * Main task function for the Wi-Fi application.
- * This function handles incoming messages from the queue and performs actions based on the message ID.
+ * This function handles incoming messages from the queue and turns them into state machine events.
  * @param pvParameters Pointer to task parameters (not used).
  */
 static void wifi_app_task(void *pvParameters)
 {
-    wifi_app_queue_message_t msg;
-    EventBits_t eventBits;
+    event_bus_event_t msg;
+    uint8_t boot_flags;
 
     // Initialize the event handler
     wifi_app_event_handler_init();
@@ -240,135 +795,147 @@ static void wifi_app_task(void *pvParameters)
     // Start WIFI
     ESP_ERROR_CHECK(esp_wifi_start());
 
+    // Link quality sampling, samples are ignored until the station has an IP
+    wifi_link_timer = xTimerCreate("wifi_link", pdMS_TO_TICKS(WIFI_LINK_SAMPLE_PERIOD_MS), pdTRUE, NULL,
+                                   &wifi_app_link_timer_callback);
+    if (wifi_link_timer != NULL)
+    {
+      xTimerStart(wifi_link_timer, 0);
+    }
+
+    // One-shot backoff timer, started by the state machine
+    wifi_retry_timer = xTimerCreate("wifi_retry", pdMS_TO_TICKS(WIFI_SM_BACKOFF_MIN_MS), pdFALSE, NULL,
+                                    &wifi_app_retry_timer_callback);
+
+    wifi_sm_init(&g_wifi_sm);
+
     // Send first event message to the queue
     wifi_app_send_message(WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS);
 
     // Loop forever
     while (1)
     {
-        // Wait for a message on the queue
-        xQueueReceive(wifi_app_queue_handle, &msg, portMAX_DELAY);
+        // Wait for a message on the event bus
+        if (event_bus_receive(wifi_app_subscriber, &msg, portMAX_DELAY) != pdTRUE)
+        {
+          continue;
+        }
 
         // Handle the message based on its ID
-        switch (msg.msgID)
+        switch (msg.id)
         {
           case WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS:
-            ESP_LOGI(TAG, "WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS");
-            // Load saved Wi-Fi credentials from NVS
+            APP_LOGI(TAG, "WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS");
+
+            boot_flags = 0;
             if (app_nvs_load_sta_creds())
             {
-              ESP_LOGI(TAG, "Saved credentials found");
-              // Set the bit to indicate that we are connecting using saved credentials
-              xEventGroupSetBits(wifi_app_event_group, WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT);
-              // Connect to the Wi-Fi network
-              wifi_app_connect_sta();
+              APP_LOGI(TAG, "Saved credentials found");
+              boot_flags |= WIFI_SM_BOOT_HAS_SAVED_NETWORKS;
+
+              g_fast_connect_valid = app_nvs_load_fast_connect(&g_fast_connect);
+              if (g_fast_connect_valid)
+              {
+                boot_flags |= WIFI_SM_BOOT_FAST_CONNECT_VALID;
+              }
             }
             else
             {
-              ESP_LOGW(TAG, "No saved Wi-Fi credentials found, starting HTTP server");
+              APP_LOGW(TAG, "No saved Wi-Fi credentials found, starting HTTP server");
             }
 
-            wifi_app_send_message(WIFI_APP_MSG_START_HTTP_SERVER);
-            break;
-          case WIFI_APP_MSG_START_HTTP_SERVER:
-            // Start the HTTP server
-            ESP_LOGI(TAG, "WIFI_APP_MSG_START_HTTP_SERVER");
-            http_server_start();
-            rgb_led_http_server_started();
-
+            wifi_app_sm_dispatch(WIFI_SM_EV_BOOT, boot_flags);
             break;
           case WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER:
-            ESP_LOGI(TAG, "WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER");
+            APP_LOGI(TAG, "WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER");
+            wifi_app_sm_dispatch(WIFI_SM_EV_HTTP_CONNECT, 0);
 
-            xEventGroupSetBits(wifi_app_event_group, WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT);
+            break;
+          case WIFI_APP_MSG_STA_CONNECTED_GOT_IP:
+            APP_LOGI(TAG, "WIFI_APP_MSG_STA_CONNECTED_GOT_IP");
 
-            // Attempt a connection to the Wi-Fi network
-            wifi_app_connect_sta();
-            // Set current number of retries to zero
-            g_retry_number = 0;
-            // Let the HTTP server know about the connection attempt
-            http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_INIT);
+            APP_LOGI(TAG, "Station got IP %lld ms after boot%s", (long long)(esp_timer_get_time() / 1000),
+                     (g_wifi_sm.state == WIFI_SM_STATE_FAST_CONNECTING) ? " (fast connect)" : "");
+            wifi_app_sm_dispatch(WIFI_SM_EV_GOT_IP, 0);
 
             break;
-          case WIFI_APP_MSG_STA_CONNECTED_GOT_IP:
-            ESP_LOGI(TAG, "WIFI_APP_MSG_STA_CONNECTED_GOT_IP");
+          case WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT:
+            APP_LOGI(TAG, "WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT");
+            wifi_app_sm_dispatch(WIFI_SM_EV_USER_DISCONNECT, 0);
 
-            xEventGroupSetBits(wifi_app_event_group, WIFI_APP_STA_CONNECTED_GOT_IP_BIT);
+            break;
+          case WIFI_APP_MSG_STA_DISCONNECTED:
+            APP_LOGI(TAG, "WIFI_APP_MSG_STA_DISCONNECTED");
+            wifi_app_sm_dispatch(WIFI_SM_EV_LINK_DOWN, 0);
 
-            // Indicate that the station has connected and got an IP address
-            rgb_led_wifi_connected();
-            http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_SUCCESS);
+            break;
+          case WIFI_APP_MSG_SCAN_DONE:
+            APP_LOGI(TAG, "WIFI_APP_MSG_SCAN_DONE");
 
-            eventBits = xEventGroupGetBits(wifi_app_event_group);
-            // Save STA creds only if connecting from the http server (not loaded from NVS)
-            if (eventBits & WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT)
+            if (g_scanning_for_roam)
             {
-              // Clear the bit, in case we want to disconnect and reconnect, then start the process again
-              xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT);
-            } else {
-              app_nvs_save_sta_creds();
+              g_scanning_for_roam = false;
+              wifi_app_sm_dispatch(WIFI_SM_EV_ROAM_SCAN_DONE, wifi_app_find_roam_target() ? 1 : 0);
+              break;
             }
 
-            if (eventBits & WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT)
+            // Full scan, requested by the state machine or by the HTTP server, both refresh the scan cache
+            g_scanning_for_cache = false;
+            if (g_wifi_sm.state == WIFI_SM_STATE_SCANNING)
             {
-              xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT);
+              size_t candidates = wifi_app_select_known_networks();
+              wifi_scan_cache_set_scanning(false);
+              wifi_app_sm_dispatch(WIFI_SM_EV_SCAN_DONE, (uint8_t)candidates);
             }
-
-            // Check for connection callback
-            if (wifi_connected_event_cb != NULL)
+            else
             {
-              wifi_app_call_callback();
+              uint16_t record_count;
+              wifi_ap_record_t *records = wifi_app_get_scan_records(&record_count);
+
+              if (records != NULL)
+              {
+                wifi_scan_cache_update(records, record_count);
+                free(records);
+              }
+              wifi_scan_cache_set_scanning(false);
             }
 
             break;
-          case WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT:
-            ESP_LOGI(TAG, "WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT");
+          case WIFI_APP_MSG_RETRY_TIMER:
+            APP_LOGI(TAG, "WIFI_APP_MSG_RETRY_TIMER");
+            wifi_app_sm_dispatch(WIFI_SM_EV_RETRY_TIMER, 0);
 
-            eventBits = xEventGroupGetBits(wifi_app_event_group);
-            if (eventBits & WIFI_APP_STA_CONNECTED_GOT_IP_BIT)
-            {
-              xEventGroupSetBits(wifi_app_event_group, WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT);
-  
-              g_retry_number = MAX_CONNECTION_RETRIES; // Set the retry number to max to force disconnect
-              ESP_ERROR_CHECK(esp_wifi_disconnect());
-  
-              // Clear the saved Wi-Fi credentials from NVS
-              app_nvs_clear_sta_creds();
-              rgb_led_http_server_started();
-            }
-            
             break;
-          case WIFI_APP_MSG_STA_DISCONNECTED:
-            ESP_LOGI(TAG, "WIFI_APP_MSG_STA_DISCONNECTED");
+          case WIFI_APP_MSG_REFRESH_SCAN_CACHE:
+            APP_LOGI(TAG, "WIFI_APP_MSG_REFRESH_SCAN_CACHE");
+            wifi_app_refresh_scan_cache();
 
-            eventBits = xEventGroupGetBits(wifi_app_event_group);
-            if (eventBits & WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT)
-            {
-              ESP_LOGI(TAG, "WIFI_APP_MSG_STA_DISCONNECTED: Attempt using saved credentials");
-              // Clear the bit, in case we want to disconnect and reconnect, then start the process again
-              xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_USING_SAVED_CREDS_BIT);
-              app_nvs_clear_sta_creds();
-            } 
-            else if (eventBits & WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT)
-            {
-              ESP_LOGI(TAG, "WIFI_APP_MSG_STA_DISCONNECTED: Attempt using HTTP server credentials");
-              xEventGroupClearBits(wifi_app_event_group, WIFI_APP_CONNECTING_FROM_HTTP_SERVER_BIT);
-              http_server_monitor_send_message(HTTP_MSG_WIFI_CONNECT_FAIL);
-            }
-            else if (eventBits & WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT)
-            {
-              ESP_LOGI(TAG, "WIFI_APP_MSG_STA_DISCONNECTED: User requested disconnect");
-              xEventGroupClearBits(wifi_app_event_group, WIFI_APP_USER_REQUESTED_STA_DISCONNECT_BIT);
-              http_server_monitor_send_message(HTTP_MSG_WIFI_USER_DISCONNECT);
-            }
-            else
+            break;
+          case WIFI_APP_MSG_NVS_COMMIT:
+            // Written here rather than in the timer task, the flash write would stall every other esp_timer callback
+            app_nvs_flush();
+
+            break;
+          case WIFI_APP_MSG_LINK_SAMPLE:
+            if (g_wifi_sm.state != WIFI_SM_STATE_CONNECTED)
             {
-              ESP_LOGI(TAG, "WIFI_APP_MSG_STA_DISCONNECTED: Unknown disconnect reason");
+              break;
             }
 
-            if (eventBits & WIFI_APP_STA_CONNECTED_GOT_IP_BIT)
+            switch (wifi_link_monitor_sample())
             {
-              xEventGroupClearBits(wifi_app_event_group, WIFI_APP_STA_CONNECTED_GOT_IP_BIT);
+              case WIFI_LINK_ACTION_DEGRADED:
+                http_server_monitor_send_message(HTTP_MSG_WIFI_LINK_DEGRADED);
+                break;
+              case WIFI_LINK_ACTION_RECOVERED:
+                http_server_monitor_send_message(HTTP_MSG_WIFI_LINK_RECOVERED);
+                esp_wifi_set_rssi_threshold(WIFI_LINK_WEAK_RSSI);
+                break;
+              case WIFI_LINK_ACTION_ROAM:
+                wifi_app_sm_dispatch(WIFI_SM_EV_ROAM_NEEDED, 0);
+                break;
+              default:
+                break;
             }
 
             break;
@@ -380,10 +947,36 @@ static void wifi_app_task(void *pvParameters)
 
 BaseType_t wifi_app_send_message(wifi_app_message_e msgID)
 {
-    wifi_app_queue_message_t msg;
-    msg.msgID = msgID;
+    uint32_t flags = EVENT_BUS_FLAG_NONE;
+
+    switch (msgID)
+    {
+      case WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT:
+        flags = EVENT_BUS_FLAG_HIGH_PRIORITY;
+        break;
+      // Connection state changes are neither merged nor sent to the front, every disconnect
+      // must reach the state machine in order with the GOT_IP events around it.
+      // Timers, samples and scan results only ask for work, one pending message is enough
+      case WIFI_APP_MSG_RETRY_TIMER:
+        flags = EVENT_BUS_FLAG_COALESCE;
+        break;
+      case WIFI_APP_MSG_SCAN_DONE:
+        flags = EVENT_BUS_FLAG_COALESCE;
+        break;
+      case WIFI_APP_MSG_LINK_SAMPLE:
+        flags = EVENT_BUS_FLAG_COALESCE;
+        break;
+      case WIFI_APP_MSG_REFRESH_SCAN_CACHE:
+        flags = EVENT_BUS_FLAG_COALESCE;
+        break;
+      case WIFI_APP_MSG_NVS_COMMIT:
+        flags = EVENT_BUS_FLAG_COALESCE;
+        break;
+      default:
+        break;
+    }
 
-    return xQueueSend(wifi_app_queue_handle, &msg, portMAX_DELAY);
+    return event_bus_publish(EVENT_BUS_TOPIC_WIFI_APP, msgID, 0, flags);
 }
 
 wifi_config_t *wifi_app_get_wifi_config(void)
@@ -403,7 +996,7 @@ void wifi_app_call_callback(void)
 
 void wifi_app_start(void)
 {
-  ESP_LOGI(TAG, "Starting Wi-Fi application...");
+  APP_LOGI(TAG, "Starting Wi-Fi application...");
 
   // Start WIFI started LED
   rgb_led_wifi_app_started();
@@ -415,11 +1008,11 @@ void wifi_app_start(void)
   wifi_config = (wifi_config_t *)malloc(sizeof(wifi_config_t));
   memset(wifi_config, 0x00, sizeof(wifi_config_t));
 
-  // Create the queue to handle messages
-  wifi_app_queue_handle = xQueueCreate(3, sizeof(wifi_app_queue_message_t));
+  // Results of full scans are kept for the HTTP server
+  wifi_scan_cache_init();
 
-  // Create Wifi application event group
-  wifi_app_event_group = xEventGroupCreate();
+  // Subscribe to the Wi-Fi application messages
+  wifi_app_subscriber = event_bus_subscribe("wifi_app", EVENT_BUS_TOPIC_BIT(EVENT_BUS_TOPIC_WIFI_APP), WIFI_APP_QUEUE_DEPTH);
 
   // Start the WIFI RTOS task
   xTaskCreatePinnedToCore(
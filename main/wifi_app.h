@@ -29,7 +29,14 @@
  #define WIFI_STA_POWER_SAVE            WIFI_PS_NONE
  #define MAX_SSID_LENGTH                32
  #define MAX_PASSWORD_LENGTH            64
- #define MAX_CONNECTION_RETRIES         5
+ #define WIFI_APP_QUEUE_DEPTH           8
+ #define WIFI_APP_SCAN_MAX_RECORDS      20            // Scan results considered when selecting a known network
+ #define WIFI_APP_PRIORITY_RSSI_BONUS   6             // dB added to a network's RSSI per priority step
+ #define WIFI_STA_STATIC_IP_ENABLED     0             // 1 to skip DHCP and use the static address below
+ #define WIFI_STA_STATIC_IP             "192.168.1.50"
+ #define WIFI_STA_STATIC_GATEWAY        "192.168.1.1"
+ #define WIFI_STA_STATIC_NETMASK        "255.255.255.0"
+ #define WIFI_STA_STATIC_DNS            "192.168.1.1"
  #define WIFI_STA_SSID                  "2682"
  #define WIFI_STA_PASSWORD              "Aa1234567890"
 
@@ -44,28 +51,22 @@
   */
 typedef enum wifi_app_message
 {
-    WIFI_APP_MSG_START_HTTP_SERVER = 0, 
-    WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER,
+    WIFI_APP_MSG_CONNECTING_FROM_HTTP_SERVER = 0,
     WIFI_APP_MSG_STA_CONNECTED_GOT_IP, 
     WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT,
     WIFI_APP_MSG_LOAD_SAVED_CREDENTIALS,
-    WIFI_APP_MSG_STA_DISCONNECTED,
+    WIFI_APP_MSG_STA_DISCONNECTED,           // Every station disconnect or failed connection attempt
+    WIFI_APP_MSG_SCAN_DONE,
+    WIFI_APP_MSG_LINK_SAMPLE,
+    WIFI_APP_MSG_REFRESH_SCAN_CACHE,
+    WIFI_APP_MSG_RETRY_TIMER,
+    WIFI_APP_MSG_NVS_COMMIT,                 // The app_nvs commit timer expired, write the configuration record
 } wifi_app_message_e;
 
 /**
- * Structure for the message queue used in the Wi-Fi application.
- * @note This structure can be expanded with additional fields as needed.
- */
-typedef struct wifi_app_queue_message
-{
-  wifi_app_message_e msgID;
-} wifi_app_queue_message_t;
-
-/**
- * Sends a message to the queue
+ * Publishes a message to the Wi-Fi application task on the event bus, never blocks.
  * @param msgID The message ID from the wifi_app_message_e enum.
- * @return pdTRUE if the message was sent successfully, otherwise pdFALSE.
- * @note Expand the parameter list based on your requirements e.g., how you've expanded the wifi_app_queue_message_t structure.
+ * @return pdTRUE if the message was queued or coalesced, pdFALSE if it was dropped.
  */
  BaseType_t wifi_app_send_message(wifi_app_message_e msgID);
 
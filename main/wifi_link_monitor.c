@@ -0,0 +1,175 @@
+/**
+ * @file wifi_link_monitor.c
+ * @brief Link quality tracking of the station connection.
+ *
+ * RSSI is smoothed with a moving average (weight 1/4) kept in 1/16 dB. The retry rate and throughput come
+ * from the MQTT transport statistics, a radio that needs many retransmissions shows up there as stalled
+ * writes and send waits that time out. Receive timeouts are left out, an idle connection has plenty. A link is weak when the average RSSI is low, or when it is marginal and
+ * the transport keeps retrying. Roaming is requested once it stays weak for several samples.
+ */
+
+#include <string.h>
+
+#include "app_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#include "aws_iot.h"
+#include "network_transport.h"
+#include "wifi_link_monitor.h"
+
+static const char TAG[] = "wifi_link_monitor";
+
+static wifi_link_quality_t link_quality;
+
+// RSSI moving average in 1/16 dB, valid once link_samples is non zero
+static int link_rssi_avg_x16 = 0;
+static uint32_t link_samples = 0;
+static uint32_t link_roam_cooldown = 0;
+
+// Transport counters at the previous sample
+static TlsTransportStats_t link_prev_stats;
+static int64_t link_prev_sample_us = 0;
+
+/**
+ * Returns cur - prev, or cur when the counters were reset in between.
+ */
+static uint32_t wifi_link_monitor_delta(uint32_t cur, uint32_t prev)
+{
+  return (cur >= prev) ? (cur - prev) : cur;
+}
+
+/**
+ * Updates the retry rate and throughput from the transport statistics.
+ */
+static void wifi_link_monitor_sample_transport(void)
+{
+  TlsTransportStats_t stats;
+  int64_t now_us = esp_timer_get_time();
+
+  // Lock free snapshot, it does not wait for a receive blocked on the socket
+  if (!xTlsGetStats(aws_iot_get_network_context(), &stats))
+  {
+    link_quality.retry_permille = 0;
+    link_quality.throughput_bps = 0;
+    return;
+  }
+
+  if (link_prev_sample_us != 0 && now_us > link_prev_sample_us)
+  {
+    uint32_t sends = wifi_link_monitor_delta(stats.ulSendCalls, link_prev_stats.ulSendCalls);
+    uint32_t retries = wifi_link_monitor_delta(stats.ulWantWriteRetries, link_prev_stats.ulWantWriteRetries) +
+                       wifi_link_monitor_delta(stats.ulPartialWrites, link_prev_stats.ulPartialWrites) +
+                       wifi_link_monitor_delta(stats.ulSendStalls, link_prev_stats.ulSendStalls);
+    uint64_t bytes = (uint64_t)wifi_link_monitor_delta(stats.ulBytesSent, link_prev_stats.ulBytesSent) +
+                     wifi_link_monitor_delta(stats.ulBytesReceived, link_prev_stats.ulBytesReceived);
+
+    link_quality.retry_permille = (sends > 0) ? (uint32_t)(((uint64_t)retries * 1000) / sends) : 0;
+    link_quality.throughput_bps = (uint32_t)((bytes * 8 * 1000000) / (uint64_t)(now_us - link_prev_sample_us));
+  }
+
+  link_prev_stats = stats;
+  link_prev_sample_us = now_us;
+}
+
+void wifi_link_monitor_reset(void)
+{
+  uint32_t roam_attempts = link_quality.roam_attempts;
+
+  memset(&link_quality, 0x00, sizeof(link_quality));
+  link_quality.roam_attempts = roam_attempts;
+  link_rssi_avg_x16 = 0;
+  link_samples = 0;
+  link_prev_sample_us = 0;
+}
+
+wifi_link_action_e wifi_link_monitor_sample(void)
+{
+  wifi_ap_record_t ap_info;
+  bool weak;
+
+  if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK)
+  {
+    return WIFI_LINK_ACTION_NONE;
+  }
+
+  // A new access point starts a new average, keep the degraded state so recovery is still reported
+  if (link_samples > 0 && memcmp(link_quality.bssid, ap_info.bssid, sizeof(link_quality.bssid)) != 0)
+  {
+    link_samples = 0;
+    link_quality.weak_samples = 0;
+  }
+
+  memcpy(link_quality.bssid, ap_info.bssid, sizeof(link_quality.bssid));
+  link_quality.channel = ap_info.primary;
+  link_quality.rssi = ap_info.rssi;
+
+  if (link_samples++ == 0)
+  {
+    link_rssi_avg_x16 = ap_info.rssi * 16;
+  }
+  else
+  {
+    link_rssi_avg_x16 += (ap_info.rssi * 16 - link_rssi_avg_x16) / 4;
+  }
+  link_quality.rssi_avg = link_rssi_avg_x16 / 16;
+
+  wifi_link_monitor_sample_transport();
+
+  if (link_roam_cooldown > 0)
+  {
+    link_roam_cooldown--;
+  }
+
+  weak = link_quality.rssi_avg < WIFI_LINK_WEAK_RSSI ||
+         (link_quality.rssi_avg < WIFI_LINK_RECOVER_RSSI && link_quality.retry_permille > WIFI_LINK_WEAK_RETRY_PERMILLE);
+
+  if (weak)
+  {
+    link_quality.weak_samples++;
+
+    if (!link_quality.degraded)
+    {
+      link_quality.degraded = true;
+      APP_LOGW(TAG, "Link degraded: RSSI avg %d dBm, retries %lu/1000",
+               link_quality.rssi_avg, (unsigned long)link_quality.retry_permille);
+      return WIFI_LINK_ACTION_DEGRADED;
+    }
+
+    if (link_quality.weak_samples >= WIFI_LINK_WEAK_SAMPLES && link_roam_cooldown == 0)
+    {
+      return WIFI_LINK_ACTION_ROAM;
+    }
+
+    return WIFI_LINK_ACTION_NONE;
+  }
+
+  link_quality.weak_samples = 0;
+
+  if (link_quality.degraded && link_quality.rssi_avg >= WIFI_LINK_RECOVER_RSSI &&
+      link_quality.retry_permille <= WIFI_LINK_WEAK_RETRY_PERMILLE)
+  {
+    link_quality.degraded = false;
+    APP_LOGI(TAG, "Link recovered: RSSI avg %d dBm", link_quality.rssi_avg);
+    return WIFI_LINK_ACTION_RECOVERED;
+  }
+
+  return WIFI_LINK_ACTION_NONE;
+}
+
+void wifi_link_monitor_roam_started(void)
+{
+  link_quality.roam_attempts++;
+  link_quality.weak_samples = 0;
+  link_roam_cooldown = WIFI_LINK_ROAM_COOLDOWN_SAMPLES;
+}
+
+bool wifi_link_monitor_is_better(int8_t rssi)
+{
+  return link_samples == 0 || rssi >= link_quality.rssi_avg + WIFI_LINK_ROAM_HYSTERESIS_DB;
+}
+
+void wifi_link_monitor_get(wifi_link_quality_t *out)
+{
+  *out = link_quality;
+}
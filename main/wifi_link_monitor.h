@@ -0,0 +1,77 @@
+/**
+ * @file wifi_link_monitor.h
+ * @brief Link quality tracking of the station connection and roaming decisions.
+ */
+#ifndef MAIN_WIFI_LINK_MONITOR_H_
+#define MAIN_WIFI_LINK_MONITOR_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Link monitor settings
+#define WIFI_LINK_SAMPLE_PERIOD_MS        5000
+#define WIFI_LINK_WEAK_RSSI               -72   // dBm, averaged RSSI below which the link is weak
+#define WIFI_LINK_RECOVER_RSSI            -67   // dBm, averaged RSSI above which a weak link has recovered
+#define WIFI_LINK_WEAK_RETRY_PERMILLE     200   // Transport retries per 1000 sends that make a marginal link weak
+#define WIFI_LINK_WEAK_SAMPLES            3     // Consecutive weak samples before roaming
+#define WIFI_LINK_ROAM_COOLDOWN_SAMPLES   12    // Samples to wait after a roam attempt
+#define WIFI_LINK_ROAM_HYSTERESIS_DB      8     // dB a new access point must beat the current one by
+
+/**
+ * Action the Wi-Fi application should take after a sample.
+ */
+typedef enum wifi_link_action
+{
+  WIFI_LINK_ACTION_NONE = 0,
+  WIFI_LINK_ACTION_DEGRADED,    // The link just became weak
+  WIFI_LINK_ACTION_RECOVERED,   // A weak link is good again
+  WIFI_LINK_ACTION_ROAM,        // The link stayed weak, look for a better access point
+} wifi_link_action_e;
+
+/**
+ * Link quality of the current station connection.
+ */
+typedef struct wifi_link_quality
+{
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;                  // Last sample, dBm
+  int rssi_avg;                 // Moving average, dBm
+  uint32_t retry_permille;      // Transport retries per 1000 sends over the last sample period
+  uint32_t throughput_bps;      // Transport payload bits per second over the last sample period
+  uint32_t weak_samples;        // Consecutive weak samples
+  uint32_t roam_attempts;
+  bool degraded;
+} wifi_link_quality_t;
+
+/**
+ * Forgets the samples of the previous connection, call when the station gets an IP.
+ */
+void wifi_link_monitor_reset(void);
+
+/**
+ * Samples RSSI, transport retries and throughput of the current connection.
+ * @note Called from the Wi-Fi application task only, as is every other function of this module.
+ * @return the action to take.
+ */
+wifi_link_action_e wifi_link_monitor_sample(void);
+
+/**
+ * Records a roam attempt, no further WIFI_LINK_ACTION_ROAM is returned during the cooldown.
+ */
+void wifi_link_monitor_roam_started(void);
+
+/**
+ * Tells whether an access point heard at rssi is worth roaming to.
+ * @param rssi RSSI of the other access point in dBm.
+ * @return true if it beats the current average by WIFI_LINK_ROAM_HYSTERESIS_DB.
+ */
+bool wifi_link_monitor_is_better(int8_t rssi);
+
+/**
+ * Copies the link quality of the current connection.
+ * @param out receives the link quality.
+ */
+void wifi_link_monitor_get(wifi_link_quality_t *out);
+
+#endif /* MAIN_WIFI_LINK_MONITOR_H_ */
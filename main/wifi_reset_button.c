@@ -3,6 +3,7 @@
 #include "freertos/semphr.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "app_log.h"
 
 #include "tasks_common.h"
 #include "wifi_app.h"
@@ -23,7 +24,8 @@ void IRAM_ATTR wifi_reset_button_isr_handler(void *arg) {
       // Notify the button task
         xSemaphoreGiveFromISR(wifi_reset_semaphore, NULL);
     } else {
-        ESP_LOGE(TAG, "Semaphore not initialized");
+        // Interrupt context, the deferred log cannot be used here
+        ESP_DRAM_LOGE(DRAM_STR("wifi_reset_button"), "Semaphore not initialized");
     }
 }
 
@@ -36,7 +38,7 @@ void wifi_reset_button_task(void *pvParam)
     while (1){
       // Wait for the button press event
       if (xSemaphoreTake(wifi_reset_semaphore, portMAX_DELAY) == pdTRUE) {
-          ESP_LOGI(TAG, "WiFi reset button pressed, disconnecting WiFi...");
+          APP_LOGI(TAG, "WiFi reset button pressed, disconnecting WiFi...");
           // Notify the WiFi application to disconnect and clear credentials
           wifi_app_send_message(WIFI_APP_MSG_USER_REQUESTED_STA_DISCONNECT);
 
@@ -62,13 +64,13 @@ void wifi_reset_button_config(void) {
 
     // Install gpio isr service
     if (gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install GPIO ISR service");
+        APP_LOGE(TAG, "Failed to install GPIO ISR service");
         return;
     }
 
     // Attach the interrupt handler for the WiFi reset button
     if (gpio_isr_handler_add(WIFI_RESET_BUTTON, wifi_reset_button_isr_handler, NULL) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to add ISR handler for WiFi reset button");
+        APP_LOGE(TAG, "Failed to add ISR handler for WiFi reset button");
         return;
     }
 
@@ -83,8 +85,8 @@ void wifi_reset_button_config(void) {
     
     // // Apply the configuration
     // if (gpio_config(&io_conf) != ESP_OK) {
-    //     ESP_LOGE(TAG, "Failed to configure WiFi reset button GPIO");
+    //     APP_LOGE(TAG, "Failed to configure WiFi reset button GPIO");
     // } else {
-    //     ESP_LOGI(TAG, "WiFi reset button configured successfully");
+    //     APP_LOGI(TAG, "WiFi reset button configured successfully");
     // }
 }
\ No newline at end of file
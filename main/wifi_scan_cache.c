@@ -0,0 +1,127 @@
+/**
+ * @file wifi_scan_cache.c
+ * @brief Cached results of the last full Wi-Fi scan.
+ *
+ * The Wi-Fi application task writes the cache after each full scan, HTTP handlers copy it out.
+ * Both sides only hold the mutex for a memcpy of a few hundred bytes.
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include "wifi_scan_cache.h"
+
+static wifi_scan_cache_entry_t scan_cache_entries[WIFI_SCAN_CACHE_MAX_ENTRIES];
+static size_t scan_cache_count = 0;
+static int64_t scan_cache_time_us = 0;      // Time of the last update, 0 if never updated
+static bool scan_cache_scanning = false;
+
+static SemaphoreHandle_t scan_cache_mutex = NULL;
+
+void wifi_scan_cache_init(void)
+{
+  if (scan_cache_mutex == NULL)
+  {
+    scan_cache_mutex = xSemaphoreCreateMutex();
+  }
+}
+
+void wifi_scan_cache_update(const wifi_ap_record_t *records, uint16_t record_count)
+{
+  wifi_scan_cache_entry_t entries[WIFI_SCAN_CACHE_MAX_ENTRIES];
+  size_t count = 0;
+
+  // Build the new list outside of the lock, insertion sort keeps it ordered by RSSI
+  for (uint16_t i = 0; i < record_count; i++)
+  {
+    const wifi_ap_record_t *record = &records[i];
+    size_t pos;
+
+    if (record->ssid[0] == '\0')
+    {
+      continue;
+    }
+
+    // Drop weaker duplicates of an SSID already in the list, a stronger one replaces the old entry
+    for (pos = 0; pos < count; pos++)
+    {
+      if (strncmp(entries[pos].ssid, (const char *)record->ssid, sizeof(entries[pos].ssid)) == 0)
+      {
+        break;
+      }
+    }
+    if (pos < count)
+    {
+      if (entries[pos].rssi >= record->rssi)
+      {
+        continue;
+      }
+      memmove(&entries[pos], &entries[pos + 1], (count - pos - 1) * sizeof(entries[0]));
+      count--;
+    }
+
+    // Find the insertion point, the weakest entry falls off when the list is full
+    for (pos = count; pos > 0 && entries[pos - 1].rssi < record->rssi; pos--)
+    {
+    }
+    if (pos >= WIFI_SCAN_CACHE_MAX_ENTRIES)
+    {
+      continue;
+    }
+    if (count == WIFI_SCAN_CACHE_MAX_ENTRIES)
+    {
+      count--;
+    }
+    memmove(&entries[pos + 1], &entries[pos], (count - pos) * sizeof(entries[0]));
+
+    memcpy(entries[pos].ssid, record->ssid, sizeof(entries[pos].ssid) - 1);
+    entries[pos].ssid[sizeof(entries[pos].ssid) - 1] = '\0';
+    entries[pos].rssi = record->rssi;
+    entries[pos].channel = record->primary;
+    entries[pos].authmode = (uint8_t)record->authmode;
+    count++;
+  }
+
+  xSemaphoreTake(scan_cache_mutex, portMAX_DELAY);
+  memcpy(scan_cache_entries, entries, count * sizeof(entries[0]));
+  scan_cache_count = count;
+  scan_cache_time_us = esp_timer_get_time();
+  xSemaphoreGive(scan_cache_mutex);
+}
+
+void wifi_scan_cache_set_scanning(bool scanning)
+{
+  xSemaphoreTake(scan_cache_mutex, portMAX_DELAY);
+  scan_cache_scanning = scanning;
+  xSemaphoreGive(scan_cache_mutex);
+}
+
+bool wifi_scan_cache_is_stale(void)
+{
+  bool stale;
+
+  xSemaphoreTake(scan_cache_mutex, portMAX_DELAY);
+  stale = !scan_cache_scanning &&
+          (scan_cache_time_us == 0 ||
+           esp_timer_get_time() - scan_cache_time_us > (int64_t)WIFI_SCAN_CACHE_MAX_AGE_MS * 1000);
+  xSemaphoreGive(scan_cache_mutex);
+
+  return stale;
+}
+
+size_t wifi_scan_cache_get(wifi_scan_cache_entry_t *out, size_t max, int32_t *age_ms, bool *scanning)
+{
+  size_t count;
+
+  xSemaphoreTake(scan_cache_mutex, portMAX_DELAY);
+  count = (scan_cache_count < max) ? scan_cache_count : max;
+  memcpy(out, scan_cache_entries, count * sizeof(out[0]));
+  *age_ms = (scan_cache_time_us == 0) ? -1 : (int32_t)((esp_timer_get_time() - scan_cache_time_us) / 1000);
+  *scanning = scan_cache_scanning;
+  xSemaphoreGive(scan_cache_mutex);
+
+  return count;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file wifi_scan_cache.h
+ * @brief Cached results of the last full Wi-Fi scan, shared with the HTTP server.
+ */
+#ifndef MAIN_WIFI_SCAN_CACHE_H_
+#define MAIN_WIFI_SCAN_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_wifi_types.h"
+
+// Scan cache settings
+#define WIFI_SCAN_CACHE_MAX_ENTRIES     16
+#define WIFI_SCAN_CACHE_MAX_AGE_MS      15000   // Older results are still served but trigger a background refresh
+
+/**
+ * One network of the scan, the strongest access point when several advertise the same SSID.
+ */
+typedef struct wifi_scan_cache_entry
+{
+  char ssid[33];
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t authmode;             // wifi_auth_mode_t
+} wifi_scan_cache_entry_t;
+
+/**
+ * Initializes the cache, must be called before the Wi-Fi application starts scanning.
+ */
+void wifi_scan_cache_init(void);
+
+/**
+ * Replaces the cache with the given scan results, deduplicated by SSID and sorted by RSSI, strongest first.
+ * Hidden networks are skipped.
+ * @param records scan results.
+ * @param record_count number of scan results.
+ */
+void wifi_scan_cache_update(const wifi_ap_record_t *records, uint16_t record_count);
+
+/**
+ * Marks a full scan as started or finished, reported to clients so they know to poll again.
+ * @param scanning true while a scan is running.
+ */
+void wifi_scan_cache_set_scanning(bool scanning);
+
+/**
+ * Tells whether a background refresh should be requested.
+ * @return true if no scan is running and the results are missing or older than WIFI_SCAN_CACHE_MAX_AGE_MS.
+ */
+bool wifi_scan_cache_is_stale(void);
+
+/**
+ * Copies the cached results.
+ * @param out receives up to max entries.
+ * @param max capacity of out.
+ * @param age_ms receives the age of the results in milliseconds, -1 if there are none.
+ * @param scanning receives whether a refresh is running.
+ * @return the number of entries copied.
+ */
+size_t wifi_scan_cache_get(wifi_scan_cache_entry_t *out, size_t max, int32_t *age_ms, bool *scanning);
+
+#endif /* MAIN_WIFI_SCAN_CACHE_H_ */
@@ -0,0 +1,311 @@
+/**
+ * @file wifi_sm.c
+ * @brief Connection state machine of the Wi-Fi application.
+ *
+ * Transitions are written as one function per state, events a state does not handle leave it unchanged.
+ * User disconnects and roaming requests are only honored while connected, as before the refactor.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "wifi_sm.h"
+
+static const char *const wifi_sm_state_names[WIFI_SM_STATE_COUNT] = {
+  "IDLE", "FAST_CONNECTING", "SCANNING", "SAVED_CONNECTING", "HTTP_CONNECTING", "CONNECTED",
+  "RECONNECTING", "WAITING", "DISCONNECTING", "ROAM_SCANNING", "ROAM_LEAVING", "ROAM_JOINING",
+};
+
+static const char *const wifi_sm_event_names[WIFI_SM_EV_COUNT] = {
+  "BOOT", "HTTP_CONNECT", "LINK_DOWN", "GOT_IP", "SCAN_DONE", "RETRY_TIMER", "USER_DISCONNECT",
+  "ROAM_NEEDED", "ROAM_SCAN_DONE",
+};
+
+/**
+ * Appends an action, the list is sized for the longest transition.
+ */
+static void wifi_sm_push(wifi_sm_actions_t *actions, wifi_sm_action_e action)
+{
+  if (actions->count < WIFI_SM_MAX_ACTIONS)
+  {
+    actions->list[actions->count++] = action;
+  }
+}
+
+/**
+ * Starts a scan for saved networks.
+ */
+static wifi_sm_state_e wifi_sm_scan(wifi_sm_t *sm, wifi_sm_actions_t *actions)
+{
+  sm->candidate_count = 0;
+  sm->candidate_next = 0;
+  wifi_sm_push(actions, WIFI_SM_ACTION_START_SCAN);
+  return WIFI_SM_STATE_SCANNING;
+}
+
+/**
+ * Waits before scanning again when saved networks exist, otherwise waits for the HTTP server.
+ */
+static wifi_sm_state_e wifi_sm_wait(wifi_sm_t *sm, wifi_sm_actions_t *actions)
+{
+  if (!sm->has_saved_networks)
+  {
+    return WIFI_SM_STATE_IDLE;
+  }
+
+  actions->delay_ms = sm->backoff_ms;
+  wifi_sm_push(actions, WIFI_SM_ACTION_START_RETRY_TIMER);
+
+  sm->backoff_ms = (sm->backoff_ms >= WIFI_SM_BACKOFF_MAX_MS / 2) ? WIFI_SM_BACKOFF_MAX_MS : sm->backoff_ms * 2;
+  return WIFI_SM_STATE_WAITING;
+}
+
+/**
+ * Joins the next ranked saved network, or waits when all of them failed.
+ */
+static wifi_sm_state_e wifi_sm_connect_next_candidate(wifi_sm_t *sm, wifi_sm_actions_t *actions)
+{
+  if (sm->candidate_next >= sm->candidate_count)
+  {
+    return wifi_sm_wait(sm, actions);
+  }
+
+  sm->retries = 0;
+  actions->candidate = sm->candidate_next++;
+  wifi_sm_push(actions, WIFI_SM_ACTION_CONNECT_CANDIDATE);
+  return WIFI_SM_STATE_SAVED_CONNECTING;
+}
+
+/**
+ * Retries the current access point while attempts are left.
+ * @return true if a retry was queued.
+ */
+static bool wifi_sm_retry(wifi_sm_t *sm, wifi_sm_actions_t *actions)
+{
+  if (sm->retries >= WIFI_SM_MAX_RETRIES)
+  {
+    return false;
+  }
+
+  sm->retries++;
+  wifi_sm_push(actions, WIFI_SM_ACTION_RECONNECT);
+  return true;
+}
+
+/**
+ * Handles the events valid in every state, returns WIFI_SM_STATE_COUNT for the others.
+ */
+static wifi_sm_state_e wifi_sm_handle_common(wifi_sm_t *sm, const wifi_sm_event_t *event, wifi_sm_actions_t *actions)
+{
+  switch (event->id)
+  {
+    case WIFI_SM_EV_HTTP_CONNECT:
+      sm->retries = 0;
+      wifi_sm_push(actions, WIFI_SM_ACTION_CONNECT_CONFIG);
+      wifi_sm_push(actions, WIFI_SM_ACTION_NOTIFY_CONNECTING);
+      return WIFI_SM_STATE_HTTP_CONNECTING;
+
+    case WIFI_SM_EV_GOT_IP:
+      if (sm->state == WIFI_SM_STATE_IDLE || sm->state == WIFI_SM_STATE_DISCONNECTING)
+      {
+        return WIFI_SM_STATE_COUNT;
+      }
+      if (sm->state == WIFI_SM_STATE_CONNECTED)
+      {
+        // Address renewed on the same connection, nothing to do
+        return WIFI_SM_STATE_CONNECTED;
+      }
+
+      sm->retries = 0;
+      sm->has_saved_networks = true;
+      sm->backoff_ms = WIFI_SM_BACKOFF_MIN_MS;
+      wifi_sm_push(actions, WIFI_SM_ACTION_SAVE_CONNECTION);
+      wifi_sm_push(actions, WIFI_SM_ACTION_NOTIFY_CONNECTED);
+      if (sm->state == WIFI_SM_STATE_ROAM_JOINING)
+      {
+        wifi_sm_push(actions, WIFI_SM_ACTION_NOTIFY_ROAMED);
+      }
+      return WIFI_SM_STATE_CONNECTED;
+
+    default:
+      return WIFI_SM_STATE_COUNT;
+  }
+}
+
+/**
+ * Handles a link down event in the given state.
+ */
+static wifi_sm_state_e wifi_sm_handle_link_down(wifi_sm_t *sm, wifi_sm_actions_t *actions)
+{
+  switch (sm->state)
+  {
+    case WIFI_SM_STATE_FAST_CONNECTING:
+      // The cached access point is gone or moved, forget it and look at every channel
+      wifi_sm_push(actions, WIFI_SM_ACTION_CLEAR_FAST_CONNECT);
+      return wifi_sm_scan(sm, actions);
+
+    case WIFI_SM_STATE_SAVED_CONNECTING:
+      if (wifi_sm_retry(sm, actions))
+      {
+        return sm->state;
+      }
+      return wifi_sm_connect_next_candidate(sm, actions);
+
+    case WIFI_SM_STATE_HTTP_CONNECTING:
+      if (wifi_sm_retry(sm, actions))
+      {
+        return sm->state;
+      }
+      wifi_sm_push(actions, WIFI_SM_ACTION_NOTIFY_CONNECT_FAILED);
+      return wifi_sm_wait(sm, actions);
+
+    case WIFI_SM_STATE_CONNECTED:
+    case WIFI_SM_STATE_ROAM_SCANNING:
+      // Unexpected drop, the scan result of a roaming attempt is ignored once the state changed
+      sm->retries = 0;
+      wifi_sm_retry(sm, actions);
+      return WIFI_SM_STATE_RECONNECTING;
+
+    case WIFI_SM_STATE_RECONNECTING:
+    case WIFI_SM_STATE_ROAM_JOINING:
+      if (wifi_sm_retry(sm, actions))
+      {
+        return sm->state;
+      }
+      return wifi_sm_scan(sm, actions);
+
+    case WIFI_SM_STATE_ROAM_LEAVING:
+      // Left the old access point on purpose, the station configuration already holds the new one
+      sm->retries = 0;
+      wifi_sm_retry(sm, actions);
+      return WIFI_SM_STATE_ROAM_JOINING;
+
+    case WIFI_SM_STATE_DISCONNECTING:
+      wifi_sm_push(actions, WIFI_SM_ACTION_NOTIFY_USER_DISCONNECTED);
+      return WIFI_SM_STATE_IDLE;
+
+    default:
+      return sm->state;
+  }
+}
+
+void wifi_sm_init(wifi_sm_t *sm)
+{
+  memset(sm, 0x00, sizeof(*sm));
+  sm->state = WIFI_SM_STATE_IDLE;
+  sm->backoff_ms = WIFI_SM_BACKOFF_MIN_MS;
+}
+
+wifi_sm_state_e wifi_sm_handle(wifi_sm_t *sm, const wifi_sm_event_t *event, wifi_sm_actions_t *actions)
+{
+  wifi_sm_state_e next;
+
+  memset(actions, 0x00, sizeof(*actions));
+
+  next = wifi_sm_handle_common(sm, event, actions);
+  if (next != WIFI_SM_STATE_COUNT)
+  {
+    sm->state = next;
+    return next;
+  }
+
+  next = sm->state;
+
+  switch (event->id)
+  {
+    case WIFI_SM_EV_BOOT:
+      if (sm->state != WIFI_SM_STATE_IDLE)
+      {
+        break;
+      }
+
+      wifi_sm_push(actions, WIFI_SM_ACTION_START_HTTP_SERVER);
+      sm->has_saved_networks = (event->value & WIFI_SM_BOOT_HAS_SAVED_NETWORKS) != 0;
+      if (!sm->has_saved_networks)
+      {
+        break;
+      }
+
+      // Rejoin the access point of the last connection directly, otherwise scan once and pick the best saved network
+      if (event->value & WIFI_SM_BOOT_FAST_CONNECT_VALID)
+      {
+        sm->retries = 0;
+        wifi_sm_push(actions, WIFI_SM_ACTION_CONNECT_FAST);
+        next = WIFI_SM_STATE_FAST_CONNECTING;
+      }
+      else
+      {
+        next = wifi_sm_scan(sm, actions);
+      }
+      break;
+
+    case WIFI_SM_EV_LINK_DOWN:
+      next = wifi_sm_handle_link_down(sm, actions);
+      break;
+
+    case WIFI_SM_EV_SCAN_DONE:
+      if (sm->state == WIFI_SM_STATE_SCANNING)
+      {
+        sm->candidate_count = event->value;
+        sm->candidate_next = 0;
+        next = wifi_sm_connect_next_candidate(sm, actions);
+      }
+      break;
+
+    case WIFI_SM_EV_RETRY_TIMER:
+      if (sm->state == WIFI_SM_STATE_WAITING)
+      {
+        next = wifi_sm_scan(sm, actions);
+      }
+      break;
+
+    case WIFI_SM_EV_USER_DISCONNECT:
+      if (sm->state == WIFI_SM_STATE_CONNECTED)
+      {
+        sm->has_saved_networks = false;
+        wifi_sm_push(actions, WIFI_SM_ACTION_DISCONNECT);
+        wifi_sm_push(actions, WIFI_SM_ACTION_CLEAR_CREDENTIALS);
+        next = WIFI_SM_STATE_DISCONNECTING;
+      }
+      break;
+
+    case WIFI_SM_EV_ROAM_NEEDED:
+      if (sm->state == WIFI_SM_STATE_CONNECTED)
+      {
+        wifi_sm_push(actions, WIFI_SM_ACTION_START_ROAM);
+        next = WIFI_SM_STATE_ROAM_SCANNING;
+      }
+      break;
+
+    case WIFI_SM_EV_ROAM_SCAN_DONE:
+      if (sm->state == WIFI_SM_STATE_ROAM_SCANNING)
+      {
+        if (event->value)
+        {
+          wifi_sm_push(actions, WIFI_SM_ACTION_ROAM_SWITCH);
+          next = WIFI_SM_STATE_ROAM_LEAVING;
+        }
+        else
+        {
+          next = WIFI_SM_STATE_CONNECTED;
+        }
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  sm->state = next;
+  return next;
+}
+
+const char *wifi_sm_state_name(wifi_sm_state_e state)
+{
+  return (state < WIFI_SM_STATE_COUNT) ? wifi_sm_state_names[state] : "?";
+}
+
+const char *wifi_sm_event_name(wifi_sm_event_id_e id)
+{
+  return (id < WIFI_SM_EV_COUNT) ? wifi_sm_event_names[id] : "?";
+}
@@ -0,0 +1,146 @@
+/**
+ * @file wifi_sm.h
+ * @brief Connection state machine of the Wi-Fi application.
+ *
+ * The state machine only decides, it never calls ESP-IDF. Each event yields the next state and a list of
+ * actions that the Wi-Fi application task carries out (connect, scan, save credentials, notify the HTTP server).
+ * It has no dependency besides the C library so it can be compiled and driven on the host.
+ */
+#ifndef MAIN_WIFI_SM_H_
+#define MAIN_WIFI_SM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// State machine settings
+#define WIFI_SM_MAX_RETRIES           5         // Reconnect attempts to one access point before giving up on it
+#define WIFI_SM_BACKOFF_MIN_MS        5000      // First delay before rescanning when no saved network could be joined
+#define WIFI_SM_BACKOFF_MAX_MS        300000    // The delay doubles up to this value
+#define WIFI_SM_MAX_ACTIONS           6
+
+/**
+ * Connection states.
+ */
+typedef enum wifi_sm_state
+{
+  WIFI_SM_STATE_IDLE = 0,           // No connection wanted, waiting for credentials from the HTTP server
+  WIFI_SM_STATE_FAST_CONNECTING,    // Joining the cached access point without scanning
+  WIFI_SM_STATE_SCANNING,           // Scanning for saved networks
+  WIFI_SM_STATE_SAVED_CONNECTING,   // Joining a ranked saved network
+  WIFI_SM_STATE_HTTP_CONNECTING,    // Joining the network entered on the web page
+  WIFI_SM_STATE_CONNECTED,          // Station has an IP
+  WIFI_SM_STATE_RECONNECTING,       // Link dropped, rejoining the same access point
+  WIFI_SM_STATE_WAITING,            // No saved network could be joined, waiting for the backoff timer
+  WIFI_SM_STATE_DISCONNECTING,      // User requested disconnect in progress
+  WIFI_SM_STATE_ROAM_SCANNING,      // Looking for a better access point of the current network
+  WIFI_SM_STATE_ROAM_LEAVING,       // Leaving the old access point
+  WIFI_SM_STATE_ROAM_JOINING,       // Joining the access point found by the roaming scan
+  WIFI_SM_STATE_COUNT,
+} wifi_sm_state_e;
+
+/**
+ * Inputs of the state machine.
+ */
+typedef enum wifi_sm_event_id
+{
+  WIFI_SM_EV_BOOT = 0,              // value: WIFI_SM_BOOT_* flags
+  WIFI_SM_EV_HTTP_CONNECT,          // Credentials entered on the web page
+  WIFI_SM_EV_LINK_DOWN,             // Driver reported a disconnect or a failed connection attempt
+  WIFI_SM_EV_GOT_IP,
+  WIFI_SM_EV_SCAN_DONE,             // value: number of saved networks in range
+  WIFI_SM_EV_RETRY_TIMER,           // Backoff delay expired
+  WIFI_SM_EV_USER_DISCONNECT,
+  WIFI_SM_EV_ROAM_NEEDED,           // The link monitor wants a better access point
+  WIFI_SM_EV_ROAM_SCAN_DONE,        // value: 1 if a better access point was found
+  WIFI_SM_EV_COUNT,
+} wifi_sm_event_id_e;
+
+// WIFI_SM_EV_BOOT flags
+#define WIFI_SM_BOOT_HAS_SAVED_NETWORKS   0x01
+#define WIFI_SM_BOOT_FAST_CONNECT_VALID   0x02
+
+/**
+ * An input with its argument.
+ */
+typedef struct wifi_sm_event
+{
+  wifi_sm_event_id_e id;
+  uint8_t value;
+} wifi_sm_event_t;
+
+/**
+ * Side effects requested by a transition, carried out in list order.
+ */
+typedef enum wifi_sm_action
+{
+  WIFI_SM_ACTION_START_HTTP_SERVER = 0,
+  WIFI_SM_ACTION_CONNECT_FAST,          // Join the cached BSSID and channel
+  WIFI_SM_ACTION_CONNECT_CANDIDATE,     // Join the ranked saved network wifi_sm_actions_t.candidate
+  WIFI_SM_ACTION_CONNECT_CONFIG,        // Join the network of the current station configuration with a full scan
+  WIFI_SM_ACTION_RECONNECT,             // Retry the last connection
+  WIFI_SM_ACTION_START_SCAN,            // Scan for saved networks, answered by WIFI_SM_EV_SCAN_DONE
+  WIFI_SM_ACTION_START_RETRY_TIMER,     // Answered by WIFI_SM_EV_RETRY_TIMER after wifi_sm_actions_t.delay_ms
+  WIFI_SM_ACTION_CLEAR_FAST_CONNECT,
+  WIFI_SM_ACTION_SAVE_CONNECTION,       // Save the credentials and access point of the new connection
+  WIFI_SM_ACTION_CLEAR_CREDENTIALS,
+  WIFI_SM_ACTION_DISCONNECT,
+  WIFI_SM_ACTION_START_ROAM,            // Look for a better access point, answered by WIFI_SM_EV_ROAM_SCAN_DONE
+  WIFI_SM_ACTION_ROAM_SWITCH,           // Leave the current access point for the one found
+  WIFI_SM_ACTION_NOTIFY_CONNECTING,
+  WIFI_SM_ACTION_NOTIFY_CONNECTED,      // HTTP server, LED and connected callback
+  WIFI_SM_ACTION_NOTIFY_CONNECT_FAILED,
+  WIFI_SM_ACTION_NOTIFY_USER_DISCONNECTED,
+  WIFI_SM_ACTION_NOTIFY_ROAMED,
+  WIFI_SM_ACTION_COUNT,
+} wifi_sm_action_e;
+
+/**
+ * Actions produced by one event.
+ */
+typedef struct wifi_sm_actions
+{
+  uint8_t count;
+  wifi_sm_action_e list[WIFI_SM_MAX_ACTIONS];
+  uint8_t candidate;            // WIFI_SM_ACTION_CONNECT_CANDIDATE argument
+  uint32_t delay_ms;            // WIFI_SM_ACTION_START_RETRY_TIMER argument
+} wifi_sm_actions_t;
+
+/**
+ * State machine context.
+ */
+typedef struct wifi_sm
+{
+  wifi_sm_state_e state;
+  uint8_t retries;              // Reconnect attempts to the current access point
+  uint8_t candidate_count;      // Saved networks in range found by the last scan
+  uint8_t candidate_next;       // Next of them to try
+  bool has_saved_networks;
+  uint32_t backoff_ms;          // Next WIFI_SM_ACTION_START_RETRY_TIMER delay
+} wifi_sm_t;
+
+/**
+ * Puts the state machine in WIFI_SM_STATE_IDLE.
+ * @param sm context to initialize.
+ */
+void wifi_sm_init(wifi_sm_t *sm);
+
+/**
+ * Feeds one event to the state machine.
+ * @param sm context.
+ * @param event input.
+ * @param actions receives the actions to carry out, count is 0 when the event is ignored in the current state.
+ * @return the new state.
+ */
+wifi_sm_state_e wifi_sm_handle(wifi_sm_t *sm, const wifi_sm_event_t *event, wifi_sm_actions_t *actions);
+
+/**
+ * Names a state for logging.
+ */
+const char *wifi_sm_state_name(wifi_sm_state_e state);
+
+/**
+ * Names an event for logging.
+ */
+const char *wifi_sm_event_name(wifi_sm_event_id_e id);
+
+#endif /* MAIN_WIFI_SM_H_ */
@@ -0,0 +1,501 @@
+/**
+ * @file network_transport_test.c
+ * @brief Host test of espTlsTransportSend() and espTlsTransportRecv().
+ *
+ * esp_tls_conn_write(), esp_tls_conn_read() and select() return scripted results, select() also
+ * records the set and the timeout it was given and advances the test clock by the time it was
+ * scripted to block. The cases cover partial writes, WANT_READ and WANT_WRITE followed by
+ * progress, zero byte writes, timeouts above one second and the results returned once the send
+ * or receive timeout expires, and the statistics read without the semaphore.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_tls.h"
+#include "network_transport.h"
+#include "sys/socket.h"
+
+#define TEST_SOCKET      7
+#define SCRIPT_MAX       16
+
+static unsigned failures = 0;
+
+#define CHECK(cond, ...)                                                                          \
+  do                                                                                              \
+  {                                                                                               \
+    if (!(cond))                                                                                  \
+    {                                                                                             \
+      failures++;                                                                                 \
+      printf("%s:%d: FAIL: ", __FILE__, __LINE__);                                                \
+      printf(__VA_ARGS__);                                                                        \
+      printf("\n");                                                                               \
+    }                                                                                             \
+  } while (0)
+
+/**
+ * Result of one esp-tls write or read.
+ */
+typedef struct io_step
+{
+  ssize_t result;
+} io_step_t;
+
+/**
+ * Result of one select() call.
+ */
+typedef struct select_step
+{
+  int result;
+  bool error;                   // Reports the socket in the error set
+  uint32_t block_ms;            // Time the call takes
+} select_step_t;
+
+/**
+ * Arguments of one select() call.
+ */
+typedef struct select_call
+{
+  bool read;
+  bool write;
+  long tv_sec;
+  long tv_usec;
+} select_call_t;
+
+TickType_t test_tick_count = 0;
+
+static io_step_t io_script[SCRIPT_MAX];
+static size_t io_count;
+static size_t io_next;
+static size_t io_lengths[SCRIPT_MAX];       // Length asked for by each write or read
+
+static select_step_t select_script[SCRIPT_MAX];
+static size_t select_count;
+static size_t select_next;
+static select_call_t select_calls[SCRIPT_MAX];
+
+static esp_tls_t tls = { .sockfd = TEST_SOCKET };
+static int semaphore;
+static NetworkContext_t context;
+
+void vTaskSetTimeOutState(TimeOut_t *pxTimeOut)
+{
+  pxTimeOut->xTimeOnEntering = test_tick_count;
+}
+
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *pxTimeOut, TickType_t *pxTicksToWait)
+{
+  TickType_t elapsed = test_tick_count - pxTimeOut->xTimeOnEntering;
+
+  if (elapsed >= *pxTicksToWait)
+  {
+    *pxTicksToWait = 0;
+    return pdTRUE;
+  }
+
+  *pxTicksToWait -= elapsed;
+  vTaskSetTimeOutState(pxTimeOut);
+  return pdFALSE;
+}
+
+void vTaskDelay(TickType_t xTicksToDelay)
+{
+  test_tick_count += xTicksToDelay;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime)
+{
+  (void)xBlockTime;
+  return (xSemaphore == &semaphore) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore)
+{
+  return (xSemaphore == &semaphore) ? pdTRUE : pdFALSE;
+}
+
+static ssize_t next_io(size_t datalen)
+{
+  if (io_next >= io_count)
+  {
+    // Ran past the script, fail the call so the loop under test ends
+    CHECK(false, "call %u past the %u scripted reads or writes", (unsigned)io_next, (unsigned)io_count);
+    return -1;
+  }
+
+  io_lengths[io_next] = datalen;
+  return io_script[io_next++].result;
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t *tls_handle, const void *data, size_t datalen)
+{
+  (void)tls_handle;
+  (void)data;
+  return next_io(datalen);
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t *tls_handle, void *data, size_t datalen)
+{
+  ssize_t result = next_io(datalen);
+
+  (void)tls_handle;
+  if (result > 0)
+  {
+    memset(data, 0xA5, (size_t)result);
+  }
+  return result;
+}
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls_handle, int *sockfd)
+{
+  *sockfd = tls_handle->sockfd;
+  return ESP_OK;
+}
+
+int test_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+{
+  CHECK(nfds == TEST_SOCKET + 1, "select nfds %d", nfds);
+
+  if (select_next >= select_count)
+  {
+    CHECK(false, "select call %u past the %u scripted", (unsigned)select_next, (unsigned)select_count);
+    return -1;
+  }
+
+  select_step_t *step = &select_script[select_next];
+  select_calls[select_next] = (select_call_t){
+    .read = (readfds != NULL) && FD_ISSET(TEST_SOCKET, readfds),
+    .write = (writefds != NULL) && FD_ISSET(TEST_SOCKET, writefds),
+    .tv_sec = (long)timeout->tv_sec,
+    .tv_usec = (long)timeout->tv_usec,
+  };
+  select_next++;
+
+  test_tick_count += pdMS_TO_TICKS(step->block_ms);
+  if (!step->error)
+  {
+    FD_ZERO(exceptfds);
+  }
+  return step->result;
+}
+
+// The connect path is not exercised, these only satisfy the linker
+esp_tls_t *esp_tls_init(void)
+{
+  return NULL;
+}
+
+int esp_tls_conn_new_async(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls_handle)
+{
+  (void)hostname;
+  (void)hostlen;
+  (void)port;
+  (void)cfg;
+  (void)tls_handle;
+  return -1;
+}
+
+int esp_tls_conn_destroy(esp_tls_t *tls_handle)
+{
+  (void)tls_handle;
+  return 0;
+}
+
+esp_err_t esp_tls_get_error_handle(esp_tls_t *tls_handle, esp_tls_error_handle_t *error_handle)
+{
+  (void)tls_handle;
+  *error_handle = NULL;
+  return ESP_FAIL;
+}
+
+esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t h, int *esp_tls_code, int *esp_tls_flags)
+{
+  (void)h;
+  (void)esp_tls_code;
+  (void)esp_tls_flags;
+  return ESP_OK;
+}
+
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls_handle)
+{
+  (void)tls_handle;
+  return NULL;
+}
+
+void esp_tls_free_client_session(esp_tls_client_session_t *client_session)
+{
+  (void)client_session;
+}
+
+/**
+ * Starts a case with the given scripts and default timeouts.
+ */
+static void setup(const ssize_t *io, size_t io_len, const select_step_t *selects, size_t select_len)
+{
+  memset(&context, 0, sizeof(context));
+  context.xTlsContextSemaphore = &semaphore;
+  context.pxTls = &tls;
+
+  memset(io_lengths, 0, sizeof(io_lengths));
+  for (size_t i = 0; i < io_len; i++)
+  {
+    io_script[i].result = io[i];
+  }
+  io_count = io_len;
+  io_next = 0;
+
+  for (size_t i = 0; i < select_len; i++)
+  {
+    select_script[i] = selects[i];
+  }
+  memset(select_calls, 0, sizeof(select_calls));
+  select_count = select_len;
+  select_next = 0;
+
+  vTlsSetSendTimeout(10000);
+  vTlsSetRecvTimeout(2000);
+}
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+static uint8_t payload[500];
+static uint8_t buffer[128];
+
+/**
+ * Every write making some progress is followed by a write of the rest, without waiting.
+ */
+static void test_send_partial_writes(void)
+{
+  static const ssize_t io[] = { 100, 50, 350 };
+
+  setup(io, COUNT(io), NULL, 0);
+  int32_t sent = espTlsTransportSend(&context, payload, sizeof(payload));
+
+  CHECK(sent == 500, "sent %d", (int)sent);
+  CHECK(io_next == 3, "%u writes", (unsigned)io_next);
+  CHECK(io_lengths[0] == 500 && io_lengths[1] == 400 && io_lengths[2] == 350,
+        "write lengths %u, %u, %u", (unsigned)io_lengths[0], (unsigned)io_lengths[1], (unsigned)io_lengths[2]);
+  CHECK(select_next == 0, "%u selects", (unsigned)select_next);
+  CHECK(context.xStats.ulBytesSent == 500 && context.xStats.ulPartialWrites == 0,
+        "stats: %u bytes, %u partial writes", (unsigned)context.xStats.ulBytesSent, (unsigned)context.xStats.ulPartialWrites);
+}
+
+/**
+ * WANT_WRITE waits for the socket to become writable, WANT_READ for it to become readable,
+ * then the write continues where it stopped.
+ */
+static void test_send_want_then_progress(void)
+{
+  static const ssize_t io[] = { 200, MBEDTLS_ERR_SSL_WANT_WRITE, MBEDTLS_ERR_SSL_WANT_READ, 300 };
+  static const select_step_t selects[] = { { 1, false, 20 }, { 1, false, 20 } };
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  int32_t sent = espTlsTransportSend(&context, payload, sizeof(payload));
+
+  CHECK(sent == 500, "sent %d", (int)sent);
+  CHECK(io_lengths[1] == 300 && io_lengths[2] == 300 && io_lengths[3] == 300,
+        "retries resume at the remainder, lengths %u, %u, %u",
+        (unsigned)io_lengths[1], (unsigned)io_lengths[2], (unsigned)io_lengths[3]);
+  CHECK(select_next == 2, "%u selects", (unsigned)select_next);
+  CHECK(select_calls[0].write && !select_calls[0].read, "WANT_WRITE waits for writable");
+  CHECK(select_calls[1].read && !select_calls[1].write, "WANT_READ waits for readable");
+  CHECK(context.xStats.ulWantWriteRetries == 1 && context.xStats.ulWantReadRetries == 1,
+        "stats: %u WANT_WRITE, %u WANT_READ",
+        (unsigned)context.xStats.ulWantWriteRetries, (unsigned)context.xStats.ulWantReadRetries);
+}
+
+/**
+ * A timeout above one second is split into seconds and microseconds, and each wait only gets
+ * the time left.
+ */
+static void test_send_timeout_split(void)
+{
+  static const ssize_t io[] = { MBEDTLS_ERR_SSL_WANT_WRITE, MBEDTLS_ERR_SSL_WANT_WRITE, 500 };
+  static const select_step_t selects[] = { { 0, false, 1000 }, { 1, false, 10 } };
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  vTlsSetSendTimeout(2500);
+  int32_t sent = espTlsTransportSend(&context, payload, sizeof(payload));
+
+  CHECK(sent == 500, "sent %d", (int)sent);
+  CHECK(select_calls[0].tv_sec == 2 && select_calls[0].tv_usec == 500000,
+        "first wait %ld s %ld us", select_calls[0].tv_sec, select_calls[0].tv_usec);
+  CHECK(select_calls[1].tv_sec == 1 && select_calls[1].tv_usec == 500000,
+        "second wait %ld s %ld us", select_calls[1].tv_sec, select_calls[1].tv_usec);
+  CHECK(context.xStats.ulSelectTimeouts == 1 && context.xStats.ulSendStalls == 1,
+        "%u select timeouts, %u send stalls", (unsigned)context.xStats.ulSelectTimeouts,
+        (unsigned)context.xStats.ulSendStalls);
+}
+
+/**
+ * A write of zero bytes waits like WANT_WRITE, and the rest is sent once the socket is writable.
+ */
+static void test_send_zero_then_progress(void)
+{
+  static const ssize_t io[] = { 0, 500 };
+  static const select_step_t selects[] = { { 1, false, 10 } };
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  int32_t sent = espTlsTransportSend(&context, payload, sizeof(payload));
+
+  CHECK(sent == 500, "sent %d", (int)sent);
+  CHECK(select_next == 1 && select_calls[0].write, "zero write waits for writable");
+}
+
+/**
+ * Without progress until the send timeout, the bytes written so far are returned and the
+ * partial write is counted, coreMQTT sends the rest.
+ */
+static void test_send_zero_progress_timeout(void)
+{
+  static const ssize_t io[] = { 200, 0, 0, 0 };
+  static const select_step_t selects[] = { { 0, false, 600 }, { 0, false, 600 } };
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  vTlsSetSendTimeout(1200);
+  int32_t sent = espTlsTransportSend(&context, payload, sizeof(payload));
+
+  CHECK(sent == 200, "sent %d", (int)sent);
+  CHECK(select_next == 2, "%u selects", (unsigned)select_next);
+  CHECK(select_calls[1].tv_sec == 0 && select_calls[1].tv_usec == 600000,
+        "second wait %ld s %ld us", select_calls[1].tv_sec, select_calls[1].tv_usec);
+  CHECK(context.xStats.ulPartialWrites == 1 && context.xStats.ulBytesSent == 200,
+        "stats: %u partial writes, %u bytes", (unsigned)context.xStats.ulPartialWrites, (unsigned)context.xStats.ulBytesSent);
+
+  // Nothing written at all returns 0, not an error
+  static const ssize_t none[] = { 0, 0 };
+  static const select_step_t block[] = { { 0, false, 1200 } };
+
+  setup(none, COUNT(none), block, COUNT(block));
+  vTlsSetSendTimeout(1200);
+  sent = espTlsTransportSend(&context, payload, sizeof(payload));
+  CHECK(sent == 0, "sent %d without progress", (int)sent);
+}
+
+/**
+ * esp-tls and socket errors end the send with a negative result.
+ */
+static void test_send_errors(void)
+{
+  static const ssize_t io_error[] = { 100, -0x7880 };
+  static const ssize_t io_want[] = { MBEDTLS_ERR_SSL_WANT_WRITE };
+  static const select_step_t select_error[] = { { -1, false, 0 } };
+  static const select_step_t socket_error[] = { { 1, true, 0 } };
+  int32_t sent;
+
+  setup(io_error, COUNT(io_error), NULL, 0);
+  sent = espTlsTransportSend(&context, payload, sizeof(payload));
+  CHECK(sent == -0x7880, "write error gives %d", (int)sent);
+
+  setup(io_want, COUNT(io_want), select_error, COUNT(select_error));
+  sent = espTlsTransportSend(&context, payload, sizeof(payload));
+  CHECK(sent == -1, "select error gives %d", (int)sent);
+
+  setup(io_want, COUNT(io_want), socket_error, COUNT(socket_error));
+  sent = espTlsTransportSend(&context, payload, sizeof(payload));
+  CHECK(sent == -1, "socket in the error set gives %d", (int)sent);
+
+  setup(NULL, 0, NULL, 0);
+  context.pxTls = NULL;
+  sent = espTlsTransportSend(&context, payload, sizeof(payload));
+  CHECK(sent == -1 && io_next == 0, "send without a connection gives %d", (int)sent);
+}
+
+/**
+ * A read waits on WANT_READ and WANT_WRITE and returns what the next read brings.
+ */
+static void test_recv_want_then_progress(void)
+{
+  static const ssize_t io[] = { MBEDTLS_ERR_SSL_WANT_READ, MBEDTLS_ERR_SSL_WANT_WRITE, 20 };
+  static const select_step_t selects[] = { { 1, false, 5 }, { 1, false, 5 } };
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  int32_t received = espTlsTransportRecv(&context, buffer, sizeof(buffer));
+
+  CHECK(received == 20, "received %d", (int)received);
+  CHECK(select_calls[0].read && !select_calls[0].write, "WANT_READ waits for readable");
+  CHECK(select_calls[1].write && !select_calls[1].read, "WANT_WRITE waits for writable");
+  CHECK(io_lengths[2] == sizeof(buffer), "read length %u", (unsigned)io_lengths[2]);
+  CHECK(context.xStats.ulBytesReceived == 20, "stats: %u bytes", (unsigned)context.xStats.ulBytesReceived);
+}
+
+/**
+ * Nothing to read until the receive timeout returns 0, the waits use the time left.
+ */
+static void test_recv_timeout(void)
+{
+  static const ssize_t io[] = { MBEDTLS_ERR_SSL_WANT_READ, MBEDTLS_ERR_SSL_WANT_READ, MBEDTLS_ERR_SSL_WANT_READ };
+  static const select_step_t selects[] = { { 0, false, 1000 }, { 0, false, 500 } };
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  vTlsSetRecvTimeout(1500);
+  int32_t received = espTlsTransportRecv(&context, buffer, sizeof(buffer));
+
+  CHECK(received == 0, "received %d", (int)received);
+  CHECK(select_calls[0].tv_sec == 1 && select_calls[0].tv_usec == 500000,
+        "first wait %ld s %ld us", select_calls[0].tv_sec, select_calls[0].tv_usec);
+  CHECK(select_calls[1].tv_sec == 0 && select_calls[1].tv_usec == 500000,
+        "second wait %ld s %ld us", select_calls[1].tv_sec, select_calls[1].tv_usec);
+  CHECK(context.xStats.ulSelectTimeouts == 2, "%u select timeouts", (unsigned)context.xStats.ulSelectTimeouts);
+  CHECK(context.xStats.ulSendStalls == 0, "idle receive counted %u send stalls", (unsigned)context.xStats.ulSendStalls);
+}
+
+/**
+ * A read of zero bytes is a closed connection, not a timeout.
+ */
+static void test_recv_closed(void)
+{
+  static const ssize_t io[] = { 0 };
+
+  setup(io, COUNT(io), NULL, 0);
+  int32_t received = espTlsTransportRecv(&context, buffer, sizeof(buffer));
+
+  CHECK(received == -1, "received %d", (int)received);
+  CHECK(select_next == 0, "%u selects", (unsigned)select_next);
+}
+
+/**
+ * The statistics are read without the semaphore, a send or receive that holds it does not hide them.
+ */
+static void test_stats_snapshot(void)
+{
+  static const ssize_t io[] = { MBEDTLS_ERR_SSL_WANT_READ, 20 };
+  static const select_step_t selects[] = { { 1, false, 5 } };
+  TlsTransportStats_t stats;
+
+  setup(io, COUNT(io), selects, COUNT(selects));
+  (void)espTlsTransportRecv(&context, buffer, sizeof(buffer));
+
+  // Another task holds the semaphore, the send gives up and only counts the timeout
+  context.xTlsContextSemaphore = NULL;
+  int32_t sent = espTlsTransportSend(&context, payload, sizeof(payload));
+  CHECK(sent == -1, "sent %d while busy", (int)sent);
+
+  CHECK(xTlsGetStats(&context, &stats), "snapshot while the semaphore is held");
+  CHECK(stats.ulBytesReceived == 20 && stats.ulRecvCalls == 1 && stats.ulWantReadRetries == 1,
+        "snapshot: %u bytes, %u calls, %u retries", (unsigned)stats.ulBytesReceived,
+        (unsigned)stats.ulRecvCalls, (unsigned)stats.ulWantReadRetries);
+  CHECK(stats.ulSemaphoreTimeouts == 1, "%u semaphore timeouts", (unsigned)stats.ulSemaphoreTimeouts);
+  CHECK((atomic_load(&context.uxStatsSeq) & 1U) == 0, "sequence left odd");
+  CHECK(!xTlsGetStats(NULL, &stats), "snapshot without a context");
+}
+
+int main(void)
+{
+  test_send_partial_writes();
+  test_send_want_then_progress();
+  test_send_timeout_split();
+  test_send_zero_then_progress();
+  test_send_zero_progress_timeout();
+  test_send_errors();
+  test_recv_want_then_progress();
+  test_recv_timeout();
+  test_recv_closed();
+  test_stats_snapshot();
+
+  printf("%u failures\n", failures);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
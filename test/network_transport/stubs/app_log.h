@@ -0,0 +1,14 @@
+/**
+ * @file app_log.h
+ * @brief Host stand-in, log calls are compiled out.
+ */
+#ifndef APP_LOG_H_
+#define APP_LOG_H_
+
+#define APP_LOGE(tag, ...)  do { } while (0)
+#define APP_LOGW(tag, ...)  do { } while (0)
+#define APP_LOGI(tag, ...)  do { } while (0)
+#define APP_LOGD(tag, ...)  do { } while (0)
+#define APP_LOGV(tag, ...)  do { } while (0)
+
+#endif /* APP_LOG_H_ */
@@ -0,0 +1,15 @@
+/**
+ * @file esp_cpu.h
+ * @brief Host stand-in, the cycle counter does not run.
+ */
+#ifndef TEST_ESP_CPU_H_
+#define TEST_ESP_CPU_H_
+
+#include <stdint.h>
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+  return 0;
+}
+
+#endif /* TEST_ESP_CPU_H_ */
@@ -0,0 +1,14 @@
+/**
+ * @file esp_err.h
+ * @brief Host stand-in for the ESP-IDF error codes used by the transport.
+ */
+#ifndef TEST_ESP_ERR_H_
+#define TEST_ESP_ERR_H_
+
+typedef int esp_err_t;
+
+#define ESP_OK                                0
+#define ESP_FAIL                              -1
+#define ESP_ERR_MBEDTLS_SSL_HANDSHAKE_FAILED  0x801A
+
+#endif /* TEST_ESP_ERR_H_ */
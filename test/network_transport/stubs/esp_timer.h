@@ -0,0 +1,17 @@
+/**
+ * @file esp_timer.h
+ * @brief Host stand-in, microseconds of the test clock.
+ */
+#ifndef TEST_ESP_TIMER_H_
+#define TEST_ESP_TIMER_H_
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+static inline int64_t esp_timer_get_time(void)
+{
+  return (int64_t)test_tick_count * portTICK_PERIOD_MS * 1000;
+}
+
+#endif /* TEST_ESP_TIMER_H_ */
@@ -0,0 +1,53 @@
+/**
+ * @file esp_tls.h
+ * @brief Host stand-in for the esp-tls calls of the transport, implemented by the test.
+ */
+#ifndef TEST_ESP_TLS_H_
+#define TEST_ESP_TLS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+
+#define MBEDTLS_ERR_SSL_WANT_READ   -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE  -0x6880
+
+typedef struct esp_tls
+{
+  int sockfd;
+} esp_tls_t;
+
+typedef struct esp_tls_client_session esp_tls_client_session_t;
+typedef struct esp_tls_last_error *esp_tls_error_handle_t;
+
+typedef struct esp_tls_cfg
+{
+  const char **alpn_protos;
+  const unsigned char *cacert_buf;
+  unsigned int cacert_bytes;
+  const unsigned char *clientcert_buf;
+  unsigned int clientcert_bytes;
+  const unsigned char *clientkey_buf;
+  unsigned int clientkey_bytes;
+  bool non_block;
+  bool use_secure_element;
+  int timeout_ms;
+  bool skip_common_name;
+  void *ds_data;
+  esp_tls_client_session_t *client_session;
+} esp_tls_cfg_t;
+
+esp_tls_t *esp_tls_init(void);
+int esp_tls_conn_new_async(const char *hostname, int hostlen, int port, const esp_tls_cfg_t *cfg, esp_tls_t *tls);
+int esp_tls_conn_destroy(esp_tls_t *tls);
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t *tls, int *sockfd);
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen);
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen);
+esp_err_t esp_tls_get_error_handle(esp_tls_t *tls, esp_tls_error_handle_t *error_handle);
+esp_err_t esp_tls_get_and_clear_last_error(esp_tls_error_handle_t h, int *esp_tls_code, int *esp_tls_flags);
+esp_tls_client_session_t *esp_tls_get_client_session(esp_tls_t *tls);
+void esp_tls_free_client_session(esp_tls_client_session_t *client_session);
+
+#endif /* TEST_ESP_TLS_H_ */
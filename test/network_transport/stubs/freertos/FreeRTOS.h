@@ -0,0 +1,38 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the FreeRTOS types and the scheduler calls of the transport.
+ *
+ * Time is a tick counter owned by the test, it only moves when the test advances it.
+ */
+#ifndef TEST_FREERTOS_H_
+#define TEST_FREERTOS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+#define pdFALSE                 ((BaseType_t)0)
+#define pdTRUE                  ((BaseType_t)1)
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+typedef struct TimeOut
+{
+  TickType_t xTimeOnEntering;
+} TimeOut_t;
+
+// Current tick count of the test clock
+extern TickType_t test_tick_count;
+
+void vTaskSetTimeOutState(TimeOut_t *pxTimeOut);
+BaseType_t xTaskCheckForTimeOut(TimeOut_t *pxTimeOut, TickType_t *pxTicksToWait);
+void vTaskDelay(TickType_t xTicksToDelay);
+
+#endif /* TEST_FREERTOS_H_ */
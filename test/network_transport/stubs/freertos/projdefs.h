@@ -0,0 +1,10 @@
+/**
+ * @file projdefs.h
+ * @brief Host stand-in, the definitions are in FreeRTOS.h.
+ */
+#ifndef TEST_PROJDEFS_H_
+#define TEST_PROJDEFS_H_
+
+#include "freertos/FreeRTOS.h"
+
+#endif /* TEST_PROJDEFS_H_ */
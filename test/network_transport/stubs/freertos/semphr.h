@@ -0,0 +1,15 @@
+/**
+ * @file semphr.h
+ * @brief Host stand-in for the mutex of the network context, never contended in the tests.
+ */
+#ifndef TEST_SEMPHR_H_
+#define TEST_SEMPHR_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t xSemaphore, TickType_t xBlockTime);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t xSemaphore);
+
+#endif /* TEST_SEMPHR_H_ */
@@ -0,0 +1,11 @@
+/**
+ * @file sdkconfig.h
+ * @brief Host stand-in for the options of sdkconfig.defaults the transport depends on.
+ */
+#ifndef TEST_SDKCONFIG_H_
+#define TEST_SDKCONFIG_H_
+
+#define CONFIG_FREERTOS_HZ                      100
+#define CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS   1
+
+#endif /* TEST_SDKCONFIG_H_ */
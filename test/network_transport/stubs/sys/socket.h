@@ -0,0 +1,16 @@
+/**
+ * @file socket.h
+ * @brief Host stand-in for the lwIP socket header, select() is routed to the test.
+ */
+#ifndef TEST_SYS_SOCKET_H_
+#define TEST_SYS_SOCKET_H_
+
+#include_next <sys/socket.h>
+#include <fcntl.h>
+#include <sys/select.h>
+
+#define select test_select
+
+int test_select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout);
+
+#endif /* TEST_SYS_SOCKET_H_ */
@@ -0,0 +1,280 @@
+/**
+ * @file wifi_sm_test.c
+ * @brief Host test of the Wi-Fi connection state machine.
+ *
+ * A few scripted sequences check the retry and backoff behavior step by step, then random event
+ * sequences check the invariants after every event:
+ *  - IDLE is only left on BOOT or HTTP_CONNECT,
+ *  - retries never exceed WIFI_SM_MAX_RETRIES,
+ *  - backoff_ms stays within [WIFI_SM_BACKOFF_MIN_MS, WIFI_SM_BACKOFF_MAX_MS] and every retry timer
+ *    delay follows the doubling sequence, which restarts after a connection,
+ *  - from SAVED_CONNECTING, link down events alone reach WAITING within a bounded number of
+ *    attempts, and a GOT_IP on the way reaches CONNECTED.
+ *
+ * Usage: wifi_sm_test [seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wifi_sm.h"
+
+#define FUZZ_SEQUENCES   200
+#define FUZZ_STEPS       5000
+
+static unsigned failures = 0;
+
+#define CHECK(cond, ...)                                                                          \
+  do                                                                                              \
+  {                                                                                               \
+    if (!(cond))                                                                                  \
+    {                                                                                             \
+      if (failures++ < 20)                                                                        \
+      {                                                                                           \
+        printf("%s:%d: FAIL: ", __FILE__, __LINE__);                                              \
+        printf(__VA_ARGS__);                                                                      \
+        printf("\n");                                                                             \
+      }                                                                                           \
+    }                                                                                             \
+  } while (0)
+
+static uint32_t rng_state;
+
+static uint32_t rng_next(void)
+{
+  // xorshift32, the same sequence on every host for a given seed
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static wifi_sm_state_e feed(wifi_sm_t *sm, wifi_sm_event_id_e id, uint8_t value, wifi_sm_actions_t *actions)
+{
+  wifi_sm_event_t event = { .id = id, .value = value };
+  return wifi_sm_handle(sm, &event, actions);
+}
+
+static bool has_action(const wifi_sm_actions_t *actions, wifi_sm_action_e action)
+{
+  for (uint8_t i = 0; i < actions->count; i++)
+  {
+    if (actions->list[i] == action)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t next_backoff(uint32_t backoff_ms)
+{
+  return (backoff_ms * 2 > WIFI_SM_BACKOFF_MAX_MS) ? WIFI_SM_BACKOFF_MAX_MS : backoff_ms * 2;
+}
+
+/**
+ * Scans that find nothing wait 5, 10, 20 ... s up to the maximum, a connection restarts the sequence.
+ */
+static void test_backoff_sequence(void)
+{
+  static const uint32_t expected[] = { 5000, 10000, 20000, 40000, 80000, 160000, 300000, 300000 };
+  wifi_sm_t sm;
+  wifi_sm_actions_t actions;
+
+  wifi_sm_init(&sm);
+  feed(&sm, WIFI_SM_EV_BOOT, WIFI_SM_BOOT_HAS_SAVED_NETWORKS, &actions);
+  CHECK(sm.state == WIFI_SM_STATE_SCANNING, "boot with saved networks scans, state %s", wifi_sm_state_name(sm.state));
+
+  for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++)
+  {
+    feed(&sm, WIFI_SM_EV_SCAN_DONE, 0, &actions);
+    CHECK(sm.state == WIFI_SM_STATE_WAITING, "empty scan %u waits, state %s", (unsigned)i, wifi_sm_state_name(sm.state));
+    CHECK(has_action(&actions, WIFI_SM_ACTION_START_RETRY_TIMER), "empty scan %u starts the retry timer", (unsigned)i);
+    CHECK(actions.delay_ms == expected[i], "delay %u is %u ms, expected %u ms", (unsigned)i,
+          (unsigned)actions.delay_ms, (unsigned)expected[i]);
+
+    feed(&sm, WIFI_SM_EV_RETRY_TIMER, 0, &actions);
+    CHECK(sm.state == WIFI_SM_STATE_SCANNING, "retry timer %u scans, state %s", (unsigned)i, wifi_sm_state_name(sm.state));
+  }
+
+  // Connect, lose the link and exhaust the reconnects, the next wait starts over
+  feed(&sm, WIFI_SM_EV_SCAN_DONE, 1, &actions);
+  feed(&sm, WIFI_SM_EV_GOT_IP, 0, &actions);
+  CHECK(sm.state == WIFI_SM_STATE_CONNECTED, "GOT_IP connects, state %s", wifi_sm_state_name(sm.state));
+  CHECK(sm.backoff_ms == WIFI_SM_BACKOFF_MIN_MS, "backoff is reset on connection, %u ms", (unsigned)sm.backoff_ms);
+
+  for (int i = 0; i <= WIFI_SM_MAX_RETRIES; i++)
+  {
+    feed(&sm, WIFI_SM_EV_LINK_DOWN, 0, &actions);
+  }
+  CHECK(sm.state == WIFI_SM_STATE_SCANNING, "exhausted reconnects scan, state %s", wifi_sm_state_name(sm.state));
+  feed(&sm, WIFI_SM_EV_SCAN_DONE, 0, &actions);
+  CHECK(actions.delay_ms == WIFI_SM_BACKOFF_MIN_MS, "first delay after a connection is %u ms", (unsigned)actions.delay_ms);
+}
+
+/**
+ * Only BOOT and HTTP_CONNECT leave IDLE, everything else is ignored.
+ */
+static void test_idle_ignores_events(void)
+{
+  for (int id = 0; id < WIFI_SM_EV_COUNT; id++)
+  {
+    for (int value = 0; value < 4; value++)
+    {
+      wifi_sm_t sm;
+      wifi_sm_actions_t actions;
+
+      wifi_sm_init(&sm);
+      feed(&sm, (wifi_sm_event_id_e)id, (uint8_t)value, &actions);
+
+      if (id == WIFI_SM_EV_BOOT || id == WIFI_SM_EV_HTTP_CONNECT)
+      {
+        continue;
+      }
+      CHECK(sm.state == WIFI_SM_STATE_IDLE, "%s(%d) left IDLE for %s", wifi_sm_event_name(id), value,
+            wifi_sm_state_name(sm.state));
+      CHECK(actions.count == 0, "%s(%d) in IDLE requested %u actions", wifi_sm_event_name(id), value, actions.count);
+    }
+  }
+}
+
+/**
+ * Each candidate is retried WIFI_SM_MAX_RETRIES times before the next one, then the machine waits.
+ */
+static void test_saved_connecting_retries(void)
+{
+  wifi_sm_t sm;
+  wifi_sm_actions_t actions;
+
+  wifi_sm_init(&sm);
+  feed(&sm, WIFI_SM_EV_BOOT, WIFI_SM_BOOT_HAS_SAVED_NETWORKS, &actions);
+  feed(&sm, WIFI_SM_EV_SCAN_DONE, 2, &actions);
+  CHECK(sm.state == WIFI_SM_STATE_SAVED_CONNECTING, "scan with candidates connects, state %s", wifi_sm_state_name(sm.state));
+  CHECK(has_action(&actions, WIFI_SM_ACTION_CONNECT_CANDIDATE) && actions.candidate == 0, "first candidate is joined");
+
+  for (uint8_t candidate = 0; candidate < 2; candidate++)
+  {
+    for (int i = 1; i <= WIFI_SM_MAX_RETRIES; i++)
+    {
+      feed(&sm, WIFI_SM_EV_LINK_DOWN, 0, &actions);
+      CHECK(sm.state == WIFI_SM_STATE_SAVED_CONNECTING && has_action(&actions, WIFI_SM_ACTION_RECONNECT),
+            "candidate %u retry %d reconnects, state %s", candidate, i, wifi_sm_state_name(sm.state));
+      CHECK(sm.retries == i, "candidate %u retries %u, expected %d", candidate, sm.retries, i);
+    }
+
+    feed(&sm, WIFI_SM_EV_LINK_DOWN, 0, &actions);
+    if (candidate == 0)
+    {
+      CHECK(has_action(&actions, WIFI_SM_ACTION_CONNECT_CANDIDATE) && actions.candidate == 1,
+            "second candidate is joined after the retries of the first");
+      CHECK(sm.retries == 0, "retries restart for the next candidate, %u", sm.retries);
+    }
+  }
+
+  CHECK(sm.state == WIFI_SM_STATE_WAITING, "all candidates failed, state %s", wifi_sm_state_name(sm.state));
+  CHECK(has_action(&actions, WIFI_SM_ACTION_START_RETRY_TIMER), "waiting starts the retry timer");
+}
+
+/**
+ * From a copy of sm in SAVED_CONNECTING, feeds link down events until the state changes: it must
+ * be WAITING within the attempts left. A second copy receives GOT_IP after a random number of them
+ * and must be CONNECTED.
+ */
+static void check_saved_connecting_progress(const wifi_sm_t *sm, uint32_t seed, int step)
+{
+  // Retries of the current candidate, then the join and retries of each remaining one
+  int bound = (WIFI_SM_MAX_RETRIES + 1) * (sm->candidate_count - sm->candidate_next + 1) + 1;
+  int got_ip_after = (int)(rng_next() % (uint32_t)bound);
+  wifi_sm_t down = *sm;
+  wifi_sm_t up = *sm;
+  wifi_sm_actions_t actions;
+  int steps = 0;
+
+  while (down.state == WIFI_SM_STATE_SAVED_CONNECTING && steps < bound)
+  {
+    feed(&down, WIFI_SM_EV_LINK_DOWN, 0, &actions);
+    steps++;
+  }
+  CHECK(down.state == WIFI_SM_STATE_WAITING, "seed %u step %d: %d link downs from SAVED_CONNECTING end in %s",
+        (unsigned)seed, step, steps, wifi_sm_state_name(down.state));
+
+  for (int i = 0; i < got_ip_after && up.state == WIFI_SM_STATE_SAVED_CONNECTING; i++)
+  {
+    feed(&up, WIFI_SM_EV_LINK_DOWN, 0, &actions);
+  }
+  if (up.state == WIFI_SM_STATE_SAVED_CONNECTING)
+  {
+    feed(&up, WIFI_SM_EV_GOT_IP, 0, &actions);
+    CHECK(up.state == WIFI_SM_STATE_CONNECTED, "seed %u step %d: GOT_IP in SAVED_CONNECTING gives %s",
+          (unsigned)seed, step, wifi_sm_state_name(up.state));
+  }
+}
+
+/**
+ * Random event sequence checked after every event.
+ */
+static void fuzz_sequence(uint32_t seed)
+{
+  wifi_sm_t sm;
+  wifi_sm_actions_t actions;
+  uint32_t expected_backoff_ms = WIFI_SM_BACKOFF_MIN_MS;
+
+  rng_state = seed;
+  wifi_sm_init(&sm);
+
+  for (int step = 0; step < FUZZ_STEPS; step++)
+  {
+    wifi_sm_event_id_e id = (wifi_sm_event_id_e)(rng_next() % WIFI_SM_EV_COUNT);
+    uint8_t value = (uint8_t)(rng_next() % 5);
+    wifi_sm_state_e before = sm.state;
+
+    feed(&sm, id, value, &actions);
+
+    CHECK(sm.state < WIFI_SM_STATE_COUNT, "seed %u step %d: invalid state %d", (unsigned)seed, step, (int)sm.state);
+    CHECK(actions.count <= WIFI_SM_MAX_ACTIONS, "seed %u step %d: %u actions", (unsigned)seed, step, actions.count);
+    CHECK(before != WIFI_SM_STATE_IDLE || sm.state == WIFI_SM_STATE_IDLE ||
+          id == WIFI_SM_EV_BOOT || id == WIFI_SM_EV_HTTP_CONNECT,
+          "seed %u step %d: %s left IDLE for %s", (unsigned)seed, step, wifi_sm_event_name(id), wifi_sm_state_name(sm.state));
+    CHECK(sm.retries <= WIFI_SM_MAX_RETRIES, "seed %u step %d: %u retries", (unsigned)seed, step, sm.retries);
+    CHECK(sm.backoff_ms >= WIFI_SM_BACKOFF_MIN_MS && sm.backoff_ms <= WIFI_SM_BACKOFF_MAX_MS,
+          "seed %u step %d: backoff %u ms", (unsigned)seed, step, (unsigned)sm.backoff_ms);
+
+    // A new connection restarts the sequence, every wait uses its next delay
+    if (has_action(&actions, WIFI_SM_ACTION_SAVE_CONNECTION))
+    {
+      expected_backoff_ms = WIFI_SM_BACKOFF_MIN_MS;
+    }
+    if (has_action(&actions, WIFI_SM_ACTION_START_RETRY_TIMER))
+    {
+      CHECK(actions.delay_ms == expected_backoff_ms, "seed %u step %d: retry timer of %u ms, expected %u ms",
+            (unsigned)seed, step, (unsigned)actions.delay_ms, (unsigned)expected_backoff_ms);
+      expected_backoff_ms = next_backoff(expected_backoff_ms);
+    }
+    CHECK(sm.backoff_ms == expected_backoff_ms, "seed %u step %d: next backoff %u ms, expected %u ms",
+          (unsigned)seed, step, (unsigned)sm.backoff_ms, (unsigned)expected_backoff_ms);
+
+    if (sm.state == WIFI_SM_STATE_SAVED_CONNECTING)
+    {
+      check_saved_connecting_progress(&sm, seed, step);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t seed = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : 1;
+
+  test_backoff_sequence();
+  test_idle_ignores_events();
+  test_saved_connecting_retries();
+
+  for (uint32_t i = 0; i < FUZZ_SEQUENCES; i++)
+  {
+    // xorshift32 never leaves 0
+    fuzz_sequence((seed + i) ? (seed + i) : 1);
+  }
+
+  printf("%u sequences of %d events from seed %u, %u failures\n", FUZZ_SEQUENCES, FUZZ_STEPS, (unsigned)seed, failures);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Measures requests per second and latency of the device web server with concurrent clients.
+
+  http_load_test.py http://192.168.0.1 --clients 1,2,4,8,16 --duration 10
+
+Every client is a thread with its own keep-alive connection, like a browser tab polling the
+device, --close opens a connection per request instead. Each level of concurrency runs for
+--duration seconds and prints the request rate, latency percentiles and errors. With --stats the
+connection counters of /httpStats.json are read after each level, showing how many requests
+reused a connection and how many sessions the server closed.
+
+Run it from a laptop joined to the SoftAP, or against any build of the server reachable on
+the host.
+"""
+import argparse
+import http.client
+import json
+import sys
+import threading
+import time
+import urllib.parse
+from typing import Dict, List, Optional, Tuple
+
+
+class Client(threading.Thread):
+    """Sends requests until the deadline and records their latencies."""
+
+    def __init__(self, host: str, port: int, paths: List[str], deadline: float, timeout: float,
+                 keep_alive: bool, offset: int) -> None:
+        super().__init__(daemon=True)
+        self.host = host
+        self.port = port
+        self.paths = paths
+        self.deadline = deadline
+        self.timeout = timeout
+        self.keep_alive = keep_alive
+        self.offset = offset
+        self.latencies: List[float] = []
+        self.errors: Dict[str, int] = {}
+        self.connections = 0
+
+    def connect(self) -> http.client.HTTPConnection:
+        self.connections += 1
+        return http.client.HTTPConnection(self.host, self.port, timeout=self.timeout)
+
+    def run(self) -> None:
+        conn: Optional[http.client.HTTPConnection] = None
+        index = self.offset
+        while time.monotonic() < self.deadline:
+            path = self.paths[index % len(self.paths)]
+            index += 1
+            if conn is None:
+                conn = self.connect()
+            start = time.monotonic()
+            try:
+                headers = {} if self.keep_alive else {'Connection': 'close'}
+                conn.request('GET', path, headers=headers)
+                response = conn.getresponse()
+                response.read()
+                if response.status != 200:
+                    self.error('HTTP %d' % response.status)
+                else:
+                    self.latencies.append(time.monotonic() - start)
+                if not self.keep_alive or response.will_close:
+                    conn.close()
+                    conn = None
+            except (OSError, http.client.HTTPException) as e:
+                self.error(type(e).__name__)
+                conn.close()
+                conn = None
+                # Back off briefly so a refusing server is not flooded with connects
+                time.sleep(0.05)
+        if conn is not None:
+            conn.close()
+
+    def error(self, name: str) -> None:
+        self.errors[name] = self.errors.get(name, 0) + 1
+
+
+def percentile(values: List[float], fraction: float) -> float:
+    if not values:
+        return 0.0
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def read_stats(host: str, port: int, timeout: float) -> Optional[Dict[str, int]]:
+    try:
+        conn = http.client.HTTPConnection(host, port, timeout=timeout)
+        conn.request('GET', '/httpStats.json', headers={'Connection': 'close'})
+        response = conn.getresponse()
+        body = response.read()
+        conn.close()
+        return json.loads(body) if response.status == 200 else None
+    except (OSError, http.client.HTTPException, ValueError):
+        return None
+
+
+def run_level(args: argparse.Namespace, host: str, port: int, clients: int) -> Tuple[str, bool]:
+    deadline = time.monotonic() + args.duration
+    threads = [Client(host, port, args.path, deadline, args.timeout, not args.close, i) for i in range(clients)]
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.monotonic() - start
+
+    latencies = sorted(value for thread in threads for value in thread.latencies)
+    errors: Dict[str, int] = {}
+    for thread in threads:
+        for name, count in thread.errors.items():
+            errors[name] = errors.get(name, 0) + count
+    connections = sum(thread.connections for thread in threads)
+
+    line = '%7d %8d %8.1f %8.1f %8.1f %8.1f %8.1f %6d %6d  %s' % (
+        clients, len(latencies), len(latencies) / elapsed,
+        percentile(latencies, 0.50) * 1000, percentile(latencies, 0.90) * 1000,
+        percentile(latencies, 0.99) * 1000, (latencies[-1] if latencies else 0.0) * 1000,
+        connections, sum(errors.values()), ', '.join('%s %d' % item for item in sorted(errors.items())))
+    return line.rstrip(), len(latencies) > 0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Load test of the device web server.')
+    parser.add_argument('url', nargs='?', default='http://192.168.0.1', help='server, default http://192.168.0.1')
+    parser.add_argument('--path', action='append', help='path to request, repeat to rotate, default /deviceState.json')
+    parser.add_argument('--clients', default='1,2,4,8,16', help='concurrency levels, default 1,2,4,8,16')
+    parser.add_argument('--duration', type=float, default=10.0, help='seconds per level, default 10')
+    parser.add_argument('--timeout', type=float, default=5.0, help='socket timeout in seconds, default 5')
+    parser.add_argument('--pause', type=float, default=2.0, help='seconds between levels, default 2')
+    parser.add_argument('--close', action='store_true', help='open a connection per request')
+    parser.add_argument('--stats', action='store_true', help='read /httpStats.json after each level')
+    args = parser.parse_args()
+
+    if not args.path:
+        args.path = ['/deviceState.json']
+    url = urllib.parse.urlsplit(args.url)
+    host = url.hostname or '192.168.0.1'
+    port = url.port or 80
+    try:
+        levels = [int(value) for value in args.clients.split(',')]
+    except ValueError:
+        print('http_load_test: bad --clients %r' % args.clients, file=sys.stderr)
+        return 2
+
+    print('%s:%d %s, %s, %g s per level' % (host, port, ' '.join(args.path),
+                                            'new connection per request' if args.close else 'keep-alive',
+                                            args.duration))
+    print('clients requests    req/s  p50 ms   p90 ms   p99 ms   max ms  conns errors')
+
+    ok = True
+    previous = read_stats(host, port, args.timeout) if args.stats else None
+    for index, clients in enumerate(levels):
+        if index > 0:
+            time.sleep(args.pause)
+        line, served = run_level(args, host, port, clients)
+        print(line)
+        ok = ok and served
+        if args.stats:
+            stats = read_stats(host, port, args.timeout)
+            if stats is not None and previous is not None:
+                delta = {key: stats[key] - previous.get(key, 0) for key in stats
+                         if key not in ('open', 'peak', 'max_sockets')}
+                print('        server: %s, open %d, peak %d of %d' % (
+                    ', '.join('%s %d' % (key, value) for key, value in delta.items()),
+                    stats.get('open', 0), stats.get('peak', 0), stats.get('max_sockets', 0)))
+            previous = stats
+        sys.stdout.flush()
+
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
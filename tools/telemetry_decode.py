@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Reference decoder of the telemetry payloads published by the device.
+
+The last level of the telemetry topic names the encoding of the payload:
+
+  json       JSON object with a "samples" array
+  ts1        binary time series, see main/telemetry_codec.h
+  json.lz4   json compressed with LZ4
+  ts1.lz4    ts1 compressed with LZ4
+
+Every encoding is decoded to the json form, values stay in tenths as read.
+
+  telemetry_decode.py esp32/telemetry/ts1.lz4 payload.bin
+  mosquitto_sub ... -t 'esp32/telemetry/ts1' -C 1 | telemetry_decode.py ts1
+"""
+import argparse
+import json
+import sys
+from typing import Dict, List, Tuple
+
+SERIES_VERSION = 1
+
+
+class Reader:
+    def __init__(self, data: bytes) -> None:
+        self.data = data
+        self.pos = 0
+
+    def u8(self) -> int:
+        if self.pos >= len(self.data):
+            raise ValueError('payload truncated at byte %d' % self.pos)
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def uvarint(self) -> int:
+        value = 0
+        shift = 0
+        while True:
+            byte = self.u8()
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+            if shift > 63:
+                raise ValueError('varint too long at byte %d' % self.pos)
+
+    def svarint(self) -> int:
+        value = self.uvarint()
+        return (value >> 1) ^ -(value & 1)
+
+
+def lz4_decompress(payload: bytes) -> bytes:
+    """Decodes a uvarint size followed by one LZ4 block."""
+    reader = Reader(payload)
+    size = reader.uvarint()
+    data = payload[reader.pos:]
+    out = bytearray()
+    pos = 0
+
+    def length(nibble: int) -> int:
+        nonlocal pos
+        if nibble == 15:
+            while True:
+                byte = data[pos]
+                pos += 1
+                nibble += byte
+                if byte != 255:
+                    break
+        return nibble
+
+    while pos < len(data):
+        token = data[pos]
+        pos += 1
+        literal_len = length(token >> 4)
+        out += data[pos:pos + literal_len]
+        pos += literal_len
+        if pos >= len(data):
+            break
+        offset = data[pos] | data[pos + 1] << 8
+        pos += 2
+        if offset == 0 or offset > len(out):
+            raise ValueError('bad LZ4 match offset %d' % offset)
+        match_len = length(token & 0x0F) + 4
+        # Byte by byte, a match may overlap the bytes it produces
+        for _ in range(match_len):
+            out.append(out[-offset])
+
+    if len(out) != size:
+        raise ValueError('LZ4 block holds %d bytes, %d expected' % (len(out), size))
+    return bytes(out)
+
+
+def decode_series(payload: bytes) -> Dict[str, List[Dict[str, int]]]:
+    reader = Reader(payload)
+    version = reader.u8()
+    if version != SERIES_VERSION:
+        raise ValueError('unsupported time series version %d' % version)
+
+    samples: List[Tuple[int, int, int, int]] = []
+    for _ in range(reader.uvarint()):
+        sensor = reader.u8()
+        count = reader.uvarint()
+        times = [reader.uvarint()]
+        delta = 0
+        for _ in range(count - 1):
+            delta += reader.svarint()
+            times.append(times[-1] + delta)
+        columns = []
+        for _ in range(2):
+            column = [reader.svarint()]
+            for _ in range(count - 1):
+                column.append(column[-1] + reader.svarint())
+            columns.append(column)
+        samples += zip(times, [sensor] * count, columns[0], columns[1])
+
+    if reader.pos != len(payload):
+        raise ValueError('%d bytes after the last series' % (len(payload) - reader.pos))
+
+    # The device sends the samples of a batch in time order, sensor by sensor here
+    samples.sort(key=lambda sample: sample[0])
+    return {'samples': [{'ts': t, 'sensor': s, 'temperature': temp, 'humidity': hum}
+                        for t, s, temp, hum in samples]}
+
+
+def decode(encoding: str, payload: bytes) -> Dict[str, List[Dict[str, int]]]:
+    encoding = encoding.rsplit('/', 1)[-1]
+    if encoding.endswith('.lz4'):
+        payload = lz4_decompress(payload)
+        encoding = encoding[:-len('.lz4')]
+    if encoding == 'json':
+        return json.loads(payload.decode('utf-8'))
+    if encoding == 'ts1':
+        return decode_series(payload)
+    raise ValueError('unknown encoding %s' % encoding)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Decodes a telemetry payload to JSON.')
+    parser.add_argument('encoding', help='topic the payload was published to, or its last level')
+    parser.add_argument('payload', nargs='?', help='file holding the payload, standard input if omitted')
+    args = parser.parse_args()
+
+    if args.payload is None:
+        payload = sys.stdin.buffer.read()
+    else:
+        with open(args.payload, 'rb') as f:
+            payload = f.read()
+
+    try:
+        decoded = decode(args.encoding, payload)
+    except (ValueError, IndexError) as e:
+        print('telemetry_decode: %s' % e, file=sys.stderr)
+        return 1
+
+    json.dump(decoded, sys.stdout, indent=2)
+    print()
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Converts the event trace downloaded from the device to the Chrome trace format.
+
+  curl -o trace.bin http://192.168.0.1/trace.bin
+  trace_to_chrome.py trace.bin trace.json
+
+Open trace.json in chrome://tracing or https://ui.perfetto.dev. Every task is a thread, begin
+and end events show as slices and the event arguments are listed in their details. The layout
+of trace.bin is described in main/trace.h.
+"""
+import argparse
+import json
+import struct
+import sys
+from typing import Any, Dict, List, Tuple
+
+MAGIC = b'TRC1'
+HEADER = struct.Struct('<4sBBBxII')
+TASK_NAME_SIZE = 16
+EVENT_NAME_SIZE = 24
+LABEL = struct.Struct('<Bxxx I 32s')
+RECORD = struct.Struct('<IBBHII')
+TASK_OTHER = 0xFF
+
+
+def cstring(data: bytes) -> str:
+    return data.split(b'\0', 1)[0].decode('utf-8', 'replace')
+
+
+def convert(data: bytes) -> Tuple[Dict[str, Any], int]:
+    """Returns the Chrome trace and the number of records missing from the ring."""
+    magic, task_count, event_count, label_count, first, end = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError('not a trace, magic %r' % magic)
+    pos = HEADER.size
+
+    tasks = []
+    for _ in range(task_count):
+        tasks.append(cstring(data[pos:pos + TASK_NAME_SIZE]))
+        pos += TASK_NAME_SIZE
+
+    events = []
+    for _ in range(event_count):
+        events.append((chr(data[pos]), cstring(data[pos + 1:pos + EVENT_NAME_SIZE])))
+        pos += EVENT_NAME_SIZE
+
+    labels: Dict[Tuple[int, int], str] = {}
+    for _ in range(label_count):
+        event, arg0, label = LABEL.unpack_from(data, pos)
+        labels[(event, arg0)] = cstring(label)
+        pos += LABEL.size
+
+    if (len(data) - pos) % RECORD.size != 0:
+        raise ValueError('truncated record at the end of the trace')
+
+    trace: List[Dict[str, Any]] = []
+    for index, name in enumerate(tasks):
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 0, 'tid': index, 'args': {'name': name}})
+    trace.append({'ph': 'M', 'name': 'thread_name', 'pid': 0, 'tid': TASK_OTHER, 'args': {'name': 'other'}})
+
+    records = 0
+    base = 0
+    last = None
+    for timestamp, event, task, _, arg0, arg1 in RECORD.iter_unpack(data[pos:]):
+        # Timestamps are the low 32 bits of the microsecond clock. Records are ordered by their slot
+        # but the time is read after the slot is claimed, so on two cores or after a preemption a
+        # record can be a little older than the one before it. Only a large step back is a wrap
+        if last is not None and last - timestamp > 1 << 31:
+            base += 1 << 32
+            last = timestamp
+        elif last is None or timestamp > last:
+            last = timestamp
+        records += 1
+
+        phase, name = events[event] if event < len(events) else ('i', 'event_%d' % event)
+        label = labels.get((event, arg0))
+        if label is not None:
+            name = '%s %s' % (name, label)
+        entry = {'ph': phase, 'name': name, 'pid': 0, 'tid': task, 'ts': base + timestamp,
+                 'args': {'arg0': arg0, 'arg1': arg1}}
+        if phase == 'i':
+            entry['s'] = 't'
+        trace.append(entry)
+
+    return {'traceEvents': trace, 'displayTimeUnit': 'ms'}, (end - first) - records
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Converts trace.bin to a Chrome trace.')
+    parser.add_argument('trace', help='trace downloaded from /trace.bin')
+    parser.add_argument('output', nargs='?', help='output file, standard output if omitted')
+    args = parser.parse_args()
+
+    with open(args.trace, 'rb') as f:
+        data = f.read()
+
+    try:
+        trace, missing = convert(data)
+    except (ValueError, struct.error) as e:
+        print('trace_to_chrome: %s' % e, file=sys.stderr)
+        return 1
+
+    if missing > 0:
+        print('trace_to_chrome: %d records were overwritten during the download' % missing, file=sys.stderr)
+
+    if args.output is None:
+        json.dump(trace, sys.stdout)
+    else:
+        with open(args.output, 'w') as f:
+            json.dump(trace, f)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())